@@ -73,8 +73,9 @@ DEFINE_string(feature_density,
               "features from each image.");
 DEFINE_string(matching_strategy,
               "CASCADE_HASHING",
-              "Strategy used to match features. Must be BRUTE_FORCE "
-              " or CASCADE_HASHING");
+              "Strategy used to match features. Must be BRUTE_FORCE, "
+              "CASCADE_HASHING, or (for binary descriptors) "
+              "BRUTE_FORCE_HAMMING or MULTI_INDEX_HASHING");
 DEFINE_string(matching_working_directory,
               "",
               "Directory used during matching to store features for "
@@ -97,6 +98,11 @@ DEFINE_bool(bundle_adjust_two_view_geometry,
 DEFINE_bool(keep_only_symmetric_matches,
             true,
             "Performs two-way matching and keeps symmetric matches.");
+DEFINE_bool(incremental_matching,
+            false,
+            "Only match images that the matching database does not record as "
+            "matched against the existing images, skipping pairs that were "
+            "already matched.");
 DEFINE_bool(select_image_pairs_with_global_image_descriptor_matching,
             true,
             "Use global descriptors to speed up image matching.");
@@ -279,6 +285,7 @@ ReconstructionBuilderOptions SetReconstructionBuilderOptions() {
   options.matching_options.lowes_ratio = FLAGS_lowes_ratio;
   options.matching_options.keep_only_symmetric_matches =
       FLAGS_keep_only_symmetric_matches;
+  options.matching_options.incremental_matching = FLAGS_incremental_matching;
   options.min_num_inlier_matches = FLAGS_min_num_inliers_for_valid_match;
   options.matching_options.perform_geometric_verification = true;
   options.matching_options.geometric_verification_options
@@ -413,13 +420,7 @@ void AddMatchesToReconstructionBuilder(
   // Add the matches.
   const auto match_keys = features_and_matches_database->ImageNamesOfMatches();
   LOG(INFO) << "Loading " << match_keys.size() << " matches from the DB.";
-  for (const auto& match_key : match_keys) {
-    const theia::ImagePairMatch& match =
-        features_and_matches_database->GetImagePairMatch(match_key.first,
-                                                         match_key.second);
-    CHECK(reconstruction_builder->AddTwoViewMatch(
-        match_key.first, match_key.second, match));
-  }
+  CHECK(reconstruction_builder->AddTwoViewMatches(match_keys));
 }
 
 void AddImagesToReconstructionBuilder(
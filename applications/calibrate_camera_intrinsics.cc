@@ -75,8 +75,9 @@ DEFINE_string(feature_density,
               "features from each image.");
 DEFINE_string(matching_strategy,
               "CASCADE_HASHING",
-              "Strategy used to match features. Must be BRUTE_FORCE "
-              " or CASCADE_HASHING");
+              "Strategy used to match features. Must be BRUTE_FORCE, "
+              "CASCADE_HASHING, or (for binary descriptors) "
+              "BRUTE_FORCE_HAMMING or MULTI_INDEX_HASHING");
 DEFINE_string(matching_working_directory,
               "",
               "Directory used during matching to store features for "
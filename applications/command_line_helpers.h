@@ -57,6 +57,8 @@ inline DescriptorExtractorType StringToDescriptorExtractorType(
     return DescriptorExtractorType::SIFT;
   } else if (descriptor == "AKAZE") {
     return DescriptorExtractorType::AKAZE;
+  } else if (descriptor == "AKAZE_MLDB") {
+    return DescriptorExtractorType::AKAZE_MLDB;
   } else {
     LOG(FATAL) << "Invalid DescriptorExtractor specified. Using SIFT instead.";
     return DescriptorExtractorType::SIFT;
@@ -84,6 +86,10 @@ inline MatchingStrategy StringToMatchingStrategyType(
     return MatchingStrategy::BRUTE_FORCE;
   } else if (matching_strategy == "CASCADE_HASHING") {
     return MatchingStrategy::CASCADE_HASHING;
+  } else if (matching_strategy == "BRUTE_FORCE_HAMMING") {
+    return MatchingStrategy::BRUTE_FORCE_HAMMING;
+  } else if (matching_strategy == "MULTI_INDEX_HASHING") {
+    return MatchingStrategy::MULTI_INDEX_HASHING;
   } else {
     LOG(FATAL)
         << "Invalid matching strategy specified. Using BRUTE_FORCE instead.";
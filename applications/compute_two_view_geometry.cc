@@ -68,7 +68,8 @@ DEFINE_string(feature_density,
 DEFINE_string(matching_strategy,
               "CASCADE_HASHING",
               "Strategy used to match features. Must be BRUTE_FORCE, "
-              "or CASCADE_HASHING");
+              "CASCADE_HASHING, or (for binary descriptors) "
+              "BRUTE_FORCE_HAMMING or MULTI_INDEX_HASHING");
 DEFINE_double(lowes_ratio, 0.75, "Lowes ratio used for feature matching.");
 DEFINE_double(
     max_sampson_error_for_verified_match,
@@ -48,6 +48,8 @@ DEFINE_string(images_directory, "",
               "Directory of input images. This is used to extract the "
               "principal point and image dimensions since Bundler does not "
               "provide those.");
+DEFINE_int32(num_threads, 1,
+             "Number of threads used to read the image sizes.");
 
 int main(int argc, char* argv[]) {
   google::InitGoogleLogging(argv[0]);
@@ -61,6 +63,7 @@ int main(int argc, char* argv[]) {
       << "Could not read Bundler files.";
   if (FLAGS_images_directory.size() > 0) {
     CHECK(theia::PopulateImageSizesAndPrincipalPoints(FLAGS_images_directory,
+                                                      FLAGS_num_threads,
                                                       &reconstruction));
   } else {
     LOG(INFO) << "The image directory was not provided so the principal point "
@@ -47,6 +47,7 @@ DEFINE_string(output_calibration_file, "",
 DEFINE_bool(initialize_uncalibrated_images_with_median_viewing_angle, true,
             "Images with no EXIF information initialize the focal length based "
             "on a focal length corresponding to a median viewing angle.");
+DEFINE_int32(num_threads, 1, "Number of threads used to read the EXIF data.");
 
 int main(int argc, char *argv[]) {
   THEIA_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
@@ -59,16 +60,19 @@ int main(int argc, char *argv[]) {
 
   std::unordered_map<std::string, theia::CameraIntrinsicsPrior> priors;
 
+  // Only the image headers are read, in parallel for all images.
   theia::ExifReader exif_reader;
+  std::vector<theia::CameraIntrinsicsPrior> exif_priors;
+  CHECK(exif_reader.ExtractEXIFMetadata(image_files, FLAGS_num_threads,
+                                        &exif_priors))
+      << "Could not open all images for reading.";
 
   //   image_name focal_length ppx ppy aspect_ratio skew k1 k2
   for (int i = 0; i < image_files.size(); i++) {
     std::string image_name;
     theia::GetFilenameFromFilepath(image_files[i], true, &image_name);
 
-    theia::CameraIntrinsicsPrior prior;
-    CHECK(exif_reader.ExtractEXIFMetadata(image_files[i], &prior))
-        << "Could not open " << image_files[i] << " for reading.";
+    theia::CameraIntrinsicsPrior& prior = exif_priors[i];
 
     // Only write the calibration for images with a focal length that was
     // extracted.
@@ -37,13 +37,17 @@
 
 #include "theia/alignment/alignment.h"
 #include "theia/image/descriptor/akaze_descriptor.h"
+#include "theia/image/descriptor/binary_descriptor.h"
 #include "theia/image/descriptor/create_descriptor_extractor.h"
 #include "theia/image/descriptor/descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
 #include "theia/image/descriptor/sift_descriptor.h"
+#include "theia/image/descriptor/sift_scale_space.h"
 #include "theia/image/image.h"
 #include "theia/image/image_cache.h"
 #include "theia/image/keypoint_detector/keypoint.h"
 #include "theia/image/keypoint_detector/keypoint_detector.h"
+#include "theia/image/keypoint_detector/keypoint_selection.h"
 #include "theia/image/keypoint_detector/sift_detector.h"
 #include "theia/image/keypoint_detector/sift_parameters.h"
 #include "theia/io/bundler_file_reader.h"
@@ -65,6 +69,7 @@
 #include "theia/io/write_nvm_file.h"
 #include "theia/io/write_ply_file.h"
 #include "theia/matching/brute_force_feature_matcher.h"
+#include "theia/matching/brute_force_hamming_feature_matcher.h"
 #include "theia/matching/cascade_hasher.h"
 #include "theia/matching/cascade_hashing_feature_matcher.h"
 #include "theia/matching/create_feature_matcher.h"
@@ -77,10 +82,13 @@
 #include "theia/matching/fisher_vector_extractor.h"
 #include "theia/matching/global_descriptor_extractor.h"
 #include "theia/matching/guided_epipolar_matcher.h"
+#include "theia/matching/hamming_distance.h"
 #include "theia/matching/image_pair_match.h"
 #include "theia/matching/indexed_feature_match.h"
 #include "theia/matching/in_memory_features_and_matches_database.h"
 #include "theia/matching/keypoints_and_descriptors.h"
+#include "theia/matching/multi_index_hasher.h"
+#include "theia/matching/multi_index_hashing_feature_matcher.h"
 #include "theia/matching/rocksdb_features_and_matches_database.h"
 #include "theia/math/closed_form_polynomial_solver.h"
 #include "theia/math/constrained_l1_solver.h"
@@ -93,6 +101,7 @@
 #include "theia/math/graph/triplet_extractor.h"
 #include "theia/math/histogram.h"
 #include "theia/math/l1_solver.h"
+#include "theia/math/matrix/conjugate_gradient.h"
 #include "theia/math/matrix/gauss_jordan.h"
 #include "theia/math/matrix/linear_operator.h"
 #include "theia/math/matrix/rq_decomposition.h"
@@ -106,12 +115,17 @@
 #include "theia/math/rotation.h"
 #include "theia/math/util.h"
 #include "theia/sfm/bundle_adjustment/angular_epipolar_error.h"
+#include "theia/sfm/bundle_adjustment/batched_reprojection_error.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjust_two_views.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjuster.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
 #include "theia/sfm/bundle_adjustment/create_loss_function.h"
+#include "theia/sfm/bundle_adjustment/incremental_bundle_adjuster.h"
 #include "theia/sfm/bundle_adjustment/optimize_relative_position_with_known_rotation.h"
 #include "theia/sfm/bundle_adjustment/orthogonal_vector_error.h"
+#include "theia/sfm/bundle_adjustment/partitioned_bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/pinhole_reprojection_error_batch.h"
+#include "theia/sfm/bundle_adjustment/schur_bundle_adjustment_solver.h"
 #include "theia/sfm/bundle_adjustment/unit_norm_three_vector_parameterization.h"
 #include "theia/sfm/camera/camera.h"
 #include "theia/sfm/camera/camera_intrinsics_model.h"
@@ -220,6 +234,7 @@
 #include "theia/sfm/view_graph/orientations_from_maximum_spanning_tree.h"
 #include "theia/sfm/view_graph/remove_disconnected_view_pairs.h"
 #include "theia/sfm/view_graph/view_graph.h"
+#include "theia/sfm/view_graph/view_graph_snapshot.h"
 #include "theia/sfm/visibility_pyramid.h"
 #include "theia/solvers/estimator.h"
 #include "theia/solvers/evsac.h"
@@ -29,13 +29,54 @@
 
 #include <Eigen/Dense>
 #include <math.h>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <ctime>
+#include <functional>
 #include <iostream>
+#include <thread>
 
 
 using namespace libAKAZE;
 
+namespace {
+
+/* ************************************************************************* */
+// Calls func(i) for all i in [begin, end) with up to num_threads threads. The
+// indices are handed out dynamically since the cost of each index (e.g., an
+// evolution level) may vary greatly. This does not depend on OpenMP so that
+// AKAZEOptions::num_threads is always respected.
+void ParallelFor(const int num_threads, const int begin, const int end,
+                 const std::function<void(int)>& func) {
+  const int num_workers = std::min(num_threads, end - begin);
+  if (num_workers <= 1) {
+    for (int i = begin; i < end; i++) {
+      func(i);
+    }
+    return;
+  }
+
+  std::atomic<int> next_index(begin);
+  const auto worker = [&]() {
+    for (int i = next_index++; i < end; i = next_index++) {
+      func(i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_workers - 1);
+  for (int i = 1; i < num_workers; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace
+
 /* ************************************************************************* */
 AKAZE::AKAZE(const AKAZEOptions& options) : options_(options) {
   Eigen::initParallel();
@@ -112,7 +153,8 @@ void AKAZE::Allocate_Memory_Evolution() {
 }
 
 /* ************************************************************************* */
-int AKAZE::Create_Nonlinear_Scale_Space(const RowMatrixXf& img) {
+int AKAZE::Create_Nonlinear_Scale_Space(
+    const Eigen::Ref<const RowMatrixXf>& img) {
   if (evolution_.size() == 0) {
     std::cerr << "Error generating the nonlinear scale space!!" << std::endl;
     std::cerr << "Firstly you need to call AKAZE::Allocate_Memory_Evolution()"
@@ -198,11 +240,7 @@ void AKAZE::Feature_Detection(std::vector<AKAZEKeypoint>& kpts) {
 void AKAZE::Compute_Multiscale_Derivatives() {
   timer::Timer timer;
 
-#ifdef AKAZE_USE_OPENMP
-#pragma omp parallel for
-#endif
-  for (int i = 0; i < (int)(evolution_.size()); i++) {
-
+  ParallelFor(options_.num_threads, 0, evolution_.size(), [&](const int i) {
     float ratio = pow(2.f, (float)evolution_[i].octave);
     int sigma_size_ =
         fRound(evolution_[i].esigma * options_.derivative_factor / ratio);
@@ -223,7 +261,7 @@ void AKAZE::Compute_Multiscale_Derivatives() {
     evolution_[i].Lxx = evolution_[i].Lxx * ((sigma_size_) * (sigma_size_));
     evolution_[i].Lxy = evolution_[i].Lxy * ((sigma_size_) * (sigma_size_));
     evolution_[i].Lyy = evolution_[i].Lyy * ((sigma_size_) * (sigma_size_));
-  }
+  });
 
   timing_.derivatives = timer.elapsedMs();
 }
@@ -234,17 +272,19 @@ void AKAZE::Compute_Determinant_Hessian_Response() {
   // Firstly compute the multiscale derivatives
   Compute_Multiscale_Derivatives();
 
-  for (size_t i = 0; i < evolution_.size(); i++) {
-    if (options_.verbosity == true) {
+  if (options_.verbosity == true) {
+    for (size_t i = 0; i < evolution_.size(); i++) {
       std::cout
           << "Computing detector response. Determinant of Hessian. Evolution "
              "time: " << evolution_[i].etime << std::endl;
     }
+  }
 
+  ParallelFor(options_.num_threads, 0, evolution_.size(), [&](const int i) {
     evolution_[i].Ldet =
         evolution_[i].Lxx.cwiseProduct(evolution_[i].Lyy).array() -
         evolution_[i].Lxy.array().square();
-  }
+  });
 }
 
 /* ************************************************************************* */
@@ -462,69 +502,53 @@ void AKAZE::Compute_Descriptors(std::vector<AKAZEKeypoint>& kpts,
       t = options_.descriptor_size;
     }
 
+    // The bits are packed 8 per byte and set with bitwise-or so the
+    // descriptors must be zero-initialized.
     for (int i = 0; i < desc.binary_descriptor.size(); i++) {
-      desc.binary_descriptor[i].resize(t);
+      desc.binary_descriptor[i].setZero((t + 7) / 8);
     }
   }
 
   timer::Timer timer;
 
+  const int num_keypoints = kpts.size();
   switch (options_.descriptor) {
     case SURF_UPRIGHT:  // Upright descriptors, not invariant to rotation
     {
-
-#ifdef AKAZE_USE_OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
+      ParallelFor(options_.num_threads, 0, num_keypoints, [&](const int i) {
         Get_SURF_Descriptor_Upright_64(kpts[i], desc.float_descriptor[i]);
-      }
+      });
     } break;
     case SURF: {
-#ifdef AKAZE_USE_OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
+      ParallelFor(options_.num_threads, 0, num_keypoints, [&](const int i) {
         Compute_Main_Orientation(kpts[i]);
         Get_SURF_Descriptor_64(kpts[i], desc.float_descriptor[i]);
-      }
+      });
     } break;
     case MSURF_UPRIGHT:  // Upright descriptors, not invariant to rotation
     {
-#ifdef AKAZE_USE_OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
+      ParallelFor(options_.num_threads, 0, num_keypoints, [&](const int i) {
         Get_MSURF_Upright_Descriptor_64(kpts[i], desc.float_descriptor[i]);
-      }
+      });
     } break;
     case MSURF: {
-#ifdef AKAZE_USE_OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
+      ParallelFor(options_.num_threads, 0, num_keypoints, [&](const int i) {
         Compute_Main_Orientation(kpts[i]);
         Get_MSURF_Descriptor_64(kpts[i], desc.float_descriptor[i]);
-      }
+      });
     } break;
     case MLDB_UPRIGHT: {
-#ifdef AKAZE_USE_OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
+      ParallelFor(options_.num_threads, 0, num_keypoints, [&](const int i) {
         Get_Upright_MLDB_Full_Descriptor(
             kpts[i], (unsigned char*)(desc.binary_descriptor[i].data()));
-      }
+      });
     } break;
     case MLDB: {
-#ifdef AKAZE_USE_OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
+      ParallelFor(options_.num_threads, 0, num_keypoints, [&](const int i) {
         Compute_Main_Orientation(kpts[i]);
         Get_MLDB_Full_Descriptor(
             kpts[i], (unsigned char*)(desc.binary_descriptor[i].data()));
-      }
+      });
     } break;
   }
 
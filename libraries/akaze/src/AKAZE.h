@@ -79,7 +79,8 @@ class AKAZE {
   // created
   // @return 0 if the nonlinear scale space was created successfully, -1
   // otherwise
-  int Create_Nonlinear_Scale_Space(const RowMatrixXf& img);
+  // @note The image is not copied so a map of an existing buffer may be used.
+  int Create_Nonlinear_Scale_Space(const Eigen::Ref<const RowMatrixXf>& img);
 
   // @brief This method selects interesting keypoints through the nonlinear
   // scale space
@@ -52,7 +52,7 @@ inline double Gaussian(double x, double mu, double sigma) {
 
 }  // namespace
 
-void SeparableConvolution2d(const RowMatrixXf& image,
+void SeparableConvolution2d(const Eigen::Ref<const RowMatrixXf>& image,
                             const Eigen::RowVectorXf& kernel_x,
                             const Eigen::RowVectorXf& kernel_y,
                             const BorderType& border_type,
@@ -193,7 +193,7 @@ void ScharrDerivative(const RowMatrixXf& image,
   return;
 }
 
-void GaussianBlur(const RowMatrixXf& image,
+void GaussianBlur(const Eigen::Ref<const RowMatrixXf>& image,
                   const double sigma,
                   RowMatrixXf* out) {
   int kernel_size = std::ceil(((sigma - 0.8) / 0.3 + 1.0) * 2.0);
@@ -47,7 +47,9 @@ enum BorderType {
 };
 
 // Performs separable convolution using two filters of the same size.
-void SeparableConvolution2d(const RowMatrixXf& image,
+// The input image may be any row-major float matrix expression (e.g., a map of
+// an externally owned buffer) so that it does not need to be copied.
+void SeparableConvolution2d(const Eigen::Ref<const RowMatrixXf>& image,
                             const Eigen::RowVectorXf& kernel_x,
                             const Eigen::RowVectorXf& kernel_y,
                             const BorderType& border_type,
@@ -61,7 +63,7 @@ void ScharrDerivative(const RowMatrixXf& image,
                       const bool normalize,
                       RowMatrixXf* out);
 
-void GaussianBlur(const RowMatrixXf& image,
+void GaussianBlur(const Eigen::Ref<const RowMatrixXf>& image,
                   const double sigma,
                   RowMatrixXf* out);
 
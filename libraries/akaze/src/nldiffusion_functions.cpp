@@ -31,8 +31,8 @@
 namespace libAKAZE {
 
 /* ************************************************************************* */
-void gaussian_2D_convolution(const RowMatrixXf& src, RowMatrixXf& dst,
-                             size_t ksize_x, size_t ksize_y, float sigma) {
+void gaussian_2D_convolution(const Eigen::Ref<const RowMatrixXf>& src,
+                             RowMatrixXf& dst, size_t ksize_x, size_t ksize_y, float sigma) {
   GaussianBlur(src, sigma, &dst);
 }
 
@@ -80,8 +80,9 @@ void charbonnier_diffusivity(const RowMatrixXf& Lx, const RowMatrixXf& Ly,
 }
 
 /* ************************************************************************* */
-float compute_k_percentile(const RowMatrixXf& img, float perc, float gscale,
-                           size_t nbins, size_t ksize_x, size_t ksize_y) {
+float compute_k_percentile(const Eigen::Ref<const RowMatrixXf>& img, float perc,
+                           float gscale, size_t nbins, size_t ksize_x,
+                           size_t ksize_y) {
   size_t nbin = 0, nelements = 0, nthreshold = 0, k = 0;
   float kperc = 0.0, modg = 0.0, npoints = 0.0, hmax = 0.0;
 
@@ -17,8 +17,8 @@ typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
 
 /* ************************************************************************* */
 /// Convolve an image with a 2D Gaussian kernel
-void gaussian_2D_convolution(const RowMatrixXf& src, RowMatrixXf& dst,
-                             size_t ksize_x, size_t ksize_y, float sigma);
+void gaussian_2D_convolution(const Eigen::Ref<const RowMatrixXf>& src,
+                             RowMatrixXf& dst, size_t ksize_x, size_t ksize_y, float sigma);
 
 /// This function computes image derivatives with Scharr kernel
 /// @param src Input image
@@ -86,8 +86,9 @@ void charbonnier_diffusivity(const RowMatrixXf& Lx, const RowMatrixXf& Ly,
 /// @param ksize_y Kernel size in Y-direction (vertical) for the Gaussian
 /// smoothing kernel
 /// @return k contrast factor
-float compute_k_percentile(const RowMatrixXf& img, float perc, float gscale,
-                           size_t nbins, size_t ksize_x, size_t ksize_y);
+float compute_k_percentile(const Eigen::Ref<const RowMatrixXf>& img, float perc,
+                           float gscale, size_t nbins, size_t ksize_x,
+                           size_t ksize_y);
 
 /// This function computes Scharr image derivatives
 /// @param src Input image
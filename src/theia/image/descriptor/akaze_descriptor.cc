@@ -55,22 +55,60 @@ bool AkazeDescriptorExtractor::ComputeDescriptor(const FloatImage& image,
                 "instead.";
 }
 
+bool AkazeDescriptorExtractor::HasBinaryDescriptors() const {
+  return akaze_params_.descriptor_type == AkazeDescriptorType::MLDB ||
+         akaze_params_.descriptor_type == AkazeDescriptorType::MLDB_UPRIGHT;
+}
+
 bool AkazeDescriptorExtractor::DetectAndExtractDescriptors(
     const FloatImage& image,
     std::vector<Keypoint>* keypoints,
     std::vector<Eigen::VectorXf>* descriptors) {
-  // Try to convert the image to grayscale and eigen type.
+  if (HasBinaryDescriptors()) {
+    LOG(ERROR) << "The AKAZE MLDB descriptor is a binary descriptor. Please use "
+                  "AkazeDescriptorExtractor::DetectAndExtractBinaryDescriptors() "
+                  "instead.";
+    return false;
+  }
+
+  libAKAZE::AKAZEDescriptors akaze_descriptors;
+  DetectAndExtractAkazeFeatures(image, keypoints, &akaze_descriptors);
+  std::swap(*descriptors, akaze_descriptors.float_descriptor);
+  return true;
+}
+
+bool AkazeDescriptorExtractor::DetectAndExtractBinaryDescriptors(
+    const FloatImage& image,
+    std::vector<Keypoint>* keypoints,
+    std::vector<BinaryVectorX>* descriptors) {
+  if (!HasBinaryDescriptors()) {
+    LOG(ERROR) << "The AKAZE MSURF descriptor is a float descriptor. Please "
+                  "use AkazeDescriptorExtractor::DetectAndExtractDescriptors() "
+                  "instead.";
+    return false;
+  }
+
+  libAKAZE::AKAZEDescriptors akaze_descriptors;
+  DetectAndExtractAkazeFeatures(image, keypoints, &akaze_descriptors);
+  std::swap(*descriptors, akaze_descriptors.binary_descriptor);
+  return true;
+}
+
+void AkazeDescriptorExtractor::DetectAndExtractAkazeFeatures(
+    const FloatImage& image,
+    std::vector<Keypoint>* keypoints,
+    libAKAZE::AKAZEDescriptors* akaze_descriptors) {
+  // Try to convert the image to grayscale. The image data is used directly by
+  // AKAZE so that it does not need to be copied.
   const FloatImage& gray_image = image.AsGrayscaleImage();
-  libAKAZE::RowMatrixXf img_32 =
-      Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic,
-                                     Eigen::RowMajor> >(
-          gray_image.Data(), gray_image.Rows(), gray_image.Cols());
+  const Eigen::Map<const libAKAZE::RowMatrixXf> img_32(
+      gray_image.Data(), gray_image.Rows(), gray_image.Cols());
 
   // Set the akaze options.
   libAKAZE::AKAZEOptions options;
   options.img_width = img_32.cols();
   options.img_height = img_32.rows();
-  options.num_threads = 1;
+  options.num_threads = std::max(1, akaze_params_.num_threads);
   options.soffset = 1.6f;
   options.derivative_factor = 1.5f;
   options.omax = akaze_params_.maximum_octave_levels;
@@ -79,7 +117,22 @@ bool AkazeDescriptorExtractor::DetectAndExtractDescriptors(
   options.min_dthreshold = 0.00001f;
 
   options.diffusivity = libAKAZE::PM_G2;
-  options.descriptor = libAKAZE::MSURF;
+  switch (akaze_params_.descriptor_type) {
+    case AkazeDescriptorType::MSURF:
+      options.descriptor = libAKAZE::MSURF;
+      break;
+    case AkazeDescriptorType::MSURF_UPRIGHT:
+      options.descriptor = libAKAZE::MSURF_UPRIGHT;
+      break;
+    case AkazeDescriptorType::MLDB:
+      options.descriptor = libAKAZE::MLDB;
+      break;
+    case AkazeDescriptorType::MLDB_UPRIGHT:
+      options.descriptor = libAKAZE::MLDB_UPRIGHT;
+      break;
+    default:
+      LOG(FATAL) << "Invalid AKAZE descriptor type.";
+  }
   options.descriptor_size = 0;
   options.descriptor_channels = 3;
   options.descriptor_pattern_size = 10;
@@ -98,8 +151,7 @@ bool AkazeDescriptorExtractor::DetectAndExtractDescriptors(
   evolution.Feature_Detection(akaze_keypoints);
 
   // Compute descriptors.
-  libAKAZE::AKAZEDescriptors akaze_descriptors;
-  evolution.Compute_Descriptors(akaze_keypoints, akaze_descriptors);
+  evolution.Compute_Descriptors(akaze_keypoints, *akaze_descriptors);
 
   // Set the output keypoints.
   keypoints->reserve(akaze_keypoints.size());
@@ -111,10 +163,6 @@ bool AkazeDescriptorExtractor::DetectAndExtractDescriptors(
     keypoint.set_orientation(akaze_keypoint.angle);
     keypoints->emplace_back(keypoint);
   }
-
-  // Set the output descriptors.
-  std::swap(*descriptors, akaze_descriptors.float_descriptor);
-  return true;
 }
 
 }  // namespace theia
@@ -37,20 +37,43 @@
 
 #include <vector>
 
+#include "theia/image/descriptor/binary_descriptor.h"
 #include "theia/image/descriptor/descriptor_extractor.h"
 #include "theia/util/util.h"
 
+namespace libAKAZE {
+struct AKAZEDescriptors;
+}  // namespace libAKAZE
+
 namespace theia {
 
 class FloatImage;
 class Keypoint;
 
+// The descriptor computed at the AKAZE keypoints. MSURF is a 64-dimensional
+// float descriptor and MLDB is a 486-bit binary descriptor that is much faster
+// to compute and match. The upright variants are not rotation invariant.
+enum class AkazeDescriptorType {
+  MSURF = 0,
+  MSURF_UPRIGHT = 1,
+  MLDB = 2,
+  MLDB_UPRIGHT = 3
+};
+
 // Parameters for the akaze feature extractor.
 struct AkazeParameters {
   int maximum_octave_levels = 4;
   int num_sublevels = 4;
   // Lowering this threshold will increase the number of features.
   float hessian_threshold = 0.001f;
+
+  // MLDB descriptors must be extracted with
+  // DetectAndExtractBinaryDescriptors.
+  AkazeDescriptorType descriptor_type = AkazeDescriptorType::MSURF;
+
+  // The number of threads used to compute the derivatives, detector responses
+  // and descriptors of the nonlinear scale space of a single image.
+  int num_threads = 1;
 };
 
 class AkazeDescriptorExtractor : public DescriptorExtractor {
@@ -66,12 +89,29 @@ class AkazeDescriptorExtractor : public DescriptorExtractor {
                          Eigen::VectorXf* descriptor);
 
   // Detect keypoints using the Akaze keypoint detector and extracts them at the
-  // same time.
+  // same time. The descriptor type must be MSURF or MSURF_UPRIGHT.
   bool DetectAndExtractDescriptors(const FloatImage& image,
                                    std::vector<Keypoint>* keypoints,
                                    std::vector<Eigen::VectorXf>* descriptors);
 
+  // Returns true if the descriptor type is MLDB or MLDB_UPRIGHT.
+  bool HasBinaryDescriptors() const;
+
+  // Same as above, but computes the binary MLDB descriptors. The descriptor
+  // type must be MLDB or MLDB_UPRIGHT.
+  bool DetectAndExtractBinaryDescriptors(
+      const FloatImage& image,
+      std::vector<Keypoint>* keypoints,
+      std::vector<BinaryVectorX>* descriptors);
+
  private:
+  // Runs the AKAZE detector and the descriptor extraction of the descriptor
+  // type in the parameters.
+  void DetectAndExtractAkazeFeatures(
+      const FloatImage& image,
+      std::vector<Keypoint>* keypoints,
+      libAKAZE::AKAZEDescriptors* akaze_descriptors);
+
   const AkazeParameters akaze_params_;
 
   DISALLOW_COPY_AND_ASSIGN(AkazeDescriptorExtractor);
@@ -62,4 +62,58 @@ TEST(AkazeDescriptor, Sanity) {
                                                           &descriptors));
 }
 
+TEST(AkazeDescriptor, BinaryDescriptors) {
+  FloatImage input_img(img_filename);
+
+  AkazeParameters options;
+  options.descriptor_type = AkazeDescriptorType::MLDB;
+  AkazeDescriptorExtractor akaze_extractor(options);
+  EXPECT_TRUE(akaze_extractor.HasBinaryDescriptors());
+
+  // Float descriptors cannot be extracted with the MLDB descriptor.
+  std::vector<Keypoint> keypoints;
+  std::vector<Eigen::VectorXf> descriptors;
+  EXPECT_FALSE(akaze_extractor.DetectAndExtractDescriptors(
+      input_img, &keypoints, &descriptors));
+
+  std::vector<BinaryVectorX> binary_descriptors;
+  EXPECT_TRUE(akaze_extractor.DetectAndExtractBinaryDescriptors(
+      input_img, &keypoints, &binary_descriptors));
+  EXPECT_GT(keypoints.size(), 0);
+  ASSERT_EQ(keypoints.size(), binary_descriptors.size());
+  // The full M-LDB descriptor has 486 bits.
+  for (const BinaryVectorX& descriptor : binary_descriptors) {
+    EXPECT_EQ(descriptor.size(), 61);
+  }
+}
+
+TEST(AkazeDescriptor, MultithreadedExtractionMatchesSingleThreaded) {
+  FloatImage input_img(img_filename);
+
+  AkazeParameters options;
+  options.descriptor_type = AkazeDescriptorType::MLDB;
+  AkazeDescriptorExtractor akaze_extractor(options);
+  std::vector<Keypoint> keypoints;
+  std::vector<BinaryVectorX> descriptors;
+  EXPECT_TRUE(akaze_extractor.DetectAndExtractBinaryDescriptors(
+      input_img, &keypoints, &descriptors));
+
+  options.num_threads = 4;
+  AkazeDescriptorExtractor multithreaded_akaze_extractor(options);
+  std::vector<Keypoint> multithreaded_keypoints;
+  std::vector<BinaryVectorX> multithreaded_descriptors;
+  EXPECT_TRUE(multithreaded_akaze_extractor.DetectAndExtractBinaryDescriptors(
+      input_img, &multithreaded_keypoints, &multithreaded_descriptors));
+
+  ASSERT_EQ(keypoints.size(), multithreaded_keypoints.size());
+  ASSERT_EQ(descriptors.size(), multithreaded_descriptors.size());
+  for (int i = 0; i < keypoints.size(); i++) {
+    EXPECT_EQ(keypoints[i].x(), multithreaded_keypoints[i].x());
+    EXPECT_EQ(keypoints[i].y(), multithreaded_keypoints[i].y());
+    EXPECT_EQ(keypoints[i].orientation(),
+              multithreaded_keypoints[i].orientation());
+    EXPECT_EQ(descriptors[i], multithreaded_descriptors[i]);
+  }
+}
+
 }  // namespace theia
@@ -35,6 +35,7 @@
 #include "theia/image/descriptor/create_descriptor_extractor.h"
 
 #include <glog/logging.h>
+#include <algorithm>
 #include <memory>
 
 #include "theia/image/descriptor/akaze_descriptor.h"
@@ -82,19 +83,45 @@ inline AkazeParameters FeatureDensityToAkazeParameters(
 
 }  // namespace
 
+bool IsBinaryDescriptorExtractorType(
+    const DescriptorExtractorType& descriptor_type) {
+  return descriptor_type == DescriptorExtractorType::AKAZE_MLDB;
+}
+
 std::unique_ptr<DescriptorExtractor> CreateDescriptorExtractor(
     const DescriptorExtractorType& descriptor_type,
     const FeatureDensity& feature_density) {
+  return CreateDescriptorExtractor(descriptor_type, feature_density, 1);
+}
+
+std::unique_ptr<DescriptorExtractor> CreateDescriptorExtractor(
+    const DescriptorExtractorType& descriptor_type,
+    const FeatureDensity& feature_density,
+    const int num_threads) {
   std::unique_ptr<DescriptorExtractor> descriptor_extractor;
   switch (descriptor_type) {
-    case DescriptorExtractorType::SIFT:
-      descriptor_extractor.reset(new SiftDescriptorExtractor(
-          FeatureDensityToSiftParameters(feature_density)));
+    case DescriptorExtractorType::SIFT: {
+      SiftParameters sift_params =
+          FeatureDensityToSiftParameters(feature_density);
+      sift_params.num_threads = std::max(1, num_threads);
+      descriptor_extractor.reset(new SiftDescriptorExtractor(sift_params));
+      break;
+    }
+    case DescriptorExtractorType::AKAZE: {
+      AkazeParameters akaze_params =
+          FeatureDensityToAkazeParameters(feature_density);
+      akaze_params.num_threads = std::max(1, num_threads);
+      descriptor_extractor.reset(new AkazeDescriptorExtractor(akaze_params));
       break;
-    case DescriptorExtractorType::AKAZE:
-      descriptor_extractor.reset(new AkazeDescriptorExtractor(
-          FeatureDensityToAkazeParameters(feature_density)));
+    }
+    case DescriptorExtractorType::AKAZE_MLDB: {
+      AkazeParameters akaze_params =
+          FeatureDensityToAkazeParameters(feature_density);
+      akaze_params.descriptor_type = AkazeDescriptorType::MLDB;
+      akaze_params.num_threads = std::max(1, num_threads);
+      descriptor_extractor.reset(new AkazeDescriptorExtractor(akaze_params));
       break;
+    }
     default:
       LOG(ERROR) << "Invalid Descriptor Extractor specified.";
   }
@@ -44,11 +44,20 @@ class DescriptorExtractor;
 // keypoint extractor for each feature type. Since this is a convenience class
 // anyways, this functionality is acceptable. If more flexibility (custom
 // features and custom descriptors) is needed then a new class may be developed.
+//
+// AKAZE_MLDB uses the AKAZE detector with the binary M-LDB descriptor. Binary
+// descriptors are extracted with
+// DescriptorExtractor::DetectAndExtractBinaryDescriptors.
 enum class DescriptorExtractorType {
   SIFT = 0,
   AKAZE = 1,
+  AKAZE_MLDB = 2,
 };
 
+// Returns true if the descriptor extractor type computes binary descriptors.
+bool IsBinaryDescriptorExtractorType(
+    const DescriptorExtractorType& descriptor_type);
+
 // Users may specify feature density to target their specific
 // application. Certain datasets do not need many features, and so they may be
 // interested in extracting a smaller number of features per image. Other
@@ -65,6 +74,13 @@ std::unique_ptr<DescriptorExtractor> CreateDescriptorExtractor(
     const DescriptorExtractorType& descriptor_type,
     const FeatureDensity& feature_density);
 
+// Same as above, but the extractor may use up to num_threads threads to
+// extract features from a single image.
+std::unique_ptr<DescriptorExtractor> CreateDescriptorExtractor(
+    const DescriptorExtractorType& descriptor_type,
+    const FeatureDensity& feature_density,
+    const int num_threads);
+
 }  // namespace theia
 
 #endif  // THEIA_IMAGE_DESCRIPTOR_CREATE_DESCRIPTOR_EXTRACTOR_H_
@@ -35,9 +35,11 @@
 #include "theia/image/descriptor/descriptor_extractor.h"
 
 #include <Eigen/Core>
+#include <glog/logging.h>
 
 #include "theia/image/image.h"
 #include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/image/keypoint_detector/keypoint_selection.h"
 
 namespace theia {
 
@@ -60,8 +62,56 @@ bool DescriptorExtractor::ComputeDescriptors(
     }
 
     descriptors->push_back(descriptor);
+    ++keypoint_it;
   }
   return true;
 }
 
+bool DescriptorExtractor::DetectAndExtractBinaryDescriptors(
+    const FloatImage& image,
+    std::vector<Keypoint>* keypoints,
+    std::vector<BinaryVectorX>* descriptors) {
+  LOG(ERROR) << "This descriptor extractor does not compute binary "
+                "descriptors.";
+  return false;
+}
+
+bool DescriptorExtractor::DetectAndExtractSelectedDescriptors(
+    const FloatImage& image,
+    const KeypointSelectionOptions& selection_options,
+    std::vector<Keypoint>* keypoints,
+    std::vector<Eigen::VectorXf>* descriptors) {
+  keypoints->clear();
+  descriptors->clear();
+  if (!DetectAndExtractDescriptors(image, keypoints, descriptors)) {
+    return false;
+  }
+
+  std::vector<int> selected_indices;
+  SelectKeypoints(selection_options, image.Width(), image.Height(), *keypoints,
+                  &selected_indices);
+  KeepSelectedElements(selected_indices, keypoints);
+  KeepSelectedElements(selected_indices, descriptors);
+  return true;
+}
+
+bool DescriptorExtractor::DetectAndExtractSelectedBinaryDescriptors(
+    const FloatImage& image,
+    const KeypointSelectionOptions& selection_options,
+    std::vector<Keypoint>* keypoints,
+    std::vector<BinaryVectorX>* descriptors) {
+  keypoints->clear();
+  descriptors->clear();
+  if (!DetectAndExtractBinaryDescriptors(image, keypoints, descriptors)) {
+    return false;
+  }
+
+  std::vector<int> selected_indices;
+  SelectKeypoints(selection_options, image.Width(), image.Height(), *keypoints,
+                  &selected_indices);
+  KeepSelectedElements(selected_indices, keypoints);
+  KeepSelectedElements(selected_indices, descriptors);
+  return true;
+}
+
 }  // namespace theia
@@ -38,6 +38,8 @@
 #include <Eigen/Core>
 #include <vector>
 
+#include "theia/image/descriptor/binary_descriptor.h"
+#include "theia/image/keypoint_detector/keypoint_selection.h"
 #include "theia/util/util.h"
 
 namespace theia {
@@ -80,6 +82,37 @@ class DescriptorExtractor {
       std::vector<Keypoint>* keypoints,
       std::vector<Eigen::VectorXf>* descriptors) = 0;
 
+  // Returns true if the extractor computes binary descriptors. Binary
+  // descriptors must be extracted with DetectAndExtractBinaryDescriptors.
+  virtual bool HasBinaryDescriptors() const { return false; }
+
+  // Same as DetectAndExtractDescriptors but for extractors that compute binary
+  // descriptors. The default implementation returns false.
+  virtual bool DetectAndExtractBinaryDescriptors(
+      const FloatImage& image,
+      std::vector<Keypoint>* keypoints,
+      std::vector<BinaryVectorX>* descriptors);
+
+  // Detects keypoints, selects the keypoints to keep with SelectKeypoints and
+  // extracts descriptors for the selected keypoints. The output containers are
+  // cleared first. The default
+  // implementation extracts descriptors for all keypoints and then discards
+  // the ones that were not selected. Extractors that can compute descriptors
+  // for a subset of the detected keypoints should override this so that only
+  // the selected keypoints are described.
+  virtual bool DetectAndExtractSelectedDescriptors(
+      const FloatImage& image,
+      const KeypointSelectionOptions& selection_options,
+      std::vector<Keypoint>* keypoints,
+      std::vector<Eigen::VectorXf>* descriptors);
+
+  // Same as above but for extractors that compute binary descriptors.
+  virtual bool DetectAndExtractSelectedBinaryDescriptors(
+      const FloatImage& image,
+      const KeypointSelectionOptions& selection_options,
+      std::vector<Keypoint>* keypoints,
+      std::vector<BinaryVectorX>* descriptors);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(DescriptorExtractor);
 };
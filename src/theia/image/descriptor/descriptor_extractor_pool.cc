@@ -0,0 +1,100 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
+
+#include <glog/logging.h>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <utility>
+
+#include "theia/image/descriptor/create_descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor.h"
+
+namespace theia {
+
+DescriptorExtractorPool::ScopedWorkspace::ScopedWorkspace(
+    DescriptorExtractorPool* pool)
+    : pool_(CHECK_NOTNULL(pool)), workspace_(pool->Acquire()) {}
+
+DescriptorExtractorPool::ScopedWorkspace::~ScopedWorkspace() {
+  pool_->Release(std::move(workspace_));
+}
+
+DescriptorExtractorPool::DescriptorExtractorPool(
+    const DescriptorExtractorType& descriptor_type,
+    const FeatureDensity& feature_density,
+    const int num_threads_per_extractor)
+    : descriptor_type_(descriptor_type),
+      feature_density_(feature_density),
+      num_threads_per_extractor_(num_threads_per_extractor),
+      num_workspaces_(0) {}
+
+DescriptorExtractorPool::~DescriptorExtractorPool() {
+  CHECK_EQ(available_workspaces_.size(), num_workspaces_)
+      << "All workspaces must be released before the pool is destroyed.";
+}
+
+std::unique_ptr<DescriptorExtractorPool::Workspace>
+DescriptorExtractorPool::Acquire() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!available_workspaces_.empty()) {
+      std::unique_ptr<Workspace> workspace =
+          std::move(available_workspaces_.back());
+      available_workspaces_.pop_back();
+      return workspace;
+    }
+    ++num_workspaces_;
+  }
+
+  // Create the new extractor outside of the lock since this may be expensive.
+  std::unique_ptr<Workspace> workspace(new Workspace);
+  workspace->descriptor_extractor = CreateDescriptorExtractor(
+      descriptor_type_, feature_density_, num_threads_per_extractor_);
+  return workspace;
+}
+
+void DescriptorExtractorPool::Release(std::unique_ptr<Workspace> workspace) {
+  CHECK_NOTNULL(workspace.get());
+  std::lock_guard<std::mutex> lock(mutex_);
+  available_workspaces_.emplace_back(std::move(workspace));
+}
+
+int DescriptorExtractorPool::NumWorkspaces() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_workspaces_;
+}
+
+}  // namespace theia
@@ -0,0 +1,121 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_IMAGE_DESCRIPTOR_DESCRIPTOR_EXTRACTOR_POOL_H_
+#define THEIA_IMAGE_DESCRIPTOR_DESCRIPTOR_EXTRACTOR_POOL_H_
+
+#include <memory>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "theia/image/descriptor/create_descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor.h"
+#include "theia/image/image.h"
+#include "theia/util/util.h"
+
+namespace theia {
+
+// A thread-safe pool of descriptor extractors, each paired with an image
+// buffer, for extracting features from many images in parallel. Descriptor
+// extractors keep buffers between images (e.g. the SIFT scale space) that are
+// only reused if the same extractor processes several images. Each task
+// borrows a workspace for the duration of one image and returns it afterwards,
+// so the pool never holds more workspaces than there were concurrent tasks and
+// each image only pays for the feature extraction itself.
+//
+// Example usage:
+//
+//   DescriptorExtractorPool pool(DescriptorExtractorType::SIFT,
+//                                FeatureDensity::NORMAL, 1);
+//   // In each task:
+//   DescriptorExtractorPool::ScopedWorkspace workspace(&pool);
+//   workspace->image.ReadGrayscale(filename, 0, &downsampling_factor);
+//   workspace->descriptor_extractor->DetectAndExtractDescriptors(
+//       workspace->image, &keypoints, &descriptors);
+class DescriptorExtractorPool {
+ public:
+  struct Workspace {
+    std::unique_ptr<DescriptorExtractor> descriptor_extractor;
+    // An image buffer that may be reused, e.g. with FloatImage::ReadGrayscale,
+    // by all images processed with this workspace.
+    FloatImage image;
+  };
+
+  // Borrows a workspace from the pool upon construction and returns it to the
+  // pool upon destruction.
+  class ScopedWorkspace {
+   public:
+    explicit ScopedWorkspace(DescriptorExtractorPool* pool);
+    ~ScopedWorkspace();
+
+    Workspace* operator->() { return workspace_.get(); }
+    Workspace& operator*() { return *workspace_; }
+
+   private:
+    DescriptorExtractorPool* pool_;
+    std::unique_ptr<Workspace> workspace_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedWorkspace);
+  };
+
+  // The descriptor extractors are created with CreateDescriptorExtractor. Each
+  // extractor may use up to num_threads_per_extractor threads for an image.
+  DescriptorExtractorPool(const DescriptorExtractorType& descriptor_type,
+                          const FeatureDensity& feature_density,
+                          const int num_threads_per_extractor);
+  ~DescriptorExtractorPool();
+
+  // Returns a workspace that is not in use, creating a new one if all
+  // workspaces are in use. The workspace must be returned with Release.
+  std::unique_ptr<Workspace> Acquire();
+  void Release(std::unique_ptr<Workspace> workspace);
+
+  // The total number of workspaces created by the pool.
+  int NumWorkspaces() const;
+
+ private:
+  const DescriptorExtractorType descriptor_type_;
+  const FeatureDensity feature_density_;
+  const int num_threads_per_extractor_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Workspace> > available_workspaces_;
+  int num_workspaces_;
+
+  DISALLOW_COPY_AND_ASSIGN(DescriptorExtractorPool);
+};
+
+}  // namespace theia
+
+#endif  // THEIA_IMAGE_DESCRIPTOR_DESCRIPTOR_EXTRACTOR_POOL_H_
@@ -0,0 +1,103 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <memory>
+#include <mutex>  // NOLINT
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "theia/image/descriptor/create_descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
+#include "theia/util/threadpool.h"
+
+namespace theia {
+
+TEST(DescriptorExtractorPool, ReusesReleasedWorkspaces) {
+  DescriptorExtractorPool pool(DescriptorExtractorType::SIFT,
+                               FeatureDensity::NORMAL,
+                               1);
+  EXPECT_EQ(pool.NumWorkspaces(), 0);
+
+  // Two workspaces in use at the same time must be distinct.
+  std::unique_ptr<DescriptorExtractorPool::Workspace> workspace1 =
+      pool.Acquire();
+  std::unique_ptr<DescriptorExtractorPool::Workspace> workspace2 =
+      pool.Acquire();
+  ASSERT_NE(workspace1->descriptor_extractor, nullptr);
+  ASSERT_NE(workspace2->descriptor_extractor, nullptr);
+  EXPECT_NE(workspace1->descriptor_extractor.get(),
+            workspace2->descriptor_extractor.get());
+  EXPECT_EQ(pool.NumWorkspaces(), 2);
+
+  // A released workspace is handed out again instead of creating a new one.
+  const DescriptorExtractor* extractor1 =
+      workspace1->descriptor_extractor.get();
+  pool.Release(std::move(workspace1));
+  {
+    DescriptorExtractorPool::ScopedWorkspace workspace(&pool);
+    EXPECT_EQ(workspace->descriptor_extractor.get(), extractor1);
+  }
+  EXPECT_EQ(pool.NumWorkspaces(), 2);
+  pool.Release(std::move(workspace2));
+}
+
+TEST(DescriptorExtractorPool, NoMoreWorkspacesThanThreads) {
+  static const int kNumThreads = 4;
+  static const int kNumTasks = 100;
+  DescriptorExtractorPool pool(DescriptorExtractorType::SIFT,
+                               FeatureDensity::NORMAL,
+                               1);
+
+  std::mutex mutex;
+  std::set<const DescriptorExtractor*> used_extractors;
+  {
+    ThreadPool thread_pool(kNumThreads);
+    for (int i = 0; i < kNumTasks; i++) {
+      thread_pool.Add([&]() {
+        DescriptorExtractorPool::ScopedWorkspace workspace(&pool);
+        std::lock_guard<std::mutex> lock(mutex);
+        used_extractors.insert(workspace->descriptor_extractor.get());
+      });
+    }
+  }
+
+  EXPECT_LE(pool.NumWorkspaces(), kNumThreads);
+  EXPECT_EQ(used_extractors.size(), pool.NumWorkspaces());
+}
+
+}  // namespace theia
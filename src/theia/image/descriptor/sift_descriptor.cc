@@ -34,17 +34,18 @@
 
 #include "theia/image/descriptor/sift_descriptor.h"
 
+#include <Eigen/Core>
 #include <algorithm>
-extern "C" {
-#include "vl/sift.h"
-}
+#include <cmath>
 #include <vector>
 
 #include "glog/logging.h"
 #include "theia/image/descriptor/descriptor_extractor.h"
+#include "theia/image/descriptor/sift_scale_space.h"
 #include "theia/image/image.h"
 #include "theia/image/keypoint_detector/keypoint.h"
-#include <Eigen/Core>
+#include "theia/image/keypoint_detector/keypoint_selection.h"
+#include "theia/util/threadpool.h"
 
 namespace theia {
 namespace {
@@ -53,6 +54,8 @@ namespace {
 // than this then we begin to have memory and speed issues.
 static constexpr int kMaxScaledDim = 3600;
 static constexpr int kNumSiftDimensions = 128;
+// Minimum number of keypoints processed by a single task.
+static constexpr int kMinKeypointsPerTask = 16;
 
 double GetValidFirstOctave(const int first_octave,
                            const int width,
@@ -67,11 +70,17 @@ double GetValidFirstOctave(const int first_octave,
   return valid_first_octave;
 }
 
+ThreadPool* CreateThreadPool(const int num_threads) {
+  return num_threads > 1 ? new ThreadPool(num_threads) : nullptr;
+}
+
 }  // namespace
 
 SiftDescriptorExtractor::SiftDescriptorExtractor(
     const SiftParameters& detector_params)
-    : sift_params_(detector_params), sift_filter_(nullptr, vl_sift_delete) {}
+    : sift_params_(detector_params),
+      thread_pool_(CreateThreadPool(sift_params_.num_threads)),
+      scale_space_(sift_params_, thread_pool_.get()) {}
 
 SiftDescriptorExtractor::SiftDescriptorExtractor(int num_octaves,
                                                  int num_levels,
@@ -81,69 +90,36 @@ SiftDescriptorExtractor::SiftDescriptorExtractor(int num_octaves,
                    first_octave,
                    10.0f,
                    255.0 * 0.02 / num_levels),
-      sift_filter_(nullptr, vl_sift_delete) {}
+      thread_pool_(CreateThreadPool(sift_params_.num_threads)),
+      scale_space_(sift_params_, thread_pool_.get()) {}
 
 SiftDescriptorExtractor::SiftDescriptorExtractor()
     : SiftDescriptorExtractor(-1, 3, -1) {}
 
 SiftDescriptorExtractor::~SiftDescriptorExtractor() {}
 
+bool SiftDescriptorExtractor::ProcessFirstOctave(const FloatImage& image) {
+  const int first_octave = GetValidFirstOctave(
+      sift_params_.first_octave, image.Rows(), image.Cols());
+  // Grayscale images are used directly to avoid copying them.
+  if (image.Channels() == 1) {
+    return scale_space_.ProcessFirstOctave(
+        image.Cols(), image.Rows(), first_octave, image.Data());
+  }
+  const FloatImage grayscale_image = image.AsGrayscaleImage();
+  return scale_space_.ProcessFirstOctave(
+      image.Cols(), image.Rows(), first_octave, grayscale_image.Data());
+}
+
 bool SiftDescriptorExtractor::ComputeDescriptor(const FloatImage& image,
                                                 const Keypoint& keypoint,
                                                 Eigen::VectorXf* descriptor) {
-  CHECK(keypoint.has_scale() && keypoint.has_orientation())
-      << "Keypoint must have scale and orientation to compute a SIFT "
-      << "descriptor.";
-  // If the filter has been set, but is not usable for the input image (i.e. the
-  // width and height are different) then we must make a new filter. Adding this
-  // statement will save the function from regenerating the filter for
-  // successive calls with images of the same size (e.g. a video sequence).
-  if (!sift_filter_ || (sift_filter_->width != image.Cols() ||
-                        sift_filter_->height != image.Rows())) {
-    const int first_octave = GetValidFirstOctave(
-        sift_params_.first_octave, image.Rows(), image.Cols());
-    sift_filter_.reset(vl_sift_new(image.Cols(),
-                                   image.Rows(),
-                                   sift_params_.num_octaves,
-                                   sift_params_.num_levels,
-                                   first_octave));
-  }
-
-  // Create the vl sift keypoint from the one passed in.
-  VlSiftKeypoint sift_keypoint;
-  vl_sift_keypoint_init(sift_filter_.get(),
-                        &sift_keypoint,
-                        keypoint.x(),
-                        keypoint.y(),
-                        keypoint.scale());
-
-  // The VLFeat functions take in a non-const image pointer so that it can
-  // calculate gaussian pyramids. Obviously, we do not want to break our const
-  // input, so the best solution (for now) is to copy the image.
-  FloatImage mutable_image = image.AsGrayscaleImage();
-
-  // Calculate the first octave to process.
-  int vl_status =
-      vl_sift_process_first_octave(sift_filter_.get(), mutable_image.Data());
-  // Proceed through the octaves we reach the same one as the keypoint.
-  while (sift_keypoint.o != sift_filter_->o_cur) {
-    vl_sift_process_next_octave(sift_filter_.get());
-  }
-
-  if (vl_status == VL_ERR_EOF) {
-    LOG(FATAL) << "could not extract sift descriptors";
-  }
-
-  // Calculate the sift feature. Note that we are passing in a direct pointer to
-  // the descriptor's underlying data.
-  CHECK_NOTNULL(descriptor)->resize(128);
-  vl_sift_calc_keypoint_descriptor(sift_filter_.get(),
-                                   descriptor->data(),
-                                   &sift_keypoint,
-                                   keypoint.orientation());
-  if (sift_params_.root_sift) {
-    ConvertToRootSift(descriptor);
+  std::vector<Keypoint> keypoints(1, keypoint);
+  std::vector<Eigen::VectorXf> descriptors;
+  if (!ComputeDescriptors(image, &keypoints, &descriptors)) {
+    return false;
   }
+  *CHECK_NOTNULL(descriptor) = descriptors[0];
   return true;
 }
 
@@ -151,57 +127,46 @@ bool SiftDescriptorExtractor::ComputeDescriptors(
     const FloatImage& image,
     std::vector<Keypoint>* keypoints,
     std::vector<Eigen::VectorXf>* descriptors) {
-  // If the filter has been set, but is not usable for the input image (i.e. the
-  // width and height are different) then we must make a new filter. Adding this
-  // statement will save the function from regenerating the filter for
-  // successive calls with images of the same size (e.g. a video sequence).
-  if (!sift_filter_ || (sift_filter_->width != image.Cols() ||
-                        sift_filter_->height != image.Rows())) {
-    const int first_octave = GetValidFirstOctave(
-        sift_params_.first_octave, image.Rows(), image.Cols());
-    sift_filter_.reset(vl_sift_new(image.Cols(),
-                                   image.Rows(),
-                                   sift_params_.num_octaves,
-                                   sift_params_.num_levels,
-                                   first_octave));
+  for (const Keypoint& keypoint : *keypoints) {
+    CHECK(keypoint.has_scale() && keypoint.has_orientation())
+        << "Keypoint must have scale and orientation to compute a SIFT "
+        << "descriptor.";
   }
 
-  // Create the vl sift keypoint from the one passed in.
-  std::vector<VlSiftKeypoint> sift_keypoints(keypoints->size());
+  // The first octave must be processed before the keypoints can be mapped to
+  // the scale space.
+  bool has_octave = ProcessFirstOctave(image);
+
+  std::vector<SiftScaleSpaceKeypoint> sift_keypoints(keypoints->size());
   for (int i = 0; i < keypoints->size(); i++) {
-    CHECK((*keypoints)[i].has_scale() && (*keypoints)[i].has_orientation())
-        << "Keypoint must have scale and orientation to compute a SIFT "
-        << "descriptor.";
-    vl_sift_keypoint_init(sift_filter_.get(),
-                          &sift_keypoints[i],
-                          (*keypoints)[i].x(),
-                          (*keypoints)[i].y(),
-                          (*keypoints)[i].scale());
+    sift_keypoints[i] = scale_space_.InitializeKeypoint(
+        (*keypoints)[i].x(), (*keypoints)[i].y(), (*keypoints)[i].scale());
   }
-  // The VLFeat functions take in a non-const image pointer so that it can
-  // calculate gaussian pyramids. Obviously, we do not want to break our const
-  // input, so the best solution (for now) is to copy the image.
-  FloatImage mutable_image = image.AsGrayscaleImage();
-
-  // Calculate the first octave to process.
-  int vl_status =
-      vl_sift_process_first_octave(sift_filter_.get(), mutable_image.Data());
-
-  // Proceed through the octaves we reach the same one as the keypoint.  We
-  // first resize the descriptors vector so that the keypoint indicies will be
-  // properly matched to the descriptors.
-  descriptors->resize(keypoints->size(), Eigen::VectorXf(128));
-  while (vl_status != VL_ERR_EOF) {
-    // Go through each keypoint to see if it came from this octave.
-    for (int i = 0; i < sift_keypoints.size(); i++) {
-      if (sift_keypoints[i].o != sift_filter_->o_cur) continue;
 
-      vl_sift_calc_keypoint_descriptor(sift_filter_.get(),
-                                       (*descriptors)[i].data(),
-                                       &sift_keypoints[i],
-                                       (*keypoints)[i].orientation());
+  // Proceed through the octaves and compute the descriptors of the keypoints
+  // that belong to each octave. We first resize the descriptors vector so that
+  // the keypoint indicies will be properly matched to the descriptors.
+  descriptors->resize(keypoints->size(),
+                      Eigen::VectorXf::Zero(kNumSiftDimensions));
+  std::vector<int> octave_keypoints;
+  while (has_octave) {
+    octave_keypoints.clear();
+    for (int i = 0; i < sift_keypoints.size(); i++) {
+      if (sift_keypoints[i].octave == scale_space_.current_octave()) {
+        octave_keypoints.emplace_back(i);
+      }
     }
-    vl_status = vl_sift_process_next_octave(sift_filter_.get());
+
+    ParallelFor(thread_pool_.get(), 0, octave_keypoints.size(),
+                kMinKeypointsPerTask, [&](const int start, const int end) {
+      for (int j = start; j < end; j++) {
+        const int i = octave_keypoints[j];
+        scale_space_.ComputeKeypointDescriptor(sift_keypoints[i],
+                                               (*keypoints)[i].orientation(),
+                                               (*descriptors)[i].data());
+      }
+    });
+    has_octave = scale_space_.ProcessNextOctave();
   }
 
   if (sift_params_.root_sift) {
@@ -217,67 +182,69 @@ bool SiftDescriptorExtractor::DetectAndExtractDescriptors(
     const FloatImage& image,
     std::vector<Keypoint>* keypoints,
     std::vector<Eigen::VectorXf>* descriptors) {
-  // If the filter has been set, but is not usable for the input image (i.e. the
-  // width and height are different) then we must make a new filter. Adding this
-  // statement will save the function from regenerating the filter for
-  // successive calls with images of the same size (e.g. a video sequence).
-  if (!sift_filter_ || (sift_filter_->width != image.Cols() ||
-                        sift_filter_->height != image.Rows())) {
-    const int first_octave = GetValidFirstOctave(
-        sift_params_.first_octave, image.Rows(), image.Cols());
-    sift_filter_.reset(vl_sift_new(image.Cols(),
-                                   image.Rows(),
-                                   sift_params_.num_octaves,
-                                   sift_params_.num_levels,
-                                   first_octave));
-    vl_sift_set_edge_thresh(sift_filter_.get(), sift_params_.edge_threshold);
-    vl_sift_set_peak_thresh(sift_filter_.get(), sift_params_.peak_threshold);
-  }
-
-  // The VLFeat functions take in a non-const image pointer so that it can
-  // calculate gaussian pyramids. Obviously, we do not want to break our const
-  // input, so the best solution (for now) is to copy the image.
-  FloatImage mutable_image = image.AsGrayscaleImage();
+  // Orientations are stored per keypoint so that the output order does not
+  // depend on the number of threads used.
+  struct SiftOrientations {
+    int num_angles;
+    double angles[4];
+  };
+  std::vector<SiftScaleSpaceKeypoint> sift_keypoints;
+  std::vector<SiftOrientations> orientations;
+  std::vector<int> offsets;
 
-  // Calculate the first octave to process.
-  int vl_status =
-      vl_sift_process_first_octave(sift_filter_.get(), mutable_image.Data());
   // Process octaves until you can't anymore.
-  while (vl_status != VL_ERR_EOF) {
+  bool has_octave = ProcessFirstOctave(image);
+  while (has_octave) {
     // Detect the keypoints.
-    vl_sift_detect(sift_filter_.get());
-
-    // Get the keypoints.
-    const VlSiftKeypoint* vl_keypoints =
-        vl_sift_get_keypoints(sift_filter_.get());
-    const int num_keypoints = vl_sift_get_nkeypoints(sift_filter_.get());
-
-    for (int i = 0; i < num_keypoints; ++i) {
-      // Calculate (up to 4) orientations of the keypoint.
-      double angles[4];
-      int num_angles = vl_sift_calc_keypoint_orientations(
-          sift_filter_.get(), angles, &vl_keypoints[i]);
-      // If upright sift is enabled, only use the first keypoint at a given
-      // pixel location.
-      if (sift_params_.upright_sift && num_angles > 1) {
-        num_angles = 1;
+    scale_space_.DetectKeypoints(&sift_keypoints);
+    const int num_keypoints = sift_keypoints.size();
+
+    // Calculate (up to 4) orientations of each keypoint.
+    orientations.resize(num_keypoints);
+    ParallelFor(thread_pool_.get(), 0, num_keypoints, kMinKeypointsPerTask,
+                [&](const int start, const int end) {
+      for (int i = start; i < end; ++i) {
+        orientations[i].num_angles = scale_space_.ComputeKeypointOrientations(
+            sift_keypoints[i], orientations[i].angles);
+        // If upright sift is enabled, only use the first keypoint at a given
+        // pixel location.
+        if (sift_params_.upright_sift && orientations[i].num_angles > 1) {
+          orientations[i].num_angles = 1;
+        }
       }
+    });
 
-      Eigen::VectorXf descriptor(kNumSiftDimensions);
-      for (int j = 0; j < num_angles; ++j) {
-        descriptor.setZero();
-        vl_sift_calc_keypoint_descriptor(
-            sift_filter_.get(), descriptor.data(), &vl_keypoints[i], angles[j]);
-        descriptors->push_back(descriptor);
-
-        Keypoint keypoint(vl_keypoints[i].x, vl_keypoints[i].y, Keypoint::SIFT);
-        keypoint.set_scale(vl_keypoints[i].sigma);
-        keypoint.set_orientation(angles[j]);
-        keypoints->push_back(keypoint);
-      }
+    // Determine where the features of each keypoint are stored.
+    offsets.resize(num_keypoints);
+    int num_features = keypoints->size();
+    for (int i = 0; i < num_keypoints; ++i) {
+      offsets[i] = num_features;
+      num_features += orientations[i].num_angles;
     }
+    keypoints->resize(num_features, Keypoint(0, 0, Keypoint::SIFT));
+    descriptors->resize(num_features);
+
+    ParallelFor(thread_pool_.get(), 0, num_keypoints, kMinKeypointsPerTask,
+                [&](const int start, const int end) {
+      for (int i = start; i < end; ++i) {
+        for (int j = 0; j < orientations[i].num_angles; ++j) {
+          const double angle = orientations[i].angles[j];
+          Eigen::VectorXf& descriptor = (*descriptors)[offsets[i] + j];
+          descriptor.setZero(kNumSiftDimensions);
+          scale_space_.ComputeKeypointDescriptor(
+              sift_keypoints[i], angle, descriptor.data());
+
+          Keypoint& keypoint = (*keypoints)[offsets[i] + j];
+          keypoint = Keypoint(sift_keypoints[i].x, sift_keypoints[i].y,
+                              Keypoint::SIFT);
+          keypoint.set_scale(sift_keypoints[i].sigma);
+          keypoint.set_orientation(angle);
+          keypoint.set_strength(sift_keypoints[i].response);
+        }
+      }
+    });
     // Attempt to process the next octave.
-    vl_status = vl_sift_process_next_octave(sift_filter_.get());
+    has_octave = scale_space_.ProcessNextOctave();
   }
 
   if (sift_params_.root_sift) {
@@ -290,6 +257,120 @@ bool SiftDescriptorExtractor::DetectAndExtractDescriptors(
   return true;
 }
 
+bool SiftDescriptorExtractor::DetectAndExtractSelectedDescriptors(
+    const FloatImage& image,
+    const KeypointSelectionOptions& selection_options,
+    std::vector<Keypoint>* keypoints,
+    std::vector<Eigen::VectorXf>* descriptors) {
+  // Without a keypoint budget few keypoints (if any) are discarded, so it is
+  // cheaper to describe all keypoints in a single pass over the scale space.
+  if (selection_options.max_num_keypoints <= 0) {
+    return DescriptorExtractor::DetectAndExtractSelectedDescriptors(
+        image, selection_options, keypoints, descriptors);
+  }
+
+  keypoints->clear();
+  std::vector<SiftScaleSpaceKeypoint> sift_keypoints;
+  DetectOrientedKeypoints(image, keypoints, &sift_keypoints);
+
+  std::vector<int> selected_indices;
+  SelectKeypoints(selection_options, image.Width(), image.Height(), *keypoints,
+                  &selected_indices);
+  KeepSelectedElements(selected_indices, keypoints);
+  KeepSelectedElements(selected_indices, &sift_keypoints);
+
+  ComputeOrientedKeypointDescriptors(image, *keypoints, sift_keypoints,
+                                     descriptors);
+  return true;
+}
+
+void SiftDescriptorExtractor::DetectOrientedKeypoints(
+    const FloatImage& image,
+    std::vector<Keypoint>* keypoints,
+    std::vector<SiftScaleSpaceKeypoint>* oriented_sift_keypoints) {
+  struct SiftOrientations {
+    int num_angles;
+    double angles[4];
+  };
+  std::vector<SiftScaleSpaceKeypoint> sift_keypoints;
+  std::vector<SiftOrientations> orientations;
+
+  bool has_octave = ProcessFirstOctave(image);
+  while (has_octave) {
+    scale_space_.DetectKeypoints(&sift_keypoints);
+    const int num_keypoints = sift_keypoints.size();
+
+    // Calculate (up to 4) orientations of each keypoint.
+    orientations.resize(num_keypoints);
+    ParallelFor(thread_pool_.get(), 0, num_keypoints, kMinKeypointsPerTask,
+                [&](const int start, const int end) {
+      for (int i = start; i < end; ++i) {
+        orientations[i].num_angles = scale_space_.ComputeKeypointOrientations(
+            sift_keypoints[i], orientations[i].angles);
+        if (sift_params_.upright_sift && orientations[i].num_angles > 1) {
+          orientations[i].num_angles = 1;
+        }
+      }
+    });
+
+    for (int i = 0; i < num_keypoints; ++i) {
+      for (int j = 0; j < orientations[i].num_angles; ++j) {
+        Keypoint keypoint(sift_keypoints[i].x, sift_keypoints[i].y,
+                          Keypoint::SIFT);
+        keypoint.set_scale(sift_keypoints[i].sigma);
+        keypoint.set_orientation(orientations[i].angles[j]);
+        keypoint.set_strength(sift_keypoints[i].response);
+        keypoints->emplace_back(keypoint);
+        oriented_sift_keypoints->emplace_back(sift_keypoints[i]);
+      }
+    }
+    has_octave = scale_space_.ProcessNextOctave();
+  }
+}
+
+void SiftDescriptorExtractor::ComputeOrientedKeypointDescriptors(
+    const FloatImage& image,
+    const std::vector<Keypoint>& keypoints,
+    const std::vector<SiftScaleSpaceKeypoint>& sift_keypoints,
+    std::vector<Eigen::VectorXf>* descriptors) {
+  descriptors->resize(keypoints.size());
+  if (keypoints.empty()) {
+    return;
+  }
+
+  int last_octave = sift_keypoints[0].octave;
+  for (const SiftScaleSpaceKeypoint& sift_keypoint : sift_keypoints) {
+    last_octave = std::max(last_octave, sift_keypoint.octave);
+  }
+
+  // The keypoints are ordered by octave, so each octave is a contiguous range.
+  int octave_start = 0;
+  bool has_octave = ProcessFirstOctave(image);
+  while (has_octave && scale_space_.current_octave() <= last_octave) {
+    int octave_end = octave_start;
+    while (octave_end < sift_keypoints.size() &&
+           sift_keypoints[octave_end].octave == scale_space_.current_octave()) {
+      ++octave_end;
+    }
+
+    ParallelFor(thread_pool_.get(), octave_start, octave_end,
+                kMinKeypointsPerTask, [&](const int start, const int end) {
+      for (int i = start; i < end; ++i) {
+        Eigen::VectorXf& descriptor = (*descriptors)[i];
+        descriptor.setZero(kNumSiftDimensions);
+        scale_space_.ComputeKeypointDescriptor(
+            sift_keypoints[i], keypoints[i].orientation(), descriptor.data());
+        if (sift_params_.root_sift) {
+          ConvertToRootSift(&descriptor);
+        }
+      }
+    });
+    octave_start = octave_end;
+    has_octave = scale_space_.ProcessNextOctave();
+  }
+  CHECK_EQ(octave_start, sift_keypoints.size());
+}
+
 // Converts to a RootSIFT descriptor which is proven to provide better matches
 // for SIFT: "Three things everyone should know to improve object retrieval" by
 // Arandjelovic and Zisserman.
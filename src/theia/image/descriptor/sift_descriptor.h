@@ -35,14 +35,11 @@
 #ifndef THEIA_IMAGE_DESCRIPTOR_SIFT_DESCRIPTOR_H_
 #define THEIA_IMAGE_DESCRIPTOR_SIFT_DESCRIPTOR_H_
 
-extern "C" {
-#include <vl/sift.h>
-}
-
 #include <memory>
 #include <vector>
 
 #include "theia/image/descriptor/descriptor_extractor.h"
+#include "theia/image/descriptor/sift_scale_space.h"
 #include "theia/image/keypoint_detector/sift_parameters.h"
 #include "theia/util/util.h"
 
@@ -50,7 +47,12 @@ namespace theia {
 
 class FloatImage;
 class Keypoint;
+class ThreadPool;
 
+// Extracts SIFT features with a native scale space implementation (see
+// SiftScaleSpace) that produces the same keypoints and descriptors as VLFeat
+// within numerical tolerance. The scale space buffers are reused for all images
+// processed by the same extractor.
 class SiftDescriptorExtractor : public DescriptorExtractor {
  public:
   //  We only implement the standard 128-dimension descriptor. Specify the
@@ -77,12 +79,45 @@ class SiftDescriptorExtractor : public DescriptorExtractor {
                                    std::vector<Keypoint>* keypoints,
                                    std::vector<Eigen::VectorXf>* descriptors);
 
+  // Detects the keypoints and their orientations in all octaves, selects the
+  // keypoints to keep, and then computes descriptors for the selected
+  // keypoints only. When a keypoint budget is given this processes the scale
+  // space twice, which is much cheaper than computing the descriptors of the
+  // keypoints that are discarded.
+  bool DetectAndExtractSelectedDescriptors(
+      const FloatImage& image,
+      const KeypointSelectionOptions& selection_options,
+      std::vector<Keypoint>* keypoints,
+      std::vector<Eigen::VectorXf>* descriptors);
+
   // This method is only public so that we can easily test it.
   static void ConvertToRootSift(Eigen::VectorXf* descriptor);
 
  private:
+  // Builds the first octave of the scale space for the image. Returns false if
+  // the scale space has no octaves.
+  bool ProcessFirstOctave(const FloatImage& image);
+
+  // Detects the keypoints of all octaves and computes their orientations. One
+  // keypoint is returned per orientation, along with the scale space keypoint
+  // that it was detected at.
+  void DetectOrientedKeypoints(
+      const FloatImage& image,
+      std::vector<Keypoint>* keypoints,
+      std::vector<SiftScaleSpaceKeypoint>* sift_keypoints);
+
+  // Computes the descriptors of oriented keypoints returned by
+  // DetectOrientedKeypoints. Octaves after the last octave that contains a
+  // keypoint are not processed.
+  void ComputeOrientedKeypointDescriptors(
+      const FloatImage& image,
+      const std::vector<Keypoint>& keypoints,
+      const std::vector<SiftScaleSpaceKeypoint>& sift_keypoints,
+      std::vector<Eigen::VectorXf>* descriptors);
+
   const SiftParameters sift_params_;
-  std::unique_ptr<VlSiftFilt, void (*)(VlSiftFilt*)> sift_filter_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+  SiftScaleSpace scale_space_;
   DISALLOW_COPY_AND_ASSIGN(SiftDescriptorExtractor);
 };
 
@@ -38,6 +38,7 @@
 #include "gtest/gtest.h"
 
 #include "theia/image/image.h"
+#include "theia/image/keypoint_detector/keypoint_selection.h"
 #include "theia/image/keypoint_detector/sift_detector.h"
 #include "theia/image/descriptor/sift_descriptor.h"
 
@@ -103,4 +104,82 @@ TEST(SiftDescriptor, DifferentImageSizes) {
                                                          &descriptors));
 }
 
+TEST(SiftDescriptor, MultithreadedExtractionMatchesSingleThreaded) {
+  FloatImage input_img(img_filename);
+
+  SiftParameters sift_params;
+  sift_params.upright_sift = false;
+  SiftDescriptorExtractor single_threaded_extractor(sift_params);
+  sift_params.num_threads = 4;
+  SiftDescriptorExtractor multithreaded_extractor(sift_params);
+
+  std::vector<Keypoint> keypoints1, keypoints2;
+  std::vector<Eigen::VectorXf> descriptors1, descriptors2;
+  EXPECT_TRUE(single_threaded_extractor.DetectAndExtractDescriptors(
+      input_img, &keypoints1, &descriptors1));
+  EXPECT_TRUE(multithreaded_extractor.DetectAndExtractDescriptors(
+      input_img, &keypoints2, &descriptors2));
+
+  // The features must be identical and returned in the same order.
+  ASSERT_EQ(keypoints1.size(), keypoints2.size());
+  ASSERT_EQ(descriptors1.size(), descriptors2.size());
+  for (int i = 0; i < keypoints1.size(); i++) {
+    EXPECT_EQ(keypoints1[i].x(), keypoints2[i].x());
+    EXPECT_EQ(keypoints1[i].y(), keypoints2[i].y());
+    EXPECT_EQ(keypoints1[i].scale(), keypoints2[i].scale());
+    EXPECT_EQ(keypoints1[i].orientation(), keypoints2[i].orientation());
+    EXPECT_EQ(descriptors1[i], descriptors2[i]);
+  }
+
+  // Computing descriptors at given keypoints must also be thread-independent.
+  EXPECT_TRUE(single_threaded_extractor.ComputeDescriptors(
+      input_img, &keypoints1, &descriptors1));
+  EXPECT_TRUE(multithreaded_extractor.ComputeDescriptors(
+      input_img, &keypoints2, &descriptors2));
+  for (int i = 0; i < descriptors1.size(); i++) {
+    EXPECT_EQ(descriptors1[i], descriptors2[i]);
+  }
+}
+
+// Selecting keypoints before computing descriptors must give the same features
+// as computing all descriptors and selecting afterwards.
+TEST(SiftDescriptor, SelectedDescriptorsMatchFullExtraction) {
+  FloatImage input_img(img_filename);
+
+  SiftParameters sift_params;
+  sift_params.upright_sift = false;
+  SiftDescriptorExtractor sift_extractor(sift_params);
+
+  std::vector<Keypoint> keypoints;
+  std::vector<Eigen::VectorXf> descriptors;
+  EXPECT_TRUE(sift_extractor.DetectAndExtractDescriptors(
+      input_img, &keypoints, &descriptors));
+
+  KeypointSelectionOptions selection_options;
+  selection_options.max_num_keypoints = keypoints.size() / 3;
+  selection_options.grid_size = 4;
+  std::vector<int> selected_indices;
+  SelectKeypoints(selection_options, input_img.Width(), input_img.Height(),
+                  keypoints, &selected_indices);
+  KeepSelectedElements(selected_indices, &keypoints);
+  KeepSelectedElements(selected_indices, &descriptors);
+
+  std::vector<Keypoint> selected_keypoints;
+  std::vector<Eigen::VectorXf> selected_descriptors;
+  EXPECT_TRUE(sift_extractor.DetectAndExtractSelectedDescriptors(
+      input_img, selection_options, &selected_keypoints,
+      &selected_descriptors));
+
+  ASSERT_EQ(selected_keypoints.size(), selection_options.max_num_keypoints);
+  ASSERT_EQ(selected_keypoints.size(), keypoints.size());
+  ASSERT_EQ(selected_descriptors.size(), descriptors.size());
+  for (int i = 0; i < keypoints.size(); i++) {
+    EXPECT_EQ(selected_keypoints[i].x(), keypoints[i].x());
+    EXPECT_EQ(selected_keypoints[i].y(), keypoints[i].y());
+    EXPECT_EQ(selected_keypoints[i].scale(), keypoints[i].scale());
+    EXPECT_EQ(selected_keypoints[i].orientation(), keypoints[i].orientation());
+    EXPECT_EQ(selected_descriptors[i], descriptors[i]);
+  }
+}
+
 }  // namespace theia
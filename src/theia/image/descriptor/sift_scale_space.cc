@@ -0,0 +1,880 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+
+#include "theia/image/descriptor/sift_scale_space.h"
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "theia/util/threadpool.h"
+
+namespace theia {
+
+namespace {
+
+typedef Eigen::Map<Eigen::ArrayXf> ArrayMap;
+typedef Eigen::Map<const Eigen::ArrayXf> ConstArrayMap;
+
+// Descriptor geometry: kNumSpatialBins x kNumSpatialBins spatial bins with
+// kNumOrientationBins orientation bins each.
+static const int kNumSpatialBins = 4;
+static const int kNumOrientationBins = 8;
+static const int kNumDescriptorDimensions =
+    kNumSpatialBins * kNumSpatialBins * kNumOrientationBins;
+// The spatial bins of the descriptor have a width of kMagnification * sigma.
+static const double kMagnification = 3.0;
+// Number of bins of the orientation histogram.
+static const int kNumOrientationHistogramBins = 36;
+
+// Minimum number of rows processed by a single task.
+static const int kMinRowsPerTask = 8;
+// Minimum number of keypoint candidates refined by a single task.
+static const int kMinCandidatesPerTask = 64;
+
+static const float kTwoPi = static_cast<float>(2.0 * M_PI);
+
+// Equivalent of VL_SHIFT_LEFT: multiplies by 2^shift for positive shifts and
+// divides by 2^-shift (rounding down) otherwise.
+int ShiftLeft(const int value, const int shift) {
+  return shift >= 0 ? value << shift : value >> -shift;
+}
+
+// Upsamples the image by a factor of two with bilinear interpolation. The
+// output has twice the width and height of the input. This matches the
+// upsampling that VLFeat performs for negative first octaves.
+void UpsampleImage(ThreadPool* pool,
+                   const int width,
+                   const int height,
+                   const float* input,
+                   float* output) {
+  const int out_width = 2 * width;
+  // Interpolate the rows of the input into the even rows of the output.
+  ParallelFor(pool, 0, height, kMinRowsPerTask, [&](const int start,
+                                                    const int end) {
+    for (int y = start; y < end; y++) {
+      const float* in_row = input + y * width;
+      float* out_row = output + 2 * y * out_width;
+      for (int x = 0; x < width - 1; x++) {
+        out_row[2 * x] = in_row[x];
+        out_row[2 * x + 1] = 0.5f * (in_row[x] + in_row[x + 1]);
+      }
+      out_row[out_width - 2] = in_row[width - 1];
+      out_row[out_width - 1] = in_row[width - 1];
+    }
+  });
+
+  // Interpolate the odd rows from the even rows.
+  ParallelFor(pool, 0, height, kMinRowsPerTask, [&](const int start,
+                                                    const int end) {
+    for (int y = start; y < end; y++) {
+      ConstArrayMap row(output + 2 * y * out_width, out_width);
+      ArrayMap odd_row(output + (2 * y + 1) * out_width, out_width);
+      if (y < height - 1) {
+        ConstArrayMap next_row(output + (2 * y + 2) * out_width, out_width);
+        odd_row = 0.5f * (row + next_row);
+      } else {
+        odd_row = row;
+      }
+    }
+  });
+}
+
+// Downsamples the image by keeping every 2^octaves pixel in each dimension.
+void DownsampleImage(const int width,
+                     const int height,
+                     const int octaves,
+                     const float* input,
+                     float* output) {
+  const int step = 1 << octaves;
+  const int out_width = width >> octaves;
+  const int out_height = height >> octaves;
+  for (int y = 0; y < out_height; y++) {
+    const float* in_row = input + y * step * width;
+    float* out_row = output + y * out_width;
+    for (int x = 0; x < out_width; x++) {
+      out_row[x] = in_row[x * step];
+    }
+  }
+}
+
+// A vectorized version of the atan2 approximation that VLFeat uses for SIFT
+// gradients (maximum error of 0.0061 radians). The angles are mapped to (0,
+// 2pi] like VLFeat does.
+void FastAtan2(const Eigen::ArrayXf& y, const Eigen::ArrayXf& x, float* angle) {
+  static const float kC1 = 0.9675f;
+  static const float kC3 = 0.1821f;
+  static const float kQuarterPi = static_cast<float>(M_PI / 4.0);
+  static const float kThreeQuarterPi = static_cast<float>(3.0 * M_PI / 4.0);
+
+  const Eigen::ArrayXf abs_y = y.abs() + FLT_EPSILON;
+  const Eigen::ArrayXf r = (x >= 0.0f).select((x - abs_y) / (x + abs_y),
+                                              (x + abs_y) / (abs_y - x));
+  const Eigen::ArrayXf base =
+      (x >= 0.0f)
+          .select(Eigen::ArrayXf::Constant(x.size(), kQuarterPi),
+                  Eigen::ArrayXf::Constant(x.size(), kThreeQuarterPi));
+  const Eigen::ArrayXf unsigned_angle = base + (kC3 * r.square() - kC1) * r;
+  const Eigen::ArrayXf positive_angle =
+      (y < 0.0f).select(-unsigned_angle, unsigned_angle) + kTwoPi;
+  ArrayMap(angle, x.size()) =
+      (positive_angle > kTwoPi).select(positive_angle - kTwoPi, positive_angle);
+}
+
+// Normalizes the descriptor to unit L2 norm and returns the norm before
+// normalization.
+float NormalizeDescriptor(float* descriptor) {
+  ArrayMap histogram(descriptor, kNumDescriptorDimensions);
+  const float norm = std::sqrt(histogram.square().sum()) + FLT_EPSILON;
+  histogram /= norm;
+  return norm;
+}
+
+}  // namespace
+
+SiftScaleSpace::SiftScaleSpace(const SiftParameters& sift_params,
+                               ThreadPool* thread_pool)
+    : num_levels_(sift_params.num_levels),
+      min_level_(-1),
+      max_level_(sift_params.num_levels + 1),
+      sigma0_(1.6 * std::pow(2.0, 1.0 / sift_params.num_levels)),
+      sigmak_(std::pow(2.0, 1.0 / sift_params.num_levels)),
+      nominal_sigma_(0.5),
+      dsigma0_(sigma0_ * std::sqrt(1.0 - 1.0 / (sigmak_ * sigmak_))),
+      peak_threshold_(sift_params.peak_threshold),
+      edge_threshold_(sift_params.edge_threshold),
+      num_octaves_param_(sift_params.num_octaves),
+      thread_pool_(thread_pool),
+      width_(0),
+      height_(0),
+      num_octaves_(0),
+      first_octave_(0),
+      current_octave_(0),
+      octave_width_(0),
+      octave_height_(0) {
+  CHECK_GT(num_levels_, 0);
+}
+
+float* SiftScaleSpace::GaussianLevel(const int s) {
+  return octave_.data() + (s - min_level_) * octave_width_ * octave_height_;
+}
+
+const float* SiftScaleSpace::GaussianLevel(const int s) const {
+  return octave_.data() + (s - min_level_) * octave_width_ * octave_height_;
+}
+
+const float* SiftScaleSpace::DoGLevel(const int s) const {
+  return dog_.data() + (s - min_level_) * octave_width_ * octave_height_;
+}
+
+const float* SiftScaleSpace::GradientMagnitudeLevel(const int s) const {
+  return gradient_magnitude_.data() +
+         (s - min_level_ - 1) * octave_width_ * octave_height_;
+}
+
+const float* SiftScaleSpace::GradientOrientationLevel(const int s) const {
+  return gradient_orientation_.data() +
+         (s - min_level_ - 1) * octave_width_ * octave_height_;
+}
+
+bool SiftScaleSpace::ProcessFirstOctave(const int width,
+                                        const int height,
+                                        const int first_octave,
+                                        const float* image) {
+  width_ = width;
+  height_ = height;
+  first_octave_ = first_octave;
+  num_octaves_ = num_octaves_param_;
+  if (num_octaves_ < 0) {
+    num_octaves_ = std::max(
+        static_cast<int>(std::floor(std::log2(std::min(width, height)))) -
+            first_octave - 3,
+        1);
+  }
+
+  current_octave_ = first_octave_;
+  octave_width_ = ShiftLeft(width_, -current_octave_);
+  octave_height_ = ShiftLeft(height_, -current_octave_);
+  if (num_octaves_ == 0) {
+    return false;
+  }
+
+  // Grow the arena if the first (and largest) octave of this image does not
+  // fit. Subsequent images with the same resolution reuse the buffers.
+  const size_t num_pixels = octave_width_ * octave_height_;
+  const int num_gaussian_levels = max_level_ - min_level_ + 1;
+  if (temp_.size() < num_pixels) {
+    octave_.resize(num_pixels * num_gaussian_levels);
+    dog_.resize(num_pixels * (num_gaussian_levels - 1));
+    gradient_magnitude_.resize(num_pixels * (num_gaussian_levels - 3));
+    gradient_orientation_.resize(num_pixels * (num_gaussian_levels - 3));
+    temp_.resize(num_pixels);
+  }
+
+  // Compute the first level of the first octave by resampling the image.
+  float* base = GaussianLevel(min_level_);
+  if (first_octave_ < 0) {
+    // Upsample once for each negative octave, alternating between the two
+    // buffers such that the final result ends up in the base level.
+    const int num_upsamplings = -first_octave_;
+    float* buffers[2] = { num_upsamplings % 2 == 0 ? temp_.data() : base,
+                          num_upsamplings % 2 == 0 ? base : temp_.data() };
+    const float* input = image;
+    int input_width = width_;
+    int input_height = height_;
+    for (int i = 0; i < num_upsamplings; i++) {
+      float* output = buffers[i % 2];
+      UpsampleImage(thread_pool_, input_width, input_height, input, output);
+      input = output;
+      input_width *= 2;
+      input_height *= 2;
+    }
+  } else if (first_octave_ > 0) {
+    DownsampleImage(width_, height_, first_octave_, image, base);
+  } else {
+    std::copy(image, image + num_pixels, base);
+  }
+
+  // The input image is assumed to have a nominal smoothing; adjust it to the
+  // smoothing of the first level.
+  const double sa = sigma0_ * std::pow(sigmak_, min_level_);
+  const double sb = nominal_sigma_ * std::pow(2.0, -first_octave_);
+  if (sa > sb) {
+    GaussianBlur(octave_width_, octave_height_, std::sqrt(sa * sa - sb * sb),
+                 base, base);
+  }
+
+  FillOctave();
+  return true;
+}
+
+bool SiftScaleSpace::ProcessNextOctave() {
+  if (current_octave_ == first_octave_ + num_octaves_ - 1) {
+    return false;
+  }
+
+  // The level with twice the smoothing of the base level becomes the base of
+  // the next octave after downsampling.
+  const int best_level = std::min(min_level_ + num_levels_, max_level_);
+  const int width = octave_width_;
+  const int height = octave_height_;
+  DownsampleImage(width, height, 1, GaussianLevel(best_level), temp_.data());
+
+  ++current_octave_;
+  octave_width_ = ShiftLeft(width_, -current_octave_);
+  octave_height_ = ShiftLeft(height_, -current_octave_);
+  float* base = GaussianLevel(min_level_);
+  std::copy(temp_.data(), temp_.data() + octave_width_ * octave_height_, base);
+
+  const double sa = sigma0_ * std::pow(sigmak_, min_level_);
+  const double sb = sigma0_ * std::pow(sigmak_, best_level - num_levels_);
+  if (sa > sb) {
+    GaussianBlur(octave_width_, octave_height_, std::sqrt(sa * sa - sb * sb),
+                 base, base);
+  }
+
+  FillOctave();
+  return true;
+}
+
+void SiftScaleSpace::FillOctave() {
+  for (int s = min_level_ + 1; s <= max_level_; ++s) {
+    const double sigma = dsigma0_ * std::pow(sigmak_, s);
+    GaussianBlur(octave_width_, octave_height_, sigma, GaussianLevel(s - 1),
+                 GaussianLevel(s));
+  }
+  ComputeDoGAndGradients();
+}
+
+void SiftScaleSpace::GaussianBlur(const int width,
+                                  const int height,
+                                  const double sigma,
+                                  const float* input,
+                                  float* output) {
+  // Build the same normalized kernel as VLFeat.
+  const int radius = std::max(static_cast<int>(std::ceil(4.0 * sigma)), 1);
+  const int kernel_size = 2 * radius + 1;
+  std::vector<float> kernel(kernel_size);
+  float kernel_sum = 0.0f;
+  for (int i = 0; i < kernel_size; i++) {
+    const float d = static_cast<float>(i - radius) / static_cast<float>(sigma);
+    kernel[i] = static_cast<float>(std::exp(-0.5 * d * d));
+    kernel_sum += kernel[i];
+  }
+  for (int i = 0; i < kernel_size; i++) {
+    kernel[i] /= kernel_sum;
+  }
+
+  // Convolve the columns into the temporary buffer. Each output row is a
+  // weighted sum of whole input rows, with the rows clamped at the image
+  // border, which vectorizes well.
+  float* temp = temp_.data();
+  ParallelFor(thread_pool_, 0, height, kMinRowsPerTask, [&](const int start,
+                                                            const int end) {
+    for (int y = start; y < end; y++) {
+      ArrayMap out_row(temp + y * width, width);
+      out_row.setZero();
+      for (int i = 0; i < kernel_size; i++) {
+        const int input_y = std::min(std::max(y + i - radius, 0), height - 1);
+        out_row += kernel[i] * ConstArrayMap(input + input_y * width, width);
+      }
+    }
+  });
+
+  // Convolve the rows of the temporary buffer into the output. Each row is
+  // padded by replicating its border pixels so that the convolution becomes a
+  // sum of shifted copies of the padded row.
+  ParallelFor(thread_pool_, 0, height, kMinRowsPerTask, [&](const int start,
+                                                            const int end) {
+    Eigen::ArrayXf padded_row(width + 2 * radius);
+    for (int y = start; y < end; y++) {
+      ConstArrayMap row(temp + y * width, width);
+      padded_row.head(radius).setConstant(row(0));
+      padded_row.segment(radius, width) = row;
+      padded_row.tail(radius).setConstant(row(width - 1));
+
+      ArrayMap out_row(output + y * width, width);
+      out_row = kernel[0] * padded_row.head(width);
+      for (int i = 1; i < kernel_size; i++) {
+        out_row += kernel[i] * padded_row.segment(i, width);
+      }
+    }
+  });
+}
+
+void SiftScaleSpace::ComputeDoGAndGradients() {
+  const int width = octave_width_;
+  const int height = octave_height_;
+
+  // Difference of Gaussians for all levels.
+  const int num_dog_levels = max_level_ - min_level_;
+  ParallelFor(thread_pool_, 0, num_dog_levels * height, kMinRowsPerTask,
+              [&](const int start, const int end) {
+    for (int i = start; i < end; i++) {
+      const int s = min_level_ + i / height;
+      const int offset = (i % height) * width;
+      ArrayMap(dog_.data() + (s - min_level_) * width * height + offset,
+               width) =
+          ConstArrayMap(GaussianLevel(s + 1) + offset, width) -
+          ConstArrayMap(GaussianLevel(s) + offset, width);
+    }
+  });
+
+  // Gradient magnitude and orientation of the levels that keypoints are
+  // detected at. Central differences are used in the interior and one-sided
+  // differences at the border.
+  const int num_gradient_levels = max_level_ - min_level_ - 2;
+  ParallelFor(thread_pool_, 0, num_gradient_levels * height, kMinRowsPerTask,
+              [&](const int start, const int end) {
+    Eigen::ArrayXf gx(width), gy(width);
+    for (int i = start; i < end; i++) {
+      const int s = min_level_ + 1 + i / height;
+      const int y = i % height;
+      const float* level = GaussianLevel(s);
+      ConstArrayMap row(level + y * width, width);
+
+      if (width > 1) {
+        gx(0) = row(1) - row(0);
+        gx.segment(1, width - 2) =
+            0.5f * (row.tail(width - 2) - row.head(width - 2));
+        gx(width - 1) = row(width - 1) - row(width - 2);
+      } else {
+        gx.setZero();
+      }
+
+      if (height == 1) {
+        gy.setZero();
+      } else if (y == 0) {
+        gy = ConstArrayMap(level + width, width) - row;
+      } else if (y == height - 1) {
+        gy = row - ConstArrayMap(level + (y - 1) * width, width);
+      } else {
+        gy = 0.5f * (ConstArrayMap(level + (y + 1) * width, width) -
+                     ConstArrayMap(level + (y - 1) * width, width));
+      }
+
+      const int offset = (s - min_level_ - 1) * width * height + y * width;
+      ArrayMap(gradient_magnitude_.data() + offset, width) =
+          (gx.square() + gy.square()).sqrt();
+      FastAtan2(gy, gx, gradient_orientation_.data() + offset);
+    }
+  });
+}
+
+void SiftScaleSpace::DetectKeypoints(
+    std::vector<SiftScaleSpaceKeypoint>* keypoints) const {
+  CHECK_NOTNULL(keypoints)->clear();
+  const int width = octave_width_;
+  const int height = octave_height_;
+  if (width < 3 || height < 3) {
+    return;
+  }
+
+  // Find the local extrema of the DoG. A pixel is an extremum if it is strictly
+  // larger (smaller) than all 26 neighbors, which is tested for a whole row at
+  // once by comparing against the maximum (minimum) of the shifted neighbor
+  // rows.
+  const int num_levels = max_level_ - min_level_ - 2;
+  const int num_rows = num_levels * (height - 2);
+  const float extremum_threshold = static_cast<float>(0.8 * peak_threshold_);
+  std::vector<std::vector<SiftScaleSpaceKeypoint> > row_candidates(num_rows);
+  ParallelFor(thread_pool_, 0, num_rows, kMinRowsPerTask,
+              [&](const int start, const int end) {
+    const int n = width - 2;
+    Eigen::ArrayXf neighbor_max(n), neighbor_min(n);
+    for (int i = start; i < end; i++) {
+      const int s = min_level_ + 1 + i / (height - 2);
+      const int y = 1 + i % (height - 2);
+      neighbor_max.setConstant(-std::numeric_limits<float>::infinity());
+      neighbor_min.setConstant(std::numeric_limits<float>::infinity());
+      for (int ds = -1; ds <= 1; ds++) {
+        for (int dy = -1; dy <= 1; dy++) {
+          const float* row = DoGLevel(s + ds) + (y + dy) * width;
+          for (int dx = -1; dx <= 1; dx++) {
+            if (ds == 0 && dy == 0 && dx == 0) {
+              continue;
+            }
+            const ConstArrayMap neighbors(row + 1 + dx, n);
+            neighbor_max = neighbor_max.max(neighbors);
+            neighbor_min = neighbor_min.min(neighbors);
+          }
+        }
+      }
+
+      const ConstArrayMap center(DoGLevel(s) + y * width + 1, n);
+      for (int j = 0; j < n; j++) {
+        const float v = center(j);
+        if ((v >= extremum_threshold && v > neighbor_max(j)) ||
+            (v <= -extremum_threshold && v < neighbor_min(j))) {
+          SiftScaleSpaceKeypoint candidate;
+          candidate.octave = current_octave_;
+          candidate.ix = j + 1;
+          candidate.iy = y;
+          candidate.is = s;
+          row_candidates[i].emplace_back(candidate);
+        }
+      }
+    }
+  });
+
+  std::vector<SiftScaleSpaceKeypoint> candidates;
+  for (const auto& candidates_in_row : row_candidates) {
+    candidates.insert(candidates.end(), candidates_in_row.begin(),
+                      candidates_in_row.end());
+  }
+
+  // Refine the location of each extremum by fitting a quadratic to the DoG and
+  // reject unstable extrema with low contrast or along edges.
+  const double xper = std::pow(2.0, current_octave_);
+  const int xo = 1;
+  const int yo = width;
+  const int so = width * height;
+  std::vector<char> is_good(candidates.size(), 0);
+  ParallelFor(thread_pool_, 0, candidates.size(), kMinCandidatesPerTask,
+              [&](const int start, const int end) {
+    for (int k = start; k < end; k++) {
+      SiftScaleSpaceKeypoint& keypoint = candidates[k];
+      int x = keypoint.ix;
+      int y = keypoint.iy;
+      const int s = keypoint.is;
+
+      double Dx = 0, Dy = 0, Ds = 0, Dxx = 0, Dyy = 0, Dss = 0, Dxy = 0,
+             Dxs = 0, Dys = 0;
+      double A[3 * 3], b[3];
+      const float* pt = nullptr;
+      int dx = 0;
+      int dy = 0;
+
+      for (int iter = 0; iter < 5; ++iter) {
+        x += dx;
+        y += dy;
+        pt = dog_.data() + xo * x + yo * y + so * (s - min_level_);
+#define AT(dx, dy, ds) (*(pt + (dx) * xo + (dy) * yo + (ds) * so))
+#define A_AT(i, j) (A[(i) + (j) * 3])
+
+        // Gradient.
+        Dx = 0.5 * (AT(+1, 0, 0) - AT(-1, 0, 0));
+        Dy = 0.5 * (AT(0, +1, 0) - AT(0, -1, 0));
+        Ds = 0.5 * (AT(0, 0, +1) - AT(0, 0, -1));
+
+        // Hessian.
+        Dxx = (AT(+1, 0, 0) + AT(-1, 0, 0) - 2.0 * AT(0, 0, 0));
+        Dyy = (AT(0, +1, 0) + AT(0, -1, 0) - 2.0 * AT(0, 0, 0));
+        Dss = (AT(0, 0, +1) + AT(0, 0, -1) - 2.0 * AT(0, 0, 0));
+        Dxy = 0.25 * (AT(+1, +1, 0) + AT(-1, -1, 0) - AT(-1, +1, 0) -
+                      AT(+1, -1, 0));
+        Dxs = 0.25 * (AT(+1, 0, +1) + AT(-1, 0, -1) - AT(-1, 0, +1) -
+                      AT(+1, 0, -1));
+        Dys = 0.25 * (AT(0, +1, +1) + AT(0, -1, -1) - AT(0, -1, +1) -
+                      AT(0, +1, -1));
+
+        A_AT(0, 0) = Dxx;
+        A_AT(1, 1) = Dyy;
+        A_AT(2, 2) = Dss;
+        A_AT(0, 1) = A_AT(1, 0) = Dxy;
+        A_AT(0, 2) = A_AT(2, 0) = Dxs;
+        A_AT(1, 2) = A_AT(2, 1) = Dys;
+        b[0] = -Dx;
+        b[1] = -Dy;
+        b[2] = -Ds;
+
+        // Gauss elimination with partial pivoting, exactly as VLFeat does it so
+        // that singular systems are treated the same way.
+        for (int j = 0; j < 3; ++j) {
+          double maxa = 0;
+          double maxabsa = 0;
+          int maxi = -1;
+          for (int i = j; i < 3; ++i) {
+            const double a = A_AT(i, j);
+            const double absa = std::abs(a);
+            if (absa > maxabsa) {
+              maxa = a;
+              maxabsa = absa;
+              maxi = i;
+            }
+          }
+
+          // Give up if the system is singular.
+          if (maxabsa < 1e-10f) {
+            b[0] = 0;
+            b[1] = 0;
+            b[2] = 0;
+            break;
+          }
+
+          const int i = maxi;
+          for (int jj = j; jj < 3; ++jj) {
+            std::swap(A_AT(i, jj), A_AT(j, jj));
+            A_AT(j, jj) /= maxa;
+          }
+          std::swap(b[j], b[i]);
+          b[j] /= maxa;
+
+          for (int ii = j + 1; ii < 3; ++ii) {
+            const double factor = A_AT(ii, j);
+            for (int jj = j; jj < 3; ++jj) {
+              A_AT(ii, jj) -= factor * A_AT(j, jj);
+            }
+            b[ii] -= factor * b[j];
+          }
+        }
+
+        // Backward substitution.
+        for (int i = 2; i > 0; --i) {
+          const double value = b[i];
+          for (int ii = i - 1; ii >= 0; --ii) {
+            b[ii] -= value * A_AT(ii, i);
+          }
+        }
+
+        // Move to the neighboring pixel and iterate if the offset is large.
+        dx = ((b[0] > 0.6 && x < width - 2) ? 1 : 0) +
+             ((b[0] < -0.6 && x > 1) ? -1 : 0);
+        dy = ((b[1] > 0.6 && y < height - 2) ? 1 : 0) +
+             ((b[1] < -0.6 && y > 1) ? -1 : 0);
+        if (dx == 0 && dy == 0) {
+          break;
+        }
+      }
+
+      const double value = AT(0, 0, 0) + 0.5 * (Dx * b[0] + Dy * b[1] +
+                                                Ds * b[2]);
+#undef AT
+#undef A_AT
+      const double score = (Dxx + Dyy) * (Dxx + Dyy) / (Dxx * Dyy - Dxy * Dxy);
+      const double xn = x + b[0];
+      const double yn = y + b[1];
+      const double sn = s + b[2];
+      const double te = edge_threshold_;
+
+      const bool good = std::abs(value) > peak_threshold_ &&
+                        score < (te + 1) * (te + 1) / te && score >= 0 &&
+                        std::abs(b[0]) < 1.5 && std::abs(b[1]) < 1.5 &&
+                        std::abs(b[2]) < 1.5 && xn >= 0 && xn <= width - 1 &&
+                        yn >= 0 && yn <= height - 1 && sn >= min_level_ &&
+                        sn <= max_level_;
+      if (good) {
+        keypoint.ix = x;
+        keypoint.iy = y;
+        keypoint.s = sn;
+        keypoint.x = xn * xper;
+        keypoint.y = yn * xper;
+        keypoint.sigma = sigma0_ * std::pow(2.0, sn / num_levels_) * xper;
+        keypoint.response = std::abs(value);
+        is_good[k] = 1;
+      }
+    }
+  });
+
+  for (int i = 0; i < candidates.size(); i++) {
+    if (is_good[i]) {
+      keypoints->emplace_back(candidates[i]);
+    }
+  }
+}
+
+int SiftScaleSpace::ComputeKeypointOrientations(
+    const SiftScaleSpaceKeypoint& keypoint, double angles[4]) const {
+  static const double kWindowFactor = 1.5;
+  static const int kNumBins = kNumOrientationHistogramBins;
+
+  const int width = octave_width_;
+  const int height = octave_height_;
+  const double xper = std::pow(2.0, current_octave_);
+  const double x = keypoint.x / xper;
+  const double y = keypoint.y / xper;
+  const double sigma = keypoint.sigma / xper;
+  const int xi = static_cast<int>(x + 0.5);
+  const int yi = static_cast<int>(y + 0.5);
+  const int si = keypoint.is;
+  const double sigmaw = kWindowFactor * sigma;
+  const int window = std::max(static_cast<int>(std::floor(3.0 * sigmaw)), 1);
+
+  if (keypoint.octave != current_octave_ || xi < 0 || xi > width - 1 ||
+      yi < 0 || yi > height - 1 || si < min_level_ + 1 ||
+      si > max_level_ - 2) {
+    return 0;
+  }
+
+  // Accumulate the gradient orientations in a circular window, weighted by the
+  // gradient magnitude and a Gaussian. The weights are computed for a whole row
+  // of the window at once and then distributed to the two nearest bins.
+  double histogram[kNumBins] = { 0.0 };
+  const float* magnitudes = GradientMagnitudeLevel(si);
+  const float* orientations = GradientOrientationLevel(si);
+  const int min_xs = std::max(-window, -xi);
+  const int max_xs = std::min(window, width - 1 - xi);
+  const int num_cols = max_xs - min_xs + 1;
+  const Eigen::ArrayXf dx =
+      Eigen::ArrayXf::LinSpaced(num_cols, min_xs, max_xs) +
+      static_cast<float>(xi - x);
+  const float max_r2 = window * window + 0.6f;
+  const float inverse_two_sigmaw_sq = 1.0 / (2.0 * sigmaw * sigmaw);
+  for (int ys = std::max(-window, -yi); ys <= std::min(window, height - 1 - yi);
+       ++ys) {
+    const float dy = static_cast<float>(yi + ys - y);
+    const int offset = (yi + ys) * width + xi + min_xs;
+    const Eigen::ArrayXf r2 = dx.square() + dy * dy;
+    const Eigen::ArrayXf weight =
+        (-r2 * inverse_two_sigmaw_sq).exp() *
+        ConstArrayMap(magnitudes + offset, num_cols);
+    const Eigen::ArrayXf fbin =
+        (kNumBins / kTwoPi) * ConstArrayMap(orientations + offset, num_cols);
+    for (int i = 0; i < num_cols; i++) {
+      // Limit to a circular window.
+      if (r2(i) >= max_r2) {
+        continue;
+      }
+      const int bin = static_cast<int>(std::floor(fbin(i) - 0.5f));
+      const double rbin = fbin(i) - bin - 0.5;
+      histogram[(bin + kNumBins) % kNumBins] += (1.0 - rbin) * weight(i);
+      histogram[(bin + 1) % kNumBins] += rbin * weight(i);
+    }
+  }
+
+  // Smooth the histogram.
+  for (int iter = 0; iter < 6; iter++) {
+    double prev = histogram[kNumBins - 1];
+    const double first = histogram[0];
+    int i;
+    for (i = 0; i < kNumBins - 1; i++) {
+      const double new_value = (prev + histogram[i] + histogram[i + 1]) / 3.0;
+      prev = histogram[i];
+      histogram[i] = new_value;
+    }
+    histogram[i] = (prev + histogram[i] + first) / 3.0;
+  }
+
+  const double max_value =
+      std::max(0.0, *std::max_element(histogram, histogram + kNumBins));
+
+  // Find the peaks within 80% of the maximum.
+  int num_angles = 0;
+  for (int i = 0; i < kNumBins; ++i) {
+    const double h0 = histogram[i];
+    const double hm = histogram[(i - 1 + kNumBins) % kNumBins];
+    const double hp = histogram[(i + 1) % kNumBins];
+    if (h0 > 0.8 * max_value && h0 > hm && h0 > hp) {
+      // Quadratic interpolation of the peak.
+      const double di = -0.5 * (hp - hm) / (hp + hm - 2 * h0);
+      angles[num_angles++] = 2.0 * M_PI * (i + di + 0.5) / kNumBins;
+      if (num_angles == 4) {
+        break;
+      }
+    }
+  }
+  return num_angles;
+}
+
+bool SiftScaleSpace::ComputeKeypointDescriptor(
+    const SiftScaleSpaceKeypoint& keypoint,
+    const double angle,
+    float* descriptor) const {
+  static const float kWindowSigma = kNumSpatialBins / 2;
+  static const int kHalfNumBins = kNumSpatialBins / 2;
+  static const int kBinYStride = kNumOrientationBins * kNumSpatialBins;
+  static const int kBinXStride = kNumOrientationBins;
+
+  const int width = octave_width_;
+  const int height = octave_height_;
+  const double xper = std::pow(2.0, current_octave_);
+  const double x = keypoint.x / xper;
+  const double y = keypoint.y / xper;
+  const double sigma = keypoint.sigma / xper;
+  const int xi = static_cast<int>(x + 0.5);
+  const int yi = static_cast<int>(y + 0.5);
+  const int si = keypoint.is;
+
+  if (keypoint.octave != current_octave_ || xi < 0 || xi >= width || yi < 0 ||
+      yi >= height - 1 || si < min_level_ + 1 || si > max_level_ - 2) {
+    return false;
+  }
+
+  const float st0 = std::sin(angle);
+  const float ct0 = std::cos(angle);
+  // The width of a spatial bin and the radius of the window that covers all
+  // (rotated) bins, including the half bin of interpolation support.
+  const double bin_size = kMagnification * sigma + DBL_EPSILON;
+  const int window = std::floor(std::sqrt(2.0) * bin_size *
+                                (kNumSpatialBins + 1) / 2.0 + 0.5);
+
+  std::fill(descriptor, descriptor + kNumDescriptorDimensions, 0.0f);
+  float* center_bin =
+      descriptor + kHalfNumBins * kBinYStride + kHalfNumBins * kBinXStride;
+
+  // Process the pixels of the window that are not on the image border. The
+  // normalized coordinates, angles and weights of each row are computed at
+  // once before the samples are distributed to the 8 adjacent bins.
+  const float* magnitudes = GradientMagnitudeLevel(si);
+  const float* orientations = GradientOrientationLevel(si);
+  const int min_dxi = std::max(-window, 1 - xi);
+  const int max_dxi = std::min(window, width - xi - 2);
+  const int num_cols = max_dxi - min_dxi + 1;
+  if (num_cols <= 0) {
+    NormalizeDescriptor(descriptor);
+    return true;
+  }
+  const Eigen::ArrayXf dx =
+      Eigen::ArrayXf::LinSpaced(num_cols, min_dxi, max_dxi) +
+      static_cast<float>(xi - x);
+  const float inverse_bin_size = 1.0 / bin_size;
+  const float inverse_two_window_sigma_sq =
+      1.0f / (2.0f * kWindowSigma * kWindowSigma);
+  Eigen::ArrayXf theta(num_cols);
+  for (int dyi = std::max(-window, 1 - yi);
+       dyi <= std::min(window, height - yi - 2); ++dyi) {
+    const float dy = static_cast<float>(yi + dyi - y);
+    const int offset = (yi + dyi) * width + xi + min_dxi;
+
+    // Orientation relative to the keypoint orientation, mapped to [0, 2pi).
+    theta = ConstArrayMap(orientations + offset, num_cols) -
+            static_cast<float>(angle);
+    theta -= kTwoPi * (theta / kTwoPi).floor();
+    const Eigen::ArrayXf nx = (ct0 * dx + st0 * dy) * inverse_bin_size;
+    const Eigen::ArrayXf ny = (-st0 * dx + ct0 * dy) * inverse_bin_size;
+    const Eigen::ArrayXf nt = (kNumOrientationBins / kTwoPi) * theta;
+    const Eigen::ArrayXf weight =
+        (-(nx.square() + ny.square()) * inverse_two_window_sigma_sq).exp() *
+        ConstArrayMap(magnitudes + offset, num_cols);
+
+    for (int i = 0; i < num_cols; i++) {
+      // The sample is distributed to the 8 adjacent bins starting from the
+      // "lower-left" one.
+      const int binx = static_cast<int>(std::floor(nx(i) - 0.5f));
+      const int biny = static_cast<int>(std::floor(ny(i) - 0.5f));
+      const int bint = static_cast<int>(std::floor(nt(i)));
+      const float rbinx = nx(i) - (binx + 0.5f);
+      const float rbiny = ny(i) - (biny + 0.5f);
+      const float rbint = nt(i) - bint;
+      for (int dbinx = 0; dbinx < 2; ++dbinx) {
+        if (binx + dbinx < -kHalfNumBins || binx + dbinx >= kHalfNumBins) {
+          continue;
+        }
+        const float wx = weight(i) * std::abs(1 - dbinx - rbinx);
+        for (int dbiny = 0; dbiny < 2; ++dbiny) {
+          if (biny + dbiny < -kHalfNumBins || biny + dbiny >= kHalfNumBins) {
+            continue;
+          }
+          const float wxy = wx * std::abs(1 - dbiny - rbiny);
+          float* bin = center_bin + (biny + dbiny) * kBinYStride +
+                       (binx + dbinx) * kBinXStride;
+          bin[bint % kNumOrientationBins] += wxy * std::abs(1 - rbint);
+          bin[(bint + 1) % kNumOrientationBins] += wxy * std::abs(rbint);
+        }
+      }
+    }
+  }
+
+  // Normalize, truncate at 0.2 and normalize again.
+  NormalizeDescriptor(descriptor);
+  ArrayMap histogram(descriptor, kNumDescriptorDimensions);
+  histogram = histogram.min(0.2f);
+  NormalizeDescriptor(descriptor);
+  return true;
+}
+
+SiftScaleSpaceKeypoint SiftScaleSpace::InitializeKeypoint(
+    const double x, const double y, const double sigma) const {
+  const double phi = std::log2((sigma + DBL_EPSILON) / sigma0_);
+  int o = static_cast<int>(
+      std::floor(phi - (static_cast<double>(min_level_) + 0.5) / num_levels_));
+  o = std::min(o, first_octave_ + num_octaves_ - 1);
+  o = std::max(o, first_octave_);
+  const double s = num_levels_ * (phi - o);
+
+  int is = static_cast<int>(s + 0.5);
+  is = std::min(is, max_level_ - 2);
+  is = std::max(is, min_level_ + 1);
+
+  const double xper = std::pow(2.0, o);
+  SiftScaleSpaceKeypoint keypoint;
+  keypoint.octave = o;
+  keypoint.ix = static_cast<int>(x / xper + 0.5);
+  keypoint.iy = static_cast<int>(y / xper + 0.5);
+  keypoint.is = is;
+  keypoint.x = x;
+  keypoint.y = y;
+  keypoint.s = s;
+  keypoint.sigma = sigma;
+  return keypoint;
+}
+
+}  // namespace theia
@@ -0,0 +1,198 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+
+#ifndef THEIA_IMAGE_DESCRIPTOR_SIFT_SCALE_SPACE_H_
+#define THEIA_IMAGE_DESCRIPTOR_SIFT_SCALE_SPACE_H_
+
+#include <vector>
+
+#include "theia/image/keypoint_detector/sift_parameters.h"
+#include "theia/util/util.h"
+
+namespace theia {
+
+class ThreadPool;
+
+// A keypoint in the SIFT scale space. The octave and integer coordinates (ix,
+// iy, is) locate the DoG extremum that the keypoint was detected at, and (x, y,
+// sigma) are the refined position and scale in the coordinates of the input
+// image. This mirrors VlSiftKeypoint. The response is the absolute value of the
+// refined DoG extremum.
+struct SiftScaleSpaceKeypoint {
+  int octave = 0;
+  int ix = 0;
+  int iy = 0;
+  int is = 0;
+  float x = 0.0f;
+  float y = 0.0f;
+  float s = 0.0f;
+  float sigma = 0.0f;
+  float response = 0.0f;
+};
+
+// A native implementation of the SIFT Gaussian and DoG scale space that is
+// output-compatible with the VLFeat SIFT filter (see
+// http://www.vlfeat.org/api/sift.html for a description of the parameters) but
+// vectorized with Eigen and, optionally, multithreaded. The Gaussian
+// convolutions are separable and applied to tiles of rows in parallel, and the
+// DoG extrema detection, refinement, gradients, orientations and descriptors
+// operate on whole rows at a time.
+//
+// Like VLFeat, the scale space is processed one octave at a time:
+//
+//   SiftScaleSpace scale_space(sift_params, nullptr);
+//   bool has_octave = scale_space.ProcessFirstOctave(width, height,
+//                                                    first_octave, image);
+//   while (has_octave) {
+//     scale_space.DetectKeypoints(&keypoints);
+//     ...
+//     has_octave = scale_space.ProcessNextOctave();
+//   }
+//
+// All buffers are kept between images and only grow when a larger image is
+// processed, so processing many images of the same resolution does not
+// allocate. Once an octave has been processed, all const methods are
+// thread-safe so orientations and descriptors may be computed concurrently.
+class SiftScaleSpace {
+ public:
+  // The thread pool is optional and not owned; if it is null all computation
+  // is done on the calling thread.
+  SiftScaleSpace(const SiftParameters& sift_params, ThreadPool* thread_pool);
+  ~SiftScaleSpace() {}
+
+  // Starts processing a new grayscale image of the given size, stored row-major
+  // in image. The first octave is upsampled (negative first_octave) or
+  // downsampled (positive first_octave) relative to the image. Returns false if
+  // the scale space has no octaves.
+  bool ProcessFirstOctave(const int width,
+                          const int height,
+                          const int first_octave,
+                          const float* image);
+
+  // Computes the next octave from the current one. Returns false if there are
+  // no more octaves to process.
+  bool ProcessNextOctave();
+
+  // Detects the DoG extrema of the current octave, refines their position and
+  // scale and returns the ones that pass the peak and edge thresholds. The
+  // keypoints are returned in the same order as VLFeat returns them.
+  void DetectKeypoints(std::vector<SiftScaleSpaceKeypoint>* keypoints) const;
+
+  // Computes up to 4 dominant orientations of a keypoint of the current octave
+  // and returns the number of orientations found. Zero is returned if the
+  // keypoint is not in the current octave or too close to the boundary.
+  int ComputeKeypointOrientations(const SiftScaleSpaceKeypoint& keypoint,
+                                  double angles[4]) const;
+
+  // Computes the 128-dimensional SIFT descriptor of a keypoint of the current
+  // octave with the given orientation. Returns false and leaves the descriptor
+  // untouched if the keypoint is not in the current octave or too close to the
+  // boundary.
+  bool ComputeKeypointDescriptor(const SiftScaleSpaceKeypoint& keypoint,
+                                 const double angle,
+                                 float* descriptor) const;
+
+  // Maps a keypoint of the input image with the given position and scale to the
+  // octave and level of the scale space that best represents it. This is the
+  // equivalent of vl_sift_keypoint_init and is only valid after
+  // ProcessFirstOctave has been called for the image.
+  SiftScaleSpaceKeypoint InitializeKeypoint(const double x,
+                                            const double y,
+                                            const double sigma) const;
+
+  // The octave that is currently processed.
+  int current_octave() const { return current_octave_; }
+
+ private:
+  // Returns a pointer to level s of the Gaussian scale space, DoG or gradient
+  // of the current octave.
+  float* GaussianLevel(const int s);
+  const float* GaussianLevel(const int s) const;
+  const float* DoGLevel(const int s) const;
+  const float* GradientMagnitudeLevel(const int s) const;
+  const float* GradientOrientationLevel(const int s) const;
+
+  // Computes the Gaussian levels s_min + 1 ... s_max from level s_min and then
+  // the DoG and gradients of the current octave.
+  void FillOctave();
+
+  // Computes the DoG levels and the gradient magnitude and orientation of the
+  // levels that keypoints may be detected at.
+  void ComputeDoGAndGradients();
+
+  // Convolves the image with a Gaussian kernel of standard deviation sigma. The
+  // input and output may be the same buffer.
+  void GaussianBlur(const int width,
+                    const int height,
+                    const double sigma,
+                    const float* input,
+                    float* output);
+
+  // Parameters.
+  const int num_levels_;
+  const int min_level_;
+  const int max_level_;
+  const double sigma0_;
+  const double sigmak_;
+  const double nominal_sigma_;
+  const double dsigma0_;
+  const double peak_threshold_;
+  const double edge_threshold_;
+  const int num_octaves_param_;
+  ThreadPool* thread_pool_;
+
+  // The geometry of the current image.
+  int width_;
+  int height_;
+  int num_octaves_;
+  int first_octave_;
+  int current_octave_;
+  int octave_width_;
+  int octave_height_;
+
+  // The scale space arena. These buffers hold a single octave and are sized
+  // for the largest octave seen so far.
+  std::vector<float> octave_;
+  std::vector<float> dog_;
+  std::vector<float> gradient_magnitude_;
+  std::vector<float> gradient_orientation_;
+  std::vector<float> temp_;
+
+  DISALLOW_COPY_AND_ASSIGN(SiftScaleSpace);
+};
+
+}  // namespace theia
+
+#endif  // THEIA_IMAGE_DESCRIPTOR_SIFT_SCALE_SPACE_H_
@@ -0,0 +1,231 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+
+extern "C" {
+#include <vl/sift.h>
+}
+
+#include <Eigen/Core>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "theia/image/descriptor/sift_scale_space.h"
+#include "theia/image/image.h"
+#include "theia/image/keypoint_detector/sift_parameters.h"
+#include "theia/util/threadpool.h"
+
+namespace theia {
+
+namespace {
+
+std::string img_filename =
+    THEIA_DATA_DIR + std::string("/") + "image/descriptor/img1.png";
+
+struct Feature {
+  int octave;
+  float x;
+  float y;
+  float sigma;
+  double angle;
+  Eigen::VectorXf descriptor;
+};
+
+// Extracts features with the first orientation of every keypoint using VLFeat.
+void ExtractVLFeatFeatures(const SiftParameters& sift_params,
+                           FloatImage* image,
+                           std::vector<Feature>* features) {
+  VlSiftFilt* sift_filter =
+      vl_sift_new(image->Cols(), image->Rows(), sift_params.num_octaves,
+                  sift_params.num_levels, sift_params.first_octave);
+  vl_sift_set_edge_thresh(sift_filter, sift_params.edge_threshold);
+  vl_sift_set_peak_thresh(sift_filter, sift_params.peak_threshold);
+
+  int vl_status = vl_sift_process_first_octave(sift_filter, image->Data());
+  while (vl_status != VL_ERR_EOF) {
+    vl_sift_detect(sift_filter);
+    const VlSiftKeypoint* keypoints = vl_sift_get_keypoints(sift_filter);
+    for (int i = 0; i < vl_sift_get_nkeypoints(sift_filter); i++) {
+      double angles[4];
+      if (vl_sift_calc_keypoint_orientations(sift_filter, angles,
+                                             &keypoints[i]) == 0) {
+        continue;
+      }
+      Feature feature;
+      feature.octave = keypoints[i].o;
+      feature.x = keypoints[i].x;
+      feature.y = keypoints[i].y;
+      feature.sigma = keypoints[i].sigma;
+      feature.angle = angles[0];
+      feature.descriptor.setZero(128);
+      vl_sift_calc_keypoint_descriptor(sift_filter, feature.descriptor.data(),
+                                       &keypoints[i], angles[0]);
+      features->emplace_back(feature);
+    }
+    vl_status = vl_sift_process_next_octave(sift_filter);
+  }
+  vl_sift_delete(sift_filter);
+}
+
+// Extracts features with the first orientation of every keypoint using the
+// native scale space.
+void ExtractNativeFeatures(const SiftParameters& sift_params,
+                           ThreadPool* thread_pool,
+                           FloatImage* image,
+                           std::vector<Feature>* features) {
+  SiftScaleSpace scale_space(sift_params, thread_pool);
+  std::vector<SiftScaleSpaceKeypoint> keypoints;
+  bool has_octave = scale_space.ProcessFirstOctave(
+      image->Cols(), image->Rows(), sift_params.first_octave, image->Data());
+  while (has_octave) {
+    scale_space.DetectKeypoints(&keypoints);
+    for (const SiftScaleSpaceKeypoint& keypoint : keypoints) {
+      double angles[4];
+      if (scale_space.ComputeKeypointOrientations(keypoint, angles) == 0) {
+        continue;
+      }
+      Feature feature;
+      feature.octave = keypoint.octave;
+      feature.x = keypoint.x;
+      feature.y = keypoint.y;
+      feature.sigma = keypoint.sigma;
+      feature.angle = angles[0];
+      feature.descriptor.setZero(128);
+      EXPECT_TRUE(scale_space.ComputeKeypointDescriptor(
+          keypoint, angles[0], feature.descriptor.data()));
+      features->emplace_back(feature);
+    }
+    has_octave = scale_space.ProcessNextOctave();
+  }
+}
+
+void ExpectFeaturesMatchVLFeat(const int first_octave, const int num_threads) {
+  static const double kPositionTolerance = 0.05;
+  static const double kAngleTolerance = 0.02;
+  static const double kDescriptorTolerance = 0.05;
+  static const double kMinFractionOfMatches = 0.99;
+
+  FloatImage image = FloatImage(img_filename).AsGrayscaleImage();
+  SiftParameters sift_params;
+  sift_params.first_octave = first_octave;
+
+  std::vector<Feature> vlfeat_features, native_features;
+  ExtractVLFeatFeatures(sift_params, &image, &vlfeat_features);
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (num_threads > 1) {
+    thread_pool.reset(new ThreadPool(num_threads));
+  }
+  ExtractNativeFeatures(
+      sift_params, thread_pool.get(), &image, &native_features);
+  ASSERT_GT(vlfeat_features.size(), 0);
+
+  // Both implementations return the features in the same order, but a few
+  // keypoints that are borderline for the thresholds may differ so we search
+  // for the closest feature instead.
+  int num_matches = 0;
+  for (const Feature& vlfeat_feature : vlfeat_features) {
+    const Feature* closest_feature = nullptr;
+    double min_distance = kPositionTolerance;
+    for (const Feature& native_feature : native_features) {
+      const double distance =
+          std::hypot(native_feature.x - vlfeat_feature.x,
+                     native_feature.y - vlfeat_feature.y) +
+          std::abs(native_feature.sigma - vlfeat_feature.sigma);
+      if (native_feature.octave == vlfeat_feature.octave &&
+          distance < min_distance) {
+        min_distance = distance;
+        closest_feature = &native_feature;
+      }
+    }
+
+    if (closest_feature != nullptr &&
+        std::abs(closest_feature->angle - vlfeat_feature.angle) <
+            kAngleTolerance &&
+        (closest_feature->descriptor - vlfeat_feature.descriptor).norm() <
+            kDescriptorTolerance) {
+      ++num_matches;
+    }
+  }
+
+  EXPECT_GE(num_matches, kMinFractionOfMatches * vlfeat_features.size());
+  EXPECT_LE(native_features.size(),
+            vlfeat_features.size() / kMinFractionOfMatches);
+}
+
+}  // namespace
+
+TEST(SiftScaleSpace, MatchesVLFeat) {
+  ExpectFeaturesMatchVLFeat(-1, 1);
+}
+
+TEST(SiftScaleSpace, MatchesVLFeatWithoutUpsampling) {
+  ExpectFeaturesMatchVLFeat(0, 1);
+}
+
+TEST(SiftScaleSpace, MatchesVLFeatMultithreaded) {
+  ExpectFeaturesMatchVLFeat(-1, 4);
+}
+
+TEST(SiftScaleSpace, ReusesBuffersForDifferentImageSizes) {
+  FloatImage image = FloatImage(img_filename).AsGrayscaleImage();
+  FloatImage small_image = image;
+  small_image.Resize(0.5);
+
+  SiftParameters sift_params;
+  SiftScaleSpace scale_space(sift_params, nullptr);
+  std::vector<SiftScaleSpaceKeypoint> keypoints;
+  for (FloatImage* input : { &small_image, &image, &small_image }) {
+    bool has_octave = scale_space.ProcessFirstOctave(
+        input->Cols(), input->Rows(), -1, input->Data());
+    int num_keypoints = 0;
+    while (has_octave) {
+      scale_space.DetectKeypoints(&keypoints);
+      for (const SiftScaleSpaceKeypoint& keypoint : keypoints) {
+        EXPECT_GE(keypoint.x, 0);
+        EXPECT_LT(keypoint.x, input->Cols());
+        EXPECT_GE(keypoint.y, 0);
+        EXPECT_LT(keypoint.y, input->Rows());
+      }
+      num_keypoints += keypoints.size();
+      has_octave = scale_space.ProcessNextOctave();
+    }
+    EXPECT_GT(num_keypoints, 0);
+  }
+}
+
+}  // namespace theia
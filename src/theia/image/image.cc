@@ -36,6 +36,7 @@
 
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
+#include <OpenImageIO/imageio.h>
 #include <glog/logging.h>
 #include <Eigen/Core>
 
@@ -246,6 +247,99 @@ void FloatImage::Read(const std::string& filename) {
   image_.read(0, 0, true, oiio::TypeDesc::FLOAT);
 }
 
+bool FloatImage::ReadGrayscale(const std::string& filename,
+                               const int max_dimension,
+                               int* downsampling_factor) {
+  std::unique_ptr<oiio::ImageInput> image_input(
+      oiio::ImageInput::open(filename));
+  if (image_input == nullptr) {
+    LOG(ERROR) << "Could not open the image " << filename << ": "
+               << oiio::geterror();
+    return false;
+  }
+
+  const oiio::ImageSpec& spec = image_input->spec();
+  const int full_width = spec.width;
+  const int full_height = spec.height;
+  int factor = 1;
+  if (max_dimension > 0) {
+    const int full_max_dimension = std::max(full_width, full_height);
+    factor = std::max(
+        1, (full_max_dimension + max_dimension - 1) / max_dimension);
+  }
+  const int width = std::max(1, full_width / factor);
+  const int height = std::max(1, full_height / factor);
+
+  // Only the color channels are decoded; alpha and any other channels are
+  // skipped. Images with fewer than 3 channels use their first channel.
+  const int num_decoded_channels = spec.nchannels >= 3 ? 3 : 1;
+  const float luma_weights[3] = {.2126, .7152, .0722};
+  const float single_channel_weight[1] = {1.0f};
+  const float* weights =
+      num_decoded_channels == 3 ? luma_weights : single_channel_weight;
+
+  // The pixel buffer is reused when images of the same size are read into the
+  // same image, which is common when extracting features from many images.
+  const oiio::ImageSpec& current_spec = image_.spec();
+  if (image_.localpixels() == nullptr || current_spec.width != width ||
+      current_spec.height != height || current_spec.nchannels != 1 ||
+      current_spec.format != oiio::TypeDesc::FLOAT) {
+    oiio::ImageSpec image_spec(width, height, 1, oiio::TypeDesc::FLOAT);
+    image_.reset(image_spec);
+  }
+  float* output = Data();
+
+  // Each output row is the box filtered average of a band of factor scanlines.
+  // The boxes are clamped to the image for very elongated images that are
+  // narrower than the downsampling factor.
+  const int box_width = std::min(factor, full_width);
+  std::vector<float> band(static_cast<size_t>(full_width) * factor *
+                          num_decoded_channels);
+  for (int y = 0; y < height; y++) {
+    const int band_begin = y * factor;
+    const int band_height = std::min(factor, full_height - band_begin);
+    if (!image_input->read_scanlines(band_begin,
+                                     band_begin + band_height,
+                                     0,
+                                     0,
+                                     num_decoded_channels,
+                                     oiio::TypeDesc::FLOAT,
+                                     band.data())) {
+      LOG(ERROR) << "Could not read the image " << filename << ": "
+                 << image_input->geterror();
+      image_input->close();
+      return false;
+    }
+
+    float* output_row = output + y * width;
+    std::fill(output_row, output_row + width, 0.0f);
+    for (int row = 0; row < band_height; row++) {
+      const float* scanline =
+          band.data() + row * full_width * num_decoded_channels;
+      for (int x = 0; x < width; x++) {
+        const float* pixel = scanline + x * factor * num_decoded_channels;
+        float sum = 0;
+        for (int i = 0; i < box_width; i++) {
+          for (int c = 0; c < num_decoded_channels; c++) {
+            sum += weights[c] * pixel[c];
+          }
+          pixel += num_decoded_channels;
+        }
+        output_row[x] += sum;
+      }
+    }
+    const float normalization = 1.0f / static_cast<float>(band_height *
+                                                          box_width);
+    for (int x = 0; x < width; x++) {
+      output_row[x] *= normalization;
+    }
+  }
+  image_input->close();
+
+  *downsampling_factor = factor;
+  return true;
+}
+
 void FloatImage::Write(const std::string& filename) const {
   image_.write(filename);
 }
@@ -357,4 +451,18 @@ void FloatImage::Resize(double scale) {
          Channels());
 }
 
+bool ReadImageDimensions(const std::string& filename, int* width, int* height) {
+  std::unique_ptr<oiio::ImageInput> image_input(
+      oiio::ImageInput::open(filename));
+  if (image_input == nullptr) {
+    LOG(ERROR) << "Could not open the image " << filename << ": "
+               << oiio::geterror();
+    return false;
+  }
+  *width = image_input->spec().width;
+  *height = image_input->spec().height;
+  image_input->close();
+  return true;
+}
+
 }  // namespace theia
@@ -140,6 +140,20 @@ class FloatImage {
   void Read(const std::string& filename);
   void Write(const std::string& filename) const;
 
+  // Reads the image from file as a single-channel grayscale image that is
+  // downsampled by the smallest integer factor for which neither dimension
+  // exceeds max_dimension (no downsampling is done if max_dimension is not
+  // positive). The file is decoded one band of scanlines at a time and each
+  // band is converted to grayscale and box filtered as it is read, so the full
+  // resolution color image is never held in memory. Pixel (x, y) of the
+  // resulting image is centered at (f * x + (f - 1) / 2, f * y + (f - 1) / 2)
+  // in the original image where f is the downsampling factor. The pixel buffer
+  // is reused if the image already has the resulting size. Returns false if
+  // the image could not be read.
+  bool ReadGrayscale(const std::string& filename,
+                     const int max_dimension,
+                     int* downsampling_factor);
+
   // Get a pointer to the data.
   float* Data();
   const float* Data() const;
@@ -177,6 +191,11 @@ class FloatImage {
  protected:
   oiio::ImageBuf image_;
 };
+
+// Reads the width and height of an image from the header of the file without
+// decoding any pixels. Returns false if the file could not be opened.
+bool ReadImageDimensions(const std::string& filename, int* width, int* height);
+
 }  // namespace theia
 
 #endif  // THEIA_IMAGE_IMAGE_H_
@@ -37,6 +37,7 @@
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 #include <stdio.h>
+#include <algorithm>
 #include <string>
 
 #include "gtest/gtest.h"
@@ -130,6 +131,57 @@ TEST(Image, ConvertToGrayscaleImage) {
   ASSERT_IMG_EQ(gray_img, theia_img, rows, cols);
 }
 
+TEST(Image, ReadGrayscaleFullResolution) {
+  FloatImage gray_img(img_filename);
+  gray_img.ConvertToGrayscaleImage();
+
+  FloatImage theia_img;
+  int downsampling_factor = 0;
+  ASSERT_TRUE(theia_img.ReadGrayscale(img_filename, 0, &downsampling_factor));
+  EXPECT_EQ(downsampling_factor, 1);
+  ASSERT_EQ(theia_img.Channels(), 1);
+  ASSERT_EQ(theia_img.Width(), gray_img.Width());
+  ASSERT_EQ(theia_img.Height(), gray_img.Height());
+
+  for (int y = 0; y < theia_img.Height(); y++) {
+    for (int x = 0; x < theia_img.Width(); x++) {
+      EXPECT_NEAR(theia_img.GetXY(x, y, 0), gray_img.GetXY(x, y, 0), 1e-6);
+    }
+  }
+}
+
+TEST(Image, ReadGrayscaleDownsampled) {
+  FloatImage gray_img(img_filename);
+  gray_img.ConvertToGrayscaleImage();
+
+  // Request an image that is a little more than a third of the original size
+  // so that it must be downsampled by a factor of 3.
+  const int max_dimension =
+      std::max(gray_img.Width(), gray_img.Height()) / 3 + 1;
+  FloatImage theia_img;
+  int downsampling_factor = 0;
+  ASSERT_TRUE(theia_img.ReadGrayscale(img_filename, max_dimension,
+                                      &downsampling_factor));
+  EXPECT_EQ(downsampling_factor, 3);
+  ASSERT_EQ(theia_img.Channels(), 1);
+  EXPECT_EQ(theia_img.Width(), gray_img.Width() / 3);
+  EXPECT_EQ(theia_img.Height(), gray_img.Height() / 3);
+  EXPECT_LE(std::max(theia_img.Width(), theia_img.Height()), max_dimension);
+
+  // Each pixel is the average of a 3x3 box of the full resolution image.
+  for (int y = 0; y < theia_img.Height(); y++) {
+    for (int x = 0; x < theia_img.Width(); x++) {
+      float box_sum = 0;
+      for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+          box_sum += gray_img.GetXY(3 * x + j, 3 * y + i, 0);
+        }
+      }
+      EXPECT_NEAR(theia_img.GetXY(x, y, 0), box_sum / 9.0f, 1e-5);
+    }
+  }
+}
+
 TEST(Image, ConvertToRGBImage) {
   oiio::ImageBuf oiio_img(img_filename.c_str());
   oiio::ImageBuf gray_img;
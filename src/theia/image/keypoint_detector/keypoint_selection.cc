@@ -0,0 +1,140 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/image/keypoint_detector/keypoint_selection.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <vector>
+
+#include "theia/image/image.h"
+#include "theia/image/keypoint_detector/keypoint.h"
+
+namespace theia {
+
+namespace {
+
+int GridCoordinate(const double coordinate,
+                   const int image_size,
+                   const int grid_size) {
+  const int cell = static_cast<int>(coordinate * grid_size / image_size);
+  return std::min(std::max(cell, 0), grid_size - 1);
+}
+
+}  // namespace
+
+void SelectKeypoints(const KeypointSelectionOptions& options,
+                     const int image_width,
+                     const int image_height,
+                     const std::vector<Keypoint>& keypoints,
+                     std::vector<int>* selected_indices) {
+  CHECK_NOTNULL(selected_indices)->clear();
+  CHECK_GT(options.grid_size, 0);
+
+  // Remove the keypoints that are outside of the mask.
+  std::vector<int> candidates;
+  candidates.reserve(keypoints.size());
+  if (options.mask != nullptr) {
+    CHECK_EQ(options.mask->Width(), image_width);
+    CHECK_EQ(options.mask->Height(), image_height);
+    for (int i = 0; i < keypoints.size(); i++) {
+      if (options.mask->BilinearInterpolate(keypoints[i].x(),
+                                            keypoints[i].y(),
+                                            0) >= options.mask_threshold) {
+        candidates.emplace_back(i);
+      }
+    }
+  } else {
+    for (int i = 0; i < keypoints.size(); i++) {
+      candidates.emplace_back(i);
+    }
+  }
+
+  if (options.max_num_keypoints <= 0 ||
+      candidates.size() <= options.max_num_keypoints) {
+    selected_indices->swap(candidates);
+    return;
+  }
+
+  // Rank the keypoints by strength. Ties keep the input order.
+  const auto strength = [&](const int i) {
+    return keypoints[i].has_strength() ? keypoints[i].strength() : 0.0;
+  };
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [&](const int i, const int j) {
+                     return strength(i) > strength(j);
+                   });
+
+  // Determine the rank of each keypoint within its grid cell. Taking the
+  // keypoints ordered by (rank, strength) takes the strongest keypoint of each
+  // cell first, then the second strongest of each cell, and so on.
+  const int grid_size = options.grid_size;
+  std::vector<int> num_keypoints_in_cell(grid_size * grid_size, 0);
+  std::vector<int> cell_rank(keypoints.size());
+  for (const int i : candidates) {
+    const int cell =
+        GridCoordinate(keypoints[i].y(), image_height, grid_size) * grid_size +
+        GridCoordinate(keypoints[i].x(), image_width, grid_size);
+    cell_rank[i] = num_keypoints_in_cell[cell]++;
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [&](const int i, const int j) {
+                     return cell_rank[i] < cell_rank[j];
+                   });
+
+  candidates.resize(options.max_num_keypoints);
+  std::sort(candidates.begin(), candidates.end());
+  selected_indices->swap(candidates);
+}
+
+void RescaleKeypointsToFullResolution(const int downsampling_factor,
+                                      std::vector<Keypoint>* keypoints) {
+  if (downsampling_factor == 1) {
+    return;
+  }
+
+  // A downsampled pixel is the average of a downsampling_factor^2 box of full
+  // resolution pixels so its center lies in the middle of that box.
+  const double factor = downsampling_factor;
+  const double offset = 0.5 * (factor - 1.0);
+  for (Keypoint& keypoint : *keypoints) {
+    keypoint.set_x(factor * keypoint.x() + offset);
+    keypoint.set_y(factor * keypoint.y() + offset);
+    if (keypoint.has_scale()) {
+      keypoint.set_scale(factor * keypoint.scale());
+    }
+  }
+}
+
+}  // namespace theia
@@ -0,0 +1,93 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_IMAGE_KEYPOINT_DETECTOR_KEYPOINT_SELECTION_H_
+#define THEIA_IMAGE_KEYPOINT_DETECTOR_KEYPOINT_SELECTION_H_
+
+#include <utility>
+#include <vector>
+
+namespace theia {
+class FloatImage;
+class Keypoint;
+
+// Options for choosing which of the detected keypoints of an image are kept.
+struct KeypointSelectionOptions {
+  // The maximum number of keypoints to keep. If this is not positive then all
+  // keypoints that pass the mask are kept.
+  int max_num_keypoints = 0;
+
+  // If the number of keypoints exceeds max_num_keypoints, the image is divided
+  // into a grid_size x grid_size grid and keypoints are taken from the cells in
+  // a round-robin fashion, strongest first, so that the kept keypoints are
+  // spread over the image. A grid size of 1 keeps the strongest keypoints.
+  int grid_size = 1;
+
+  // An optional single-channel mask with the same size as the image. Keypoints
+  // where the mask is below mask_threshold are removed. The mask is not owned.
+  const FloatImage* mask = nullptr;
+  float mask_threshold = 0.5f;
+};
+
+// Selects the keypoints that should be kept according to the options and
+// returns their indices in increasing order. Keypoints are ranked by their
+// strength; keypoints without a strength are ranked by their order in the
+// input.
+void SelectKeypoints(const KeypointSelectionOptions& options,
+                     const int image_width,
+                     const int image_height,
+                     const std::vector<Keypoint>& keypoints,
+                     std::vector<int>* selected_indices);
+
+// Maps keypoints that were detected in an image downsampled by an integer
+// factor (e.g. with FloatImage::ReadGrayscale) back to the coordinates and
+// scale of the full resolution image.
+void RescaleKeypointsToFullResolution(const int downsampling_factor,
+                                      std::vector<Keypoint>* keypoints);
+
+// Keeps only the elements at the (increasing) selected indices.
+template <typename T>
+void KeepSelectedElements(const std::vector<int>& selected_indices,
+                          std::vector<T>* elements) {
+  for (int i = 0; i < selected_indices.size(); i++) {
+    if (selected_indices[i] != i) {
+      (*elements)[i] = std::move((*elements)[selected_indices[i]]);
+    }
+  }
+  elements->resize(selected_indices.size());
+}
+
+}  // namespace theia
+
+#endif  // THEIA_IMAGE_KEYPOINT_DETECTOR_KEYPOINT_SELECTION_H_
@@ -0,0 +1,180 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/image/image.h"
+#include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/image/keypoint_detector/keypoint_selection.h"
+
+namespace theia {
+
+namespace {
+
+static const int kImageWidth = 100;
+static const int kImageHeight = 100;
+
+Keypoint MakeKeypoint(const double x, const double y, const double strength) {
+  Keypoint keypoint(x, y, Keypoint::OTHER);
+  keypoint.set_strength(strength);
+  return keypoint;
+}
+
+}  // namespace
+
+TEST(KeypointSelection, NoBudgetKeepsAllKeypoints) {
+  std::vector<Keypoint> keypoints;
+  for (int i = 0; i < 10; i++) {
+    keypoints.emplace_back(MakeKeypoint(i, i, i));
+  }
+
+  KeypointSelectionOptions options;
+  std::vector<int> selected_indices;
+  SelectKeypoints(options, kImageWidth, kImageHeight, keypoints,
+                  &selected_indices);
+  ASSERT_EQ(selected_indices.size(), keypoints.size());
+  for (int i = 0; i < selected_indices.size(); i++) {
+    EXPECT_EQ(selected_indices[i], i);
+  }
+}
+
+TEST(KeypointSelection, KeepsStrongestKeypoints) {
+  std::vector<Keypoint> keypoints;
+  for (int i = 0; i < 10; i++) {
+    keypoints.emplace_back(MakeKeypoint(i, i, i % 5));
+  }
+
+  KeypointSelectionOptions options;
+  options.max_num_keypoints = 4;
+  std::vector<int> selected_indices;
+  SelectKeypoints(options, kImageWidth, kImageHeight, keypoints,
+                  &selected_indices);
+  const std::vector<int> expected_indices = { 3, 4, 8, 9 };
+  EXPECT_EQ(selected_indices, expected_indices);
+
+  // Keypoints without a strength are kept in the input order.
+  std::vector<Keypoint> keypoints_without_strength;
+  for (int i = 0; i < 10; i++) {
+    keypoints_without_strength.emplace_back(i, i, Keypoint::OTHER);
+  }
+  SelectKeypoints(options, kImageWidth, kImageHeight,
+                  keypoints_without_strength, &selected_indices);
+  const std::vector<int> expected_indices_without_strength = { 0, 1, 2, 3 };
+  EXPECT_EQ(selected_indices, expected_indices_without_strength);
+}
+
+TEST(KeypointSelection, GridSpreadsKeypoints) {
+  // Many strong keypoints in the top left corner of the image and a few weak
+  // keypoints in the other quadrants.
+  std::vector<Keypoint> keypoints;
+  for (int i = 0; i < 20; i++) {
+    keypoints.emplace_back(MakeKeypoint(10 + i, 10 + i, 100 + i));
+  }
+  keypoints.emplace_back(MakeKeypoint(75, 25, 1.0));
+  keypoints.emplace_back(MakeKeypoint(25, 75, 2.0));
+  keypoints.emplace_back(MakeKeypoint(75, 75, 3.0));
+
+  KeypointSelectionOptions options;
+  options.max_num_keypoints = 6;
+  options.grid_size = 2;
+  std::vector<int> selected_indices;
+  SelectKeypoints(options, kImageWidth, kImageHeight, keypoints,
+                  &selected_indices);
+
+  // The strongest keypoint of each cell is kept, then the remaining budget
+  // goes to the strongest remaining keypoints.
+  const std::vector<int> expected_indices = { 17, 18, 19, 20, 21, 22 };
+  EXPECT_EQ(selected_indices, expected_indices);
+
+  // Without the grid only the top left keypoints are kept.
+  options.grid_size = 1;
+  SelectKeypoints(options, kImageWidth, kImageHeight, keypoints,
+                  &selected_indices);
+  const std::vector<int> expected_indices_without_grid = { 14, 15, 16, 17, 18,
+                                                           19 };
+  EXPECT_EQ(selected_indices, expected_indices_without_grid);
+}
+
+TEST(KeypointSelection, Mask) {
+  // Mask out the right half of the image.
+  FloatImage mask(kImageWidth, kImageHeight, 1);
+  for (int y = 0; y < kImageHeight; y++) {
+    for (int x = 0; x < kImageWidth; x++) {
+      mask.SetXY(x, y, 0, x < kImageWidth / 2 ? 1.0f : 0.0f);
+    }
+  }
+
+  std::vector<Keypoint> keypoints;
+  keypoints.emplace_back(MakeKeypoint(10, 10, 1.0));
+  keypoints.emplace_back(MakeKeypoint(90, 10, 5.0));
+  keypoints.emplace_back(MakeKeypoint(20, 80, 2.0));
+  keypoints.emplace_back(MakeKeypoint(60, 80, 4.0));
+
+  KeypointSelectionOptions options;
+  options.mask = &mask;
+  std::vector<int> selected_indices;
+  SelectKeypoints(options, kImageWidth, kImageHeight, keypoints,
+                  &selected_indices);
+  const std::vector<int> expected_indices = { 0, 2 };
+  EXPECT_EQ(selected_indices, expected_indices);
+
+  KeepSelectedElements(selected_indices, &keypoints);
+  ASSERT_EQ(keypoints.size(), 2);
+  EXPECT_EQ(keypoints[0].x(), 10);
+  EXPECT_EQ(keypoints[1].x(), 20);
+}
+
+TEST(KeypointSelection, RescaleKeypointsToFullResolution) {
+  std::vector<Keypoint> keypoints;
+  keypoints.emplace_back(MakeKeypoint(0, 0, 1.0));
+  keypoints.emplace_back(MakeKeypoint(10, 20, 1.0));
+  keypoints[1].set_scale(1.5);
+
+  RescaleKeypointsToFullResolution(1, &keypoints);
+  EXPECT_EQ(keypoints[1].x(), 10);
+  EXPECT_EQ(keypoints[1].y(), 20);
+  EXPECT_EQ(keypoints[1].scale(), 1.5);
+
+  // Downsampled pixel (0, 0) covers the full resolution pixels 0 to 3.
+  RescaleKeypointsToFullResolution(4, &keypoints);
+  EXPECT_EQ(keypoints[0].x(), 1.5);
+  EXPECT_EQ(keypoints[0].y(), 1.5);
+  EXPECT_FALSE(keypoints[0].has_scale());
+  EXPECT_EQ(keypoints[1].x(), 41.5);
+  EXPECT_EQ(keypoints[1].y(), 81.5);
+  EXPECT_EQ(keypoints[1].scale(), 6.0);
+}
+
+}  // namespace theia
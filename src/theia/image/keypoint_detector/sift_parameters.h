@@ -70,6 +70,11 @@ struct SiftParameters {
   // location. This is useful for SfM for a number of reasons, especially during
   // geometric verification.
   bool upright_sift = true;
+
+  // Number of threads used to compute keypoint orientations and descriptors
+  // within a single image. This is useful for very large images when there are
+  // not enough images to saturate the machine with per-image parallelism.
+  int num_threads = 1;
 };
 
 }  // namespace theia
@@ -52,34 +52,59 @@
 #include "theia/sfm/view.h"
 #include "theia/util/filesystem.h"
 #include "theia/util/string.h"
+#include "theia/util/threadpool.h"
 
 namespace theia {
 
-// Loads all images from the defined directory, and sets each of the
-// recontruction's cameras to have an image size corresponding to the found
+// Reads the header of all images from the defined directory, and sets each of
+// the recontruction's cameras to have an image size corresponding to the found
 // image and a principal point at the center of that image.
 bool PopulateImageSizesAndPrincipalPoints(const std::string& image_directory,
                                           Reconstruction* reconstruction) {
+  return PopulateImageSizesAndPrincipalPoints(image_directory, 1,
+                                              reconstruction);
+}
+
+bool PopulateImageSizesAndPrincipalPoints(const std::string& image_directory,
+                                          const int num_threads,
+                                          Reconstruction* reconstruction) {
   CHECK_NOTNULL(reconstruction);
   std::string directory_with_slash = image_directory;
   AppendTrailingSlashIfNeeded(&directory_with_slash);
   const std::vector<ViewId> view_ids = reconstruction->ViewIds();
+  std::vector<std::string> files(view_ids.size());
+  for (int i = 0; i < view_ids.size(); i++) {
+    files[i] = directory_with_slash + reconstruction->View(view_ids[i])->Name();
+    if (!FileExists(files[i])) {
+      LOG(ERROR) << "Could not find " << files[i];
+      return false;
+    }
+  }
+
+  // Read the image dimensions in parallel. Opening each file dominates the
+  // cost, so images are read in small blocks to keep all threads busy.
+  static const int kMinImagesPerTask = 4;
+  std::vector<int> widths(view_ids.size(), 0);
+  std::vector<int> heights(view_ids.size(), 0);
+  ThreadPool pool(num_threads);
+  ParallelFor(&pool, 0, view_ids.size(), kMinImagesPerTask,
+              [&](const int start, const int end) {
+    for (int i = start; i < end; i++) {
+      ReadImageDimensions(files[i], &widths[i], &heights[i]);
+    }
+  });
+
+  // Only modify the reconstruction once all image sizes are known.
   for (int i = 0; i < view_ids.size(); i++) {
-    const std::string file =
-        directory_with_slash + reconstruction->View(view_ids[i])->Name();
-    if (!FileExists(file)) {
-      LOG(ERROR) << "Could not find " << file;
+    if (widths[i] <= 0 || heights[i] <= 0) {
+      LOG(ERROR) << "Could not read the image size of " << files[i];
       return false;
     }
   }
   for (int i = 0; i < view_ids.size(); i++) {
-    const std::string file =
-        directory_with_slash + reconstruction->View(view_ids[i])->Name();
-    const FloatImage image(file);
-    CHECK_GT(image.Cols(), 0);
     Camera* camera = reconstruction->MutableView(view_ids[i])->MutableCamera();
-    camera->SetImageSize(image.Cols(), image.Rows());
-    camera->SetPrincipalPoint(image.Cols() / 2.0, image.Rows() / 2.0);
+    camera->SetImageSize(widths[i], heights[i]);
+    camera->SetPrincipalPoint(widths[i] / 2.0, heights[i] / 2.0);
   }
 
   return true;
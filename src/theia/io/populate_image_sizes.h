@@ -59,6 +59,12 @@ class Reconstruction;
 bool PopulateImageSizesAndPrincipalPoints(const std::string& image_directory,
                                           Reconstruction* reconstruction);
 
+// Same as above, but the image headers are read in parallel with num_threads
+// threads. Only the image headers are read so no image is decoded.
+bool PopulateImageSizesAndPrincipalPoints(const std::string& image_directory,
+                                          const int num_threads,
+                                          Reconstruction* reconstruction);
+
 }  // namespace theia
 
 #endif  // THEIA_IO_IMPORT_IMAGE_SIZES_H_
@@ -56,8 +56,19 @@ namespace theia {
 bool ReadKeypointsAndDescriptors(const std::string& features_file,
                                  std::vector<Keypoint>* keypoints,
                                  std::vector<Eigen::VectorXf>* descriptors) {
+  std::vector<BinaryVectorX> binary_descriptors;
+  return ReadKeypointsAndDescriptors(
+      features_file, keypoints, descriptors, &binary_descriptors);
+}
+
+bool ReadKeypointsAndDescriptors(
+    const std::string& features_file,
+    std::vector<Keypoint>* keypoints,
+    std::vector<Eigen::VectorXf>* descriptors,
+    std::vector<BinaryVectorX>* binary_descriptors) {
   CHECK_NOTNULL(keypoints)->clear();
   CHECK_NOTNULL(descriptors)->clear();
+  CHECK_NOTNULL(binary_descriptors)->clear();
 
   // Return false if the file cannot be opened.
   std::ifstream features_reader(features_file, std::ios::in | std::ios::binary);
@@ -69,6 +80,10 @@ bool ReadKeypointsAndDescriptors(const std::string& features_file,
 
   cereal::PortableBinaryInputArchive input_archive(features_reader);
   input_archive(*keypoints, *descriptors);
+  // Older feature files do not contain binary descriptors.
+  if (features_reader.peek() != std::ifstream::traits_type::eof()) {
+    input_archive(*binary_descriptors);
+  }
 
   return true;
 }
@@ -39,6 +39,8 @@
 #include <string>
 #include <vector>
 
+#include "theia/image/descriptor/binary_descriptor.h"
+
 namespace theia {
 class Keypoint;
 
@@ -47,6 +49,15 @@ bool ReadKeypointsAndDescriptors(const std::string& features_file,
                                  std::vector<Keypoint>* keypoints,
                                  std::vector<Eigen::VectorXf>* descriptors);
 
+// Same as above, but also reads the binary descriptors. Files that were written
+// without binary descriptors may be read and will return no binary
+// descriptors.
+bool ReadKeypointsAndDescriptors(
+    const std::string& features_file,
+    std::vector<Keypoint>* keypoints,
+    std::vector<Eigen::VectorXf>* descriptors,
+    std::vector<BinaryVectorX>* binary_descriptors);
+
 }  // namespace theia
 
 #endif  // THEIA_IO_READ_KEYPOINTS_AND_DESCRIPTORS_H_
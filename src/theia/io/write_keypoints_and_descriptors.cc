@@ -57,6 +57,15 @@ bool WriteKeypointsAndDescriptors(
     const std::string& features_file,
     const std::vector<Keypoint>& keypoints,
     const std::vector<Eigen::VectorXf>& descriptors) {
+  return WriteKeypointsAndDescriptors(
+      features_file, keypoints, descriptors, std::vector<BinaryVectorX>());
+}
+
+bool WriteKeypointsAndDescriptors(
+    const std::string& features_file,
+    const std::vector<Keypoint>& keypoints,
+    const std::vector<Eigen::VectorXf>& descriptors,
+    const std::vector<BinaryVectorX>& binary_descriptors) {
   // Return false if the file cannot be opened.
   std::ofstream features_writer(features_file, std::ios::out | std::ios::binary);
   if (!features_writer.is_open()) {
@@ -66,7 +75,7 @@ bool WriteKeypointsAndDescriptors(
   }
 
   cereal::PortableBinaryOutputArchive output_archive(features_writer);
-  output_archive(keypoints, descriptors);
+  output_archive(keypoints, descriptors, binary_descriptors);
 
   return true;
 
@@ -39,6 +39,8 @@
 #include <string>
 #include <vector>
 
+#include "theia/image/descriptor/binary_descriptor.h"
+
 namespace theia {
 class Keypoint;
 
@@ -48,6 +50,13 @@ bool WriteKeypointsAndDescriptors(
     const std::vector<Keypoint>& keypoints,
     const std::vector<Eigen::VectorXf>& descriptors);
 
+// Same as above, but also writes the binary descriptors.
+bool WriteKeypointsAndDescriptors(
+    const std::string& features_file,
+    const std::vector<Keypoint>& keypoints,
+    const std::vector<Eigen::VectorXf>& descriptors,
+    const std::vector<BinaryVectorX>& binary_descriptors);
+
 }  // namespace theia
 
 #endif  // THEIA_IO_WRITE_KEYPOINTS_AND_DESCRIPTORS_H_
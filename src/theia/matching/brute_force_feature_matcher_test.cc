@@ -180,4 +180,82 @@ TEST(BruteForceFeatureMatcherTest, SymmetricMatches) {
   EXPECT_EQ(database.NumMatches(), 1);
 }
 
+TEST(BruteForceFeatureMatcherTest, IncrementalMatching) {
+  KeypointsAndDescriptors features;
+  features.descriptors.resize(kNumDescriptors);
+  for (int i = 0; i < kNumDescriptors; i++) {
+    features.descriptors[i] = VectorXf::Random(kNumDescriptorDimensions);
+    features.descriptors[i].normalize();
+  }
+  features.keypoints.resize(features.descriptors.size());
+
+  // Set options.
+  FeatureMatcherOptions options;
+  options.min_num_feature_matches = 0;
+  options.use_lowes_ratio = false;
+  options.perform_geometric_verification = false;
+  options.incremental_matching = true;
+
+  // Images 1 and 2 were matched in a previous run, and image 3 is new.
+  InMemoryFeaturesAndMatchesDatabase database;
+  database.PutFeatures("1", features);
+  database.PutFeatures("2", features);
+  database.PutFeatures("3", features);
+  database.PutImagePairMatch("1", "2", ImagePairMatch());
+
+  BruteForceFeatureMatcher matcher(options, &database);
+  matcher.AddImage("1");
+  matcher.AddImage("2");
+  matcher.AddImage("3");
+  matcher.SetNewImages({"3"});
+  matcher.MatchImages();
+
+  // Only the pairs containing the new image should have been matched, and the
+  // previously matched pair must be left untouched.
+  EXPECT_EQ(database.NumMatches(), 3);
+  EXPECT_EQ(database.GetImagePairMatch("1", "2").correspondences.size(), 0);
+  EXPECT_EQ(database.GetImagePairMatch("1", "3").correspondences.size(),
+            kNumDescriptors);
+  EXPECT_EQ(database.GetImagePairMatch("2", "3").correspondences.size(),
+            kNumDescriptors);
+  EXPECT_TRUE(database.ContainsMatchedImage("3"));
+}
+
+TEST(BruteForceFeatureMatcherTest, RecordsImagesWithoutVerifiedMatches) {
+  KeypointsAndDescriptors features;
+  features.descriptors.resize(kNumDescriptors);
+  for (int i = 0; i < kNumDescriptors; i++) {
+    features.descriptors[i] = VectorXf::Random(kNumDescriptorDimensions);
+    features.descriptors[i].normalize();
+  }
+  features.keypoints.resize(features.descriptors.size());
+
+  // Require more matches than there are features so that no pair is stored.
+  FeatureMatcherOptions options;
+  options.min_num_feature_matches = kNumDescriptors + 1;
+  options.use_lowes_ratio = false;
+  options.perform_geometric_verification = false;
+  options.incremental_matching = true;
+
+  InMemoryFeaturesAndMatchesDatabase database;
+  database.PutFeatures("1", features);
+  database.PutFeatures("2", features);
+  EXPECT_FALSE(database.ContainsMatchedImage("1"));
+  EXPECT_FALSE(database.ContainsMatchedImage("2"));
+
+  BruteForceFeatureMatcher matcher(options, &database);
+  matcher.AddImage("1");
+  matcher.AddImage("2");
+  matcher.SetNewImages({"1", "2"});
+  matcher.MatchImages();
+
+  // The images were matched even though none of their pairs were stored.
+  EXPECT_EQ(database.NumMatches(), 0);
+  EXPECT_TRUE(database.ContainsMatchedImage("1"));
+  EXPECT_TRUE(database.ContainsMatchedImage("2"));
+
+  database.RemoveAllMatches();
+  EXPECT_FALSE(database.ContainsMatchedImage("1"));
+}
+
 }  // namespace theia
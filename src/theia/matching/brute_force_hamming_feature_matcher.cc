@@ -0,0 +1,124 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/matching/brute_force_hamming_feature_matcher.h"
+
+#include <glog/logging.h>
+#include <limits>
+#include <vector>
+
+#include "theia/matching/feature_matcher_utils.h"
+#include "theia/matching/hamming_distance.h"
+#include "theia/matching/indexed_feature_match.h"
+
+namespace theia {
+
+namespace {
+
+// Finds the nearest neighbor of each query descriptor among the database
+// descriptors and keeps the match if it passes the Lowes ratio test.
+void MatchBinaryDescriptors(const PackedBinaryDescriptors& queries,
+                            const PackedBinaryDescriptors& database,
+                            const bool use_lowes_ratio,
+                            const double lowes_ratio,
+                            std::vector<IndexedFeatureMatch>* matches) {
+  std::vector<int> distances(database.NumDescriptors());
+  for (int i = 0; i < queries.NumDescriptors(); i++) {
+    ComputeHammingDistances(queries.Descriptor(i), database, distances.data());
+
+    // Get the two lowest distances.
+    int best_index = 0;
+    int best_distance = std::numeric_limits<int>::max();
+    int second_best_distance = std::numeric_limits<int>::max();
+    for (int j = 0; j < distances.size(); j++) {
+      if (distances[j] < best_distance) {
+        second_best_distance = best_distance;
+        best_distance = distances[j];
+        best_index = j;
+      } else if (distances[j] < second_best_distance) {
+        second_best_distance = distances[j];
+      }
+    }
+
+    // Add to the matches vector if lowes ratio test is turned off or it is
+    // turned on and passes the test.
+    if (!use_lowes_ratio ||
+        best_distance < lowes_ratio * second_best_distance) {
+      matches->emplace_back(i, best_index, best_distance);
+    }
+  }
+}
+
+}  // namespace
+
+bool BruteForceHammingFeatureMatcher::MatchImagePair(
+    const KeypointsAndDescriptors& features1,
+    const KeypointsAndDescriptors& features2,
+    std::vector<IndexedFeatureMatch>* matches) {
+  if (features1.binary_descriptors.empty() ||
+      features2.binary_descriptors.empty()) {
+    return false;
+  }
+
+  const PackedBinaryDescriptors descriptors1(features1.binary_descriptors);
+  const PackedBinaryDescriptors descriptors2(features2.binary_descriptors);
+  CHECK_EQ(descriptors1.NumBytes(), descriptors2.NumBytes())
+      << "Binary descriptors must have the same length to be matched.";
+  matches->reserve(descriptors1.NumDescriptors());
+
+  // Compute forward matches.
+  MatchBinaryDescriptors(descriptors1,
+                         descriptors2,
+                         this->options_.use_lowes_ratio,
+                         this->options_.lowes_ratio,
+                         matches);
+  if (matches->size() < this->options_.min_num_feature_matches) {
+    return false;
+  }
+
+  // Compute the symmetric matches, if applicable.
+  if (this->options_.keep_only_symmetric_matches) {
+    std::vector<IndexedFeatureMatch> reverse_matches;
+    MatchBinaryDescriptors(descriptors2,
+                           descriptors1,
+                           this->options_.use_lowes_ratio,
+                           this->options_.lowes_ratio,
+                           &reverse_matches);
+    IntersectMatches(reverse_matches, matches);
+  }
+
+  return matches->size() >= this->options_.min_num_feature_matches;
+}
+
+}  // namespace theia
@@ -0,0 +1,184 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <vector>
+
+#include "theia/image/descriptor/binary_descriptor.h"
+#include "theia/matching/brute_force_hamming_feature_matcher.h"
+#include "theia/matching/feature_matcher.h"
+#include "theia/matching/image_pair_match.h"
+#include "theia/matching/in_memory_features_and_matches_database.h"
+#include "theia/matching/keypoints_and_descriptors.h"
+
+#include "gtest/gtest.h"
+
+namespace theia {
+
+static const int kNumDescriptors = 10;
+static const int kNumDescriptorBytes = 61;
+
+TEST(BruteForceHammingFeatureMatcherTest, NoOptions) {
+  // Set up descriptors.
+  KeypointsAndDescriptors features1, features2;
+  features1.binary_descriptors.resize(kNumDescriptors);
+  features2.binary_descriptors.resize(kNumDescriptors);
+  for (int i = 0; i < kNumDescriptors; i++) {
+    features1.binary_descriptors[i] =
+        BinaryVectorX::Constant(kNumDescriptorBytes, 0x0f);
+    features2.binary_descriptors[i] =
+        BinaryVectorX::Constant(kNumDescriptorBytes, 0x0f);
+  }
+
+  // Set options.
+  FeatureMatcherOptions options;
+  options.min_num_feature_matches = 0;
+  options.keep_only_symmetric_matches = false;
+  options.use_lowes_ratio = false;
+  options.perform_geometric_verification = false;
+
+  // Add features.
+  features1.keypoints.resize(features1.binary_descriptors.size());
+  features2.keypoints.resize(features2.binary_descriptors.size());
+  InMemoryFeaturesAndMatchesDatabase database;
+  database.PutFeatures("1", features1);
+  database.PutFeatures("2", features2);
+
+  BruteForceHammingFeatureMatcher matcher(options, &database);
+  matcher.AddImage("1");
+  matcher.AddImage("2");
+
+  // Match features
+  matcher.MatchImages();
+
+  // Check that the results are valid.
+  EXPECT_EQ(database.NumMatches(), 1);
+  EXPECT_EQ(database.GetImagePairMatch("1", "2").correspondences.size(),
+            kNumDescriptors);
+}
+
+TEST(BruteForceHammingFeatureMatcherTest, RatioTest) {
+  // Set up descriptors.
+  KeypointsAndDescriptors features1, features2;
+  features1.binary_descriptors.resize(2);
+  features2.binary_descriptors.resize(2);
+
+  // The first descriptor differs by 5 and 6 bits from the two descriptors of
+  // the second image so it fails the ratio test. The second descriptor differs
+  // by 0 and 1 bits so it passes.
+  features1.binary_descriptors[0] = BinaryVectorX::Zero(kNumDescriptorBytes);
+  features1.binary_descriptors[1] = BinaryVectorX::Zero(kNumDescriptorBytes);
+  features1.binary_descriptors[1](0) = 0x1f;
+  features2.binary_descriptors[0] = BinaryVectorX::Zero(kNumDescriptorBytes);
+  features2.binary_descriptors[0](0) = 0x1f;
+  features2.binary_descriptors[1] = BinaryVectorX::Zero(kNumDescriptorBytes);
+  features2.binary_descriptors[1](0) = 0x3f;
+
+  // Set options.
+  FeatureMatcherOptions options;
+  options.min_num_feature_matches = 0;
+  options.keep_only_symmetric_matches = false;
+  options.use_lowes_ratio = true;
+  options.lowes_ratio = 0.8;
+  options.perform_geometric_verification = false;
+
+  // Add features.
+  features1.keypoints.resize(features1.binary_descriptors.size());
+  features2.keypoints.resize(features2.binary_descriptors.size());
+  features1.keypoints[1].set_x(1.0);
+  features2.keypoints[0].set_x(2.0);
+
+  InMemoryFeaturesAndMatchesDatabase database;
+  database.PutFeatures("1", features1);
+  database.PutFeatures("2", features2);
+
+  BruteForceHammingFeatureMatcher matcher(options, &database);
+  matcher.AddImage("1");
+  matcher.AddImage("2");
+
+  // Match features.
+  matcher.MatchImages();
+
+  // Check that only the second descriptor was matched.
+  ASSERT_EQ(database.NumMatches(), 1);
+  const ImagePairMatch match = database.GetImagePairMatch("1", "2");
+  ASSERT_EQ(match.correspondences.size(), 1);
+  EXPECT_EQ(match.correspondences[0].feature1.x(), 1.0);
+  EXPECT_EQ(match.correspondences[0].feature2.x(), 2.0);
+}
+
+TEST(BruteForceHammingFeatureMatcherTest, SymmetricMatches) {
+  // Set up descriptors.
+  KeypointsAndDescriptors features1, features2;
+  features1.binary_descriptors.resize(2);
+  features2.binary_descriptors.resize(2);
+
+  features1.binary_descriptors[0] = BinaryVectorX::Zero(kNumDescriptorBytes);
+  features1.binary_descriptors[1] =
+      BinaryVectorX::Constant(kNumDescriptorBytes, 0xff);
+
+  // Set the two descriptors to be closer to features1.binary_descriptors[0] so
+  // that the symmetric matching produces only 1 match.
+  features2.binary_descriptors[0] = BinaryVectorX::Zero(kNumDescriptorBytes);
+  features2.binary_descriptors[0](0) = 0x01;
+  features2.binary_descriptors[1] = BinaryVectorX::Zero(kNumDescriptorBytes);
+  features2.binary_descriptors[1](0) = 0x03;
+
+  // Set options.
+  FeatureMatcherOptions options;
+  options.min_num_feature_matches = 0;
+  options.keep_only_symmetric_matches = true;
+  options.use_lowes_ratio = false;
+  options.perform_geometric_verification = false;
+
+  // Add features.
+  features1.keypoints.resize(features1.binary_descriptors.size());
+  features2.keypoints.resize(features2.binary_descriptors.size());
+
+  InMemoryFeaturesAndMatchesDatabase database;
+  database.PutFeatures("1", features1);
+  database.PutFeatures("2", features2);
+
+  BruteForceHammingFeatureMatcher matcher(options, &database);
+  matcher.AddImage("1");
+  matcher.AddImage("2");
+
+  // Match features.
+  matcher.MatchImages();
+
+  // Check that the results are valid.
+  ASSERT_EQ(database.NumMatches(), 1);
+  EXPECT_EQ(database.GetImagePairMatch("1", "2").correspondences.size(), 1);
+}
+
+}  // namespace theia
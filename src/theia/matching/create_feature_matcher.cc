@@ -38,13 +38,20 @@
 #include <memory>
 
 #include "theia/matching/brute_force_feature_matcher.h"
+#include "theia/matching/brute_force_hamming_feature_matcher.h"
 #include "theia/matching/cascade_hashing_feature_matcher.h"
 #include "theia/matching/distance.h"
 #include "theia/matching/feature_matcher.h"
 #include "theia/matching/features_and_matches_database.h"
+#include "theia/matching/multi_index_hashing_feature_matcher.h"
 
 namespace theia {
 
+bool IsBinaryMatchingStrategy(const MatchingStrategy& matching_strategy) {
+  return matching_strategy == MatchingStrategy::BRUTE_FORCE_HAMMING ||
+         matching_strategy == MatchingStrategy::MULTI_INDEX_HASHING;
+}
+
 std::unique_ptr<FeatureMatcher> CreateFeatureMatcher(
     const MatchingStrategy& matching_strategy,
     const FeatureMatcherOptions& options,
@@ -56,6 +63,12 @@ std::unique_ptr<FeatureMatcher> CreateFeatureMatcher(
   } else if (matching_strategy == MatchingStrategy::BRUTE_FORCE) {
     matcher.reset(
         new BruteForceFeatureMatcher(options, features_and_matches_database));
+  } else if (matching_strategy == MatchingStrategy::BRUTE_FORCE_HAMMING) {
+    matcher.reset(new BruteForceHammingFeatureMatcher(
+        options, features_and_matches_database));
+  } else if (matching_strategy == MatchingStrategy::MULTI_INDEX_HASHING) {
+    matcher.reset(new MultiIndexHashingFeatureMatcher(
+        options, features_and_matches_database));
   } else {
     LOG(FATAL) << "Invalid matching strategy specified.";
   }
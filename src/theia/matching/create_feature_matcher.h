@@ -42,14 +42,23 @@ class FeatureMatcher;
 class FeaturesAndMatchesDatabase;
 struct FeatureMatcherOptions;
 
-// The type of matching to perform.
+// The type of matching to perform. BRUTE_FORCE and CASCADE_HASHING match float
+// descriptors with the L2 distance, while BRUTE_FORCE_HAMMING and
+// MULTI_INDEX_HASHING match binary descriptors (e.g. AKAZE_MLDB) with the
+// Hamming distance.
 enum class MatchingStrategy {
   BRUTE_FORCE = 0,
   CASCADE_HASHING = 1,
+  BRUTE_FORCE_HAMMING = 2,
+  MULTI_INDEX_HASHING = 3,
 };
 
-// A factory method for creating an L2-based feature matcher (i.e. for float
-// descriptors).
+// Returns true if the matching strategy matches binary descriptors.
+bool IsBinaryMatchingStrategy(const MatchingStrategy& matching_strategy);
+
+// A factory method for creating a feature matcher. The L2-based matchers use
+// the float descriptors of the features and the Hamming-based matchers use the
+// binary descriptors.
 std::unique_ptr<FeatureMatcher> CreateFeatureMatcher(
     const MatchingStrategy& matching_strategy,
     const FeatureMatcherOptions& options,
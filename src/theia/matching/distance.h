@@ -38,9 +38,12 @@
 #include <Eigen/Core>
 #include <glog/logging.h>
 
+#include "theia/image/descriptor/binary_descriptor.h"
+#include "theia/matching/hamming_distance.h"
+
 namespace theia {
 // This file includes all of the distance metrics that are used:
-// L2 distance for euclidean features.
+// L2 distance for euclidean features and Hamming distance for binary features.
 
 // Squared Euclidean distance functor. We let Eigen handle the SSE optimization.
 // NOTE: This assumes that each vector has a unit norm:
@@ -56,6 +59,19 @@ struct L2 {
   }
 };
 
+// Hamming distance functor for bit-packed binary descriptors. The popcount is
+// computed with the fastest kernel that the CPU supports (see
+// hamming_distance.h).
+struct Hamming {
+  typedef int DistanceType;
+  typedef BinaryVectorX DescriptorType;
+
+  DistanceType operator()(const BinaryVectorX& descriptor_a,
+                          const BinaryVectorX& descriptor_b) const {
+    return HammingDistance(descriptor_a, descriptor_b);
+  }
+};
+
 }  // namespace theia
 
 #endif  // THEIA_MATCHING_DISTANCE_H_
@@ -41,6 +41,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -49,11 +50,13 @@
 #include "theia/matching/feature_correspondence.h"
 #include "theia/matching/feature_matcher_options.h"
 #include "theia/matching/features_and_matches_database.h"
+#include "theia/matching/guided_epipolar_matcher.h"
 #include "theia/matching/image_pair_match.h"
 #include "theia/matching/keypoints_and_descriptors.h"
 #include "theia/sfm/camera_intrinsics_prior.h"
 #include "theia/sfm/two_view_match_geometric_verification.h"
 
+#include "theia/util/hash.h"
 #include "theia/util/map_util.h"
 #include "theia/util/threadpool.h"
 #include "theia/util/util.h"
@@ -75,6 +78,22 @@ void SelectAllPairs(
     }
   }
 }
+
+// Selects all image pairs that contain at least one new image.
+void SelectAllPairsWithNewImages(
+    const std::vector<std::string>& image_names,
+    const std::unordered_set<std::string>& new_image_names,
+    std::vector<std::pair<std::string, std::string>>* pairs_to_match) {
+  pairs_to_match->reserve(new_image_names.size() * image_names.size());
+  for (int i = 0; i < image_names.size(); i++) {
+    const bool image1_is_new = ContainsKey(new_image_names, image_names[i]);
+    for (int j = i + 1; j < image_names.size(); j++) {
+      if (image1_is_new || ContainsKey(new_image_names, image_names[j])) {
+        pairs_to_match->emplace_back(image_names[i], image_names[j]);
+      }
+    }
+  }
+}
 }  // namespace
 
 FeatureMatcher::~FeatureMatcher() {}
@@ -82,7 +101,34 @@ FeatureMatcher::~FeatureMatcher() {}
 FeatureMatcher::FeatureMatcher(
     const FeatureMatcherOptions& options,
     FeaturesAndMatchesDatabase* feature_and_matches_db)
-    : options_(options), feature_and_matches_db_(feature_and_matches_db) {}
+    : options_(options), feature_and_matches_db_(feature_and_matches_db) {
+  if (options_.perform_geometric_verification &&
+      options_.geometric_verification_options.guided_matching) {
+    static constexpr int kNumImagesInCache = 256;
+    guided_matching_indices_.reset(
+        new GuidedMatchingIndexCache(kNumImagesInCache));
+  }
+}
+
+std::shared_ptr<const GuidedMatchingIndex>
+FeatureMatcher::GetGuidedMatchingIndex(
+    const KeypointsAndDescriptors& features) {
+  std::shared_ptr<const GuidedMatchingIndex> guided_matching_index;
+  if (guided_matching_indices_->FetchIfCached(features.image_name,
+                                              &guided_matching_index)) {
+    return guided_matching_index;
+  }
+
+  // Build the index from the keypoints that are already loaded. This is done
+  // outside of the cache lock so that cache misses do not serialize the
+  // matching threads.
+  guided_matching_index = std::make_shared<const GuidedMatchingIndex>(
+      features.keypoints,
+      options_.geometric_verification_options
+          .guided_matching_max_distance_pixels);
+  return guided_matching_indices_->InsertIfMissing(features.image_name,
+                                                   guided_matching_index);
+}
 
 void FeatureMatcher::AddImage(const std::string& image_name) {
   image_names_.push_back(image_name);
@@ -101,11 +147,50 @@ void FeatureMatcher::SetImagePairsToMatch(
   pairs_to_match_ = pairs_to_match;
 }
 
+void FeatureMatcher::SetNewImages(
+    const std::vector<std::string>& new_image_names) {
+  new_image_names_.clear();
+  new_image_names_.insert(new_image_names.begin(), new_image_names.end());
+}
+
+void FeatureMatcher::RemovePreviouslyMatchedPairs() {
+  std::unordered_set<std::pair<std::string, std::string>> matched_pairs;
+  for (const auto& matched_pair :
+       feature_and_matches_db_->ImageNamesOfMatches()) {
+    matched_pairs.emplace(matched_pair);
+    matched_pairs.emplace(matched_pair.second, matched_pair.first);
+  }
+
+  const int num_pairs = pairs_to_match_.size();
+  pairs_to_match_.erase(
+      std::remove_if(pairs_to_match_.begin(),
+                     pairs_to_match_.end(),
+                     [&](const std::pair<std::string, std::string>& pair) {
+                       return (!ContainsKey(new_image_names_, pair.first) &&
+                               !ContainsKey(new_image_names_, pair.second)) ||
+                              ContainsKey(matched_pairs, pair);
+                     }),
+      pairs_to_match_.end());
+  VLOG(1) << "Incremental matching removed "
+          << num_pairs - pairs_to_match_.size()
+          << " image pairs that were previously matched.";
+}
+
 void FeatureMatcher::MatchImages() {
   // If SetImagePairsToMatch has not been called, match all image-to-image
-  // pairs.
+  // pairs. When matching incrementally, only pairs with a new image are
+  // considered.
   if (pairs_to_match_.empty()) {
-    SelectAllPairs(image_names_, &pairs_to_match_);
+    if (options_.incremental_matching) {
+      SelectAllPairsWithNewImages(
+          image_names_, new_image_names_, &pairs_to_match_);
+    } else {
+      SelectAllPairs(image_names_, &pairs_to_match_);
+    }
+  }
+
+  if (options_.incremental_matching) {
+    RemovePreviouslyMatchedPairs();
   }
 
   // Add workers for matching. It is more efficient to let each thread compute
@@ -113,21 +198,32 @@ void FeatureMatcher::MatchImages() {
   // sort of like OpenMP's dynamic schedule in that it is able to balance
   // threads fairly efficiently.
   const int num_matches = pairs_to_match_.size();
-  const int num_threads =
-      std::min(options_.num_threads, static_cast<int>(num_matches));
-  std::unique_ptr<ThreadPool> pool(new ThreadPool(num_threads));
-  const int interval_step =
-      std::min(this->kMaxThreadingStepSize_, num_matches / num_threads);
-  for (int i = 0; i < num_matches; i += interval_step) {
-    const int end_interval = std::min(num_matches, i + interval_step);
-    pool->Add(&FeatureMatcher::MatchAndVerifyImagePairs, this, i, end_interval);
+  if (num_matches > 0) {
+    const int num_threads =
+        std::min(options_.num_threads, static_cast<int>(num_matches));
+    std::unique_ptr<ThreadPool> pool(new ThreadPool(num_threads));
+    const int interval_step =
+        std::min(this->kMaxThreadingStepSize_, num_matches / num_threads);
+    for (int i = 0; i < num_matches; i += interval_step) {
+      const int end_interval = std::min(num_matches, i + interval_step);
+      pool->Add(
+          &FeatureMatcher::MatchAndVerifyImagePairs, this, i, end_interval);
+    }
+    // Wait for all threads to finish.
+    pool.reset(nullptr);
+
+    VLOG(1) << "Matched " << feature_and_matches_db_->NumMatches()
+            << " image pairs out of " << num_matches
+            << " pairs selected for matching.";
+  } else {
+    VLOG(1) << "No image pairs were selected for matching.";
   }
-  // Wait for all threads to finish.
-  pool.reset(nullptr);
 
-  VLOG(1) << "Matched " << feature_and_matches_db_->NumMatches()
-          << " image pairs out of " << num_matches
-          << " pairs selected for matching.";
+  // Record that the images have been matched so that incremental matching does
+  // not match them again, even if none of their pairs were verified.
+  for (const std::string& image_name : image_names_) {
+    feature_and_matches_db_->PutMatchedImage(image_name);
+  }
 }
 
 void FeatureMatcher::MatchAndVerifyImagePairs(const int start_index,
@@ -214,13 +310,20 @@ bool FeatureMatcher::GeometricVerification(
         features2.image_name);
   }
 
+  // Reuse the guided matching index of the second image if applicable.
+  std::shared_ptr<const GuidedMatchingIndex> guided_matching_index2;
+  if (guided_matching_indices_ && !features2.image_name.empty()) {
+    guided_matching_index2 = GetGuidedMatchingIndex(features2);
+  }
+
   TwoViewMatchGeometricVerification geometric_verification(
       options_.geometric_verification_options,
       intrinsics1,
       intrinsics2,
       features1,
       features2,
-      putative_matches);
+      putative_matches,
+      guided_matching_index2.get());
 
   // Return whether geometric verification succeeds.
   return geometric_verification.VerifyMatches(
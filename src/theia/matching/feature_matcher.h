@@ -40,14 +40,17 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "theia/matching/feature_matcher_options.h"
+#include "theia/util/lru_cache.h"
 #include "theia/util/util.h"
 
 namespace theia {
 class FeaturesAndMatchesDatabase;
+class GuidedMatchingIndex;
 class Keypoint;
 struct ImagePairMatch;
 struct IndexedFeatureMatche;
@@ -104,7 +107,18 @@ class FeatureMatcher {
   virtual void SetImagePairsToMatch(
       const std::vector<std::pair<std::string, std::string> >& pairs_to_match);
 
+  // Marks the images that were added to the collection since the last matching
+  // run. This is only used when options.incremental_matching is true, in which
+  // case only image pairs containing at least one new image are matched. The
+  // images must still be added with AddImage.
+  virtual void SetNewImages(const std::vector<std::string>& new_image_names);
+
  protected:
+  // Removes the image pairs that do not need to be matched in incremental mode,
+  // i.e. pairs that do not contain a new image and pairs that already have
+  // matches stored in the database.
+  void RemovePreviouslyMatchedPairs();
+
   // NOTE: This method should be overridden in the subclass implementations!
   // Returns true if the image pair is a valid match.
   virtual bool MatchImagePair(
@@ -145,7 +159,21 @@ class FeatureMatcher {
   // Pairs that we will perform matching on.
   std::vector<std::pair<std::string, std::string> > pairs_to_match_;
 
+  // Images added since the last matching run, used for incremental matching.
+  std::unordered_set<std::string> new_image_names_;
+
  private:
+  // Returns the cached guided matching index of the image, building it from
+  // the keypoints of the features if it is not in the cache.
+  std::shared_ptr<const GuidedMatchingIndex> GetGuidedMatchingIndex(
+      const KeypointsAndDescriptors& features);
+
+  // If guided matching is enabled, the guided matching index of each image is
+  // built once and shared by all image pairs containing the image.
+  using GuidedMatchingIndexCache =
+      LRUCache<std::string, std::shared_ptr<const GuidedMatchingIndex>>;
+  std::unique_ptr<GuidedMatchingIndexCache> guided_matching_indices_;
+
   DISALLOW_COPY_AND_ASSIGN(FeatureMatcher);
 };
 
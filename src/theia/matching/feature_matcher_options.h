@@ -68,6 +68,13 @@ struct FeatureMatcherOptions {
   // Only images that contain more feature matches than this number will be
   // returned.
   int min_num_feature_matches = 30;
+
+  // If true, matching is performed incrementally: only image pairs that contain
+  // at least one image marked as new with FeatureMatcher::SetNewImages are
+  // matched, and image pairs that already have matches stored in the features
+  // and matches database are skipped. This allows images to be appended to an
+  // existing collection without re-matching the entire collection.
+  bool incremental_matching = false;
 };
 
 }  // namespace theia
@@ -35,6 +35,7 @@
 #ifndef THEIA_MATCHING_FEATURES_AND_MATCHES_DATABASE_H_
 #define THEIA_MATCHING_FEATURES_AND_MATCHES_DATABASE_H_
 
+#include <Eigen/Core>
 #include <string>
 #include <utility>
 #include <vector>
@@ -81,6 +82,28 @@ class FeaturesAndMatchesDatabase {
   virtual std::vector<std::string> ImageNamesOfFeatures() = 0;
   virtual size_t NumImages() = 0;
 
+  virtual bool ContainsGlobalDescriptor(const std::string& image_name) = 0;
+
+  // Get/set the global image descriptor (e.g., a Fisher Vector) for the image.
+  // Global descriptors are only valid for the global descriptor extractor model
+  // stored in the database.
+  virtual Eigen::VectorXf GetGlobalDescriptor(
+      const std::string& image_name) = 0;
+  virtual void PutGlobalDescriptor(const std::string& image_name,
+                                   const Eigen::VectorXf& global_descriptor) = 0;
+
+  // Supply an iterator to iterate over the global descriptors.
+  virtual std::vector<std::string> ImageNamesOfGlobalDescriptors() = 0;
+
+  // Get/set the serialized model of the global descriptor extractor (see
+  // GlobalDescriptorExtractor::SerializeModel) so that it does not need to be
+  // retrained on subsequent runs. Returns false if no model is stored. Putting
+  // an empty model clears the stored model.
+  virtual bool GetGlobalDescriptorExtractorModel(
+      std::string* serialized_model) = 0;
+  virtual void PutGlobalDescriptorExtractorModel(
+      const std::string& serialized_model) = 0;
+
   // Get the image pair match for the images.
   virtual ImagePairMatch GetImagePairMatch(const std::string& image_name1,
                                            const std::string& image_name2) = 0;
@@ -95,7 +118,13 @@ class FeaturesAndMatchesDatabase {
   ImageNamesOfMatches() = 0;
   virtual size_t NumMatches() = 0;
 
-  // Clear all matches from the DB.
+  // Get/set whether the image has been matched to the other images. Pairs whose
+  // matches fail verification are not stored, so this records that an image
+  // was matched even if none of its pairs were stored.
+  virtual bool ContainsMatchedImage(const std::string& image_name) = 0;
+  virtual void PutMatchedImage(const std::string& image_name) = 0;
+
+  // Clear all matches and matched images from the DB.
   virtual void RemoveAllMatches() = 0;
 };
 }  // namespace theia
@@ -32,20 +32,40 @@
 // Please contact the author of this library if you have any questions.
 // Author: Chris Sweeney (sweeney.chris.m@gmail.com)
 
-extern "C" {
-#include <vl/fisher.h>
-#include <vl/gmm.h>
-}
+#include "theia/matching/fisher_vector_extractor.h"
 
 #include <Eigen/Core>
+#include <cereal/archives/portable_binary.hpp>
 #include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <future>  // NOLINT
+#include <limits>
 #include <memory>
+#include <sstream>
+#include <string>
 #include <vector>
 
-#include "theia/matching/fisher_vector_extractor.h"
+#include "theia/io/eigen_serializable.h"
+#include "theia/util/random.h"
+#include "theia/util/threadpool.h"
 
 namespace theia {
 namespace {
+
+// Descriptors are processed in column blocks of this size so that the
+// log-likelihood matrices for a block stay small enough to be cache friendly
+// while still allowing the GEMM kernels to run at full speed.
+static const int kDescriptorBlockSize = 4096;
+
+// Parameters matching the defaults of VLFeat's GMM and Fisher vector code.
+static const int kMaxNumEMIterations = 50;
+static const double kEMConvergenceThreshold = 1e-5;
+static const float kMinPosterior = 1e-6;
+static const double kMinPrior = 1e-6;
+static const double kCovarianceLowerBoundScale = 1e-4;
+static const double kMinCovariance = 1e-6;
+
 Eigen::MatrixXf ConvertVectorOfFeaturesToMatrix(
     const std::vector<Eigen::VectorXf>& features) {
   Eigen::MatrixXf feature_table(features[0].size(), features.size());
@@ -54,50 +74,287 @@ Eigen::MatrixXf ConvertVectorOfFeaturesToMatrix(
   }
   return feature_table;
 }
+
+// The sufficient statistics of a block of data points required for the
+// M-step of EM and for Fisher vector encoding.
+struct GMMSufficientStatistics {
+  GMMSufficientStatistics(const int dimension, const int num_clusters)
+      : log_likelihood(0),
+        posterior_sum(Eigen::VectorXd::Zero(num_clusters)),
+        weighted_sum(Eigen::MatrixXd::Zero(dimension, num_clusters)),
+        weighted_squared_sum(Eigen::MatrixXd::Zero(dimension, num_clusters)) {}
+
+  void Add(const GMMSufficientStatistics& other) {
+    log_likelihood += other.log_likelihood;
+    posterior_sum += other.posterior_sum;
+    weighted_sum += other.weighted_sum;
+    weighted_squared_sum += other.weighted_squared_sum;
+  }
+
+  double log_likelihood;
+  // Sum of the posteriors of each cluster, sum_i q_ik.
+  Eigen::VectorXd posterior_sum;
+  // D x K matrices of sum_i q_ik * x_i and sum_i q_ik * x_i^2.
+  Eigen::MatrixXd weighted_sum;
+  Eigen::MatrixXd weighted_squared_sum;
+};
+
 }  // namespace
 
-// Wrapper for the VlFeat gmm.
+// A Gaussian Mixture Model with diagonal covariances. The per-cluster
+// log-likelihoods of a block of points are computed with matrix products by
+// expanding the Mahalanobis distance:
+//
+//   (x - mu)^T S^-1 (x - mu) = (x^2)^T diag(S^-1) - 2 x^T S^-1 mu + mu^T S^-1 mu
+//
+// so that the E-step and the Fisher vector encoding are dominated by GEMM
+// operations instead of per-descriptor loops.
 class FisherVectorExtractor::GaussianMixtureModel {
  public:
-  // NOTE: We need the unique_ptr to use vlfeat's delete function for the GMM.
-  GaussianMixtureModel(const int num_clusters)
-      : num_clusters_(num_clusters), gmm_(nullptr, vl_gmm_delete) {}
+  GaussianMixtureModel(const int num_clusters,
+                       const int num_threads,
+                       const std::shared_ptr<RandomNumberGenerator>& rng)
+      : num_clusters_(num_clusters), num_threads_(num_threads) {
+    CHECK_GT(num_clusters_, 0);
+    CHECK_GT(num_threads_, 0);
+    if (rng.get() == nullptr) {
+      rng_ = std::make_shared<RandomNumberGenerator>();
+    } else {
+      rng_ = rng;
+    }
+  }
 
   int num_clusters() const { return num_clusters_; }
+  int dimension() const { return means_.rows(); }
 
-  // Computes the Gaussian mixture model based on the input training features.
+  // Computes the Gaussian mixture model based on the input training features
+  // using EM. The data points are the columns of the D x N input matrix.
   bool Compute(const Eigen::MatrixXf& data_points) {
     CHECK(!data_points.hasNaN());
-
-    // Create the GMM instance.
-    gmm_.reset(vl_gmm_new(VL_TYPE_FLOAT, data_points.rows(), num_clusters_));
-    if (!gmm_) {
+    if (data_points.cols() < num_clusters_) {
+      LOG(ERROR) << "Cannot train a GMM with " << num_clusters_
+                 << " clusters from only " << data_points.cols()
+                 << " data points.";
       return false;
     }
-    // Compute the model.
-    const double distortion =
-        vl_gmm_cluster(gmm_.get(), data_points.data(), data_points.cols());
-    CHECK(!std::isnan(distortion));
+
+    InitializeFromRandomDataPoints(data_points);
+
+    std::unique_ptr<ThreadPool> pool(new ThreadPool(num_threads_));
+    double prev_log_likelihood = -std::numeric_limits<double>::max();
+    for (int i = 0; i < kMaxNumEMIterations; i++) {
+      const GMMSufficientStatistics statistics =
+          ExpectationStep(data_points, pool.get());
+      CHECK(std::isfinite(statistics.log_likelihood));
+      VLOG(3) << "GMM EM iteration " << i
+              << ": log-likelihood = " << statistics.log_likelihood;
+      MaximizationStep(data_points, statistics);
+
+      // Stop once the improvement in log-likelihood is negligible.
+      if (statistics.log_likelihood - prev_log_likelihood <
+          kEMConvergenceThreshold * std::abs(statistics.log_likelihood)) {
+        break;
+      }
+      prev_log_likelihood = statistics.log_likelihood;
+    }
     return true;
   }
 
-  // Helper accessor methods for retreiving VLFeat types.
-  void const* GetMeans() const { return vl_gmm_get_means(gmm_.get()); }
-  void const* GetCovariances() const {
-    return vl_gmm_get_covariances(gmm_.get());
+  // Computes the K x N posterior probabilities p(k | x_i) of the data points
+  // and returns the total log-likelihood of the points.
+  double ComputePosteriors(const Eigen::MatrixXf& points,
+                           Eigen::MatrixXf* posteriors) const {
+    // Log-likelihood of each point for each cluster.
+    posteriors->noalias() = mean_over_covariance_ * points;
+    posteriors->noalias() -= 0.5f * inverse_covariances_ * points.cwiseAbs2();
+    posteriors->colwise() += log_normalization_;
+
+    // Normalize with the log-sum-exp trick for numerical stability.
+    double log_likelihood = 0;
+    for (int i = 0; i < posteriors->cols(); i++) {
+      auto column = posteriors->col(i);
+      const float max_log_likelihood = column.maxCoeff();
+      column = (column.array() - max_log_likelihood).exp();
+      const float sum = column.sum();
+      column /= sum;
+      log_likelihood += max_log_likelihood + std::log(sum);
+    }
+    return log_likelihood;
+  }
+
+  // Accumulates the sufficient statistics of the data points with the given
+  // posteriors.
+  void AccumulateStatistics(const Eigen::MatrixXf& points,
+                            const Eigen::MatrixXf& posteriors,
+                            GMMSufficientStatistics* statistics) const {
+    const Eigen::MatrixXf weighted_sum = points * posteriors.transpose();
+    const Eigen::MatrixXf weighted_squared_sum =
+        points.cwiseAbs2() * posteriors.transpose();
+    statistics->posterior_sum +=
+        posteriors.rowwise().sum().cast<double>();
+    statistics->weighted_sum += weighted_sum.cast<double>();
+    statistics->weighted_squared_sum += weighted_squared_sum.cast<double>();
+  }
+
+  const Eigen::MatrixXd& means() const { return means_; }
+  const Eigen::MatrixXd& covariances() const { return covariances_; }
+  const Eigen::VectorXd& priors() const { return priors_; }
+
+  // Sets the model parameters directly, e.g. from a previously trained model.
+  // Returns false if the parameters are not a valid model.
+  bool SetModel(const Eigen::MatrixXd& means,
+                const Eigen::MatrixXd& covariances,
+                const Eigen::VectorXd& priors) {
+    if (means.cols() != num_clusters_ || means.rows() == 0 ||
+        covariances.rows() != means.rows() ||
+        covariances.cols() != num_clusters_ || priors.size() != num_clusters_ ||
+        (covariances.array() <= 0).any() || (priors.array() <= 0).any()) {
+      return false;
+    }
+    means_ = means;
+    covariances_ = covariances;
+    priors_ = priors;
+    UpdateLikelihoodTerms();
+    return true;
   }
-  void const* GetPriors() const { return vl_gmm_get_priors(gmm_.get()); }
 
  private:
+  // Initializes the means to randomly chosen data points, the covariances to
+  // the variance of the data, and uses uniform priors.
+  void InitializeFromRandomDataPoints(const Eigen::MatrixXf& data_points) {
+    const Eigen::VectorXd data_mean =
+        data_points.rowwise().mean().cast<double>();
+    data_variance_ =
+        (data_points.cwiseAbs2().rowwise().mean().cast<double>() -
+         data_mean.cwiseAbs2())
+            .cwiseMax(kMinCovariance);
+    covariance_lower_bound_ = (kCovarianceLowerBoundScale * data_variance_)
+                                  .cwiseMax(kMinCovariance);
+
+    means_.resize(data_points.rows(), num_clusters_);
+    for (int k = 0; k < num_clusters_; k++) {
+      means_.col(k) = data_points.col(rng_->RandInt(0, data_points.cols() - 1))
+                          .cast<double>();
+    }
+    covariances_ = data_variance_.replicate(1, num_clusters_);
+    priors_.setConstant(num_clusters_, 1.0 / num_clusters_);
+    UpdateLikelihoodTerms();
+  }
+
+  // Computes the sufficient statistics for all data points. The data is split
+  // into blocks that are processed in parallel, and the per-block statistics
+  // are reduced once all blocks are complete.
+  GMMSufficientStatistics ExpectationStep(const Eigen::MatrixXf& data_points,
+                                          ThreadPool* pool) const {
+    const int num_points = data_points.cols();
+    const int num_blocks =
+        (num_points + kDescriptorBlockSize - 1) / kDescriptorBlockSize;
+    std::vector<GMMSufficientStatistics> block_statistics(
+        num_blocks, GMMSufficientStatistics(dimension(), num_clusters_));
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(num_blocks);
+    for (int i = 0; i < num_blocks; i++) {
+      tasks.emplace_back(pool->Add(
+          [&](const int block_index) {
+            const int start_col = block_index * kDescriptorBlockSize;
+            const int block_size =
+                std::min(kDescriptorBlockSize, num_points - start_col);
+            const Eigen::MatrixXf block =
+                data_points.middleCols(start_col, block_size);
+            Eigen::MatrixXf posteriors;
+            GMMSufficientStatistics* statistics =
+                &block_statistics[block_index];
+            statistics->log_likelihood = ComputePosteriors(block, &posteriors);
+            AccumulateStatistics(block, posteriors, statistics);
+          },
+          i));
+    }
+    for (std::future<void>& task : tasks) {
+      task.get();
+    }
+
+    GMMSufficientStatistics statistics(dimension(), num_clusters_);
+    for (const GMMSufficientStatistics& block : block_statistics) {
+      statistics.Add(block);
+    }
+    return statistics;
+  }
+
+  // Updates the model parameters from the sufficient statistics. Clusters that
+  // receive (almost) no support are re-seeded at a random data point.
+  void MaximizationStep(const Eigen::MatrixXf& data_points,
+                        const GMMSufficientStatistics& statistics) {
+    const double num_points = data_points.cols();
+    for (int k = 0; k < num_clusters_; k++) {
+      const double posterior_sum = statistics.posterior_sum(k);
+      if (posterior_sum / num_points < kMinPrior) {
+        VLOG(3) << "Restarting empty GMM cluster " << k;
+        means_.col(k) = data_points.col(rng_->RandInt(0, num_points - 1))
+                            .cast<double>();
+        covariances_.col(k) = data_variance_;
+        priors_(k) = kMinPrior;
+        continue;
+      }
+
+      priors_(k) = posterior_sum / num_points;
+      means_.col(k) = statistics.weighted_sum.col(k) / posterior_sum;
+      covariances_.col(k) =
+          (statistics.weighted_squared_sum.col(k) / posterior_sum -
+           means_.col(k).cwiseAbs2())
+              .cwiseMax(covariance_lower_bound_);
+    }
+    priors_ /= priors_.sum();
+    UpdateLikelihoodTerms();
+  }
+
+  // Precomputes the terms of the log-likelihood that only depend on the model
+  // parameters so that each block of points requires only two GEMMs.
+  void UpdateLikelihoodTerms() {
+    const Eigen::MatrixXd inverse_covariances =
+        covariances_.cwiseInverse().transpose();
+    inverse_covariances_ = inverse_covariances.cast<float>();
+    mean_over_covariance_ =
+        means_.cwiseQuotient(covariances_).transpose().cast<float>();
+
+    static const double kLog2Pi = std::log(2.0 * M_PI);
+    log_normalization_.resize(num_clusters_);
+    for (int k = 0; k < num_clusters_; k++) {
+      log_normalization_(k) =
+          std::log(priors_(k)) -
+          0.5 * (kLog2Pi * dimension() +
+                 covariances_.col(k).array().log().sum() +
+                 means_.col(k).cwiseAbs2().dot(inverse_covariances.row(k)));
+    }
+  }
+
   // Number of clusters.
   const int num_clusters_;
-  // The VlFeat GMM model.
-  std::unique_ptr<VlGMM, void (*)(VlGMM*)> gmm_;
+  // Number of threads used for the E-step of training.
+  const int num_threads_;
+  std::shared_ptr<RandomNumberGenerator> rng_;
+
+  // D x K means and diagonal covariances, and the K cluster priors.
+  Eigen::MatrixXd means_;
+  Eigen::MatrixXd covariances_;
+  Eigen::VectorXd priors_;
+
+  // The variance of the training data and the lower bound on covariances.
+  Eigen::VectorXd data_variance_;
+  Eigen::VectorXd covariance_lower_bound_;
+
+  // K x D matrices of S^-1 and (S^-1 mu) and the constant K-vector of
+  // log(prior) - 0.5 * (log|2 pi S| + mu^T S^-1 mu).
+  Eigen::MatrixXf inverse_covariances_;
+  Eigen::MatrixXf mean_over_covariance_;
+  Eigen::VectorXf log_normalization_;
 };
 
 FisherVectorExtractor::FisherVectorExtractor(const Options& options)
-    : gmm_(new GaussianMixtureModel(options.num_gmm_clusters)),
-      training_feature_sampler_(options.max_num_features_for_training) {}
+    : gmm_(new GaussianMixtureModel(options.num_gmm_clusters,
+                                    options.num_threads,
+                                    options.rng)),
+      training_feature_sampler_(options.max_num_features_for_training,
+                                options.rng){}
 
 FisherVectorExtractor::~FisherVectorExtractor() {}
 
@@ -124,31 +381,119 @@ bool FisherVectorExtractor::Train() {
   return gmm_->Compute(feature_table);
 }
 
+// Computes the improved Fisher vector of Perronnin et al. The encoding uses the
+// same layout and normalization as VLFeat's vl_fisher_encode with
+// VL_FISHER_FLAG_IMPROVED: the K mean deviation vectors are followed by the K
+// covariance deviation vectors, then the signed square root and L2
+// normalization are applied. All descriptors of the image are processed at once
+// so the encoding reduces to a few matrix products.
 Eigen::VectorXf FisherVectorExtractor::ExtractGlobalDescriptor(
     const std::vector<Eigen::VectorXf>& features) {
   // Ensure there are input features and they are not zero dimensions.
   CHECK_GT(features.size(), 0);
   CHECK_GT(features[0].size(), 0);
+  CHECK_EQ(features[0].size(), gmm_->dimension());
 
   // Convert the features into a continuous memory block. The matrix is of size
-  // D x N where D is the number of descrip
+  // D x N where D is the number of descriptor dimensions.
   const Eigen::MatrixXf feature_table =
       ConvertVectorOfFeaturesToMatrix(features);
-  // Compute the fisher vector encoding.
-  Eigen::VectorXf fisher_vector(2 * feature_table.rows() *
-                                gmm_->num_clusters());
-  vl_fisher_encode(fisher_vector.data(),
-                   VL_TYPE_FLOAT,
-                   gmm_->GetMeans(),
-                   feature_table.rows(),
-                   gmm_->num_clusters(),
-                   gmm_->GetCovariances(),
-                   gmm_->GetPriors(),
-                   feature_table.data(),
-                   feature_table.cols(),
-                   VL_FISHER_FLAG_IMPROVED);
+  const int dimension = feature_table.rows();
+  const int num_clusters = gmm_->num_clusters();
+
+  // Compute the posteriors for all features and discard negligible posteriors
+  // as VLFeat does.
+  Eigen::MatrixXf posteriors;
+  gmm_->ComputePosteriors(feature_table, &posteriors);
+  posteriors = (posteriors.array() < kMinPosterior).select(0, posteriors);
+
+  GMMSufficientStatistics statistics(dimension, num_clusters);
+  gmm_->AccumulateStatistics(feature_table, posteriors, &statistics);
+
+  const Eigen::MatrixXd& means = gmm_->means();
+  const Eigen::MatrixXd& covariances = gmm_->covariances();
+  const Eigen::VectorXd& priors = gmm_->priors();
+  const double num_features = features.size();
+
+  Eigen::VectorXd fisher_vector =
+      Eigen::VectorXd::Zero(2 * dimension * num_clusters);
+  for (int k = 0; k < num_clusters; k++) {
+    if (priors(k) < kMinPrior) {
+      continue;
+    }
+
+    // With sum_i q_ik (x_i - mu_k) = S1 - q * mu_k and
+    // sum_i q_ik (x_i - mu_k)^2 = S2 - 2 mu_k S1 + q * mu_k^2.
+    const double posterior_sum = statistics.posterior_sum(k);
+    const auto mean = means.col(k).array();
+    const auto sum = statistics.weighted_sum.col(k).array();
+    const auto squared_sum = statistics.weighted_squared_sum.col(k).array();
+    const Eigen::ArrayXd mean_deviation =
+        (sum - posterior_sum * mean) / covariances.col(k).array().sqrt();
+    const Eigen::ArrayXd covariance_deviation =
+        (squared_sum - 2.0 * mean * sum + posterior_sum * mean.square()) /
+            covariances.col(k).array() -
+        posterior_sum;
+
+    fisher_vector.segment(k * dimension, dimension) =
+        mean_deviation / (num_features * std::sqrt(priors(k)));
+    fisher_vector.segment((num_clusters + k) * dimension, dimension) =
+        covariance_deviation / (num_features * std::sqrt(2.0 * priors(k)));
+  }
+
+  // Apply the signed square root and L2 normalization.
+  fisher_vector = fisher_vector.array().sign() *
+                  fisher_vector.array().abs().sqrt();
+  const double norm = fisher_vector.norm();
+  if (norm > 0) {
+    fisher_vector /= norm;
+  }
+
   DCHECK(std::isfinite(fisher_vector.sum()));
-  return fisher_vector;
+  return fisher_vector.cast<float>();
+}
+
+bool FisherVectorExtractor::SerializeModel(std::string* serialized_model) const {
+  if (gmm_->means().size() == 0) {
+    LOG(ERROR) << "Cannot serialize the Fisher Vector model before training.";
+    return false;
+  }
+
+  std::stringstream ss;
+  {
+    cereal::PortableBinaryOutputArchive output_archive(ss);
+    const int num_clusters = gmm_->num_clusters();
+    output_archive(
+        num_clusters, gmm_->means(), gmm_->covariances(), gmm_->priors());
+  }
+  *CHECK_NOTNULL(serialized_model) = ss.str();
+  return true;
+}
+
+bool FisherVectorExtractor::DeserializeModel(
+    const std::string& serialized_model) {
+  int num_clusters;
+  Eigen::MatrixXd means, covariances;
+  Eigen::VectorXd priors;
+  // Cereal throws an exception if the model is truncated or corrupt. A model
+  // that cannot be read is rejected so that it is retrained.
+  try {
+    std::stringstream ss(serialized_model);
+    cereal::PortableBinaryInputArchive input_archive(ss);
+    input_archive(num_clusters, means, covariances, priors);
+  } catch (const cereal::Exception& exception) {
+    LOG(WARNING) << "Could not read the stored Fisher Vector model: "
+                 << exception.what();
+    return false;
+  }
+
+  if (num_clusters != gmm_->num_clusters()) {
+    LOG(WARNING) << "The stored Fisher Vector model has " << num_clusters
+                 << " GMM clusters but " << gmm_->num_clusters()
+                 << " clusters were requested. The model must be retrained.";
+    return false;
+  }
+  return gmm_->SetModel(means, covariances, priors);
 }
 
 }  // namespace theia
@@ -37,10 +37,12 @@
 
 #include <Eigen/Core>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "theia/matching/global_descriptor_extractor.h"
 #include "theia/math/reservoir_sampler.h"
+#include "theia/util/random.h"
 
 namespace theia {
 
@@ -61,6 +63,16 @@ class FisherVectorExtractor : public GlobalDescriptorExtractor {
     // max_num_features_for_training using a memory efficient Reservoir sampler
     // to avoid holding all features in memory.
     int max_num_features_for_training = 100000;
+
+    // The E-step of GMM training is computed over blocks of descriptors in
+    // parallel with this many threads.
+    int num_threads = 1;
+
+    // The random number generator used to sample the training features and to
+    // initialize the GMM. This may be controlled by the caller so that training
+    // is deterministic. If rng is not supplied, the seed is initialized based
+    // on the time.
+    std::shared_ptr<RandomNumberGenerator> rng;
   };
 
   // The number of clusters to use for the GMM.
@@ -83,6 +95,11 @@ class FisherVectorExtractor : public GlobalDescriptorExtractor {
   Eigen::VectorXf ExtractGlobalDescriptor(
       const std::vector<Eigen::VectorXf>& features) override;
 
+  // Serialize or restore the trained GMM. A model can only be restored if it
+  // has the same number of clusters as specified in the options.
+  bool SerializeModel(std::string* serialized_model) const override;
+  bool DeserializeModel(const std::string& serialized_model) override;
+
  private:
   // A Gaussian Mixture Model is used to compute the Fisher Kernel.
   class GaussianMixtureModel;
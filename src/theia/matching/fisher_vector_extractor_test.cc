@@ -0,0 +1,177 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (sweeney.chris.m@gmail.com)
+
+#include <Eigen/Core>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/matching/fisher_vector_extractor.h"
+#include "theia/util/random.h"
+
+namespace theia {
+
+namespace {
+
+static const int kDescriptorDimension = 32;
+
+RandomNumberGenerator rng(52);
+
+// Returns features drawn from a Gaussian centered at the given mean.
+std::vector<Eigen::VectorXf> DrawFeatures(const Eigen::VectorXf& mean,
+                                          const int num_features) {
+  std::vector<Eigen::VectorXf> features(num_features);
+  for (int i = 0; i < num_features; i++) {
+    features[i] = mean;
+    for (int j = 0; j < kDescriptorDimension; j++) {
+      features[i][j] += rng.RandGaussian(0.0, 0.1);
+    }
+  }
+  return features;
+}
+
+void TestFisherVectorsSeparateClusters(const int num_threads) {
+  static const int kNumTrainingFeaturesPerCluster = 5000;
+  static const int kNumImageFeatures = 500;
+  static const int kNumGMMClusters = 2;
+
+  const Eigen::VectorXf mean1 = Eigen::VectorXf::Zero(kDescriptorDimension);
+  const Eigen::VectorXf mean2 = Eigen::VectorXf::Ones(kDescriptorDimension);
+
+  FisherVectorExtractor::Options options;
+  options.num_gmm_clusters = kNumGMMClusters;
+  options.num_threads = num_threads;
+  FisherVectorExtractor fisher_vector_extractor(options);
+  fisher_vector_extractor.AddFeaturesForTraining(
+      DrawFeatures(mean1, kNumTrainingFeaturesPerCluster));
+  fisher_vector_extractor.AddFeaturesForTraining(
+      DrawFeatures(mean2, kNumTrainingFeaturesPerCluster));
+  EXPECT_TRUE(fisher_vector_extractor.Train());
+
+  // Images whose features come from the same distribution should have more
+  // similar global descriptors than images with features from a different
+  // distribution.
+  const Eigen::VectorXf offset =
+      0.05 * Eigen::VectorXf::Ones(kDescriptorDimension);
+  const Eigen::VectorXf descriptor1a =
+      fisher_vector_extractor.ExtractGlobalDescriptor(
+          DrawFeatures(mean1 + offset, kNumImageFeatures));
+  const Eigen::VectorXf descriptor1b =
+      fisher_vector_extractor.ExtractGlobalDescriptor(
+          DrawFeatures(mean1 + offset, kNumImageFeatures));
+  const Eigen::VectorXf descriptor2 =
+      fisher_vector_extractor.ExtractGlobalDescriptor(
+          DrawFeatures(mean2 - offset, kNumImageFeatures));
+
+  // The improved Fisher vector is L2 normalized.
+  EXPECT_EQ(descriptor1a.size(),
+            2 * kDescriptorDimension * kNumGMMClusters);
+  EXPECT_NEAR(descriptor1a.norm(), 1.0, 1e-4);
+  EXPECT_NEAR(descriptor2.norm(), 1.0, 1e-4);
+  EXPECT_LT((descriptor1a - descriptor1b).squaredNorm(),
+            (descriptor1a - descriptor2).squaredNorm());
+}
+
+}  // namespace
+
+TEST(FisherVectorExtractor, SeparatesClustersSingleThreaded) {
+  TestFisherVectorsSeparateClusters(1);
+}
+
+TEST(FisherVectorExtractor, SeparatesClustersMultiThreaded) {
+  TestFisherVectorsSeparateClusters(4);
+}
+
+TEST(FisherVectorExtractor, SerializeModel) {
+  static const int kNumTrainingFeatures = 5000;
+  static const int kNumImageFeatures = 500;
+
+  FisherVectorExtractor::Options options;
+  options.num_gmm_clusters = 4;
+  FisherVectorExtractor fisher_vector_extractor(options);
+  std::string serialized_model;
+  // The model cannot be serialized before training.
+  EXPECT_FALSE(fisher_vector_extractor.SerializeModel(&serialized_model));
+
+  const Eigen::VectorXf mean = Eigen::VectorXf::Zero(kDescriptorDimension);
+  fisher_vector_extractor.AddFeaturesForTraining(
+      DrawFeatures(mean, kNumTrainingFeatures));
+  EXPECT_TRUE(fisher_vector_extractor.Train());
+  EXPECT_TRUE(fisher_vector_extractor.SerializeModel(&serialized_model));
+
+  // A restored model must produce identical global descriptors.
+  FisherVectorExtractor restored_extractor(options);
+  EXPECT_TRUE(restored_extractor.DeserializeModel(serialized_model));
+  const std::vector<Eigen::VectorXf> features =
+      DrawFeatures(mean, kNumImageFeatures);
+  EXPECT_EQ(fisher_vector_extractor.ExtractGlobalDescriptor(features),
+            restored_extractor.ExtractGlobalDescriptor(features));
+
+  // Models with a different number of clusters are rejected.
+  options.num_gmm_clusters = 8;
+  FisherVectorExtractor incompatible_extractor(options);
+  EXPECT_FALSE(incompatible_extractor.DeserializeModel(serialized_model));
+
+  // Truncated or corrupt models are rejected.
+  EXPECT_FALSE(restored_extractor.DeserializeModel(
+      serialized_model.substr(0, serialized_model.size() / 2)));
+  EXPECT_FALSE(restored_extractor.DeserializeModel(""));
+}
+
+// Training with random number generators that have the same seed must produce
+// the same model, including the reservoir sampling of the training features.
+TEST(FisherVectorExtractor, SeededTrainingIsDeterministic) {
+  static const int kNumTrainingFeatures = 5000;
+  static const unsigned kSeed = 63;
+
+  const Eigen::VectorXf mean = Eigen::VectorXf::Zero(kDescriptorDimension);
+  const std::vector<Eigen::VectorXf> features =
+      DrawFeatures(mean, kNumTrainingFeatures);
+
+  FisherVectorExtractor::Options options;
+  options.num_gmm_clusters = 4;
+  options.max_num_features_for_training = kNumTrainingFeatures / 5;
+  std::string serialized_models[2];
+  for (int i = 0; i < 2; i++) {
+    options.rng = std::make_shared<RandomNumberGenerator>(kSeed);
+    FisherVectorExtractor fisher_vector_extractor(options);
+    fisher_vector_extractor.AddFeaturesForTraining(features);
+    EXPECT_TRUE(fisher_vector_extractor.Train());
+    EXPECT_TRUE(fisher_vector_extractor.SerializeModel(&serialized_models[i]));
+  }
+  EXPECT_EQ(serialized_models[0], serialized_models[1]);
+}
+
+}  // namespace theia
@@ -36,6 +36,7 @@
 #define THEIA_MATCHING_GLOBAL_DESCRIPTOR_EXTRACTOR_H_
 
 #include <Eigen/Core>
+#include <string>
 #include <vector>
 
 namespace theia {
@@ -63,6 +64,16 @@ class GlobalDescriptorExtractor {
   // Compute a global image descriptor for the set of input features.
   virtual Eigen::VectorXf ExtractGlobalDescriptor(
       const std::vector<Eigen::VectorXf>& features) = 0;
+
+  // Serializes the trained model so that it may be stored (e.g., in the
+  // features and matches database) and reused without retraining. Returns
+  // false if the model cannot be serialized.
+  virtual bool SerializeModel(std::string* serialized_model) const = 0;
+
+  // Restores a model previously written with SerializeModel. Returns false if
+  // the model is invalid or incompatible with the options of the extractor, in
+  // which case the extractor must be trained.
+  virtual bool DeserializeModel(const std::string& serialized_model) = 0;
 };
 
 }  // namespace theia
@@ -37,15 +37,15 @@
 #include <Eigen/Core>
 #include <stdint.h>
 #include <algorithm>
+#include <cmath>
 #include <limits>
+#include <utility>
 #include <vector>
-#include <unordered_map>
 #include <unordered_set>
 
-#include "flann/flann.hpp"
-
+#include "theia/image/keypoint_detector/keypoint.h"
 #include "theia/matching/keypoints_and_descriptors.h"
-#include "theia/matching/distance.h"
+#include "theia/matching/hamming_distance.h"
 #include "theia/matching/indexed_feature_match.h"
 #include "theia/sfm/camera/camera.h"
 #include "theia/sfm/pose/fundamental_matrix_util.h"
@@ -86,9 +86,15 @@ void DecodeLineEndpoints(const uint64_t encoded_endpoint,
   endpoints->emplace_back(static_cast<double>(x2), static_cast<double>(y2));
 }
 
+// Encodes the center of a grid cell into an uint64_t key for sorting.
+uint64_t EncodeGridCenter(const Eigen::Vector2i& grid_center) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(grid_center.x())) << 32) |
+         static_cast<uint64_t>(static_cast<uint32_t>(grid_center.y()));
+}
+
 }  // namespace
 
-// Creates the grid structure for the fast epipolar lookup. This method must
+// Sets up the grid structure for the fast epipolar lookup. This method must
 // be called before calling GetMatches();
 bool GuidedEpipolarMatcher::Initialize(
     const std::vector<IndexedFeatureMatch>& matches) {
@@ -105,49 +111,25 @@ bool GuidedEpipolarMatcher::Initialize(
     matched_features2_.insert(match.feature2_ind);
   }
 
-  const double half_cell_width = options_.guided_matching_max_distance_pixels;
-  const double offset = half_cell_width;
-  image_grids_.emplace_back(ImageGrid(half_cell_width, 0, 0));
-  image_grids_.emplace_back(ImageGrid(half_cell_width, offset, 0));
-  image_grids_.emplace_back(ImageGrid(half_cell_width, 0, offset));
-  image_grids_.emplace_back(ImageGrid(half_cell_width, offset, offset));
-
-  // These helper vectors will be used to find the bounding box of the
-  // features. This will help constrain the search along epipolar lines later.
-  std::vector<double> x, y;
-  x.reserve(features2_.keypoints.size());
-  y.reserve(features2_.keypoints.size());
-  // For each grid, add all features from features2.
-  for (int i = 0; i < features2_.keypoints.size(); i++) {
-    // TODO(csweeney): Test if the epipolar line of feature2 features is within
-    // the image bounds of image 1. If not, we can skip the feature entirely.
-    if (ContainsKey(matched_features2_, i)) {
-      continue;
-    }
-    for (int j = 0; j < image_grids_.size(); j++) {
-      image_grids_[j].AddFeature(i,
-                                 features2_.keypoints[i].x(),
-                                 features2_.keypoints[i].y());
-    }
-    x.emplace_back(features2_.keypoints[i].x());
-    y.emplace_back(features2_.keypoints[i].y());
+  // Build the index of features2 if it was not supplied.
+  if (features2_index_ == nullptr ||
+      features2_index_->MaxDistancePixels() !=
+          options_.guided_matching_max_distance_pixels) {
+    owned_features2_index_.reset(new GuidedMatchingIndex(
+        features2_.keypoints, options_.guided_matching_max_distance_pixels));
+    features2_index_ = owned_features2_index_.get();
   }
 
-  // Set the bounding box of the features.
-  const auto& minmax_x = std::minmax_element(x.begin(), x.end());
-  const auto& minmax_y = std::minmax_element(y.begin(), y.end());
-  top_left_.x() = *minmax_x.first;
-  top_left_.y() = *minmax_y.first;
-  bottom_right_.x() = *minmax_x.second;
-  bottom_right_.y() = *minmax_y.second;
-
   return true;
 }
 
 bool GuidedEpipolarMatcher::GetMatches(
     std::vector<IndexedFeatureMatch>* matches) {
   const int num_input_matches = matches->size();
-  const double lowes_ratio_sq = options_.lowes_ratio * options_.lowes_ratio;
+  // The L2 distances are squared but the Hamming distances are not.
+  const double lowes_ratio = features1_.binary_descriptors.empty()
+                                 ? options_.lowes_ratio * options_.lowes_ratio
+                                 : options_.lowes_ratio;
 
   Initialize(*matches);
 
@@ -162,8 +144,8 @@ bool GuidedEpipolarMatcher::GetMatches(
     std::vector<int> candidate_keypoint_indices;
     FindFeaturesNearEpipolarLines(epiline_group, &candidate_keypoint_indices);
 
-    // Build a KD-tree for those features and query the tree to get the nearest
-    // neighbor matches for each feature in this epiline group.
+    // Get the nearest neighbor matches among those features for each feature
+    // in this epiline group.
     std::vector<std::vector<float> > nn_distances;
     std::vector<std::vector<int> > nn_indices;
     FindKNearestNeighbors(epiline_group.features, candidate_keypoint_indices,
@@ -174,7 +156,7 @@ bool GuidedEpipolarMatcher::GetMatches(
     for (int i = 0; i < nn_distances.size(); i++) {
       // If the top 2 distance pass lowes ratio test then add the match to the
       // output.
-      if (nn_distances[i][0] < nn_distances[i][1] * lowes_ratio_sq) {
+      if (nn_distances[i][0] < nn_distances[i][1] * lowes_ratio) {
         IndexedFeatureMatch match;
         match.feature1_ind = epiline_group.features[i];
         match.feature2_ind = nn_indices[i][0];
@@ -292,14 +274,20 @@ void GuidedEpipolarMatcher::FindFeaturesNearEpipolarLines(
       (line_endpoints[0] - line_endpoints[1]) / static_cast<double>(num_steps);
   Eigen::Vector2d sample_point = line_endpoints[1];
 
+  std::vector<int> new_keypoints;
   for (int i = 0; i < num_steps; i++) {
     sample_point += line_delta;
 
     // Find the cell center among all grids that is closest and add the
-    // keypoints belonging to that cell.
-    std::vector<int> new_keypoints;
-    FindClosestCellAndKeypoints(sample_point, &new_keypoints);
-    candidate_keypoints.insert(new_keypoints.begin(), new_keypoints.end());
+    // keypoints belonging to that cell that have not been matched yet.
+    new_keypoints.clear();
+    features2_index_->FindClosestCellAndKeypoints(sample_point,
+                                                  &new_keypoints);
+    for (const int keypoint_index : new_keypoints) {
+      if (!ContainsKey(matched_features2_, keypoint_index)) {
+        candidate_keypoints.insert(keypoint_index);
+      }
+    }
   }
 
   // If we do not have enough features then the lowes ratio test is not
@@ -320,38 +308,40 @@ void GuidedEpipolarMatcher::FindFeaturesNearEpipolarLines(
 void GuidedEpipolarMatcher::FindEpipolarLineIntersection(
     const Eigen::Vector3d& epipolar_line,
     std::vector<Eigen::Vector2d>* lines) {
+  const Eigen::Vector2d& top_left = features2_index_->TopLeft();
+  const Eigen::Vector2d& bottom_right = features2_index_->BottomRight();
   const double y_of_left_intersection =
-      -(epipolar_line.z() + epipolar_line.x() * top_left_.x()) /
+      -(epipolar_line.z() + epipolar_line.x() * top_left.x()) /
       epipolar_line.y();
-  if (y_of_left_intersection >= top_left_.y() &&
-      y_of_left_intersection <= bottom_right_.y()) {
-    lines->emplace_back(Eigen::Vector2d(top_left_.x(), y_of_left_intersection));
+  if (y_of_left_intersection >= top_left.y() &&
+      y_of_left_intersection <= bottom_right.y()) {
+    lines->emplace_back(Eigen::Vector2d(top_left.x(), y_of_left_intersection));
   }
 
   const double x_of_top_intersection =
-      -(epipolar_line.z() + epipolar_line.y() * top_left_.y()) /
+      -(epipolar_line.z() + epipolar_line.y() * top_left.y()) /
       epipolar_line.x();
-  if (x_of_top_intersection >= top_left_.x() &&
-      x_of_top_intersection <= bottom_right_.x()) {
-    lines->emplace_back(Eigen::Vector2d(x_of_top_intersection, top_left_.y()));
+  if (x_of_top_intersection >= top_left.x() &&
+      x_of_top_intersection <= bottom_right.x()) {
+    lines->emplace_back(Eigen::Vector2d(x_of_top_intersection, top_left.y()));
   }
 
   const double y_of_right_intersection =
-      -(epipolar_line.z() + epipolar_line.x() * bottom_right_.x()) /
+      -(epipolar_line.z() + epipolar_line.x() * bottom_right.x()) /
       epipolar_line.y();
-  if (y_of_right_intersection >= top_left_.y() &&
-      y_of_right_intersection <= bottom_right_.y()) {
+  if (y_of_right_intersection >= top_left.y() &&
+      y_of_right_intersection <= bottom_right.y()) {
     lines->emplace_back(
-        Eigen::Vector2d(bottom_right_.x(), y_of_right_intersection));
+        Eigen::Vector2d(bottom_right.x(), y_of_right_intersection));
   }
 
   const double x_of_bottom_intersection =
-      -(epipolar_line.z() + epipolar_line.y() * bottom_right_.y()) /
+      -(epipolar_line.z() + epipolar_line.y() * bottom_right.y()) /
       epipolar_line.x();
-  if (x_of_bottom_intersection >= top_left_.x() &&
-      x_of_bottom_intersection <= bottom_right_.x()) {
+  if (x_of_bottom_intersection >= top_left.x() &&
+      x_of_bottom_intersection <= bottom_right.x()) {
     lines->emplace_back(
-        Eigen::Vector2d(x_of_bottom_intersection, bottom_right_.y()));
+        Eigen::Vector2d(x_of_bottom_intersection, bottom_right.y()));
   }
 }
 
@@ -361,110 +351,136 @@ void GuidedEpipolarMatcher::FindKNearestNeighbors(
     std::vector<std::vector<float> >* nn_distances,
     std::vector<std::vector<int> >* nn_indices) {
   static const int kNumNearestNeighbors = 2;
-  static const int kMinNumLeafsVisited = 50;
-  const int num_descriptor_dimensions = features1_.descriptors[0].size();
+  const bool use_binary_descriptors = !features1_.binary_descriptors.empty();
 
-  // Gather the query descriptors.
-  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      query_descriptors(query_feature_indices.size(),
-                        num_descriptor_dimensions);
+  nn_distances->resize(query_feature_indices.size());
+  nn_indices->resize(query_feature_indices.size());
+  std::vector<float> candidate_distances(candidate_feature_indices.size());
   for (int i = 0; i < query_feature_indices.size(); i++) {
-    const int match_index = query_feature_indices[i];
-    query_descriptors.row(i) = features1_.descriptors[match_index];
-  }
-  flann::Matrix<float> flann_query_descriptors(query_descriptors.data(),
-                                               query_descriptors.rows(),
-                                               query_descriptors.cols());
-
-  // Gather the candidate matching descriptors.
-  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      candidate_descriptors(candidate_feature_indices.size(),
-                            num_descriptor_dimensions);
-  for (int i = 0; i < candidate_feature_indices.size(); i++) {
-    const int match_index = candidate_feature_indices[i];
-    candidate_descriptors.row(i) = features2_.descriptors[match_index];
-  }
-
-  // Create the searchable KD-tree with FLANN.
-  flann::Matrix<float> flann_candidate_descriptors(
-      candidate_descriptors.data(), candidate_descriptors.rows(),
-      candidate_descriptors.cols());
-
-  flann::Index<flann::L2<float> > flann_kd_tree(
-      flann_candidate_descriptors, flann::KDTreeSingleIndexParams());
-  flann_kd_tree.buildIndex();
+    const int query_index = query_feature_indices[i];
+    if (use_binary_descriptors) {
+      const BinaryVectorX& query =
+          features1_.binary_descriptors[query_index];
+      for (int j = 0; j < candidate_feature_indices.size(); j++) {
+        candidate_distances[j] = HammingDistance(
+            query, features2_.binary_descriptors[candidate_feature_indices[j]]);
+      }
+    } else {
+      const Eigen::VectorXf& query = features1_.descriptors[query_index];
+      for (int j = 0; j < candidate_feature_indices.size(); j++) {
+        candidate_distances[j] =
+            (query - features2_.descriptors[candidate_feature_indices[j]])
+                .squaredNorm();
+      }
+    }
 
-  // Query the KD-tree to get the top 2 nearest neighbors.
-  const int max_leafs_to_check =
-      std::max(static_cast<int>(candidate_descriptors.rows() * 0.2),
-               kMinNumLeafsVisited);
-  flann_kd_tree.knnSearch(flann_query_descriptors, *nn_indices, *nn_distances,
-                          kNumNearestNeighbors,
-                          flann::SearchParams(max_leafs_to_check));
+    // Output the top 2 matches. If there is only one candidate then the second
+    // distance is infinite so that the ratio test passes.
+    std::vector<float>& distances = (*nn_distances)[i];
+    std::vector<int>& indices = (*nn_indices)[i];
+    distances.assign(kNumNearestNeighbors,
+                     std::numeric_limits<float>::infinity());
+    indices.assign(kNumNearestNeighbors, -1);
+    for (int j = 0; j < candidate_feature_indices.size(); j++) {
+      if (candidate_distances[j] < distances[0]) {
+        distances[1] = distances[0];
+        indices[1] = indices[0];
+        distances[0] = candidate_distances[j];
+        indices[0] = candidate_feature_indices[j];
+      } else if (candidate_distances[j] < distances[1]) {
+        distances[1] = candidate_distances[j];
+        indices[1] = candidate_feature_indices[j];
+      }
+    }
+  }
+}
 
-  // Output the top 2 matches.
-  for (int i = 0; i < query_feature_indices.size(); i++) {
-    // Change the NN indices to be the feature index instead of the index of the
-    // FLANN matrix.
-    for (int j = 0; j < kNumNearestNeighbors; j++) {
-      const int flann_index = (*nn_indices)[i][j];
-      (*nn_indices)[i][j] = candidate_feature_indices[flann_index];
+GuidedMatchingIndex::GuidedMatchingIndex(const std::vector<Keypoint>& keypoints,
+                                         const double max_distance_pixels)
+    : max_distance_pixels_(max_distance_pixels),
+      top_left_(Eigen::Vector2d::Zero()),
+      bottom_right_(Eigen::Vector2d::Zero()) {
+  const double offset = max_distance_pixels_;
+  image_grids_.resize(4);
+  image_grids_[0].cell_offset_x = 0;
+  image_grids_[0].cell_offset_y = 0;
+  image_grids_[1].cell_offset_x = offset;
+  image_grids_[1].cell_offset_y = 0;
+  image_grids_[2].cell_offset_x = 0;
+  image_grids_[2].cell_offset_y = offset;
+  image_grids_[3].cell_offset_x = offset;
+  image_grids_[3].cell_offset_y = offset;
+
+  // For each grid, add all features to the cell that contains them.
+  for (ImageGrid& grid : image_grids_) {
+    grid.sorted_cells.reserve(keypoints.size());
+    for (int i = 0; i < keypoints.size(); i++) {
+      const Eigen::Vector2i grid_center =
+          GetClosestGridCenter(grid, keypoints[i].x(), keypoints[i].y());
+      grid.sorted_cells.emplace_back(EncodeGridCenter(grid_center), i);
     }
+    std::sort(grid.sorted_cells.begin(), grid.sorted_cells.end());
+  }
+
+  // Set the bounding box of the features. This will help constrain the search
+  // along epipolar lines later.
+  if (keypoints.empty()) {
+    return;
+  }
+  top_left_ << keypoints[0].x(), keypoints[0].y();
+  bottom_right_ = top_left_;
+  for (const Keypoint& keypoint : keypoints) {
+    top_left_.x() = std::min(top_left_.x(), keypoint.x());
+    top_left_.y() = std::min(top_left_.y(), keypoint.y());
+    bottom_right_.x() = std::max(bottom_right_.x(), keypoint.x());
+    bottom_right_.y() = std::max(bottom_right_.y(), keypoint.y());
   }
 }
 
-void GuidedEpipolarMatcher::FindClosestCellAndKeypoints(
-    const Eigen::Vector2d& point, std::vector<int>* new_keypoints) {
+void GuidedMatchingIndex::FindClosestCellAndKeypoints(
+    const Eigen::Vector2d& point, std::vector<int>* keypoint_indices) const {
   int min_grid = 0;
   Eigen::Vector2i min_grid_center;
   double min_dist = std::numeric_limits<double>::max();
 
   // Find the grid cell with the closest center.
-  for (int i = 0; i < 4; i++) {
-    Eigen::Vector2i grid_center;
-    image_grids_[i].GetClosestGridCenter(point.x(), point.y(), &grid_center);
+  for (int i = 0; i < image_grids_.size(); i++) {
+    const Eigen::Vector2i grid_center =
+        GetClosestGridCenter(image_grids_[i], point.x(), point.y());
     const double dist = (grid_center.cast<double>() - point).squaredNorm();
     if (dist < min_dist) {
       min_grid = i;
       min_dist = dist;
-      std::swap(min_grid_center, grid_center);
+      min_grid_center = grid_center;
     }
   }
 
   // Get the features from the closest grid cell.
-  image_grids_[min_grid].GetFeaturesFromCell(min_grid_center, new_keypoints);
-}
-
-GuidedEpipolarMatcher::ImageGrid::ImageGrid(const double cell_size,
-                                            const double cell_offset_x,
-                                            const double cell_offset_y)
-    : cell_size_(cell_size),
-      cell_offset_x_(cell_offset_x),
-      cell_offset_y_(cell_offset_y) {
-  cells_.reserve(10000);
+  const std::vector<std::pair<uint64_t, int> >& sorted_cells =
+      image_grids_[min_grid].sorted_cells;
+  const uint64_t cell_key = EncodeGridCenter(min_grid_center);
+  for (auto it = std::lower_bound(sorted_cells.begin(),
+                                  sorted_cells.end(),
+                                  std::make_pair(cell_key, 0));
+       it != sorted_cells.end() && it->first == cell_key;
+       ++it) {
+    keypoint_indices->emplace_back(it->second);
+  }
 }
 
-void GuidedEpipolarMatcher::ImageGrid::AddFeature(const int feature_index,
-                                                  const double x,
-                                                  const double y) {
+Eigen::Vector2i GuidedMatchingIndex::GetClosestGridCenter(
+    const ImageGrid& grid, const double x, const double y) const {
+  const double cell_size = max_distance_pixels_;
   Eigen::Vector2i grid_center;
-  GetClosestGridCenter(x, y, &grid_center);
-  cells_[grid_center].emplace_back(feature_index);
-}
-
-void GuidedEpipolarMatcher::ImageGrid::GetClosestGridCenter(
-    const double x, const double y, Eigen::Vector2i* grid_center) {
-  grid_center->x() = static_cast<int>(
-      std::floor((x - cell_offset_x_) / (2.0 * cell_size_)) * 2.0 * cell_size_ +
-      cell_size_ + cell_offset_x_);
-  grid_center->y() = static_cast<int>(
-      std::floor((y - cell_offset_y_) / (2.0 * cell_size_)) * 2.0 * cell_size_ +
-      + cell_size_ + cell_offset_y_);
-}
-
-void GuidedEpipolarMatcher::ImageGrid::GetFeaturesFromCell(
-    const Eigen::Vector2i& cell_center, std::vector<int>* feature_indices) {
-  *feature_indices = FindWithDefault(cells_, cell_center, std::vector<int>());
+  grid_center.x() = static_cast<int>(
+      std::floor((x - grid.cell_offset_x) / (2.0 * cell_size)) * 2.0 *
+          cell_size +
+      cell_size + grid.cell_offset_x);
+  grid_center.y() = static_cast<int>(
+      std::floor((y - grid.cell_offset_y) / (2.0 * cell_size)) * 2.0 *
+          cell_size +
+      cell_size + grid.cell_offset_y);
+  return grid_center;
 }
 
 }  // namespace theia
@@ -36,8 +36,8 @@
 #define THEIA_MATCHING_GUIDED_EPIPOLAR_MATCHER_H_
 
 #include <Eigen/Core>
+#include <stdint.h>
 #include <memory>
-#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -45,12 +45,53 @@
 #include "theia/alignment/alignment.h"
 #include "theia/matching/keypoints_and_descriptors.h"
 #include "theia/sfm/camera/camera.h"
-#include "theia/util/hash.h"
 
 namespace theia {
+class Keypoint;
 class RandomNumberGenerator;
 struct IndexedFeatureMatch;
 
+// A spatial index of the keypoints of an image that is used to rapidly find the
+// features near epipolar lines during guided matching. The index only depends
+// on the image itself so it may be built once and shared by all image pairs
+// that the image is part of (see FeatureMatcher).
+class GuidedMatchingIndex {
+ public:
+  // The grid cells have a half-width of max_distance_pixels, which should be
+  // set to GuidedEpipolarMatcher::Options::guided_matching_max_distance_pixels.
+  GuidedMatchingIndex(const std::vector<Keypoint>& keypoints,
+                      const double max_distance_pixels);
+
+  double MaxDistancePixels() const { return max_distance_pixels_; }
+
+  // The bounding box of the keypoints.
+  const Eigen::Vector2d& TopLeft() const { return top_left_; }
+  const Eigen::Vector2d& BottomRight() const { return bottom_right_; }
+
+  // Finds the closest grid cell among all image grids and appends the indices
+  // of the keypoints in that cell.
+  void FindClosestCellAndKeypoints(const Eigen::Vector2d& point,
+                                   std::vector<int>* keypoint_indices) const;
+
+ private:
+  // The keypoints are assigned to the cells of four grids that are offset by
+  // half of a cell from each other. Each grid is stored as the keypoint
+  // indices sorted by the key of the cell that contains them.
+  struct ImageGrid {
+    double cell_offset_x, cell_offset_y;
+    std::vector<std::pair<uint64_t, int> > sorted_cells;
+  };
+
+  // Retrieve the closest cell center of the grid to the point.
+  Eigen::Vector2i GetClosestGridCenter(const ImageGrid& grid,
+                                       const double x,
+                                       const double y) const;
+
+  double max_distance_pixels_;
+  Eigen::Vector2d top_left_, bottom_right_;
+  std::vector<ImageGrid> image_grids_;
+};
+
 class GuidedEpipolarMatcher {
  public:
   struct Options {
@@ -69,16 +110,21 @@ class GuidedEpipolarMatcher {
     double lowes_ratio = 0.8;
   };
 
+  // If features2_index is not null then it must be the guided matching index of
+  // features2 and outlive the matcher. Otherwise the index is built when
+  // GetMatches is called.
   GuidedEpipolarMatcher(const Options& options,
                         const Camera& camera1,
                         const Camera& camera2,
                         const KeypointsAndDescriptors& features1,
-                        const KeypointsAndDescriptors& features2)
+                        const KeypointsAndDescriptors& features2,
+                        const GuidedMatchingIndex* features2_index = nullptr)
       : options_(options),
         camera1_(camera1),
         camera2_(camera2),
         features1_(features1),
-        features2_(features2) {}
+        features2_(features2),
+        features2_index_(features2_index) {}
 
   // Find matches using a guided search strategy. Valid matches are appended to
   // the matches vector, and only features that do not contain a match are used
@@ -86,39 +132,13 @@ class GuidedEpipolarMatcher {
   bool GetMatches(std::vector<IndexedFeatureMatch>* matches);
 
  private:
-  // This helper class provides quick and easy access to the image grids that
-  // are used to rapidly find features near epipolar lines.
-  class ImageGrid {
-   public:
-    ImageGrid(const double cell_size,
-              const double cell_offset_x,
-              const double cell_offset_y);
-
-    // Add a feature the the grid and assign it to a cell.
-    void AddFeature(const int feature_index, const double x, const double y);
-
-    // Retrieve the closest cell center to the point.
-    void GetClosestGridCenter(const double x, const double y,
-                              Eigen::Vector2i* grid_center);
-
-    // Get all features that lie within the cell specified by the center.
-    void GetFeaturesFromCell(const Eigen::Vector2i& cell_center,
-                             std::vector<int>* feature_indices);
-
-   private:
-    // A container for the grid cells. The mapping is such the the cell center
-    // contains all keypoints in the cell.
-    std::unordered_map<Eigen::Vector2i, std::vector<int>> cells_;
-    double cell_size_, cell_offset_x_, cell_offset_y_;
-  };
-
   // Holds a group of features with similar epiplines as a single epiline.
   struct EpilineGroup {
     std::vector<Eigen::Vector2d> endpoints;
     std::vector<int> features;
   };
 
-  // Creates the grid structure for the fast epipolar lookup.
+  // Sets up the grid structure for the fast epipolar lookup.
   bool Initialize(const std::vector<IndexedFeatureMatch>& matches);
 
   // Groups similar epipolar lines into groups so that the computational
@@ -138,16 +158,15 @@ class GuidedEpipolarMatcher {
   // Computes a fundamental matrix from the cameras.
   Eigen::Matrix3d ComputeFundamentalMatrix();
 
-  // Finds the closest grid cell among all image grids and returns the keypoints
-  // in that cell.
-  void FindClosestCellAndKeypoints(const Eigen::Vector2d& point,
-                                   std::vector<int>* new_keypoints);
-
   // Given the set of query descriptors (in features1) and the candidate matches
   // (in features2), return the top 2 nearest neighbor distances and indices
   // where the index is the index in features2 of the match. The format is
   // nn_distances[query_feature_index][nn_number] where nn_number == 0 is the
-  // closest neighbor by descriptor distance.
+  // closest neighbor by descriptor distance. The candidates near an epipolar
+  // line are few, so the distances are computed exhaustively rather than by
+  // building a search tree over the candidates. The distance is the squared L2
+  // distance for float descriptors and the Hamming distance for binary
+  // descriptors.
   void FindKNearestNeighbors(const std::vector<int>& query_feature_indices,
                              const std::vector<int>& candidate_feature_indices,
                              std::vector<std::vector<float> >* nn_distances,
@@ -159,8 +178,10 @@ class GuidedEpipolarMatcher {
 
   std::shared_ptr<RandomNumberGenerator> rng_;
 
-  Eigen::Vector2d top_left_, bottom_right_;
-  std::vector<ImageGrid> image_grids_;
+  // The index of features2, which is either supplied by the caller or owned by
+  // this class.
+  const GuidedMatchingIndex* features2_index_;
+  std::unique_ptr<GuidedMatchingIndex> owned_features2_index_;
   std::unordered_set<int> matched_features1_, matched_features2_;
 };
 
@@ -34,6 +34,7 @@
 
 #include <glog/logging.h>
 #include <Eigen/Core>
+#include <memory>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -54,7 +55,8 @@ std::shared_ptr<RandomNumberGenerator> rng =
 
 void TestGuidedEpipolarMatcher(const int num_valid_matches,
                                const int num_invalid_matches,
-                               const int num_provided_matches) {
+                               const int num_provided_matches,
+                               const bool use_shared_index) {
   static const int kNumDescriptorDimensions = 128;
 
   // Set up two cameras, with camera 1 being at the coordinate system origin.
@@ -124,11 +126,17 @@ void TestGuidedEpipolarMatcher(const int num_valid_matches,
     matches.emplace_back(match);
   }
 
-  // Run guided matching.
+  // Run guided matching, optionally with an index of features2 that is built
+  // beforehand as it would be when it is shared between image pairs.
   GuidedEpipolarMatcher::Options options;
   options.rng = rng;
+  std::unique_ptr<GuidedMatchingIndex> features2_index;
+  if (use_shared_index) {
+    features2_index.reset(new GuidedMatchingIndex(
+        features2.keypoints, options.guided_matching_max_distance_pixels));
+  }
   GuidedEpipolarMatcher matcher(options, camera1, camera2, features1,
-                                features2);
+                                features2, features2_index.get());
 
   // Ensure that the guided matching returns true.
   EXPECT_TRUE(matcher.GetMatches(&matches));
@@ -145,19 +153,27 @@ void TestGuidedEpipolarMatcher(const int num_valid_matches,
 }
 
 TEST(GuidedEpipolarMatcherTest, NoInputMatchesSmall) {
-  TestGuidedEpipolarMatcher(100, 50, 0);
+  TestGuidedEpipolarMatcher(100, 50, 0, false);
 }
 
 TEST(GuidedEpipolarMatcherTest, NoInputMatchesLarge) {
-  TestGuidedEpipolarMatcher(2000, 500, 0);
+  TestGuidedEpipolarMatcher(2000, 500, 0, false);
 }
 
 TEST(GuidedEpipolarMatcherTest, WithInputMatchesSmall) {
-  TestGuidedEpipolarMatcher(100, 50, 10);
+  TestGuidedEpipolarMatcher(100, 50, 10, false);
 }
 
 TEST(GuidedEpipolarMatcherTest, WithInputMatchesLarge) {
-  TestGuidedEpipolarMatcher(2000, 500, 1000);
+  TestGuidedEpipolarMatcher(2000, 500, 1000, false);
+}
+
+TEST(GuidedEpipolarMatcherTest, SharedIndexNoInputMatches) {
+  TestGuidedEpipolarMatcher(2000, 500, 0, true);
+}
+
+TEST(GuidedEpipolarMatcherTest, SharedIndexWithInputMatches) {
+  TestGuidedEpipolarMatcher(2000, 500, 1000, true);
 }
 
 }  // namespace theia
@@ -0,0 +1,309 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/matching/hamming_distance.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// The SIMD kernels are compiled with function-level target attributes and
+// selected at runtime, so that they are available without building the whole
+// library for a specific instruction set.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define THEIA_HAMMING_X86_KERNELS
+#include <immintrin.h>
+#if (defined(__clang__) && __clang_major__ >= 6) || \
+    (!defined(__clang__) && __GNUC__ >= 8)
+#define THEIA_HAMMING_AVX512_KERNEL
+#endif
+#endif
+
+namespace theia {
+
+namespace {
+
+// Descriptors are padded to a multiple of this many bytes when packed.
+static const int kPackedAlignment = 32;
+
+typedef int (*HammingDistanceKernel)(const uint8_t*, const uint8_t*, int);
+typedef void (*HammingDistancesKernel)(const uint8_t*,
+                                       const uint8_t*,
+                                       int,
+                                       int,
+                                       int*);
+
+inline int PopCount64(const uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(x);
+#else
+  uint64_t v = x - ((x >> 1) & 0x5555555555555555ULL);
+  v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+  v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return static_cast<int>((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// XORs and popcounts the descriptors one 64-bit word at a time.
+inline int ScalarHammingDistance(const uint8_t* a,
+                                 const uint8_t* b,
+                                 const int num_bytes) {
+  int distance = 0;
+  int i = 0;
+  for (; i + 8 <= num_bytes; i += 8) {
+    uint64_t word_a, word_b;
+    std::memcpy(&word_a, a + i, sizeof(word_a));
+    std::memcpy(&word_b, b + i, sizeof(word_b));
+    distance += PopCount64(word_a ^ word_b);
+  }
+  for (; i < num_bytes; i++) {
+    distance += PopCount64(static_cast<uint64_t>(a[i] ^ b[i]));
+  }
+  return distance;
+}
+
+int PortableHammingDistance(const uint8_t* a,
+                            const uint8_t* b,
+                            const int num_bytes) {
+  return ScalarHammingDistance(a, b, num_bytes);
+}
+
+void PortableHammingDistances(const uint8_t* query,
+                              const uint8_t* database,
+                              const int num_descriptors,
+                              const int stride,
+                              int* distances) {
+  for (int i = 0; i < num_descriptors; i++) {
+    distances[i] = ScalarHammingDistance(query, database + i * stride, stride);
+  }
+}
+
+#ifdef THEIA_HAMMING_X86_KERNELS
+
+__attribute__((target("popcnt"))) int PopcntHammingDistance(
+    const uint8_t* a, const uint8_t* b, const int num_bytes) {
+  return ScalarHammingDistance(a, b, num_bytes);
+}
+
+__attribute__((target("popcnt"))) void PopcntHammingDistances(
+    const uint8_t* query,
+    const uint8_t* database,
+    const int num_descriptors,
+    const int stride,
+    int* distances) {
+  for (int i = 0; i < num_descriptors; i++) {
+    distances[i] = ScalarHammingDistance(query, database + i * stride, stride);
+  }
+}
+
+// Counts the bits of 32 bytes at a time with a 4-bit lookup table (pshufb)
+// and accumulates the byte counts into 64-bit lanes with psadbw.
+__attribute__((target("avx2,popcnt"))) inline int Avx2HammingDistanceImpl(
+    const uint8_t* a, const uint8_t* b, const int num_bytes) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  __m256i sum = _mm256_setzero_si256();
+  int i = 0;
+  for (; i + 32 <= num_bytes; i += 32) {
+    const __m256i x = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+    const __m256i low = _mm256_and_si256(x, low_mask);
+    const __m256i high = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+    const __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low),
+                                           _mm256_shuffle_epi8(lookup, high));
+    sum = _mm256_add_epi64(sum,
+                           _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+  }
+  int distance = static_cast<int>(_mm256_extract_epi64(sum, 0) +
+                                  _mm256_extract_epi64(sum, 1) +
+                                  _mm256_extract_epi64(sum, 2) +
+                                  _mm256_extract_epi64(sum, 3));
+  if (i < num_bytes) {
+    distance += ScalarHammingDistance(a + i, b + i, num_bytes - i);
+  }
+  return distance;
+}
+
+__attribute__((target("avx2,popcnt"))) int Avx2HammingDistance(
+    const uint8_t* a, const uint8_t* b, const int num_bytes) {
+  return Avx2HammingDistanceImpl(a, b, num_bytes);
+}
+
+__attribute__((target("avx2,popcnt"))) void Avx2HammingDistances(
+    const uint8_t* query,
+    const uint8_t* database,
+    const int num_descriptors,
+    const int stride,
+    int* distances) {
+  for (int i = 0; i < num_descriptors; i++) {
+    distances[i] =
+        Avx2HammingDistanceImpl(query, database + i * stride, stride);
+  }
+}
+
+#ifdef THEIA_HAMMING_AVX512_KERNEL
+
+// Popcounts 64 bytes at a time with VPOPCNTQ. The tail is read with a masked
+// load so that no bytes past the end of the descriptor are accessed.
+__attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) inline int
+Avx512HammingDistanceImpl(const uint8_t* a,
+                          const uint8_t* b,
+                          const int num_bytes) {
+  __m512i sum = _mm512_setzero_si512();
+  int i = 0;
+  for (; i + 64 <= num_bytes; i += 64) {
+    const __m512i x = _mm512_xor_si512(_mm512_loadu_si512(a + i),
+                                       _mm512_loadu_si512(b + i));
+    sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(x));
+  }
+  if (i < num_bytes) {
+    const __mmask64 mask = (~0ULL) >> (64 - (num_bytes - i));
+    const __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, a + i),
+                                       _mm512_maskz_loadu_epi8(mask, b + i));
+    sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(x));
+  }
+  return static_cast<int>(_mm512_reduce_add_epi64(sum));
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) int
+Avx512HammingDistance(const uint8_t* a, const uint8_t* b, const int num_bytes) {
+  return Avx512HammingDistanceImpl(a, b, num_bytes);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) void
+Avx512HammingDistances(const uint8_t* query,
+                       const uint8_t* database,
+                       const int num_descriptors,
+                       const int stride,
+                       int* distances) {
+  for (int i = 0; i < num_descriptors; i++) {
+    distances[i] =
+        Avx512HammingDistanceImpl(query, database + i * stride, stride);
+  }
+}
+
+#endif  // THEIA_HAMMING_AVX512_KERNEL
+#endif  // THEIA_HAMMING_X86_KERNELS
+
+struct HammingKernels {
+  HammingDistanceKernel distance;
+  HammingDistancesKernel distances;
+  const char* name;
+};
+
+HammingKernels SelectHammingKernels() {
+#ifdef THEIA_HAMMING_X86_KERNELS
+  __builtin_cpu_init();
+#ifdef THEIA_HAMMING_AVX512_KERNEL
+  if (__builtin_cpu_supports("avx512f") &&
+      __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512vpopcntdq")) {
+    return {&Avx512HammingDistance, &Avx512HammingDistances, "AVX512"};
+  }
+#endif  // THEIA_HAMMING_AVX512_KERNEL
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+    return {&Avx2HammingDistance, &Avx2HammingDistances, "AVX2"};
+  }
+  if (__builtin_cpu_supports("popcnt")) {
+    return {&PopcntHammingDistance, &PopcntHammingDistances, "POPCNT"};
+  }
+#endif  // THEIA_HAMMING_X86_KERNELS
+  return {&PortableHammingDistance, &PortableHammingDistances, "PORTABLE"};
+}
+
+// The kernels are selected once, the first time a distance is computed.
+const HammingKernels& GetHammingKernels() {
+  static const HammingKernels kernels = SelectHammingKernels();
+  return kernels;
+}
+
+}  // namespace
+
+int HammingDistance(const uint8_t* descriptor_a,
+                    const uint8_t* descriptor_b,
+                    const int num_bytes) {
+  return GetHammingKernels().distance(descriptor_a, descriptor_b, num_bytes);
+}
+
+int HammingDistance(const BinaryVectorX& descriptor_a,
+                    const BinaryVectorX& descriptor_b) {
+  DCHECK_EQ(descriptor_a.size(), descriptor_b.size());
+  return HammingDistance(
+      descriptor_a.data(), descriptor_b.data(), descriptor_a.size());
+}
+
+const char* HammingDistanceKernelName() {
+  return GetHammingKernels().name;
+}
+
+PackedBinaryDescriptors::PackedBinaryDescriptors(
+    const std::vector<BinaryVectorX>& descriptors)
+    : num_descriptors_(descriptors.size()), num_bytes_(0), stride_(0) {
+  if (descriptors.empty()) {
+    return;
+  }
+
+  num_bytes_ = descriptors[0].size();
+  stride_ = std::max(
+      kPackedAlignment,
+      ((num_bytes_ + kPackedAlignment - 1) / kPackedAlignment) *
+          kPackedAlignment);
+  data_.resize(num_descriptors_ * stride_, 0);
+  for (int i = 0; i < num_descriptors_; i++) {
+    CHECK_EQ(descriptors[i].size(), num_bytes_)
+        << "All binary descriptors must have the same length.";
+    std::copy(descriptors[i].data(),
+              descriptors[i].data() + num_bytes_,
+              data_.begin() + i * stride_);
+  }
+}
+
+void ComputeHammingDistances(const uint8_t* query,
+                             const PackedBinaryDescriptors& database,
+                             int* distances) {
+  GetHammingKernels().distances(query,
+                                database.Descriptor(0),
+                                database.NumDescriptors(),
+                                database.Stride(),
+                                distances);
+}
+
+}  // namespace theia
@@ -0,0 +1,98 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_MATCHING_HAMMING_DISTANCE_H_
+#define THEIA_MATCHING_HAMMING_DISTANCE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "theia/image/descriptor/binary_descriptor.h"
+
+namespace theia {
+
+// Returns the number of bits that differ between the two bit-packed
+// descriptors of num_bytes bytes. The popcount kernel is chosen once at
+// runtime from the instruction sets supported by the CPU: AVX-512 VPOPCNTDQ,
+// AVX2, the POPCNT instruction, or a portable fallback.
+int HammingDistance(const uint8_t* descriptor_a,
+                    const uint8_t* descriptor_b,
+                    const int num_bytes);
+
+int HammingDistance(const BinaryVectorX& descriptor_a,
+                    const BinaryVectorX& descriptor_b);
+
+// Returns the name of the popcount kernel that is used on this CPU.
+const char* HammingDistanceKernelName();
+
+// A set of binary descriptors that is stored contiguously so that it may be
+// searched efficiently. Each descriptor is zero-padded to a multiple of 32
+// bytes so that the SIMD kernels do not need to handle a partial tail; the
+// padding does not change the Hamming distance between two packed
+// descriptors.
+class PackedBinaryDescriptors {
+ public:
+  explicit PackedBinaryDescriptors(
+      const std::vector<BinaryVectorX>& descriptors);
+
+  int NumDescriptors() const { return num_descriptors_; }
+
+  // The number of bytes of each descriptor, excluding the padding.
+  int NumBytes() const { return num_bytes_; }
+
+  // The number of bytes of each (padded) packed descriptor.
+  int Stride() const { return stride_; }
+
+  const uint8_t* Descriptor(const int i) const {
+    return data_.data() + i * stride_;
+  }
+
+ private:
+  int num_descriptors_;
+  int num_bytes_;
+  int stride_;
+  std::vector<uint8_t> data_;
+};
+
+// Computes the Hamming distance between the query and all descriptors of the
+// database, such that distances[i] is the distance to database descriptor
+// i. The query must be a packed descriptor with the same stride as the
+// database (e.g., PackedBinaryDescriptors::Descriptor of another set).
+void ComputeHammingDistances(const uint8_t* query,
+                             const PackedBinaryDescriptors& database,
+                             int* distances);
+
+}  // namespace theia
+
+#endif  // THEIA_MATCHING_HAMMING_DISTANCE_H_
@@ -0,0 +1,116 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <glog/logging.h>
+#include <bitset>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "theia/image/descriptor/binary_descriptor.h"
+#include "theia/matching/distance.h"
+#include "theia/matching/hamming_distance.h"
+#include "theia/util/random.h"
+
+namespace theia {
+
+namespace {
+
+RandomNumberGenerator rng(48);
+
+BinaryVectorX RandomBinaryDescriptor(const int num_bytes) {
+  BinaryVectorX descriptor(num_bytes);
+  for (int i = 0; i < num_bytes; i++) {
+    descriptor(i) = static_cast<uint8_t>(rng.RandInt(0, 255));
+  }
+  return descriptor;
+}
+
+int NaiveHammingDistance(const BinaryVectorX& descriptor_a,
+                         const BinaryVectorX& descriptor_b) {
+  int distance = 0;
+  for (int i = 0; i < descriptor_a.size(); i++) {
+    distance += std::bitset<8>(descriptor_a(i) ^ descriptor_b(i)).count();
+  }
+  return distance;
+}
+
+TEST(HammingDistance, ZeroDistance) {
+  const BinaryVectorX descriptor = RandomBinaryDescriptor(61);
+  Hamming hamming_dist;
+  EXPECT_EQ(hamming_dist(descriptor, descriptor), 0);
+}
+
+TEST(HammingDistance, KnownDistance) {
+  VLOG(1) << "Using the " << HammingDistanceKernelName() << " kernel.";
+  // Test all lengths up to a few SIMD blocks so that the tails are covered.
+  for (int num_bytes = 1; num_bytes <= 200; num_bytes++) {
+    const BinaryVectorX descriptor1 = RandomBinaryDescriptor(num_bytes);
+    const BinaryVectorX descriptor2 = RandomBinaryDescriptor(num_bytes);
+    EXPECT_EQ(HammingDistance(descriptor1, descriptor2),
+              NaiveHammingDistance(descriptor1, descriptor2));
+  }
+
+  // All bits differ.
+  const BinaryVectorX zeros = BinaryVectorX::Zero(64);
+  const BinaryVectorX ones = BinaryVectorX::Constant(64, 255);
+  EXPECT_EQ(HammingDistance(zeros, ones), 512);
+}
+
+TEST(HammingDistance, PackedDescriptors) {
+  const int kNumDescriptors = 100;
+  for (const int num_bytes : {8, 32, 61, 64, 100}) {
+    std::vector<BinaryVectorX> descriptors(kNumDescriptors);
+    for (int i = 0; i < kNumDescriptors; i++) {
+      descriptors[i] = RandomBinaryDescriptor(num_bytes);
+    }
+    const PackedBinaryDescriptors packed(descriptors);
+    EXPECT_EQ(packed.NumDescriptors(), kNumDescriptors);
+    EXPECT_EQ(packed.NumBytes(), num_bytes);
+    EXPECT_EQ(packed.Stride() % 32, 0);
+    EXPECT_GE(packed.Stride(), num_bytes);
+
+    // The distances to all descriptors must match the pairwise distances.
+    std::vector<int> distances(kNumDescriptors);
+    for (int i = 0; i < kNumDescriptors; i += 7) {
+      ComputeHammingDistances(packed.Descriptor(i), packed, distances.data());
+      for (int j = 0; j < kNumDescriptors; j++) {
+        EXPECT_EQ(distances[j],
+                  NaiveHammingDistance(descriptors[i], descriptors[j]));
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace theia
@@ -116,6 +116,51 @@ size_t InMemoryFeaturesAndMatchesDatabase::NumImages() {
   return features_.size();
 }
 
+bool InMemoryFeaturesAndMatchesDatabase::ContainsGlobalDescriptor(
+    const std::string& image_name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ContainsKey(global_descriptors_, image_name);
+}
+
+Eigen::VectorXf InMemoryFeaturesAndMatchesDatabase::GetGlobalDescriptor(
+    const std::string& image_name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return FindOrDie(global_descriptors_, image_name);
+}
+
+void InMemoryFeaturesAndMatchesDatabase::PutGlobalDescriptor(
+    const std::string& image_name, const Eigen::VectorXf& global_descriptor) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  global_descriptors_[image_name] = global_descriptor;
+}
+
+std::vector<std::string>
+InMemoryFeaturesAndMatchesDatabase::ImageNamesOfGlobalDescriptors() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::string> image_names;
+  image_names.reserve(global_descriptors_.size());
+  for (const auto& global_descriptor : global_descriptors_) {
+    image_names.push_back(global_descriptor.first);
+  }
+  return image_names;
+}
+
+bool InMemoryFeaturesAndMatchesDatabase::GetGlobalDescriptorExtractorModel(
+    std::string* serialized_model) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (global_descriptor_extractor_model_.empty()) {
+    return false;
+  }
+  *CHECK_NOTNULL(serialized_model) = global_descriptor_extractor_model_;
+  return true;
+}
+
+void InMemoryFeaturesAndMatchesDatabase::PutGlobalDescriptorExtractorModel(
+    const std::string& serialized_model) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  global_descriptor_extractor_model_ = serialized_model;
+}
+
 // Get the image pair match for the images.
 ImagePairMatch InMemoryFeaturesAndMatchesDatabase::GetImagePairMatch(
     const std::string& image_name1, const std::string& image_name2) {
@@ -145,6 +190,18 @@ size_t InMemoryFeaturesAndMatchesDatabase::NumMatches() {
   return matches_.size();
 }
 
+bool InMemoryFeaturesAndMatchesDatabase::ContainsMatchedImage(
+    const std::string& image_name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ContainsKey(matched_images_, image_name);
+}
+
+void InMemoryFeaturesAndMatchesDatabase::PutMatchedImage(
+    const std::string& image_name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  matched_images_.emplace(image_name);
+}
+
 bool InMemoryFeaturesAndMatchesDatabase::ReadFromFile(
     const std::string& filepath) {
   // Return false if the file cannot be opened.
@@ -212,6 +269,7 @@ bool InMemoryFeaturesAndMatchesDatabase::WriteToFile(
 
 void InMemoryFeaturesAndMatchesDatabase::RemoveAllMatches() {
   matches_.clear();
+  matched_images_.clear();
 }
 
 }  // namespace theia
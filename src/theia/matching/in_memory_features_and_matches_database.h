@@ -38,6 +38,7 @@
 #include <mutex>  // NOLINT
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 #include "theia/io/read_keypoints_and_descriptors.h"
@@ -85,6 +86,22 @@ class InMemoryFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
   std::vector<std::string> ImageNamesOfFeatures() override;
   size_t NumImages() override;
 
+  bool ContainsGlobalDescriptor(const std::string& image_name) override;
+
+  // Get/set the global image descriptor for the image.
+  Eigen::VectorXf GetGlobalDescriptor(const std::string& image_name) override;
+  void PutGlobalDescriptor(const std::string& image_name,
+                           const Eigen::VectorXf& global_descriptor) override;
+
+  // Supply an iterator to iterate over the global descriptors.
+  std::vector<std::string> ImageNamesOfGlobalDescriptors() override;
+
+  // Get/set the serialized model of the global descriptor extractor.
+  bool GetGlobalDescriptorExtractorModel(
+      std::string* serialized_model) override;
+  void PutGlobalDescriptorExtractorModel(
+      const std::string& serialized_model) override;
+
   // Get the image pair match for the images.Returns true if the features exist
   // in the database and false otherwise.
   ImagePairMatch GetImagePairMatch(const std::string& image_name1,
@@ -99,6 +116,10 @@ class InMemoryFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
       override;
   size_t NumMatches() override;
 
+  // Get/set whether the image has been matched to the other images.
+  bool ContainsMatchedImage(const std::string& image_name) override;
+  void PutMatchedImage(const std::string& image_name) override;
+
   bool ReadFromFile(const std::string& filepath);
   bool WriteToFile(const std::string& filepath);
 
@@ -112,6 +133,9 @@ class InMemoryFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
   std::unordered_map<std::string, KeypointsAndDescriptors> features_;
   std::unordered_map<std::pair<std::string, std::string>, ImagePairMatch>
       matches_;
+  std::unordered_set<std::string> matched_images_;
+  std::unordered_map<std::string, Eigen::VectorXf> global_descriptors_;
+  std::string global_descriptor_extractor_model_;
 };
 }  // namespace theia
 #endif  // THEIA_MATCHING_IN_MEMORY_FEATURES_AND_MATCHES_DATABASE_H_
@@ -39,16 +39,20 @@
 #include <string>
 #include <vector>
 
+#include "theia/image/descriptor/binary_descriptor.h"
 #include "theia/image/keypoint_detector/keypoint.h"
 
 namespace theia {
 
 // This struct is used by the internal cache to hold keypoints and descriptors
-// when the are retrieved from the cache.
+// when the are retrieved from the cache. Features with float descriptors (e.g.,
+// SIFT) use descriptors and features with binary descriptors (e.g., AKAZE
+// MLDB) use binary_descriptors. Only one of the two containers is used.
 struct KeypointsAndDescriptors {
   std::string image_name;
   std::vector<Keypoint> keypoints;
   std::vector<Eigen::VectorXf> descriptors;
+  std::vector<BinaryVectorX> binary_descriptors;
 };
 
 }  // namespace theia
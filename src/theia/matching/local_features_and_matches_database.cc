@@ -107,8 +107,10 @@ void LocalFeaturesAndMatchesDatabase::PutFeatures(
     const std::string& image_name, const KeypointsAndDescriptors& features) {
   const std::string features_file =
       FeatureFilenameFromImage(directory_, image_name);
-  CHECK(WriteKeypointsAndDescriptors(
-      features_file, features.keypoints, features.descriptors))
+  CHECK(WriteKeypointsAndDescriptors(features_file,
+                                     features.keypoints,
+                                     features.descriptors,
+                                     features.binary_descriptors))
       << "Could not write features for image " << image_name << " to file "
       << features_file;
   image_names_.insert(image_name);
@@ -161,7 +163,8 @@ KeypointsAndDescriptors LocalFeaturesAndMatchesDatabase::FetchImages(
   CHECK(ReadKeypointsAndDescriptors(
       FeatureFilenameFromImage(directory_, image_name),
       &features.keypoints,
-      &features.descriptors));
+      &features.descriptors,
+      &features.binary_descriptors));
   features.image_name = image_name;
   return features;
 }
@@ -0,0 +1,250 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/matching/multi_index_hasher.h"
+
+#include <glog/logging.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "theia/matching/hamming_distance.h"
+
+namespace theia {
+
+namespace {
+
+// Substrings are whole bytes and the keys are stored in 32 bits.
+static const int kMaxSubstringBytes = 4;
+
+// The approximate cost of probing a hash table relative to computing the
+// distance to one descriptor with the batched SIMD kernels.
+static const double kRelativeProbeCost = 32.0;
+
+// Replaces the current neighbors if the candidate is closer. Ties are broken
+// by the smaller index so that the results match a linear scan.
+inline void UpdateNearestNeighbors(const int index,
+                                   const int distance,
+                                   int* neighbor_indices,
+                                   int* neighbor_distances) {
+  if (distance < neighbor_distances[0] ||
+      (distance == neighbor_distances[0] && index < neighbor_indices[0])) {
+    neighbor_indices[1] = neighbor_indices[0];
+    neighbor_distances[1] = neighbor_distances[0];
+    neighbor_indices[0] = index;
+    neighbor_distances[0] = distance;
+  } else if (distance < neighbor_distances[1] ||
+             (distance == neighbor_distances[1] &&
+              index < neighbor_indices[1])) {
+    neighbor_indices[1] = index;
+    neighbor_distances[1] = distance;
+  }
+}
+
+// Returns n choose k as a double so that it does not overflow.
+double NumCombinations(const int n, const int k) {
+  if (k < 0 || k > n) {
+    return 0.0;
+  }
+  double num_combinations = 1.0;
+  for (int i = 1; i <= k; i++) {
+    num_combinations *= static_cast<double>(n - k + i) / i;
+  }
+  return num_combinations;
+}
+
+}  // namespace
+
+MultiIndexHasher::MultiIndexHasher(const PackedBinaryDescriptors& descriptors)
+    : descriptors_(descriptors),
+      max_substring_bits_(0),
+      visited_(descriptors.NumDescriptors(), -1),
+      query_id_(-1),
+      distances_(descriptors.NumDescriptors()) {
+  const int num_descriptors = descriptors_.NumDescriptors();
+  const int num_bytes = descriptors_.NumBytes();
+  if (num_descriptors == 0 || num_bytes == 0) {
+    return;
+  }
+
+  // Use substrings of roughly log2(N) bits so that most buckets contain at
+  // most a few descriptors.
+  const double log_num_descriptors =
+      std::log2(std::max(num_descriptors, 2));
+  const int substring_bytes = std::min(
+      std::min(kMaxSubstringBytes, num_bytes),
+      std::max(1, static_cast<int>(std::round(log_num_descriptors / 8.0))));
+  const int num_substrings =
+      (num_bytes + substring_bytes - 1) / substring_bytes;
+
+  tables_.resize(num_substrings);
+  std::vector<std::pair<uint32_t, int> > keys_and_indices(num_descriptors);
+  for (int i = 0; i < num_substrings; i++) {
+    SubstringTable& table = tables_[i];
+    table.first_byte = i * substring_bytes;
+    table.num_bytes = std::min(substring_bytes, num_bytes - table.first_byte);
+    max_substring_bits_ = std::max(max_substring_bits_, 8 * table.num_bytes);
+
+    for (int j = 0; j < num_descriptors; j++) {
+      keys_and_indices[j] =
+          std::make_pair(SubstringKey(descriptors_.Descriptor(j), table), j);
+    }
+    std::sort(keys_and_indices.begin(), keys_and_indices.end());
+
+    table.keys.resize(num_descriptors);
+    table.indices.resize(num_descriptors);
+    for (int j = 0; j < num_descriptors; j++) {
+      table.keys[j] = keys_and_indices[j].first;
+      table.indices[j] = keys_and_indices[j].second;
+    }
+  }
+}
+
+uint32_t MultiIndexHasher::SubstringKey(const uint8_t* descriptor,
+                                        const SubstringTable& table) const {
+  uint32_t key = 0;
+  for (int i = 0; i < table.num_bytes; i++) {
+    key |= static_cast<uint32_t>(descriptor[table.first_byte + i]) << (8 * i);
+  }
+  return key;
+}
+
+bool MultiIndexHasher::FindNearestNeighbor(const uint8_t* query,
+                                           const double lowes_ratio,
+                                           int* neighbor_index,
+                                           int* neighbor_distance) {
+  const int num_descriptors = descriptors_.NumDescriptors();
+  const int stride = descriptors_.Stride();
+  if (num_descriptors == 0) {
+    return false;
+  }
+
+  if (query_id_ == std::numeric_limits<int>::max()) {
+    std::fill(visited_.begin(), visited_.end(), -1);
+    query_id_ = -1;
+  }
+  ++query_id_;
+
+  int neighbor_indices[2] = {std::numeric_limits<int>::max(),
+                             std::numeric_limits<int>::max()};
+  int neighbor_distances[2] = {std::numeric_limits<int>::max(),
+                               std::numeric_limits<int>::max()};
+  const int num_substrings = tables_.size();
+  for (int radius = 0; radius <= max_substring_bits_; radius++) {
+    // Switch to a linear scan over all descriptors if probing all keys within
+    // this radius is more expensive than the scan.
+    double num_probes = 0.0;
+    for (const SubstringTable& table : tables_) {
+      num_probes += NumCombinations(8 * table.num_bytes, radius);
+    }
+    if (kRelativeProbeCost * num_probes > num_descriptors) {
+      ComputeHammingDistances(query, descriptors_, distances_.data());
+      neighbor_distances[0] = neighbor_distances[1] =
+          std::numeric_limits<int>::max();
+      for (int i = 0; i < num_descriptors; i++) {
+        UpdateNearestNeighbors(
+            i, distances_[i], neighbor_indices, neighbor_distances);
+      }
+      break;
+    }
+
+    // Probe every key within the radius of each query substring, enumerating
+    // the bit flips with Gosper's hack.
+    for (const SubstringTable& table : tables_) {
+      const int num_bits = 8 * table.num_bytes;
+      if (radius > num_bits) {
+        continue;
+      }
+      const uint32_t query_key = SubstringKey(query, table);
+      const uint64_t end_mask = 1ULL << num_bits;
+      uint64_t mask = (1ULL << radius) - 1;
+      while (mask < end_mask) {
+        const uint32_t key = query_key ^ static_cast<uint32_t>(mask);
+        for (auto it =
+                 std::lower_bound(table.keys.begin(), table.keys.end(), key);
+             it != table.keys.end() && *it == key;
+             ++it) {
+          const int index = table.indices[it - table.keys.begin()];
+          if (visited_[index] == query_id_) {
+            continue;
+          }
+          visited_[index] = query_id_;
+          UpdateNearestNeighbors(
+              index,
+              HammingDistance(query, descriptors_.Descriptor(index), stride),
+              neighbor_indices,
+              neighbor_distances);
+        }
+
+        if (mask == 0) {
+          break;
+        }
+        const uint64_t lowest_bit = mask & (~mask + 1);
+        const uint64_t ripple = mask + lowest_bit;
+        mask = (((ripple ^ mask) >> 2) / lowest_bit) | ripple;
+      }
+    }
+
+    // All descriptors within this distance of the query have been found, so
+    // the nearest neighbor is final once it is within this distance.
+    const int max_found_distance = num_substrings * (radius + 1) - 1;
+    if (neighbor_distances[0] > max_found_distance) {
+      continue;
+    }
+    if (lowes_ratio <= 0.0 || neighbor_distances[1] <= max_found_distance) {
+      break;
+    }
+    // The second nearest neighbor is at most the one found so far, so the
+    // ratio test fails if it fails against it. Likewise, the test passes if it
+    // passes against any descriptor that has not been found yet.
+    if (neighbor_distances[0] >= lowes_ratio * neighbor_distances[1]) {
+      break;
+    }
+    if (neighbor_distances[0] < lowes_ratio * (max_found_distance + 1)) {
+      *neighbor_index = neighbor_indices[0];
+      *neighbor_distance = neighbor_distances[0];
+      return true;
+    }
+  }
+
+  *neighbor_index = neighbor_indices[0];
+  *neighbor_distance = neighbor_distances[0];
+  return lowes_ratio <= 0.0 ||
+         neighbor_distances[0] < lowes_ratio * neighbor_distances[1];
+}
+
+}  // namespace theia
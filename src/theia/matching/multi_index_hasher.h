@@ -0,0 +1,116 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_MATCHING_MULTI_INDEX_HASHER_H_
+#define THEIA_MATCHING_MULTI_INDEX_HASHER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "theia/util/util.h"
+
+namespace theia {
+class PackedBinaryDescriptors;
+
+// An exact nearest neighbor index for binary descriptors under the Hamming
+// distance. Each descriptor is split into m disjoint substrings and every
+// substring is indexed in its own hash table. By the pigeonhole principle, any
+// descriptor within a Hamming distance of m * (r + 1) - 1 of the query matches
+// the query within a distance of r in at least one substring, so the neighbors
+// are found by probing each table with all keys within an increasing radius r
+// of the query substring. The search stops as soon as the nearest neighbor
+// (and the outcome of the Lowes ratio test, if requested) is known, which is
+// after very few probes for good matches. If probing would be more expensive
+// than a linear scan then the index falls back to comparing against all
+// remaining descriptors, so the results are always identical to a brute force
+// search (ties are broken by the smaller index).
+//
+// The substring length is chosen as roughly log2 of the number of descriptors
+// so that each bucket holds few descriptors.
+//
+// Implementation is based on the paper "Fast Exact Search in Hamming Space
+// with Multi-Index Hashing" by Norouzi et al (PAMI 2014).
+class MultiIndexHasher {
+ public:
+  // The descriptors must outlive the hasher.
+  explicit MultiIndexHasher(const PackedBinaryDescriptors& descriptors);
+
+  // Finds the nearest neighbor of the query, which must be a packed
+  // descriptor with the same stride as the indexed descriptors. If lowes_ratio
+  // is positive then true is returned only if the nearest neighbor passes the
+  // Lowes ratio test, i.e. its distance is less than lowes_ratio times the
+  // distance of the second nearest neighbor (which passes trivially if only
+  // one descriptor is indexed). Otherwise, true is returned if any descriptors
+  // are indexed. This method is not thread-safe since it reuses internal
+  // scratch space.
+  bool FindNearestNeighbor(const uint8_t* query,
+                           const double lowes_ratio,
+                           int* neighbor_index,
+                           int* neighbor_distance);
+
+  int NumSubstrings() const { return tables_.size(); }
+
+ private:
+  // A hash table for one substring, stored as the sorted keys and the
+  // descriptor index of each key.
+  struct SubstringTable {
+    int first_byte;
+    int num_bytes;
+    std::vector<uint32_t> keys;
+    std::vector<int> indices;
+  };
+
+  uint32_t SubstringKey(const uint8_t* descriptor,
+                        const SubstringTable& table) const;
+
+  const PackedBinaryDescriptors& descriptors_;
+  std::vector<SubstringTable> tables_;
+
+  // The number of bits of the longest substring.
+  int max_substring_bits_;
+
+  // visited_[i] == query_id_ if descriptor i was already compared against the
+  // current query.
+  std::vector<int> visited_;
+  int query_id_;
+
+  // Scratch space for the distances of a linear scan.
+  std::vector<int> distances_;
+
+  DISALLOW_COPY_AND_ASSIGN(MultiIndexHasher);
+};
+
+}  // namespace theia
+
+#endif  // THEIA_MATCHING_MULTI_INDEX_HASHER_H_
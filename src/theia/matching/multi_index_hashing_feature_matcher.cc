@@ -0,0 +1,112 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/matching/multi_index_hashing_feature_matcher.h"
+
+#include <glog/logging.h>
+#include <vector>
+
+#include "theia/matching/feature_matcher_utils.h"
+#include "theia/matching/hamming_distance.h"
+#include "theia/matching/indexed_feature_match.h"
+#include "theia/matching/multi_index_hasher.h"
+
+namespace theia {
+
+namespace {
+
+// Finds the nearest neighbor of each query descriptor among the hashed
+// descriptors and keeps the match if it passes the Lowes ratio test.
+void MatchBinaryDescriptors(const PackedBinaryDescriptors& queries,
+                            const bool use_lowes_ratio,
+                            const double lowes_ratio,
+                            MultiIndexHasher* hasher,
+                            std::vector<IndexedFeatureMatch>* matches) {
+  // A non-positive ratio disables the ratio test of the hasher.
+  const double ratio = use_lowes_ratio ? lowes_ratio : 0.0;
+  int neighbor_index, neighbor_distance;
+  for (int i = 0; i < queries.NumDescriptors(); i++) {
+    // Add to the matches vector if lowes ratio test is turned off or it is
+    // turned on and passes the test.
+    if (hasher->FindNearestNeighbor(
+            queries.Descriptor(i), ratio, &neighbor_index, &neighbor_distance)) {
+      matches->emplace_back(i, neighbor_index, neighbor_distance);
+    }
+  }
+}
+
+}  // namespace
+
+bool MultiIndexHashingFeatureMatcher::MatchImagePair(
+    const KeypointsAndDescriptors& features1,
+    const KeypointsAndDescriptors& features2,
+    std::vector<IndexedFeatureMatch>* matches) {
+  if (features1.binary_descriptors.empty() ||
+      features2.binary_descriptors.empty()) {
+    return false;
+  }
+
+  const PackedBinaryDescriptors descriptors1(features1.binary_descriptors);
+  const PackedBinaryDescriptors descriptors2(features2.binary_descriptors);
+  CHECK_EQ(descriptors1.NumBytes(), descriptors2.NumBytes())
+      << "Binary descriptors must have the same length to be matched.";
+  matches->reserve(descriptors1.NumDescriptors());
+
+  // Compute forward matches.
+  MultiIndexHasher hasher2(descriptors2);
+  MatchBinaryDescriptors(descriptors1,
+                         this->options_.use_lowes_ratio,
+                         this->options_.lowes_ratio,
+                         &hasher2,
+                         matches);
+  if (matches->size() < this->options_.min_num_feature_matches) {
+    return false;
+  }
+
+  // Compute the symmetric matches, if applicable.
+  if (this->options_.keep_only_symmetric_matches) {
+    std::vector<IndexedFeatureMatch> reverse_matches;
+    MultiIndexHasher hasher1(descriptors1);
+    MatchBinaryDescriptors(descriptors2,
+                           this->options_.use_lowes_ratio,
+                           this->options_.lowes_ratio,
+                           &hasher1,
+                           &reverse_matches);
+    IntersectMatches(reverse_matches, matches);
+  }
+
+  return matches->size() >= this->options_.min_num_feature_matches;
+}
+
+}  // namespace theia
@@ -0,0 +1,216 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "theia/image/descriptor/binary_descriptor.h"
+#include "theia/matching/create_feature_matcher.h"
+#include "theia/matching/feature_matcher.h"
+#include "theia/matching/hamming_distance.h"
+#include "theia/matching/image_pair_match.h"
+#include "theia/matching/in_memory_features_and_matches_database.h"
+#include "theia/matching/keypoints_and_descriptors.h"
+#include "theia/matching/multi_index_hasher.h"
+#include "theia/util/random.h"
+
+#include "gtest/gtest.h"
+
+namespace theia {
+
+namespace {
+
+static const int kNumDescriptorBytes = 61;
+
+RandomNumberGenerator rng(59);
+
+BinaryVectorX RandomBinaryDescriptor(const int num_bytes) {
+  BinaryVectorX descriptor(num_bytes);
+  for (int i = 0; i < num_bytes; i++) {
+    descriptor(i) = static_cast<uint8_t>(rng.RandInt(0, 255));
+  }
+  return descriptor;
+}
+
+// Flips random bits of the descriptor.
+BinaryVectorX PerturbBinaryDescriptor(const BinaryVectorX& descriptor,
+                                      const int num_bit_flips) {
+  BinaryVectorX perturbed = descriptor;
+  for (int i = 0; i < num_bit_flips; i++) {
+    const int bit = rng.RandInt(0, 8 * descriptor.size() - 1);
+    perturbed(bit / 8) ^= static_cast<uint8_t>(1 << (bit % 8));
+  }
+  return perturbed;
+}
+
+// Creates two images such that the first few features of the second image are
+// noisy copies of features of the first image.
+void CreateFeatures(const int num_features,
+                    KeypointsAndDescriptors* features1,
+                    KeypointsAndDescriptors* features2) {
+  for (int i = 0; i < num_features; i++) {
+    features1->binary_descriptors.emplace_back(
+        RandomBinaryDescriptor(kNumDescriptorBytes));
+    features1->keypoints.emplace_back(i, 0, Keypoint::INVALID);
+  }
+  for (int i = 0; i < num_features; i++) {
+    if (i < num_features / 2) {
+      features2->binary_descriptors.emplace_back(PerturbBinaryDescriptor(
+          features1->binary_descriptors[rng.RandInt(0, num_features - 1)],
+          rng.RandInt(0, 60)));
+    } else {
+      features2->binary_descriptors.emplace_back(
+          RandomBinaryDescriptor(kNumDescriptorBytes));
+    }
+    features2->keypoints.emplace_back(i, 0, Keypoint::INVALID);
+  }
+}
+
+// Returns the nearest neighbor by a linear scan and whether it passes the
+// ratio test.
+bool FindNearestNeighborLinear(const std::vector<BinaryVectorX>& descriptors,
+                               const BinaryVectorX& query,
+                               const double lowes_ratio,
+                               int* neighbor_index,
+                               int* neighbor_distance) {
+  int best_distance = std::numeric_limits<int>::max();
+  int second_best_distance = std::numeric_limits<int>::max();
+  for (int i = 0; i < descriptors.size(); i++) {
+    const int distance = HammingDistance(query, descriptors[i]);
+    if (distance < best_distance) {
+      second_best_distance = best_distance;
+      best_distance = distance;
+      *neighbor_index = i;
+    } else if (distance < second_best_distance) {
+      second_best_distance = distance;
+    }
+  }
+  *neighbor_distance = best_distance;
+  return lowes_ratio <= 0.0 ||
+         best_distance < lowes_ratio * second_best_distance;
+}
+
+void MatchImages(const MatchingStrategy& strategy,
+                 const FeatureMatcherOptions& options,
+                 const KeypointsAndDescriptors& features1,
+                 const KeypointsAndDescriptors& features2,
+                 ImagePairMatch* match) {
+  InMemoryFeaturesAndMatchesDatabase database;
+  database.PutFeatures("1", features1);
+  database.PutFeatures("2", features2);
+
+  std::unique_ptr<FeatureMatcher> matcher =
+      CreateFeatureMatcher(strategy, options, &database);
+  matcher->AddImage("1");
+  matcher->AddImage("2");
+  matcher->MatchImages();
+
+  ASSERT_EQ(database.NumMatches(), 1);
+  *match = database.GetImagePairMatch("1", "2");
+}
+
+}  // namespace
+
+TEST(MultiIndexHasherTest, ExactNearestNeighbors) {
+  for (const int num_descriptors : {1, 2, 10, 1000, 5000}) {
+    std::vector<BinaryVectorX> descriptors(num_descriptors);
+    for (int i = 0; i < num_descriptors; i++) {
+      descriptors[i] = RandomBinaryDescriptor(kNumDescriptorBytes);
+    }
+    const PackedBinaryDescriptors packed_descriptors(descriptors);
+    MultiIndexHasher hasher(packed_descriptors);
+
+    // Query with noisy copies of the descriptors as well as random ones.
+    std::vector<BinaryVectorX> queries;
+    for (int i = 0; i < 200; i++) {
+      queries.emplace_back(PerturbBinaryDescriptor(
+          descriptors[rng.RandInt(0, num_descriptors - 1)],
+          rng.RandInt(0, 80)));
+    }
+    for (int i = 0; i < 20; i++) {
+      queries.emplace_back(RandomBinaryDescriptor(kNumDescriptorBytes));
+    }
+    const PackedBinaryDescriptors packed_queries(queries);
+
+    for (const double lowes_ratio : {0.0, 0.8}) {
+      for (int i = 0; i < queries.size(); i++) {
+        int expected_index, expected_distance, index, distance;
+        const bool expected_passes = FindNearestNeighborLinear(
+            descriptors, queries[i], lowes_ratio, &expected_index,
+            &expected_distance);
+        const bool passes = hasher.FindNearestNeighbor(
+            packed_queries.Descriptor(i), lowes_ratio, &index, &distance);
+        ASSERT_EQ(passes, expected_passes);
+        if (expected_passes) {
+          EXPECT_EQ(index, expected_index);
+          EXPECT_EQ(distance, expected_distance);
+        }
+      }
+    }
+  }
+}
+
+TEST(MultiIndexHashingFeatureMatcherTest, MatchesBruteForce) {
+  static const int kNumFeatures = 2000;
+  KeypointsAndDescriptors features1, features2;
+  CreateFeatures(kNumFeatures, &features1, &features2);
+
+  FeatureMatcherOptions options;
+  options.min_num_feature_matches = 0;
+  options.perform_geometric_verification = false;
+  for (const bool use_lowes_ratio : {false, true}) {
+    for (const bool keep_only_symmetric_matches : {false, true}) {
+      options.use_lowes_ratio = use_lowes_ratio;
+      options.keep_only_symmetric_matches = keep_only_symmetric_matches;
+
+      ImagePairMatch expected_match, match;
+      MatchImages(MatchingStrategy::BRUTE_FORCE_HAMMING,
+                  options,
+                  features1,
+                  features2,
+                  &expected_match);
+      MatchImages(MatchingStrategy::MULTI_INDEX_HASHING,
+                  options,
+                  features1,
+                  features2,
+                  &match);
+      EXPECT_GT(match.correspondences.size(), 0);
+      EXPECT_EQ(match.correspondences, expected_match.correspondences);
+    }
+  }
+}
+
+}  // namespace theia
@@ -50,6 +50,7 @@
 #include <rocksdb/filter_policy.h>
 #include <rocksdb/table.h>
 
+#include "theia/io/eigen_serializable.h"
 #include "theia/matching/image_pair_match.h"
 #include "theia/matching/keypoints_and_descriptors.h"
 #include "theia/util/filesystem.h"
@@ -63,8 +64,15 @@ using StringPair = std::pair<std::string, std::string>;
 static const std::string kFeaturesColumnFamilyName =
     "keypoints_and_descriptors";
 static const std::string kMatchesColumnFamilyName = "image_pair_matches";
+static const std::string kMatchedImagesColumnFamilyName = "matched_images";
 static const std::string kIntrinsicsColumnFamilyName =
     "camera_intrinsics_prior";
+static const std::string kGlobalDescriptorsColumnFamilyName =
+    "global_descriptors";
+// The global descriptor extractor model is stored in the default column family
+// with this key.
+static const std::string kGlobalDescriptorExtractorModelKey =
+    "global_descriptor_extractor_model";
 static const std::string kNamePairSeparator = "/";
 
 // For serialization using the Cereal library we must provide a stream for the
@@ -163,27 +171,45 @@ void RocksDbFeaturesAndMatchesDatabase::InitializeRocksDB() {
   // Take ownership of the database object.
   database_.reset(temp_db);
 
-  // If the DB is new (i.e. no existing column families are present), then we
-  // need to create the column families.
-  if (existing_column_families.empty()) {
+  // Set up the mapping for the column families that already exist in the
+  // database.
+  for (int i = 0; i < existing_column_families.size(); i++) {
+    if (existing_column_families[i] == kFeaturesColumnFamilyName) {
+      features_handle_.reset(temp_col_family_handles[i]);
+    } else if (existing_column_families[i] == kMatchesColumnFamilyName) {
+      matches_handle_.reset(temp_col_family_handles[i]);
+    } else if (existing_column_families[i] ==
+               kMatchedImagesColumnFamilyName) {
+      matched_images_handle_.reset(temp_col_family_handles[i]);
+    } else if (existing_column_families[i] == kIntrinsicsColumnFamilyName) {
+      intrinsics_prior_handle_.reset(temp_col_family_handles[i]);
+    } else if (existing_column_families[i] ==
+               kGlobalDescriptorsColumnFamilyName) {
+      global_descriptors_handle_.reset(temp_col_family_handles[i]);
+    }
+  }
+
+  // Create any column families that are not present. This is the case for new
+  // databases and for databases written before a column family was added.
+  if (!features_handle_) {
     features_handle_.reset(CreateColumnFamily(
         *options_, kFeaturesColumnFamilyName, database_.get()));
+  }
+  if (!matches_handle_) {
     matches_handle_.reset(CreateColumnFamily(
         *options_, kMatchesColumnFamilyName, database_.get()));
+  }
+  if (!matched_images_handle_) {
+    matched_images_handle_.reset(CreateColumnFamily(
+        *options_, kMatchedImagesColumnFamilyName, database_.get()));
+  }
+  if (!intrinsics_prior_handle_) {
     intrinsics_prior_handle_.reset(CreateColumnFamily(
         *options_, kIntrinsicsColumnFamilyName, database_.get()));
-  } else {
-    // Otherwise, set up the mapping for the existing column families in the
-    // database.
-    for (int i = 0; i < temp_col_family_handles.size(); i++) {
-      if (existing_column_families[i] == kFeaturesColumnFamilyName) {
-        features_handle_.reset(temp_col_family_handles[i]);
-      } else if (existing_column_families[i] == kMatchesColumnFamilyName) {
-        matches_handle_.reset(temp_col_family_handles[i]);
-      } else if (existing_column_families[i] == kIntrinsicsColumnFamilyName) {
-        intrinsics_prior_handle_.reset(temp_col_family_handles[i]);
-      }
-    }
+  }
+  if (!global_descriptors_handle_) {
+    global_descriptors_handle_.reset(CreateColumnFamily(
+        *options_, kGlobalDescriptorsColumnFamilyName, database_.get()));
   }
 }
 
@@ -295,6 +321,11 @@ KeypointsAndDescriptors RocksDbFeaturesAndMatchesDatabase::GetFeatures(
     cereal::PortableBinaryInputArchive input_archive(ins);
     input_archive(
         features.image_name, features.keypoints, features.descriptors);
+    // Features that were stored before binary descriptors were supported do
+    // not contain them.
+    if (ins.peek() != std::istream::traits_type::eof()) {
+      input_archive(features.binary_descriptors);
+    }
   }
   return features;
 }
@@ -305,8 +336,10 @@ void RocksDbFeaturesAndMatchesDatabase::PutFeatures(
   std::stringstream ss;
   {
     cereal::PortableBinaryOutputArchive output_archive(ss);
-    output_archive(
-        features.image_name, features.keypoints, features.descriptors);
+    output_archive(features.image_name,
+                   features.keypoints,
+                   features.descriptors,
+                   features.binary_descriptors);
   }
 
   rocksdb::WriteOptions options;
@@ -337,6 +370,87 @@ size_t RocksDbFeaturesAndMatchesDatabase::NumImages() {
   return static_cast<size_t>(num_images);
 }
 
+bool RocksDbFeaturesAndMatchesDatabase::ContainsGlobalDescriptor(
+    const std::string& image_name) {
+  rocksdb::ReadOptions options;
+  const rocksdb::Slice key(image_name);
+  rocksdb::PinnableSlice value;
+  const rocksdb::Status status =
+      database_->Get(options, global_descriptors_handle_.get(), key, &value);
+  return !status.IsNotFound();
+}
+
+Eigen::VectorXf RocksDbFeaturesAndMatchesDatabase::GetGlobalDescriptor(
+    const std::string& image_name) {
+  rocksdb::ReadOptions options;
+  const rocksdb::Slice key(image_name);
+  rocksdb::PinnableSlice value;
+  const rocksdb::Status status =
+      database_->Get(options, global_descriptors_handle_.get(), key, &value);
+  CHECK(!status.IsNotFound()) << "Could not find the global descriptor for "
+                              << image_name << " in the database.";
+
+  // Create a stream wrapped around the rocksdb value.
+  ZeroCopyBuffer buffer(value.data(), value.size());
+  std::istream ins(&buffer);
+
+  Eigen::VectorXf global_descriptor;
+  {
+    cereal::PortableBinaryInputArchive input_archive(ins);
+    input_archive(global_descriptor);
+  }
+  return global_descriptor;
+}
+
+void RocksDbFeaturesAndMatchesDatabase::PutGlobalDescriptor(
+    const std::string& image_name, const Eigen::VectorXf& global_descriptor) {
+  std::stringstream ss;
+  {
+    cereal::PortableBinaryOutputArchive output_archive(ss);
+    output_archive(global_descriptor);
+  }
+
+  rocksdb::WriteOptions options;
+  const rocksdb::Slice key(image_name);
+  const rocksdb::Status status =
+      database_->Put(options, global_descriptors_handle_.get(), key, ss.str());
+  CHECK(status.ok()) << "Could not insert the global descriptor for "
+                     << image_name << " into the database.";
+}
+
+std::vector<std::string>
+RocksDbFeaturesAndMatchesDatabase::ImageNamesOfGlobalDescriptors() {
+  std::vector<std::string> image_names;
+  std::unique_ptr<rocksdb::Iterator> it(database_->NewIterator(
+      rocksdb::ReadOptions(), global_descriptors_handle_.get()));
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    image_names.push_back(it->key().ToString());
+  }
+  return image_names;
+}
+
+bool RocksDbFeaturesAndMatchesDatabase::GetGlobalDescriptorExtractorModel(
+    std::string* serialized_model) {
+  const rocksdb::Status status =
+      database_->Get(rocksdb::ReadOptions(),
+                     database_->DefaultColumnFamily(),
+                     kGlobalDescriptorExtractorModelKey,
+                     CHECK_NOTNULL(serialized_model));
+  return status.ok() && !serialized_model->empty();
+}
+
+void RocksDbFeaturesAndMatchesDatabase::PutGlobalDescriptorExtractorModel(
+    const std::string& serialized_model) {
+  const rocksdb::Status status =
+      database_->Put(rocksdb::WriteOptions(),
+                     database_->DefaultColumnFamily(),
+                     kGlobalDescriptorExtractorModelKey,
+                     serialized_model);
+  CHECK(status.ok())
+      << "Could not insert the global descriptor extractor model into the "
+         "database.";
+}
+
 // Get the image pair match for the images.
 ImagePairMatch RocksDbFeaturesAndMatchesDatabase::GetImagePairMatch(
     const std::string& image_name1, const std::string& image_name2) {
@@ -405,6 +519,27 @@ size_t RocksDbFeaturesAndMatchesDatabase::NumMatches() {
   return static_cast<size_t>(num_matches);
 }
 
+bool RocksDbFeaturesAndMatchesDatabase::ContainsMatchedImage(
+    const std::string& image_name) {
+  rocksdb::ReadOptions options;
+  const rocksdb::Slice key(image_name);
+  rocksdb::PinnableSlice value;
+  const rocksdb::Status status =
+      database_->Get(options, matched_images_handle_.get(), key, &value);
+  return !status.IsNotFound();
+}
+
+// The matched images are stored as keys without values.
+void RocksDbFeaturesAndMatchesDatabase::PutMatchedImage(
+    const std::string& image_name) {
+  rocksdb::WriteOptions options;
+  const rocksdb::Slice key(image_name);
+  const rocksdb::Status status =
+      database_->Put(options, matched_images_handle_.get(), key, "");
+  CHECK(status.ok()) << "Could not insert the matched image " << image_name
+                     << " into the database.";
+}
+
 void RocksDbFeaturesAndMatchesDatabase::RemoveAllMatches() {
   // Drop the column family handle -- this deletes all key/values in the column
   // family.
@@ -413,6 +548,11 @@ void RocksDbFeaturesAndMatchesDatabase::RemoveAllMatches() {
   // Add the column family back again.
   matches_handle_.reset(
       CreateColumnFamily(*options_, kMatchesColumnFamilyName, database_.get()));
+
+  // Without their matches, the images must be matched again.
+  database_->DropColumnFamily(matched_images_handle_.get());
+  matched_images_handle_.reset(CreateColumnFamily(
+      *options_, kMatchedImagesColumnFamilyName, database_.get()));
 }
 
 }  // namespace theia
@@ -93,6 +93,22 @@ class RocksDbFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
   std::vector<std::string> ImageNamesOfFeatures() override;
   size_t NumImages() override;
 
+  bool ContainsGlobalDescriptor(const std::string& image_name) override;
+
+  // Get/set the global image descriptor for the image.
+  Eigen::VectorXf GetGlobalDescriptor(const std::string& image_name) override;
+  void PutGlobalDescriptor(const std::string& image_name,
+                           const Eigen::VectorXf& global_descriptor) override;
+
+  // Supply an iterator to iterate over the global descriptors.
+  std::vector<std::string> ImageNamesOfGlobalDescriptors() override;
+
+  // Get/set the serialized model of the global descriptor extractor.
+  bool GetGlobalDescriptorExtractorModel(
+      std::string* serialized_model) override;
+  void PutGlobalDescriptorExtractorModel(
+      const std::string& serialized_model) override;
+
   // Get the image pair match for the images.Returns true if the features exist
   // in the database and false otherwise.
   ImagePairMatch GetImagePairMatch(const std::string& image_name1,
@@ -107,6 +123,10 @@ class RocksDbFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
       override;
   size_t NumMatches() override;
 
+  // Get/set whether the image has been matched to the other images.
+  bool ContainsMatchedImage(const std::string& image_name) override;
+  void PutMatchedImage(const std::string& image_name) override;
+
   void RemoveAllMatches() override;
 
  private:
@@ -120,6 +140,8 @@ class RocksDbFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
   std::unique_ptr<rocksdb::ColumnFamilyHandle> intrinsics_prior_handle_;
   std::unique_ptr<rocksdb::ColumnFamilyHandle> features_handle_;
   std::unique_ptr<rocksdb::ColumnFamilyHandle> matches_handle_;
+  std::unique_ptr<rocksdb::ColumnFamilyHandle> matched_images_handle_;
+  std::unique_ptr<rocksdb::ColumnFamilyHandle> global_descriptors_handle_;
 };
 }  // namespace theia
 #endif  // THEIA_MATCHING_LOCAL_FEATURES_AND_MATCHES_DATABASE_H_
@@ -60,6 +60,40 @@ TEST(RocksDbFeaturesAndMatchesDatabase, PutFeature) {
   rocksdb::DestroyDB(db_directory, rocksdb::Options());
 }
 
+TEST(RocksDbFeaturesAndMatchesDatabase, PutBinaryFeature) {
+  static const std::string kImageName = "image_name";
+  static const int kNumFeatures = 1000;
+  static const int kNumBytes = 61;
+
+  // Create some features with binary descriptors.
+  KeypointsAndDescriptors features;
+  features.keypoints.resize(kNumFeatures);
+  features.binary_descriptors.resize(kNumFeatures);
+  for (int i = 0; i < kNumFeatures; i++) {
+    features.keypoints[i] = Keypoint(i, i + 1, Keypoint::AKAZE);
+    features.binary_descriptors[i] = BinaryVectorX::Random(kNumBytes);
+  }
+
+  RocksDbFeaturesAndMatchesDatabase db(db_directory);
+
+  // Add the features.
+  db.PutFeatures(kImageName, features);
+
+  // Get the features and ensure they are correct.
+  const KeypointsAndDescriptors db_features = db.GetFeatures(kImageName);
+  ASSERT_EQ(db_features.keypoints.size(), kNumFeatures);
+  EXPECT_EQ(db_features.descriptors.size(), 0);
+  ASSERT_EQ(db_features.binary_descriptors.size(), kNumFeatures);
+  for (int i = 0; i < kNumFeatures; i++) {
+    EXPECT_EQ(db_features.keypoints[i].x(), features.keypoints[i].x());
+    EXPECT_EQ(db_features.keypoints[i].y(), features.keypoints[i].y());
+    EXPECT_EQ(db_features.binary_descriptors[i],
+              features.binary_descriptors[i]);
+  }
+
+  rocksdb::DestroyDB(db_directory, rocksdb::Options());
+}
+
 TEST(RocksDbFeaturesAndMatchesDatabase, GetFeatureFromInputDB) {
   static const std::string kImageName = "image_name";
   static const int kNumFeatures = 1000;
@@ -150,6 +184,69 @@ TEST(RocksDbFeaturesAndMatchesDatabase, ImageNames) {
   rocksdb::DestroyDB(db_directory, rocksdb::Options());
 }
 
+TEST(RocksDbFeaturesAndMatchesDatabase, GlobalDescriptorsFromInputDB) {
+  static const std::string kImageName = "image_name";
+  static const std::string kModel = "serialized global descriptor model";
+  static const int kGlobalDescriptorSize = 4096;
+
+  const Eigen::VectorXf global_descriptor =
+      Eigen::VectorXf::Random(kGlobalDescriptorSize);
+  {
+    RocksDbFeaturesAndMatchesDatabase db(db_directory);
+    std::string model;
+    EXPECT_FALSE(db.GetGlobalDescriptorExtractorModel(&model));
+    EXPECT_FALSE(db.ContainsGlobalDescriptor(kImageName));
+
+    db.PutGlobalDescriptorExtractorModel(kModel);
+    db.PutGlobalDescriptor(kImageName, global_descriptor);
+    // Database closes when it goes out of scope.
+  }
+
+  {
+    // Open the DB again and ensure it can retreive the model and descriptor.
+    RocksDbFeaturesAndMatchesDatabase db(db_directory);
+    std::string model;
+    EXPECT_TRUE(db.GetGlobalDescriptorExtractorModel(&model));
+    EXPECT_EQ(model, kModel);
+
+    EXPECT_TRUE(db.ContainsGlobalDescriptor(kImageName));
+    EXPECT_EQ(db.GetGlobalDescriptor(kImageName), global_descriptor);
+    const std::vector<std::string> image_names =
+        db.ImageNamesOfGlobalDescriptors();
+    ASSERT_EQ(image_names.size(), 1);
+    EXPECT_EQ(image_names[0], kImageName);
+
+    // Putting an empty model clears the stored model.
+    db.PutGlobalDescriptorExtractorModel("");
+    EXPECT_FALSE(db.GetGlobalDescriptorExtractorModel(&model));
+  }
+
+  rocksdb::DestroyDB(db_directory, rocksdb::Options());
+}
+
+TEST(RocksDbFeaturesAndMatchesDatabase, MatchedImagesFromInputDB) {
+  static const std::string kImageName = "image_name";
+
+  {
+    RocksDbFeaturesAndMatchesDatabase db(db_directory);
+    EXPECT_FALSE(db.ContainsMatchedImage(kImageName));
+    db.PutMatchedImage(kImageName);
+    // Database closes when it goes out of scope.
+  }
+
+  {
+    // Open the DB again and ensure the image is still recorded as matched.
+    RocksDbFeaturesAndMatchesDatabase db(db_directory);
+    EXPECT_TRUE(db.ContainsMatchedImage(kImageName));
+
+    // Removing the matches requires the images to be matched again.
+    db.RemoveAllMatches();
+    EXPECT_FALSE(db.ContainsMatchedImage(kImageName));
+  }
+
+  rocksdb::DestroyDB(db_directory, rocksdb::Options());
+}
+
 TEST(RocksDbFeaturesAndMatchesDatabase, PutMatch) {}
 
 TEST(RocksDbFeaturesAndMatchesDatabase, GetMatchFromInputDB) {}
@@ -37,16 +37,31 @@
 
 #include <Eigen/Cholesky>
 #include <Eigen/Core>
+#include <Eigen/SparseCore>
 #include <glog/logging.h>
 
 #include <algorithm>
 #include <string>
 
+#include "theia/math/matrix/conjugate_gradient.h"
+#include "theia/math/matrix/linear_operator.h"
 #include "theia/math/matrix/sparse_cholesky_llt.h"
 #include "theia/util/stringprintf.h"
 
 namespace theia {
 
+// The linear solver used for the x-update of the L1 solver.
+enum class L1SolverLinearSolverType {
+  // Factorize A^t * A once with a sparse Cholesky decomposition and reuse the
+  // factorization for every iteration.
+  SPARSE_CHOLESKY = 0,
+
+  // Solve the normal equations with matrix-free preconditioned conjugate
+  // gradients, warm started from the previous iterate. This avoids forming
+  // and factorizing A^t * A entirely.
+  CONJUGATE_GRADIENT = 1
+};
+
 // These are template overrides that allow the sparse linear solvers to work
 // with sparse or dense matrices. The sparseView() method is not implemented for
 // Eigen::SparseMatrix.
@@ -62,6 +77,45 @@ inline void Compute(const Eigen::MatrixXd& spd_mat,
   linear_solver->Compute(spd_mat.sparseView());
 }
 
+// Returns the diagonal of A^t * A.
+inline Eigen::VectorXd ColumnSquaredNorms(
+    const Eigen::SparseMatrix<double>& mat) {
+  Eigen::VectorXd squared_norms(mat.cols());
+  for (int i = 0; i < mat.cols(); i++) {
+    squared_norms(i) = mat.col(i).squaredNorm();
+  }
+  return squared_norms;
+}
+
+inline Eigen::VectorXd ColumnSquaredNorms(const Eigen::MatrixXd& mat) {
+  return mat.colwise().squaredNorm().transpose();
+}
+
+// A linear operator view of a dense or sparse Eigen matrix.
+template <class MatrixType>
+class MatrixLinearOperator : public LinearOperator {
+ public:
+  explicit MatrixLinearOperator(const MatrixType& matrix) : matrix_(matrix) {}
+
+  // y = y + Ax;
+  void RightMultiply(const Eigen::VectorXd& x,
+                     Eigen::VectorXd* y) const override {
+    y->noalias() += matrix_ * x;
+  }
+
+  // y = y + A'x;
+  void LeftMultiply(const Eigen::VectorXd& x,
+                    Eigen::VectorXd* y) const override {
+    y->noalias() += matrix_.transpose() * x;
+  }
+
+  int num_rows() const override { return matrix_.rows(); }
+  int num_cols() const override { return matrix_.cols(); }
+
+ private:
+  const MatrixType& matrix_;
+};
+
 }  // namespace l1_solver_internal
 
 // An L1 norm approximation solver. This class will attempt to solve the
@@ -95,10 +149,33 @@ class L1Solver {
 
     double absolute_tolerance = 1e-4;
     double relative_tolerance = 1e-2;
+
+    // If true, rho is adapted with the residual balancing scheme of Boyd et al.
+    // (Section 3.4.1): rho is scaled by rho_scale whenever the primal residual
+    // is more than rho_balance_ratio times larger than the dual residual (or
+    // vice versa). Since the x-update of the L1 problem does not depend on rho,
+    // this does not require refactorizing the linear system.
+    bool adaptive_rho = false;
+    double rho_balance_ratio = 10.0;
+    double rho_scale = 2.0;
+
+    // The linear solver used for the x-update.
+    L1SolverLinearSolverType linear_solver_type =
+        L1SolverLinearSolverType::SPARSE_CHOLESKY;
+
+    // Options for the conjugate gradient solver. Only used when the linear
+    // solver type is CONJUGATE_GRADIENT.
+    ConjugateGradientOptions conjugate_gradient_options;
   };
 
   L1Solver(const Options& options, const MatrixType& mat)
-      : options_(options), a_(mat) {
+      : options_(options), a_(mat), a_operator_(a_), rho_(options.rho) {
+    if (options_.linear_solver_type ==
+        L1SolverLinearSolverType::CONJUGATE_GRADIENT) {
+      normal_equations_diagonal_ = l1_solver_internal::ColumnSquaredNorms(a_);
+      return;
+    }
+
     // Analyze the sparsity pattern once. Only the values of the entries will be
     // changed with each iteration.
     const MatrixType spd_mat = a_.transpose() * a_;
@@ -116,13 +193,51 @@ class L1Solver {
   //        min   1 * y
   //   s.t. [  A   -I ] [ x ] < [  b ]
   //        [ -A   -I ] [ y ]   [ -b ]
-  // which is an equivalent linear program.
+  // which is an equivalent linear program. The ADMM state is reset before
+  // solving.
   void Solve(const Eigen::VectorXd& rhs, Eigen::VectorXd* solution) {
+    z_.setZero(a_.rows());
+    u_.setZero(a_.rows());
+    rho_ = options_.rho;
+    RunADMM(rhs, solution);
+  }
+
+  // Same as Solve, but continues from the ADMM state (the auxiliary variable z,
+  // the scaled dual variable u, and rho) left by the previous call to Solve,
+  // WarmStartSolve, or InitializeFromResidual. This is useful when solving a
+  // sequence of closely related problems, such as the linearized problems of
+  // an iteratively relinearized L1 minimization where b is the current
+  // residual and x is the update step.
+  void WarmStartSolve(const Eigen::VectorXd& rhs, Eigen::VectorXd* solution) {
+    if (z_.size() != a_.rows()) {
+      Solve(rhs, solution);
+      return;
+    }
+    RunADMM(rhs, solution);
+  }
+
+  // Initializes the ADMM state from the residual A * x - b of a known
+  // (approximate) solution x. This should be followed by a call to
+  // WarmStartSolve. ADMM then starts close to the known solution instead of
+  // first moving to the least-squares solution, which is far from the L1
+  // solution when there are outliers.
+  void InitializeFromResidual(const Eigen::VectorXd& residual) {
+    CHECK_EQ(residual.size(), a_.rows());
+    rho_ = options_.rho;
+    z_ = residual;
+    // The scaled dual variable is a subgradient of |z| divided by rho.
+    u_ = (rho_ * residual).array().max(-1.0).min(1.0) / rho_;
+  }
+
+  // The current value of the augmented Lagrangian parameter.
+  double rho() const { return rho_; }
+
+ private:
+  void RunADMM(const Eigen::VectorXd& rhs, Eigen::VectorXd* solution) {
     CHECK_NOTNULL(solution);
     Eigen::VectorXd& x = *solution;
-    Eigen::VectorXd z(a_.rows()), u(a_.rows());
-    z.setZero();
-    u.setZero();
+    Eigen::VectorXd& z = z_;
+    Eigen::VectorXd& u = u_;
 
     Eigen::VectorXd a_times_x(a_.rows()), z_old(z.size()), ax_hat(a_.rows());
     // Precompute some convergence terms.
@@ -137,8 +252,7 @@ class L1Solver {
         "  % 4d     % 4.4e     % 4.4e     % 4.4e     % 4.4e";
     for (int i = 0; i < options_.max_num_iterations; i++) {
       // Update x.
-      x.noalias() = linear_solver_.Solve(a_.transpose() * (rhs + z - u));
-      if (linear_solver_.Info() != Eigen::Success) {
+      if (!SolveNormalEquations(a_.transpose() * (rhs + z - u), &x)) {
         LOG(ERROR) << "L1 Minimization failed. Could not solve the sparse "
                       "linear system with Cholesky Decomposition";
         return;
@@ -150,7 +264,7 @@ class L1Solver {
 
       // Update z and set z_old.
       std::swap(z, z_old);
-      z.noalias() = Shrinkage(ax_hat - rhs + u, 1.0 / options_.rho);
+      z.noalias() = Shrinkage(ax_hat - rhs + u, 1.0 / rho_);
 
       // Update u.
       u.noalias() += ax_hat - z - rhs;
@@ -158,14 +272,14 @@ class L1Solver {
       // Compute the convergence terms.
       const double r_norm = (a_times_x - z - rhs).norm();
       const double s_norm =
-          (-options_.rho * a_.transpose() * (z - z_old)).norm();
+          (-rho_ * a_.transpose() * (z - z_old)).norm();
       const double max_norm =
           std::max({a_times_x.norm(), z.norm(), rhs_norm});
       const double primal_eps =
           primal_abs_tolerance_eps + options_.relative_tolerance * max_norm;
       const double dual_eps = dual_abs_tolerance_eps +
                  options_.relative_tolerance *
-                     (options_.rho * a_.transpose() * u).norm();
+                     (rho_ * a_.transpose() * u).norm();
 
       // Log the result to the screen.
       VLOG(2) << StringPrintf(row_format.c_str(), i, r_norm, s_norm, primal_eps,
@@ -174,19 +288,55 @@ class L1Solver {
       if (r_norm < primal_eps && s_norm < dual_eps) {
         break;
       }
+
+      // Balance the primal and dual residuals. The scaled dual variable must be
+      // rescaled whenever rho changes.
+      if (options_.adaptive_rho) {
+        if (r_norm > options_.rho_balance_ratio * s_norm) {
+          rho_ *= options_.rho_scale;
+          u /= options_.rho_scale;
+        } else if (s_norm > options_.rho_balance_ratio * r_norm) {
+          rho_ /= options_.rho_scale;
+          u *= options_.rho_scale;
+        }
+      }
     }
   }
 
- private:
+  // Solves A^t * A * x = rhs with the chosen linear solver. The input value of
+  // x is used as the initial guess for iterative solvers.
+  bool SolveNormalEquations(const Eigen::VectorXd& rhs, Eigen::VectorXd* x) {
+    if (options_.linear_solver_type ==
+        L1SolverLinearSolverType::CONJUGATE_GRADIENT) {
+      SolveNormalEquationsWithConjugateGradient(
+          options_.conjugate_gradient_options, a_operator_,
+          normal_equations_diagonal_, rhs, x);
+      return true;
+    }
+
+    x->noalias() = linear_solver_.Solve(rhs);
+    return linear_solver_.Info() == Eigen::Success;
+  }
+
   Options options_;
 
   // Matrix A where || Ax - b ||_1 is the problem we are solving.
   MatrixType a_;
+  l1_solver_internal::MatrixLinearOperator<MatrixType> a_operator_;
 
   // Cholesky linear solver. Since our linear system will be a SPD matrix we can
   // utilize the Cholesky factorization.
   SparseCholeskyLLt linear_solver_;
 
+  // The diagonal of A^t * A, used to precondition the conjugate gradient
+  // solver.
+  Eigen::VectorXd normal_equations_diagonal_;
+
+  // The ADMM state. This is kept between calls so that the solver may be warm
+  // started.
+  Eigen::VectorXd z_, u_;
+  double rho_;
+
   Eigen::VectorXd Shrinkage(const Eigen::VectorXd& vec, const double kappa) {
     Eigen::ArrayXd zero_vec(vec.size());
     zero_vec.setZero();
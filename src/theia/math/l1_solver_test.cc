@@ -50,7 +50,7 @@ namespace theia {
 //
 // For this problem, the L1 minimization should result in
 // x = [-0.75, 1.0, 0.0]^t.
-TEST(L1Solver, SmallProblem) {
+void TestSmallProblem(const L1Solver<Eigen::MatrixXd>::Options& options) {
   static const double kTolerance = 1e-8;
 
   Eigen::MatrixXd lhs(4, 3);
@@ -70,8 +70,6 @@ TEST(L1Solver, SmallProblem) {
   solution.setZero();
 
   // Recover the code word.
-  L1Solver<Eigen::MatrixXd>::Options options;
-  options.max_num_iterations = 100;
   L1Solver<Eigen::MatrixXd> l1_solver(options, lhs);
   l1_solver.Solve(rhs, &solution);
 
@@ -88,6 +86,27 @@ TEST(L1Solver, SmallProblem) {
   }
 }
 
+TEST(L1Solver, SmallProblem) {
+  L1Solver<Eigen::MatrixXd>::Options options;
+  options.max_num_iterations = 100;
+  TestSmallProblem(options);
+}
+
+TEST(L1Solver, SmallProblemConjugateGradient) {
+  L1Solver<Eigen::MatrixXd>::Options options;
+  options.max_num_iterations = 100;
+  options.linear_solver_type = L1SolverLinearSolverType::CONJUGATE_GRADIENT;
+  options.conjugate_gradient_options.relative_tolerance = 1e-12;
+  TestSmallProblem(options);
+}
+
+TEST(L1Solver, SmallProblemAdaptiveRho) {
+  L1Solver<Eigen::MatrixXd>::Options options;
+  options.max_num_iterations = 100;
+  options.adaptive_rho = true;
+  TestSmallProblem(options);
+}
+
 // This example is taken from the L1-magic library. It is formulated as a
 // codeword recovery problem.
 TEST(L1Solver, Decoding) {
@@ -132,4 +151,48 @@ TEST(L1Solver, Decoding) {
 
 }
 
+// Warm starting from the solution should converge much faster than solving
+// from scratch.
+TEST(L1Solver, WarmStartFromSolution) {
+  RandomNumberGenerator rng(94);
+  static const double kTolerance = 1e-8;
+
+  static const int source_length = 64;
+  static const int codeword_length = 4 * source_length;
+  static const int num_pertubations = 0.2 * codeword_length;
+
+  Eigen::MatrixXd mat(codeword_length, source_length);
+  rng.SetRandom(&mat);
+  Eigen::VectorXd source_word(source_length);
+  rng.SetRandom(&source_word);
+  Eigen::VectorXd observation = mat * source_word;
+  for (int i = 0; i < num_pertubations; i++) {
+    observation(rng.RandInt(0, observation.size() - 1)) = rng.RandDouble(-1, 1);
+  }
+
+  // Solve with a small iteration budget from scratch and warm started from
+  // the known solution.
+  L1Solver<Eigen::MatrixXd>::Options options;
+  options.absolute_tolerance = 1e-10;
+  options.relative_tolerance = 1e-10;
+  options.max_num_iterations = 10;
+  L1Solver<Eigen::MatrixXd> cold_l1_solver(options, mat);
+  Eigen::VectorXd cold_solution = source_word;
+  cold_l1_solver.Solve(observation, &cold_solution);
+
+  L1Solver<Eigen::MatrixXd> warm_l1_solver(options, mat);
+  warm_l1_solver.InitializeFromResidual(mat * source_word - observation);
+  Eigen::VectorXd warm_solution = source_word;
+  warm_l1_solver.WarmStartSolve(observation, &warm_solution);
+  EXPECT_LT((warm_solution - source_word).norm(),
+            (cold_solution - source_word).norm());
+
+  // Continuing the warm started solve should recover the solution.
+  warm_l1_solver.SetMaxIterations(200);
+  warm_l1_solver.WarmStartSolve(observation, &warm_solution);
+  for (int i = 0; i < source_length; i++) {
+    EXPECT_NEAR(warm_solution(i), source_word(i), kTolerance);
+  }
+}
+
 }  // namespace theia
@@ -0,0 +1,108 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/math/matrix/conjugate_gradient.h"
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+#include "theia/math/matrix/linear_operator.h"
+
+namespace theia {
+
+int SolveNormalEquationsWithConjugateGradient(
+    const ConjugateGradientOptions& options,
+    const LinearOperator& a,
+    const Eigen::VectorXd& normal_equations_diagonal,
+    const Eigen::VectorXd& rhs,
+    Eigen::VectorXd* x) {
+  CHECK_NOTNULL(x);
+  CHECK_EQ(rhs.size(), a.num_cols());
+  CHECK_EQ(normal_equations_diagonal.size(), a.num_cols());
+  if (x->size() != a.num_cols()) {
+    x->setZero(a.num_cols());
+  }
+
+  const double rhs_norm = rhs.norm();
+  if (rhs_norm == 0.0) {
+    x->setZero();
+    return 0;
+  }
+
+  // Columns with no entries do not constrain the solution, so they are left
+  // unpreconditioned.
+  const Eigen::VectorXd inverse_diagonal =
+      (normal_equations_diagonal.array() > 0.0)
+          .select(normal_equations_diagonal.array().inverse(), 1.0);
+
+  // r = rhs - A^t * A * x.
+  Eigen::VectorXd a_times_p = Eigen::VectorXd::Zero(a.num_rows());
+  Eigen::VectorXd q = Eigen::VectorXd::Zero(a.num_cols());
+  a.RightMultiply(*x, &a_times_p);
+  a.LeftMultiply(a_times_p, &q);
+  Eigen::VectorXd r = rhs - q;
+  Eigen::VectorXd z = inverse_diagonal.cwiseProduct(r);
+  Eigen::VectorXd p = z;
+  double r_dot_z = r.dot(z);
+
+  const double tolerance = options.relative_tolerance * rhs_norm;
+  int i = 0;
+  for (; i < options.max_num_iterations; i++) {
+    if (r.norm() <= tolerance) {
+      break;
+    }
+
+    // q = A^t * A * p. Note that p^t * q = ||A * p||^2.
+    a_times_p.setZero();
+    q.setZero();
+    a.RightMultiply(p, &a_times_p);
+    a.LeftMultiply(a_times_p, &q);
+    const double p_dot_q = a_times_p.squaredNorm();
+    if (p_dot_q <= 0.0) {
+      break;
+    }
+
+    const double alpha = r_dot_z / p_dot_q;
+    *x += alpha * p;
+    r -= alpha * q;
+
+    z = inverse_diagonal.cwiseProduct(r);
+    const double r_dot_z_new = r.dot(z);
+    p = z + (r_dot_z_new / r_dot_z) * p;
+    r_dot_z = r_dot_z_new;
+  }
+  return i;
+}
+
+}  // namespace theia
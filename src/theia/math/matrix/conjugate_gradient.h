@@ -0,0 +1,68 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_MATH_MATRIX_CONJUGATE_GRADIENT_H_
+#define THEIA_MATH_MATRIX_CONJUGATE_GRADIENT_H_
+
+#include <Eigen/Core>
+
+namespace theia {
+class LinearOperator;
+
+struct ConjugateGradientOptions {
+  // Maximum number of conjugate gradient iterations to perform.
+  int max_num_iterations = 50;
+
+  // The solver terminates when the norm of the residual falls below
+  // relative_tolerance times the norm of the right hand side.
+  double relative_tolerance = 1e-6;
+};
+
+// Solves the normal equations A^t * A * x = rhs with the preconditioned
+// conjugate gradient method. The matrix A is only accessed through
+// matrix-vector products, so A^t * A is never formed explicitly. The diagonal
+// of A^t * A is used as a Jacobi preconditioner. The input value of x is used
+// as the initial guess, which makes this well suited for sequences of closely
+// related systems (e.g. inside ADMM). Returns the number of iterations that
+// were performed.
+int SolveNormalEquationsWithConjugateGradient(
+    const ConjugateGradientOptions& options,
+    const LinearOperator& a,
+    const Eigen::VectorXd& normal_equations_diagonal,
+    const Eigen::VectorXd& rhs,
+    Eigen::VectorXd* x);
+
+}  // namespace theia
+
+#endif  // THEIA_MATH_MATRIX_CONJUGATE_GRADIENT_H_
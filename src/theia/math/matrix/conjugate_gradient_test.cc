@@ -0,0 +1,131 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <Eigen/LU>
+#include <Eigen/SparseCore>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/math/matrix/conjugate_gradient.h"
+#include "theia/math/matrix/sparse_matrix.h"
+#include "theia/util/random.h"
+
+namespace theia {
+
+namespace {
+
+RandomNumberGenerator rng(52);
+
+// Returns a random sparse matrix with num_entries_per_row nonzero entries in
+// each row.
+Eigen::SparseMatrix<double> RandomSparseMatrix(const int rows,
+                                               const int cols,
+                                               const int num_entries_per_row) {
+  std::vector<Eigen::Triplet<double> > triplets;
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < num_entries_per_row; j++) {
+      triplets.emplace_back(i, rng.RandInt(0, cols - 1), rng.RandDouble(-1, 1));
+    }
+  }
+  Eigen::SparseMatrix<double> mat(rows, cols);
+  mat.setFromTriplets(triplets.begin(), triplets.end());
+  return mat;
+}
+
+Eigen::VectorXd NormalEquationsDiagonal(
+    const Eigen::SparseMatrix<double>& mat) {
+  Eigen::VectorXd diagonal(mat.cols());
+  for (int i = 0; i < mat.cols(); i++) {
+    diagonal(i) = mat.col(i).squaredNorm();
+  }
+  return diagonal;
+}
+
+}  // namespace
+
+TEST(ConjugateGradient, SolvesNormalEquations) {
+  static const double kTolerance = 1e-6;
+  static const int kNumRows = 400;
+  static const int kNumCols = 100;
+  static const int kNumEntriesPerRow = 5;
+
+  const Eigen::SparseMatrix<double> sparse_mat =
+      RandomSparseMatrix(kNumRows, kNumCols, kNumEntriesPerRow);
+  const SparseMatrix mat(sparse_mat);
+  Eigen::VectorXd b(kNumRows);
+  rng.SetRandom(&b);
+
+  const Eigen::MatrixXd dense_mat(sparse_mat);
+  const Eigen::VectorXd rhs = dense_mat.transpose() * b;
+  const Eigen::VectorXd expected_x =
+      (dense_mat.transpose() * dense_mat).lu().solve(rhs);
+
+  ConjugateGradientOptions options;
+  options.max_num_iterations = 1000;
+  options.relative_tolerance = 1e-12;
+  Eigen::VectorXd x = Eigen::VectorXd::Zero(kNumCols);
+  const int num_iterations = SolveNormalEquationsWithConjugateGradient(
+      options, mat, NormalEquationsDiagonal(sparse_mat), rhs, &x);
+  EXPECT_LT(num_iterations, options.max_num_iterations);
+
+  for (int i = 0; i < kNumCols; i++) {
+    EXPECT_NEAR(x(i), expected_x(i), kTolerance);
+  }
+}
+
+TEST(ConjugateGradient, WarmStartFromSolution) {
+  static const int kNumRows = 400;
+  static const int kNumCols = 100;
+  static const int kNumEntriesPerRow = 5;
+
+  const Eigen::SparseMatrix<double> sparse_mat =
+      RandomSparseMatrix(kNumRows, kNumCols, kNumEntriesPerRow);
+  const SparseMatrix mat(sparse_mat);
+  Eigen::VectorXd expected_x(kNumCols);
+  rng.SetRandom(&expected_x);
+  const Eigen::VectorXd rhs =
+      sparse_mat.transpose() * (sparse_mat * expected_x);
+
+  // Starting from the solution should not require any iterations.
+  ConjugateGradientOptions options;
+  Eigen::VectorXd x = expected_x;
+  EXPECT_EQ(SolveNormalEquationsWithConjugateGradient(
+                options, mat, NormalEquationsDiagonal(sparse_mat), rhs, &x),
+            0);
+  EXPECT_LT((x - expected_x).norm(), 1e-12);
+}
+
+}  // namespace theia
@@ -35,6 +35,7 @@
 #ifndef THEIA_MATH_RESERVOIR_SAMPLER_H_
 #define THEIA_MATH_RESERVOIR_SAMPLER_H_
 
+#include <memory>
 #include <vector>
 
 #include <theia/util/random.h>
@@ -52,12 +53,19 @@ namespace theia {
 template <typename ElementType>
 class ReservoirSampler {
  public:
-  // TODO(sweeneychris): Add a constructor to set the RNG or the seed.
-
   // The number of elements we would like to sample from the entire sequence.
-  explicit ReservoirSampler(const int num_elements_to_sample)
+  // If rng is not supplied, a random number generator seeded from the time is
+  // used.
+  explicit ReservoirSampler(
+      const int num_elements_to_sample,
+      const std::shared_ptr<RandomNumberGenerator>& rng = nullptr)
       : num_elements_to_sample_(num_elements_to_sample),
         num_elements_added_(0) {
+    if (rng.get() == nullptr) {
+      rng_ = std::make_shared<RandomNumberGenerator>();
+    } else {
+      rng_ = rng;
+    }
     randomly_sampled_elements_.reserve(num_elements_to_sample_);
   }
 
@@ -76,7 +84,7 @@ class ReservoirSampler {
       // where N is the number of elements added so far, but this version avoids
       // costly division operators for each sample.
       const int modified_sample_probability =
-          rng_.RandInt(0, num_elements_added_);
+          rng_->RandInt(0, num_elements_added_);
       if (modified_sample_probability < num_elements_to_sample_) {
         randomly_sampled_elements_[modified_sample_probability] = element;
       }
@@ -98,7 +106,7 @@ class ReservoirSampler {
   // The number of elements currently added to the sampler. This informs how to
   // probabilistically sample new data as it is added.
   int num_elements_added_;
-  RandomNumberGenerator rng_;
+  std::shared_ptr<RandomNumberGenerator> rng_;
 
   // The current random sampling of elements.
   std::vector<ElementType> randomly_sampled_elements_;
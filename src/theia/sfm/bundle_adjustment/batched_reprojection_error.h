@@ -0,0 +1,133 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_SFM_BUNDLE_ADJUSTMENT_BATCHED_REPROJECTION_ERROR_H_
+#define THEIA_SFM_BUNDLE_ADJUSTMENT_BATCHED_REPROJECTION_ERROR_H_
+
+#include <ceres/ceres.h>
+#include <ceres/evaluation_callback.h>
+#include <glog/logging.h>
+#include <algorithm>
+
+#include "theia/sfm/bundle_adjustment/pinhole_reprojection_error_batch.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera/pinhole_camera_model.h"
+
+namespace theia {
+
+// A reprojection error cost function whose residuals and Jacobians are read
+// from a PinholeReprojectionErrorBatch rather than computed when Ceres asks for
+// them. The batch must be evaluated at the current parameters before Ceres
+// evaluates the cost function; this is done by attaching the
+// ReprojectionErrorBatchEvaluationCallback below to the problem or solver.
+class BatchedReprojectionError
+    : public ceres::SizedCostFunction<
+          PinholeReprojectionErrorBatch::kResidualSize,
+          Camera::kExtrinsicsSize,
+          PinholeCameraModel::kIntrinsicsSize,
+          PinholeReprojectionErrorBatch::kPointSize> {
+ public:
+  BatchedReprojectionError(const PinholeReprojectionErrorBatch* batch,
+                           const int observation)
+      : batch_(batch), observation_(observation) {}
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const {
+    // Points that are too close to the camera center cannot be constrained.
+    if (!batch_->IsValid(observation_)) {
+      return false;
+    }
+
+    const double* batch_residuals = batch_->Residuals(observation_);
+    std::copy(batch_residuals,
+              batch_residuals + PinholeReprojectionErrorBatch::kResidualSize,
+              residuals);
+    if (jacobians == nullptr) {
+      return true;
+    }
+
+    CHECK(batch_->HasJacobians())
+        << "The reprojection error batch was not evaluated with Jacobians.";
+    CopyJacobian(batch_->ExtrinsicsJacobian(observation_),
+                 PinholeReprojectionErrorBatch::kExtrinsicsJacobianSize,
+                 jacobians[0]);
+    CopyJacobian(batch_->IntrinsicsJacobian(observation_),
+                 PinholeReprojectionErrorBatch::kIntrinsicsJacobianSize,
+                 jacobians[1]);
+    CopyJacobian(batch_->PointJacobian(observation_),
+                 PinholeReprojectionErrorBatch::kPointJacobianSize,
+                 jacobians[2]);
+    return true;
+  }
+
+ private:
+  // Jacobians of constant parameter blocks are not requested by Ceres.
+  static void CopyJacobian(const double* batch_jacobian,
+                           const int size,
+                           double* jacobian) {
+    if (jacobian != nullptr) {
+      std::copy(batch_jacobian, batch_jacobian + size, jacobian);
+    }
+  }
+
+  const PinholeReprojectionErrorBatch* batch_;
+  const int observation_;
+};
+
+// Evaluates all observations of the batch at once whenever Ceres is about to
+// evaluate the problem at a new point, or needs Jacobians that were not
+// computed at the current point.
+class ReprojectionErrorBatchEvaluationCallback
+    : public ceres::EvaluationCallback {
+ public:
+  explicit ReprojectionErrorBatchEvaluationCallback(
+      PinholeReprojectionErrorBatch* batch)
+      : batch_(batch) {}
+
+  void PrepareForEvaluation(bool evaluate_jacobians,
+                            bool new_evaluation_point) {
+    if (new_evaluation_point ||
+        (evaluate_jacobians && !batch_->HasJacobians())) {
+      batch_->Evaluate(evaluate_jacobians);
+    }
+  }
+
+ private:
+  PinholeReprojectionErrorBatch* batch_;
+};
+
+}  // namespace theia
+
+#endif  // THEIA_SFM_BUNDLE_ADJUSTMENT_BATCHED_REPROJECTION_ERROR_H_
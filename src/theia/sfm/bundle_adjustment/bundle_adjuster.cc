@@ -41,8 +41,11 @@
 #include <unordered_set>
 #include <vector>
 
+#include "theia/sfm/bundle_adjustment/batched_reprojection_error.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
 #include "theia/sfm/bundle_adjustment/create_loss_function.h"
+#include "theia/sfm/bundle_adjustment/pinhole_reprojection_error_batch.h"
+#include "theia/sfm/bundle_adjustment/schur_bundle_adjustment_solver.h"
 #include "theia/sfm/camera/camera.h"
 #include "theia/sfm/camera/create_reprojection_error_cost_function.h"
 #include "theia/sfm/reconstruction.h"
@@ -53,6 +56,11 @@
 
 namespace theia {
 namespace {
+// The parameter ordering groups used for Schur elimination.
+static const int kTrackParameterGroup = 0;
+static const int kIntrinsicsParameterGroup = 1;
+static const int kExtrinsicsParameterGroup = 2;
+
 // Set the solver options to defaults.
 void SetSolverOptions(const BundleAdjustmentOptions& options,
                       ceres::Solver::Options* solver_options) {
@@ -92,13 +100,36 @@ BundleAdjuster::BundleAdjuster(const BundleAdjustmentOptions& options,
       CreateLossFunction(options.loss_function_type, options.robust_loss_width);
   ceres::Problem::Options problem_options;
   problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
-  problem_.reset(new ceres::Problem(problem_options));
 
   // Set solver options.
   SetSolverOptions(options, &solver_options_);
   parameter_ordering_ = solver_options_.linear_solver_ordering.get();
+
+  // Set up the batched evaluation of the reprojection errors if requested. The
+  // batch is evaluated all at once by the evaluation callback so inner
+  // iterations, which evaluate subsets of the residuals, cannot be used.
+  if (options.reprojection_error_evaluation_type !=
+      ReprojectionErrorEvaluationType::AUTODIFF) {
+    reprojection_error_batch_.reset(new PinholeReprojectionErrorBatch(
+        options.reprojection_error_evaluation_type ==
+            ReprojectionErrorEvaluationType::BATCHED_SINGLE_PRECISION,
+        options.num_threads));
+    evaluation_callback_.reset(new ReprojectionErrorBatchEvaluationCallback(
+        reprojection_error_batch_.get()));
+#if CERES_VERSION_MAJOR >= 2
+    problem_options.evaluation_callback = evaluation_callback_.get();
+#else
+    solver_options_.evaluation_callback = evaluation_callback_.get();
+#endif
+    solver_options_.use_inner_iterations = false;
+  }
+
+  problem_.reset(new ceres::Problem(problem_options));
 }
 
+// Defined here so that the batch types are complete when they are destroyed.
+BundleAdjuster::~BundleAdjuster() {}
+
 void BundleAdjuster::AddView(const ViewId view_id) {
   View* view = CHECK_NOTNULL(reconstruction_->MutableView(view_id));
 
@@ -201,6 +232,11 @@ BundleAdjustmentSummary BundleAdjuster::Optimize() {
 
   // Solve the problem.
   const double internal_setup_time = timer_.ElapsedTimeInSeconds();
+  if (options_.solver_type ==
+      BundleAdjustmentSolverType::SCHUR_LEVENBERG_MARQUARDT) {
+    return OptimizeWithSchurSolver(internal_setup_time);
+  }
+
   ceres::Solver::Summary solver_summary;
   ceres::Solve(solver_options_, problem_.get(), &solver_summary);
   LOG_IF(INFO, options_.verbose) << solver_summary.FullReport();
@@ -220,6 +256,44 @@ BundleAdjustmentSummary BundleAdjuster::Optimize() {
   return summary;
 }
 
+BundleAdjustmentSummary BundleAdjuster::OptimizeWithSchurSolver(
+    const double internal_setup_time) {
+  SchurBundleAdjustmentSolver::Options schur_options;
+  schur_options.num_threads = options_.num_threads;
+  schur_options.max_num_iterations = options_.max_num_iterations;
+  schur_options.max_solver_time_in_seconds =
+      options_.max_solver_time_in_seconds;
+  schur_options.function_tolerance = options_.function_tolerance;
+  schur_options.gradient_tolerance = options_.gradient_tolerance;
+  schur_options.parameter_tolerance = options_.parameter_tolerance;
+  schur_options.max_trust_region_radius = options_.max_trust_region_radius;
+  schur_options.evaluation_callback = evaluation_callback_.get();
+  schur_options.verbose = options_.verbose;
+
+  // The optimized tracks are eliminated.
+  std::vector<double*> track_parameters;
+  const auto& groups = parameter_ordering_->group_to_elements();
+  const auto track_group = groups.find(kTrackParameterGroup);
+  if (track_group != groups.end()) {
+    track_parameters.assign(track_group->second.begin(),
+                            track_group->second.end());
+  }
+
+  Timer solver_timer;
+  SchurBundleAdjustmentSolver solver(schur_options, track_parameters,
+                                     problem_.get());
+  const double solver_setup_time = solver_timer.ElapsedTimeInSeconds();
+  const SchurBundleAdjustmentSolver::Summary solver_summary = solver.Solve();
+
+  BundleAdjustmentSummary summary;
+  summary.setup_time_in_seconds = internal_setup_time + solver_setup_time;
+  summary.solve_time_in_seconds = solver_summary.total_time_in_seconds;
+  summary.initial_cost = solver_summary.initial_cost;
+  summary.final_cost = solver_summary.final_cost;
+  summary.success = solver_summary.success;
+  return summary;
+}
+
 void BundleAdjuster::SetCameraExtrinsicsParameterization() {
   if (options_.constant_camera_orientation &&
       options_.constant_camera_position) {
@@ -344,8 +418,6 @@ void BundleAdjuster::SetTrackVariable(const TrackId track_id) {
 }
 
 void BundleAdjuster::SetCameraSchurGroups(const ViewId view_id) {
-  static const int kIntrinsicsParameterGroup = 1;
-  static const int kExtrinsicsParameterGroup = 2;
   View* view = reconstruction_->MutableView(view_id);
   Camera* camera = view->MutableCamera();
 
@@ -362,7 +434,6 @@ void BundleAdjuster::SetCameraSchurGroups(const ViewId view_id) {
 }
 
 void BundleAdjuster::SetTrackSchurGroup(const TrackId track_id) {
-  static const int kTrackParameterGroup = 0;
   Track* track = reconstruction_->MutableTrack(track_id);
   // Set the parameter ordering for Schur elimination. We do this after the loop
   // above so that the track is already added to the problem.
@@ -373,12 +444,29 @@ void BundleAdjuster::SetTrackSchurGroup(const TrackId track_id) {
 void BundleAdjuster::AddReprojectionErrorResidual(const Feature& feature,
                                                   Camera* camera,
                                                   Track* track) {
+  // Pinhole cameras are added to the reprojection error batch when batched
+  // evaluation is enabled. All other camera models use autodiff.
+  ceres::CostFunction* cost_function = nullptr;
+  if (reprojection_error_batch_ != nullptr &&
+      camera->GetCameraIntrinsicsModelType() ==
+          CameraIntrinsicsModelType::PINHOLE) {
+    const int observation = reprojection_error_batch_->AddObservation(
+        feature,
+        camera->extrinsics(),
+        camera->intrinsics(),
+        track->Point().data());
+    cost_function = new BatchedReprojectionError(
+        reprojection_error_batch_.get(), observation);
+  } else {
+    cost_function = CreateReprojectionErrorCostFunction(
+        camera->GetCameraIntrinsicsModelType(), feature);
+  }
+
   // Add the residual for the track to the problem. The shared intrinsics
   // parameter block will be set to constant after the loop if no optimized
   // cameras share the same camera intrinsics.
   problem_->AddResidualBlock(
-      CreateReprojectionErrorCostFunction(
-          camera->GetCameraIntrinsicsModelType(), feature),
+      cost_function,
       loss_function_.get(),
       camera->mutable_extrinsics(),
       camera->mutable_intrinsics(),
@@ -37,6 +37,7 @@
 
 #include <ceres/ceres.h>
 #include <ceres/types.h>
+#include <memory>
 #include <unordered_set>
 
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
@@ -47,7 +48,9 @@
 namespace theia {
 class Camera;
 class CameraIntrinsicsModel;
+class PinholeReprojectionErrorBatch;
 class Reconstruction;
+class ReprojectionErrorBatchEvaluationCallback;
 class Track;
 
 // This class sets up nonlinear optimization problems for bundle adjustment.
@@ -63,6 +66,7 @@ class BundleAdjuster {
   // bundle adjustment.
   BundleAdjuster(const BundleAdjustmentOptions& options,
                  Reconstruction* reconstruction);
+  virtual ~BundleAdjuster();
 
   // Add a view to be optimized with bundle adjustment. A residual is created
   // for each estimated track that the view observes.
@@ -92,6 +96,10 @@ class BundleAdjuster {
   virtual void SetTrackConstant(const TrackId track_id);
   virtual void SetTrackVariable(const TrackId track_id);
 
+  // Optimizes the problem with SchurBundleAdjustmentSolver rather than Ceres.
+  BundleAdjustmentSummary OptimizeWithSchurSolver(
+      const double internal_setup_time);
+
   // Set the schur ordering for the parameters.
   virtual void SetCameraSchurGroups(const ViewId view_id);
   virtual void SetTrackSchurGroup(const TrackId track_id);
@@ -105,6 +113,14 @@ class BundleAdjuster {
   Reconstruction* reconstruction_;
   Timer timer_;
 
+  // When batched reprojection errors are requested, the residuals of all
+  // pinhole cameras are evaluated together by the batch. The callback evaluates
+  // the batch whenever Ceres moves to a new evaluation point. These must
+  // outlive the problem.
+  std::unique_ptr<PinholeReprojectionErrorBatch> reprojection_error_batch_;
+  std::unique_ptr<ReprojectionErrorBatchEvaluationCallback>
+      evaluation_callback_;
+
   // Ceres problem for optimization.
   std::unique_ptr<ceres::Problem> problem_;
   ceres::Solver::Options solver_options_;
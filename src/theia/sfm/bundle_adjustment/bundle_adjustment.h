@@ -75,12 +75,44 @@ enum class OptimizeIntrinsicsType {
 };
 ENABLE_ENUM_BITMASK_OPERATORS(OptimizeIntrinsicsType)
 
+// How the reprojection error residuals and Jacobians are evaluated. AUTODIFF
+// evaluates each residual independently with Ceres' automatic differentiation.
+// The BATCHED types instead evaluate all residuals of pinhole cameras together
+// with analytic Jacobians that are vectorized over the observations of each
+// camera, which is considerably faster for large problems.
+// BATCHED_SINGLE_PRECISION performs the vectorized arithmetic in single
+// precision (with the residual offsets still in double precision) to double the
+// SIMD width at the cost of slightly less accurate Jacobians. Cameras with
+// other intrinsics models always use AUTODIFF.
+enum class ReprojectionErrorEvaluationType {
+  AUTODIFF = 0,
+  BATCHED = 1,
+  BATCHED_SINGLE_PRECISION = 2,
+};
+
+// The nonlinear solver used for bundle adjustment. CERES uses Ceres Solver
+// with the linear solver and preconditioner given in the options below.
+// SCHUR_LEVENBERG_MARQUARDT uses Theia's Levenberg-Marquardt solver, which
+// solves the reduced camera system with conjugate gradients on the implicit
+// Schur complement and a block-Jacobi preconditioner over the cameras. It
+// avoids forming the Schur complement and the visibility based preconditioners
+// altogether and is recommended for very large problems. See
+// //theia/sfm/bundle_adjustment/schur_bundle_adjustment_solver.h.
+enum class BundleAdjustmentSolverType {
+  CERES = 0,
+  SCHUR_LEVENBERG_MARQUARDT = 1,
+};
+
 struct BundleAdjustmentOptions {
   // The type of loss function used for BA. By default, we use a standard L2
   // loss function, but robust cost functions could be used.
   LossFunctionType loss_function_type = LossFunctionType::TRIVIAL;
   double robust_loss_width = 2.0;
 
+  // The solver used to minimize the reprojection error. The linear solver,
+  // preconditioner, and clustering options below only apply to CERES.
+  BundleAdjustmentSolverType solver_type = BundleAdjustmentSolverType::CERES;
+
   // For larger problems (> 1000 cameras) it is recommended to use the
   // ITERATIVE_SCHUR solver.
   ceres::LinearSolverType linear_solver_type = ceres::SPARSE_SCHUR;
@@ -111,8 +143,13 @@ struct BundleAdjustmentOptions {
   double max_solver_time_in_seconds = 3600.0;
 
   // Inner iterations can improve the quality according to the Ceres email list.
+  // NOTE: Inner iterations are not used with the batched reprojection errors.
   bool use_inner_iterations = true;
 
+  // The method used to evaluate the reprojection errors. See above for details.
+  ReprojectionErrorEvaluationType reprojection_error_evaluation_type =
+      ReprojectionErrorEvaluationType::AUTODIFF;
+
   // These variables may be useful to change if the optimization is converging
   // to a bad result.
   double function_tolerance = 1e-6;
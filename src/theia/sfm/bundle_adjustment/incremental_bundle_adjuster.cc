@@ -0,0 +1,472 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/sfm/bundle_adjustment/incremental_bundle_adjuster.h"
+
+#include <ceres/ceres.h>
+#include <glog/logging.h>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/create_loss_function.h"
+#include "theia/sfm/bundle_adjustment/schur_bundle_adjustment_solver.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera/create_reprojection_error_cost_function.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/types.h"
+#include "theia/sfm/view.h"
+#include "theia/util/map_util.h"
+#include "theia/util/timer.h"
+
+namespace theia {
+namespace {
+// The parameter ordering groups used for Schur elimination. These match the
+// groups used by BundleAdjuster.
+static const int kTrackParameterGroup = 0;
+static const int kIntrinsicsParameterGroup = 1;
+static const int kExtrinsicsParameterGroup = 2;
+
+// Returns true if the options that determine the residuals and
+// parameterizations of the problem are the same.
+bool HaveSameProblemStructure(const BundleAdjustmentOptions& options1,
+                              const BundleAdjustmentOptions& options2) {
+  return options1.loss_function_type == options2.loss_function_type &&
+         options1.robust_loss_width == options2.robust_loss_width &&
+         options1.intrinsics_to_optimize == options2.intrinsics_to_optimize &&
+         options1.constant_camera_orientation ==
+             options2.constant_camera_orientation &&
+         options1.constant_camera_position ==
+             options2.constant_camera_position;
+}
+
+void SetSolverOptions(const BundleAdjustmentOptions& options,
+                      ceres::Solver::Options* solver_options) {
+  solver_options->linear_solver_type = options.linear_solver_type;
+  solver_options->preconditioner_type = options.preconditioner_type;
+  solver_options->visibility_clustering_type =
+      options.visibility_clustering_type;
+  solver_options->logging_type =
+      options.verbose ? ceres::PER_MINIMIZER_ITERATION : ceres::SILENT;
+  solver_options->num_threads = options.num_threads;
+  solver_options->max_num_iterations = options.max_num_iterations;
+  solver_options->max_solver_time_in_seconds =
+      options.max_solver_time_in_seconds;
+  solver_options->use_inner_iterations = options.use_inner_iterations;
+  solver_options->function_tolerance = options.function_tolerance;
+  solver_options->gradient_tolerance = options.gradient_tolerance;
+  solver_options->parameter_tolerance = options.parameter_tolerance;
+  solver_options->max_trust_region_radius = options.max_trust_region_radius;
+}
+
+}  // namespace
+
+IncrementalBundleAdjuster::IncrementalBundleAdjuster(
+    Reconstruction* reconstruction)
+    : reconstruction_(CHECK_NOTNULL(reconstruction)) {}
+
+IncrementalBundleAdjuster::~IncrementalBundleAdjuster() {
+  // The problem refers to the loss function and parameterizations so it must
+  // be destroyed first.
+  problem_.reset();
+}
+
+void IncrementalBundleAdjuster::Reset() {
+  problem_.reset();
+  loss_function_.reset();
+  parameterizations_.clear();
+  parameter_ordering_ = ceres::ParameterBlockOrdering();
+  residual_blocks_.clear();
+  num_residual_blocks_.clear();
+  variable_parameter_blocks_.clear();
+  constant_parameter_blocks_.clear();
+}
+
+int IncrementalBundleAdjuster::NumResidualBlocks() const {
+  return residual_blocks_.size();
+}
+
+BundleAdjustmentSummary IncrementalBundleAdjuster::Optimize(
+    const BundleAdjustmentOptions& options,
+    const std::unordered_set<ViewId>& views_to_optimize,
+    const std::unordered_set<TrackId>& tracks_to_optimize) {
+  // Residuals that are evaluated in a batch cannot be removed from the batch,
+  // so the problem is rebuilt for every call.
+  if (options.reprojection_error_evaluation_type !=
+      ReprojectionErrorEvaluationType::AUTODIFF) {
+    Reset();
+    return BundleAdjustPartialReconstruction(
+        options, views_to_optimize, tracks_to_optimize, reconstruction_);
+  }
+
+  Timer timer;
+  if (problem_ != nullptr && !HaveSameProblemStructure(options, options_)) {
+    Reset();
+  }
+  options_ = options;
+  if (problem_ == nullptr) {
+    loss_function_ = CreateLossFunction(options.loss_function_type,
+                                        options.robust_loss_width);
+    ceres::Problem::Options problem_options;
+    problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+    problem_options.local_parameterization_ownership =
+        ceres::DO_NOT_TAKE_OWNERSHIP;
+    // Residual and parameter blocks are removed frequently.
+    problem_options.enable_fast_removal = true;
+    problem_.reset(new ceres::Problem(problem_options));
+  }
+
+  UpdateResidualBlocks(views_to_optimize, tracks_to_optimize);
+
+  // The extrinsics and intrinsics of the optimized views and the optimized
+  // tracks are variable, and all other parameters are held constant.
+  std::unordered_set<double*> variable_parameter_blocks;
+  for (const ViewId view_id : views_to_optimize) {
+    View* view = reconstruction_->MutableView(view_id);
+    if (view == nullptr || !view->IsEstimated()) {
+      continue;
+    }
+    Camera* camera = view->MutableCamera();
+    variable_parameter_blocks.emplace(camera->mutable_extrinsics());
+    variable_parameter_blocks.emplace(camera->mutable_intrinsics());
+  }
+  for (const TrackId track_id : tracks_to_optimize) {
+    Track* track = reconstruction_->MutableTrack(track_id);
+    if (track == nullptr || !track->IsEstimated()) {
+      continue;
+    }
+    variable_parameter_blocks.emplace(track->MutablePoint()->data());
+  }
+  SetVariableParameterBlocks(variable_parameter_blocks);
+
+  return Solve(options, timer.ElapsedTimeInSeconds());
+}
+
+void IncrementalBundleAdjuster::UpdateResidualBlocks(
+    const std::unordered_set<ViewId>& views_to_optimize,
+    const std::unordered_set<TrackId>& tracks_to_optimize) {
+  // Collect the observations that should be in the problem. This mirrors
+  // BundleAdjuster::AddView and BundleAdjuster::AddTrack.
+  std::unordered_set<std::pair<ViewId, TrackId>> observations;
+  for (const ViewId view_id : views_to_optimize) {
+    const View* view = reconstruction_->View(view_id);
+    if (view == nullptr || !view->IsEstimated()) {
+      continue;
+    }
+    for (const TrackId track_id : view->TrackIds()) {
+      const Track* track = reconstruction_->Track(track_id);
+      if (track != nullptr && track->IsEstimated()) {
+        observations.emplace(view_id, track_id);
+      }
+    }
+  }
+  for (const TrackId track_id : tracks_to_optimize) {
+    const Track* track = reconstruction_->Track(track_id);
+    if (track == nullptr || !track->IsEstimated()) {
+      continue;
+    }
+    for (const ViewId view_id : track->ViewIds()) {
+      const View* view = reconstruction_->View(view_id);
+      if (view != nullptr && view->IsEstimated()) {
+        observations.emplace(view_id, track_id);
+      }
+    }
+  }
+
+  // Remove the residuals that are no longer desired. Residuals whose view or
+  // track was modified such that the parameter blocks moved (e.g. the track
+  // was removed and added again) must be recreated.
+  for (auto it = residual_blocks_.begin(); it != residual_blocks_.end();) {
+    const ViewId view_id = it->first.first;
+    const TrackId track_id = it->first.second;
+    bool is_valid = ContainsKey(observations, it->first);
+    if (is_valid) {
+      View* view = reconstruction_->MutableView(view_id);
+      Track* track = reconstruction_->MutableTrack(track_id);
+      is_valid = view->GetFeature(track_id) != nullptr &&
+                 view->MutableCamera()->mutable_extrinsics() ==
+                     it->second.extrinsics &&
+                 view->MutableCamera()->mutable_intrinsics() ==
+                     it->second.intrinsics &&
+                 track->MutablePoint()->data() == it->second.point;
+    }
+
+    if (is_valid) {
+      observations.erase(it->first);
+      ++it;
+    } else {
+      RemoveResidualBlock(it->second);
+      it = residual_blocks_.erase(it);
+    }
+  }
+
+  // Add all remaining observations. The stale residuals are removed first so
+  // that their parameter blocks are not confused with any new parameter blocks
+  // that reuse the same memory.
+  for (const auto& observation : observations) {
+    AddResidualBlock(observation.first, observation.second);
+  }
+}
+
+void IncrementalBundleAdjuster::AddResidualBlock(const ViewId view_id,
+                                                 const TrackId track_id) {
+  View* view = reconstruction_->MutableView(view_id);
+  Track* track = reconstruction_->MutableTrack(track_id);
+  const Feature* feature = CHECK_NOTNULL(view->GetFeature(track_id));
+  Camera* camera = view->MutableCamera();
+
+  ResidualBlock residual_block;
+  residual_block.extrinsics = camera->mutable_extrinsics();
+  residual_block.intrinsics = camera->mutable_intrinsics();
+  residual_block.point = track->MutablePoint()->data();
+  residual_block.id = problem_->AddResidualBlock(
+      CreateReprojectionErrorCostFunction(
+          camera->GetCameraIntrinsicsModelType(), *feature),
+      loss_function_.get(),
+      residual_block.extrinsics,
+      residual_block.intrinsics,
+      residual_block.point);
+  residual_blocks_.emplace(std::make_pair(view_id, track_id), residual_block);
+
+  // The extrinsics *must* belong to the last group. See
+  // BundleAdjuster::SetCameraSchurGroups for details.
+  bool always_constant = false;
+  ceres::LocalParameterization* extrinsics_parameterization =
+      GetExtrinsicsParameterization(&always_constant);
+  AddParameterBlockReference(residual_block.extrinsics,
+                             kExtrinsicsParameterGroup,
+                             extrinsics_parameterization,
+                             always_constant);
+
+  ceres::LocalParameterization* intrinsics_parameterization =
+      GetIntrinsicsParameterization(*camera->CameraIntrinsics(),
+                                    &always_constant);
+  AddParameterBlockReference(residual_block.intrinsics,
+                             kIntrinsicsParameterGroup,
+                             intrinsics_parameterization,
+                             always_constant);
+
+  AddParameterBlockReference(
+      residual_block.point, kTrackParameterGroup, nullptr, false);
+}
+
+void IncrementalBundleAdjuster::RemoveResidualBlock(
+    const ResidualBlock& residual_block) {
+  problem_->RemoveResidualBlock(residual_block.id);
+  RemoveParameterBlockReference(residual_block.extrinsics);
+  RemoveParameterBlockReference(residual_block.intrinsics);
+  RemoveParameterBlockReference(residual_block.point);
+}
+
+void IncrementalBundleAdjuster::AddParameterBlockReference(
+    double* parameters,
+    const int group,
+    ceres::LocalParameterization* parameterization,
+    const bool always_constant) {
+  int& num_residual_blocks = num_residual_blocks_[parameters];
+  ++num_residual_blocks;
+  if (num_residual_blocks > 1) {
+    return;
+  }
+
+  parameter_ordering_.AddElementToGroup(parameters, group);
+  if (parameterization != nullptr) {
+    problem_->SetParameterization(parameters, parameterization);
+  }
+  // New parameter blocks are constant until they are marked as variable.
+  problem_->SetParameterBlockConstant(parameters);
+  if (always_constant) {
+    constant_parameter_blocks_.emplace(parameters);
+  }
+}
+
+void IncrementalBundleAdjuster::RemoveParameterBlockReference(
+    double* parameters) {
+  auto it = num_residual_blocks_.find(parameters);
+  CHECK(it != num_residual_blocks_.end());
+  --it->second;
+  if (it->second > 0) {
+    return;
+  }
+
+  num_residual_blocks_.erase(it);
+  problem_->RemoveParameterBlock(parameters);
+  parameter_ordering_.Remove(parameters);
+  variable_parameter_blocks_.erase(parameters);
+  constant_parameter_blocks_.erase(parameters);
+}
+
+ceres::LocalParameterization*
+IncrementalBundleAdjuster::GetExtrinsicsParameterization(
+    bool* always_constant) {
+  *always_constant = options_.constant_camera_orientation &&
+                     options_.constant_camera_position;
+  std::vector<int> constant_extrinsics;
+  if (*always_constant) {
+    return nullptr;
+  } else if (options_.constant_camera_orientation) {
+    constant_extrinsics = {Camera::ORIENTATION + 0,
+                           Camera::ORIENTATION + 1,
+                           Camera::ORIENTATION + 2};
+  } else if (options_.constant_camera_position) {
+    constant_extrinsics = {
+        Camera::POSITION + 0, Camera::POSITION + 1, Camera::POSITION + 2};
+  } else {
+    return nullptr;
+  }
+
+  std::unique_ptr<ceres::LocalParameterization>& parameterization =
+      parameterizations_[std::make_pair(Camera::kExtrinsicsSize,
+                                        constant_extrinsics)];
+  if (parameterization == nullptr) {
+    parameterization.reset(new ceres::SubsetParameterization(
+        Camera::kExtrinsicsSize, constant_extrinsics));
+  }
+  return parameterization.get();
+}
+
+ceres::LocalParameterization*
+IncrementalBundleAdjuster::GetIntrinsicsParameterization(
+    const CameraIntrinsicsModel& intrinsics, bool* always_constant) {
+  const std::vector<int> constant_intrinsics =
+      intrinsics.GetSubsetFromOptimizeIntrinsicsType(
+          options_.intrinsics_to_optimize);
+  *always_constant = constant_intrinsics.size() == intrinsics.NumParameters();
+  if (*always_constant || constant_intrinsics.empty()) {
+    return nullptr;
+  }
+
+  std::unique_ptr<ceres::LocalParameterization>& parameterization =
+      parameterizations_[std::make_pair(intrinsics.NumParameters(),
+                                        constant_intrinsics)];
+  if (parameterization == nullptr) {
+    parameterization.reset(new ceres::SubsetParameterization(
+        intrinsics.NumParameters(), constant_intrinsics));
+  }
+  return parameterization.get();
+}
+
+void IncrementalBundleAdjuster::SetVariableParameterBlocks(
+    const std::unordered_set<double*>& variable_parameter_blocks) {
+  for (auto it = variable_parameter_blocks_.begin();
+       it != variable_parameter_blocks_.end();) {
+    if (ContainsKey(variable_parameter_blocks, *it)) {
+      ++it;
+    } else {
+      problem_->SetParameterBlockConstant(*it);
+      it = variable_parameter_blocks_.erase(it);
+    }
+  }
+
+  for (double* parameters : variable_parameter_blocks) {
+    // Views in the optimized set may not have any residuals (and so their
+    // parameters are not in the problem).
+    if (!ContainsKey(num_residual_blocks_, parameters) ||
+        ContainsKey(constant_parameter_blocks_, parameters)) {
+      continue;
+    }
+    if (variable_parameter_blocks_.emplace(parameters).second) {
+      problem_->SetParameterBlockVariable(parameters);
+    }
+  }
+}
+
+BundleAdjustmentSummary IncrementalBundleAdjuster::Solve(
+    const BundleAdjustmentOptions& options, const double setup_time) {
+  BundleAdjustmentSummary summary;
+  if (options.solver_type ==
+      BundleAdjustmentSolverType::SCHUR_LEVENBERG_MARQUARDT) {
+    SchurBundleAdjustmentSolver::Options schur_options;
+    schur_options.num_threads = options.num_threads;
+    schur_options.max_num_iterations = options.max_num_iterations;
+    schur_options.max_solver_time_in_seconds =
+        options.max_solver_time_in_seconds;
+    schur_options.function_tolerance = options.function_tolerance;
+    schur_options.gradient_tolerance = options.gradient_tolerance;
+    schur_options.parameter_tolerance = options.parameter_tolerance;
+    schur_options.max_trust_region_radius = options.max_trust_region_radius;
+    schur_options.verbose = options.verbose;
+
+    // The optimized tracks are eliminated.
+    std::vector<double*> track_parameters;
+    for (double* parameters : variable_parameter_blocks_) {
+      if (parameter_ordering_.GroupId(parameters) == kTrackParameterGroup) {
+        track_parameters.emplace_back(parameters);
+      }
+    }
+
+    Timer solver_timer;
+    SchurBundleAdjustmentSolver solver(
+        schur_options, track_parameters, problem_.get());
+    const double solver_setup_time = solver_timer.ElapsedTimeInSeconds();
+    const SchurBundleAdjustmentSolver::Summary solver_summary = solver.Solve();
+
+    summary.setup_time_in_seconds = setup_time + solver_setup_time;
+    summary.solve_time_in_seconds = solver_summary.total_time_in_seconds;
+    summary.initial_cost = solver_summary.initial_cost;
+    summary.final_cost = solver_summary.final_cost;
+    summary.success = solver_summary.success;
+    return summary;
+  }
+
+  // Ceres removes the constant parameter blocks from the orderings, so they are
+  // copied for every solve.
+  ceres::Solver::Options solver_options;
+  SetSolverOptions(options, &solver_options);
+  solver_options.linear_solver_ordering.reset(
+      new ceres::ParameterBlockOrdering(parameter_ordering_));
+  if (solver_options.use_inner_iterations) {
+    solver_options.inner_iteration_ordering.reset(
+        new ceres::ParameterBlockOrdering(parameter_ordering_));
+    solver_options.inner_iteration_ordering->Reverse();
+  }
+
+  ceres::Solver::Summary solver_summary;
+  ceres::Solve(solver_options, problem_.get(), &solver_summary);
+  LOG_IF(INFO, options.verbose) << solver_summary.FullReport();
+
+  summary.setup_time_in_seconds =
+      setup_time + solver_summary.preprocessor_time_in_seconds;
+  summary.solve_time_in_seconds = solver_summary.total_time_in_seconds;
+  summary.initial_cost = solver_summary.initial_cost;
+  summary.final_cost = solver_summary.final_cost;
+  summary.success = solver_summary.IsSolutionUsable();
+  return summary;
+}
+
+}  // namespace theia
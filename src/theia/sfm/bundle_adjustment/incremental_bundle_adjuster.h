@@ -0,0 +1,182 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_SFM_BUNDLE_ADJUSTMENT_INCREMENTAL_BUNDLE_ADJUSTER_H_
+#define THEIA_SFM_BUNDLE_ADJUSTMENT_INCREMENTAL_BUNDLE_ADJUSTER_H_
+
+#include <ceres/ceres.h>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/types.h"
+#include "theia/util/hash.h"
+#include "theia/util/util.h"
+
+namespace theia {
+
+class CameraIntrinsicsModel;
+class Reconstruction;
+
+// A bundle adjustment session for reconstructions that change gradually, such
+// as during incremental SfM. BundleAdjustPartialReconstruction builds a new
+// ceres::Problem for every call, so its setup time grows with the size of the
+// optimized region even when only a few cameras changed since the last call.
+// This class instead keeps the problem alive between calls to Optimize and only
+// applies the differences: residual blocks for new observations are added,
+// residual blocks for observations that are no longer optimized (or whose view
+// or track is no longer estimated) are removed along with parameter blocks that
+// no residual depends on, and the parameter blocks whose optimization status
+// changed are toggled between constant and variable.
+//
+// The parameter blocks point directly into the reconstruction, so changes to
+// the cameras and points between calls (e.g. from localization or
+// triangulation) are picked up automatically. Views and tracks may be added
+// to, removed from, or set as unestimated in the reconstruction between calls.
+//
+// NOTE: Batched reprojection error evaluation does not support removing
+// residuals, so if it is requested the problem is rebuilt with
+// BundleAdjustPartialReconstruction on every call.
+class IncrementalBundleAdjuster {
+ public:
+  explicit IncrementalBundleAdjuster(Reconstruction* reconstruction);
+  ~IncrementalBundleAdjuster();
+
+  // Bundle adjusts the views and tracks. This optimizes the same problem as
+  // BundleAdjustPartialReconstruction: a residual is used for every estimated
+  // track observed by the views and every estimated view observing the tracks,
+  // and all other cameras and tracks in these residuals are held constant.
+  //
+  // The solver options (e.g. the linear solver and number of iterations) may
+  // change between calls. If the options that determine the structure of the
+  // problem (the loss function, the optimized intrinsics, or the constant
+  // camera orientations or positions) change, the problem is rebuilt.
+  BundleAdjustmentSummary Optimize(
+      const BundleAdjustmentOptions& options,
+      const std::unordered_set<ViewId>& views_to_optimize,
+      const std::unordered_set<TrackId>& tracks_to_optimize);
+
+  // Discards the problem so that the next call to Optimize rebuilds it.
+  void Reset();
+
+  // The number of residual blocks that are currently in the problem.
+  int NumResidualBlocks() const;
+
+ private:
+  // A residual block and the parameter blocks that it was created with.
+  struct ResidualBlock {
+    ceres::ResidualBlockId id;
+    double* extrinsics;
+    double* intrinsics;
+    double* point;
+  };
+
+  // Removes residuals that are not part of the desired problem or whose view or
+  // track changed since they were added, then adds residuals for all desired
+  // observations that are not yet in the problem.
+  void UpdateResidualBlocks(
+      const std::unordered_set<ViewId>& views_to_optimize,
+      const std::unordered_set<TrackId>& tracks_to_optimize);
+
+  // Adds a residual for the observation of the track in the view.
+  void AddResidualBlock(const ViewId view_id, const TrackId track_id);
+
+  // Removes the residual block and any parameter blocks that no other residual
+  // block depends on.
+  void RemoveResidualBlock(const ResidualBlock& residual_block);
+
+  // Adds a reference to the parameter block. The first time that a parameter
+  // block is referenced it is added to the Schur group, given the (optional)
+  // parameterization, and set to constant.
+  void AddParameterBlockReference(
+      double* parameters,
+      const int group,
+      ceres::LocalParameterization* parameterization,
+      const bool always_constant);
+  void RemoveParameterBlockReference(double* parameters);
+
+  // Returns the parameterization to use for the camera extrinsics or
+  // intrinsics, or nullptr if all parameters are optimized. always_constant is
+  // set to true if no parameters are optimized.
+  ceres::LocalParameterization* GetExtrinsicsParameterization(
+      bool* always_constant);
+  ceres::LocalParameterization* GetIntrinsicsParameterization(
+      const CameraIntrinsicsModel& intrinsics, bool* always_constant);
+
+  // Sets the parameter blocks in the problem to be variable if and only if they
+  // are in the given set.
+  void SetVariableParameterBlocks(
+      const std::unordered_set<double*>& variable_parameter_blocks);
+
+  // Solves the current problem.
+  BundleAdjustmentSummary Solve(const BundleAdjustmentOptions& options,
+                                const double setup_time);
+
+  Reconstruction* reconstruction_;
+  // The options that the current problem was built with.
+  BundleAdjustmentOptions options_;
+
+  std::unique_ptr<ceres::LossFunction> loss_function_;
+  std::unique_ptr<ceres::Problem> problem_;
+  // The parameter groups for Schur elimination of all parameter blocks in the
+  // problem.
+  ceres::ParameterBlockOrdering parameter_ordering_;
+
+  // The parameterizations are shared by all parameter blocks that use them.
+  // They are keyed by the size of the parameter block and the constant
+  // parameters.
+  std::map<std::pair<int, std::vector<int>>,
+           std::unique_ptr<ceres::LocalParameterization>>
+      parameterizations_;
+
+  // The residual block of each (view, track) observation in the problem.
+  std::unordered_map<std::pair<ViewId, TrackId>, ResidualBlock>
+      residual_blocks_;
+  // The number of residual blocks that depend on each parameter block.
+  std::unordered_map<double*, int> num_residual_blocks_;
+  // The parameter blocks that are currently variable, and those that must
+  // always be constant (e.g. when no intrinsics are optimized).
+  std::unordered_set<double*> variable_parameter_blocks_;
+  std::unordered_set<double*> constant_parameter_blocks_;
+
+  DISALLOW_COPY_AND_ASSIGN(IncrementalBundleAdjuster);
+};
+
+}  // namespace theia
+
+#endif  // THEIA_SFM_BUNDLE_ADJUSTMENT_INCREMENTAL_BUNDLE_ADJUSTER_H_
@@ -0,0 +1,293 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/incremental_bundle_adjuster.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/types.h"
+#include "theia/util/map_util.h"
+#include "theia/util/random.h"
+#include "theia/util/stringprintf.h"
+
+namespace theia {
+
+namespace {
+
+RandomNumberGenerator rng(61);
+
+// Creates a reconstruction of cameras moving along a street that observe the
+// points within a few meters of them. All cameras share their intrinsics, and
+// the camera heights vary so that the focal length is not confounded with the
+// depth of the points. The observations are noisy and the estimates are
+// perturbed.
+void CreateStreetReconstruction(const int num_views,
+                                const int num_tracks,
+                                Reconstruction* reconstruction) {
+  static const double kViewSpacing = 0.5;
+  static const double kMaxObservationDistance = 2.5;
+  static const double kPixelNoise = 0.5;
+  static const double kHeightVariation = 0.5;
+
+  std::vector<ViewId> view_ids;
+  for (int i = 0; i < num_views; i++) {
+    const ViewId view_id =
+        reconstruction->AddView(StringPrintf("%d", i), 0);
+    View* view = reconstruction->MutableView(view_id);
+    view->SetEstimated(true);
+    Camera* camera = view->MutableCamera();
+    camera->SetPosition(
+        Eigen::Vector3d(kViewSpacing * i, 0.0, kHeightVariation * (i % 3)));
+    camera->SetFocalLength(800.0);
+    camera->SetPrincipalPoint(400.0, 300.0);
+    view_ids.emplace_back(view_id);
+  }
+
+  const double street_length = kViewSpacing * (num_views - 1);
+  for (int i = 0; i < num_tracks; i++) {
+    const Eigen::Vector4d point(rng.RandDouble(-1.0, street_length + 1.0),
+                                rng.RandDouble(-1.0, 1.0),
+                                rng.RandDouble(6.0, 10.0),
+                                1.0);
+    std::vector<std::pair<ViewId, Feature> > observations;
+    for (const ViewId view_id : view_ids) {
+      const Camera& camera = reconstruction->View(view_id)->Camera();
+      if (std::abs(camera.GetPosition().x() - point.x()) >
+          kMaxObservationDistance) {
+        continue;
+      }
+      Feature feature;
+      camera.ProjectPoint(point, &feature);
+      feature += kPixelNoise * Feature(rng.RandGaussian(0.0, 1.0),
+                                       rng.RandGaussian(0.0, 1.0));
+      observations.emplace_back(view_id, feature);
+    }
+    if (observations.size() < 2) {
+      continue;
+    }
+
+    const TrackId track_id = reconstruction->AddTrack(observations);
+    Track* track = reconstruction->MutableTrack(track_id);
+    track->SetEstimated(true);
+    *track->MutablePoint() = point;
+    track->MutablePoint()->head<3>() += 0.05 * rng.RandVector3d();
+  }
+
+  // Perturb the cameras.
+  for (const ViewId view_id : view_ids) {
+    Camera* camera = reconstruction->MutableView(view_id)->MutableCamera();
+    camera->SetPosition(camera->GetPosition() + 0.01 * rng.RandVector3d());
+    camera->SetOrientationFromAngleAxis(0.002 * rng.RandVector3d());
+  }
+}
+
+// Copies the reconstruction such that the copy has its own camera intrinsics.
+void CopyReconstruction(const Reconstruction& reconstruction,
+                        Reconstruction* copy) {
+  *copy = reconstruction;
+  Camera intrinsics_camera;
+  intrinsics_camera.DeepCopy(reconstruction.View(0)->Camera());
+  for (const ViewId view_id : copy->ViewIds()) {
+    copy->MutableView(view_id)->MutableCamera()->MutableCameraIntrinsics() =
+        intrinsics_camera.MutableCameraIntrinsics();
+  }
+}
+
+// Returns the tracks observed by the views.
+std::unordered_set<TrackId> TracksInViews(
+    const Reconstruction& reconstruction,
+    const std::unordered_set<ViewId>& view_ids) {
+  std::unordered_set<TrackId> track_ids;
+  for (const ViewId view_id : view_ids) {
+    const auto& view_track_ids = reconstruction.View(view_id)->TrackIds();
+    track_ids.insert(view_track_ids.begin(), view_track_ids.end());
+  }
+  return track_ids;
+}
+
+int NumObservations(const Reconstruction& reconstruction) {
+  int num_observations = 0;
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    const Track* track = reconstruction.Track(track_id);
+    if (track->IsEstimated()) {
+      num_observations += track->NumViews();
+    }
+  }
+  return num_observations;
+}
+
+// Returns the number of residuals that BundleAdjustPartialReconstruction adds,
+// i.e. the observations between estimated views and tracks for which either
+// the view or the track is optimized.
+int NumPartialObservations(const Reconstruction& reconstruction,
+                           const std::unordered_set<ViewId>& view_ids,
+                           const std::unordered_set<TrackId>& track_ids) {
+  int num_observations = 0;
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    const Track* track = reconstruction.Track(track_id);
+    if (!track->IsEstimated()) {
+      continue;
+    }
+    for (const ViewId view_id : track->ViewIds()) {
+      if (!reconstruction.View(view_id)->IsEstimated()) {
+        continue;
+      }
+      if (ContainsKey(view_ids, view_id) || ContainsKey(track_ids, track_id)) {
+        ++num_observations;
+      }
+    }
+  }
+  return num_observations;
+}
+
+}  // namespace
+
+TEST(IncrementalBundleAdjuster, MatchesBundleAdjustPartialReconstruction) {
+  static const int kNumViews = 20;
+  static const int kWindowSize = 6;
+  // The problems are built in a different order, so the solutions only agree up
+  // to the convergence tolerance of the solver.
+  static const double kCameraTolerance = 1e-4;
+
+  Reconstruction reconstruction;
+  CreateStreetReconstruction(kNumViews, 600, &reconstruction);
+  Reconstruction expected_reconstruction;
+  CopyReconstruction(reconstruction, &expected_reconstruction);
+
+  BundleAdjustmentOptions options;
+  options.use_inner_iterations = false;
+  IncrementalBundleAdjuster bundle_adjuster(&reconstruction);
+
+  // Slide a window of optimized views along the street so that residuals are
+  // added to and removed from the problem between calls.
+  for (int i = 0; i + kWindowSize <= kNumViews; i += 2) {
+    std::unordered_set<ViewId> view_ids;
+    for (int j = i; j < i + kWindowSize; j++) {
+      view_ids.emplace(reconstruction.ViewIdFromName(StringPrintf("%d", j)));
+    }
+    const std::unordered_set<TrackId> track_ids =
+        TracksInViews(reconstruction, view_ids);
+
+    const BundleAdjustmentSummary summary =
+        bundle_adjuster.Optimize(options, view_ids, track_ids);
+    const BundleAdjustmentSummary expected_summary =
+        BundleAdjustPartialReconstruction(
+            options, view_ids, track_ids, &expected_reconstruction);
+    EXPECT_TRUE(summary.success);
+    ASSERT_TRUE(expected_summary.success);
+
+    // The session must hold exactly the residuals of the one-shot problem.
+    // Only then are the costs compared, up to the solver tolerance.
+    ASSERT_EQ(bundle_adjuster.NumResidualBlocks(),
+              NumPartialObservations(expected_reconstruction, view_ids,
+                                     track_ids));
+    EXPECT_NEAR(summary.initial_cost, expected_summary.initial_cost,
+                1e-4 * expected_summary.initial_cost);
+    EXPECT_NEAR(summary.final_cost, expected_summary.final_cost,
+                1e-4 * expected_summary.final_cost);
+
+    // The session and the one-shot bundle adjustment must agree.
+    for (const ViewId view_id : reconstruction.ViewIds()) {
+      const Camera& camera = reconstruction.View(view_id)->Camera();
+      const Camera& expected_camera =
+          expected_reconstruction.View(view_id)->Camera();
+      EXPECT_LT((camera.GetPosition() - expected_camera.GetPosition()).norm(),
+                kCameraTolerance);
+    }
+    EXPECT_NEAR(reconstruction.View(0)->Camera().FocalLength(),
+                expected_reconstruction.View(0)->Camera().FocalLength(),
+                kCameraTolerance * 800.0);
+  }
+}
+
+TEST(IncrementalBundleAdjuster, UpdatesResidualsWhenReconstructionChanges) {
+  Reconstruction reconstruction;
+  CreateStreetReconstruction(10, 500, &reconstruction);
+
+  BundleAdjustmentOptions options;
+  options.max_num_iterations = 5;
+  IncrementalBundleAdjuster bundle_adjuster(&reconstruction);
+  const std::vector<ViewId> view_id_list = reconstruction.ViewIds();
+  const std::unordered_set<ViewId> view_ids(view_id_list.begin(),
+                                            view_id_list.end());
+  const std::unordered_set<TrackId> track_ids;
+  EXPECT_TRUE(bundle_adjuster.Optimize(options, view_ids, track_ids).success);
+  EXPECT_EQ(bundle_adjuster.NumResidualBlocks(),
+            NumObservations(reconstruction));
+
+  // Residuals of tracks that are no longer estimated are removed.
+  const TrackId unestimated_track_id = reconstruction.TrackIds()[0];
+  reconstruction.MutableTrack(unestimated_track_id)->SetEstimated(false);
+  EXPECT_TRUE(bundle_adjuster.Optimize(options, view_ids, track_ids).success);
+  EXPECT_EQ(bundle_adjuster.NumResidualBlocks(),
+            NumObservations(reconstruction));
+
+  // Residuals of removed views are removed.
+  const ViewId removed_view_id = view_id_list[0];
+  ASSERT_TRUE(reconstruction.RemoveView(removed_view_id));
+  EXPECT_TRUE(bundle_adjuster.Optimize(options, view_ids, track_ids).success);
+  EXPECT_EQ(bundle_adjuster.NumResidualBlocks(),
+            NumObservations(reconstruction));
+
+  // Changing the loss function rebuilds the problem.
+  options.loss_function_type = LossFunctionType::HUBER;
+  EXPECT_TRUE(bundle_adjuster.Optimize(options, view_ids, track_ids).success);
+  EXPECT_EQ(bundle_adjuster.NumResidualBlocks(),
+            NumObservations(reconstruction));
+
+  // Only the observations of the optimized tracks remain.
+  const std::unordered_set<ViewId> no_view_ids;
+  TrackId optimized_track_id = kInvalidTrackId;
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    if (reconstruction.Track(track_id)->IsEstimated()) {
+      optimized_track_id = track_id;
+      break;
+    }
+  }
+  const std::unordered_set<TrackId> optimized_track_ids = {optimized_track_id};
+  EXPECT_TRUE(
+      bundle_adjuster.Optimize(options, no_view_ids, optimized_track_ids)
+          .success);
+  EXPECT_EQ(bundle_adjuster.NumResidualBlocks(),
+            reconstruction.Track(optimized_track_id)->NumViews());
+}
+
+}  // namespace theia
@@ -36,6 +36,7 @@
 
 #include <ceres/rotation.h>
 #include <Eigen/Core>
+#include <Eigen/SVD>
 #include <glog/logging.h>
 #include <algorithm>
 #include <vector>
@@ -47,24 +48,15 @@
 namespace theia {
 namespace {
 
-// Creates the constraint matrix such that ||A * t|| is minimized, where A is
-// R_i * f_i x R_j * f_j. Given known rotations, we can solve for the
-// relative translation from this constraint matrix.
-void CreateConstraintMatrix(
-    const std::vector<FeatureCorrespondence>& correspondences,
-    const Eigen::Vector3d& rotation1,
-    const Eigen::Vector3d& rotation2,
-    Eigen::MatrixXd* constraint_matrix) {
-  constraint_matrix->resize(3, correspondences.size());
-
-  Eigen::Matrix3d rotation_matrix1;
-  ceres::AngleAxisToRotationMatrix(
-      rotation1.data(), ceres::ColumnMajorAdapter3x3(rotation_matrix1.data()));
-  Eigen::Matrix3d rotation_matrix2;
-  ceres::AngleAxisToRotationMatrix(
-      rotation2.data(), ceres::ColumnMajorAdapter3x3(rotation_matrix2.data()));
-
-  for (int i = 0; i < correspondences.size(); i++) {
+// Creates the constraints such that sum_i |c_i^t * t| is minimized, where each
+// constraint c_i is R_1 * (R_2^t * f_2 x R_1^t * f_1). Given known rotations,
+// we can solve for the relative translation from these constraints.
+void CreateConstraints(const FeatureCorrespondence* correspondences,
+                       const int num_correspondences,
+                       const Eigen::Matrix3d& rotation_matrix1,
+                       const Eigen::Matrix3d& rotation_matrix2,
+                       Eigen::Vector3d* constraints) {
+  for (int i = 0; i < num_correspondences; i++) {
     const Eigen::Vector3d rotated_feature1 =
         rotation_matrix1.transpose() *
         correspondences[i].feature1.homogeneous();
@@ -72,9 +64,8 @@ void CreateConstraintMatrix(
         rotation_matrix2.transpose() *
         correspondences[i].feature2.homogeneous();
 
-    constraint_matrix->col(i) =
-        rotated_feature2.cross(rotated_feature1).transpose() *
-        rotation_matrix1.transpose();
+    constraints[i] =
+        rotation_matrix1 * rotated_feature2.cross(rotated_feature1);
   }
 }
 
@@ -83,30 +74,26 @@ void CreateConstraintMatrix(
 // more than 50% of correspondences are in front of both cameras and false
 // otherwise.
 bool MajorityOfPointsInFrontOfCameras(
-    const std::vector<FeatureCorrespondence>& correspondences,
-    const Eigen::Vector3d& rotation1,
-    const Eigen::Vector3d& rotation2,
+    const FeatureCorrespondence* correspondences,
+    const int num_correspondences,
+    const Eigen::Matrix3d& rotation_matrix1,
+    const Eigen::Matrix3d& rotation_matrix2,
     const Eigen::Vector3d& relative_position) {
   // Compose the relative rotation.
-  Eigen::Matrix3d rotation_matrix1, rotation_matrix2;
-  ceres::AngleAxisToRotationMatrix(
-      rotation1.data(), ceres::ColumnMajorAdapter3x3(rotation_matrix1.data()));
-  ceres::AngleAxisToRotationMatrix(
-      rotation2.data(), ceres::ColumnMajorAdapter3x3(rotation_matrix2.data()));
   const Eigen::Matrix3d relative_rotation_matrix =
       rotation_matrix2 * rotation_matrix1.transpose();
 
   // Tests all points for cheirality.
   int num_points_in_front_of_cameras = 0;
-  for (const FeatureCorrespondence& match : correspondences) {
-    if (IsTriangulatedPointInFrontOfCameras(match,
+  for (int i = 0; i < num_correspondences; i++) {
+    if (IsTriangulatedPointInFrontOfCameras(correspondences[i],
                                             relative_rotation_matrix,
                                             relative_position)) {
       ++num_points_in_front_of_cameras;
     }
   }
 
-  return num_points_in_front_of_cameras > (correspondences.size() / 2);
+  return num_points_in_front_of_cameras > (num_correspondences / 2);
 }
 
 }  // namespace
@@ -119,11 +106,24 @@ bool OptimizeRelativePositionWithKnownRotation(
     const Eigen::Vector3d& rotation1,
     const Eigen::Vector3d& rotation2,
     Eigen::Vector3d* relative_position) {
-  CHECK_NOTNULL(relative_position);
+  RelativePositionOptimizationBuffer buffer;
+  return OptimizeRelativePositionWithKnownRotation(correspondences.data(),
+                                                   correspondences.size(),
+                                                   rotation1,
+                                                   rotation2,
+                                                   &buffer,
+                                                   relative_position);
+}
 
-  // Set the initial relative position to random. This helps avoid a bad local
-  // minima that is achieved from poor initialization.
-  relative_position->setRandom();
+bool OptimizeRelativePositionWithKnownRotation(
+    const FeatureCorrespondence* correspondences,
+    const int num_correspondences,
+    const Eigen::Vector3d& rotation1,
+    const Eigen::Vector3d& rotation2,
+    RelativePositionOptimizationBuffer* buffer,
+    Eigen::Vector3d* relative_position) {
+  CHECK_NOTNULL(buffer);
+  CHECK_NOTNULL(relative_position);
 
   // Constants used for the IRLS solving.
   const double eps = 1e-5;
@@ -131,16 +131,29 @@ bool OptimizeRelativePositionWithKnownRotation(
   const int kMaxInnerIterations = 10;
   const double kMinWeight = 1e-7;
 
-  // Create the constraint matrix from the known correspondences and rotations.
-  Eigen::MatrixXd constraint_matrix;
-  CreateConstraintMatrix(correspondences,
-                         rotation1,
-                         rotation2,
-                         &constraint_matrix);
+  Eigen::Matrix3d rotation_matrix1;
+  ceres::AngleAxisToRotationMatrix(
+      rotation1.data(), ceres::ColumnMajorAdapter3x3(rotation_matrix1.data()));
+  Eigen::Matrix3d rotation_matrix2;
+  ceres::AngleAxisToRotationMatrix(
+      rotation2.data(), ceres::ColumnMajorAdapter3x3(rotation_matrix2.data()));
+
+  // Create the constraints from the known correspondences and rotations. The
+  // buffers only grow, so reusing them across calls does not allocate.
+  if (buffer->constraints.size() < num_correspondences) {
+    buffer->constraints.resize(num_correspondences);
+    buffer->weights.resize(num_correspondences);
+  }
+  Eigen::Vector3d* constraints = buffer->constraints.data();
+  double* weights = buffer->weights.data();
+  CreateConstraints(correspondences,
+                    num_correspondences,
+                    rotation_matrix1,
+                    rotation_matrix2,
+                    constraints);
 
   // Initialize the weighting terms for each correspondence.
-  Eigen::VectorXd weights(correspondences.size());
-  weights.setConstant(1.0);
+  std::fill(weights, weights + num_correspondences, 1.0);
 
   // Solve for the relative positions using a robust IRLS.
   double cost = 0;
@@ -148,25 +161,26 @@ bool OptimizeRelativePositionWithKnownRotation(
   for (int i = 0;
        i < kMaxIterations && num_inner_iterations < kMaxInnerIterations;
        i++) {
-    // Limit the minimum weight at kMinWeight.
-    weights = (weights.array() < kMinWeight).select(kMinWeight, weights);
-
-    // Apply the weights to the constraint matrix.
-    const Eigen::Matrix3d lhs = constraint_matrix *
-                                weights.asDiagonal().inverse() *
-                                constraint_matrix.transpose();
+    // Apply the weights to the constraints, limiting the minimum weight at
+    // kMinWeight.
+    Eigen::Matrix3d lhs = Eigen::Matrix3d::Zero();
+    for (int j = 0; j < num_correspondences; j++) {
+      const double inverse_weight = 1.0 / std::max(weights[j], kMinWeight);
+      lhs.noalias() +=
+          inverse_weight * constraints[j] * constraints[j].transpose();
+    }
 
     // Solve for the relative position which is the null vector of the weighted
-    // constraints.
-    const Eigen::Vector3d new_relative_position =
-        lhs.jacobiSvd(Eigen::ComputeFullU).matrixU().rightCols<1>();
-
-    // Update the weights based on the current errors.
-    weights =
-        (new_relative_position.transpose() * constraint_matrix).array().abs();
-
-    // Compute the new cost.
-    const double new_cost = weights.sum();
+    // constraints. The fixed-size SVD does not allocate.
+    const Eigen::JacobiSVD<Eigen::Matrix3d> svd(lhs, Eigen::ComputeFullU);
+    const Eigen::Vector3d new_relative_position = svd.matrixU().col(2);
+
+    // Update the weights based on the current errors and compute the new cost.
+    double new_cost = 0;
+    for (int j = 0; j < num_correspondences; j++) {
+      weights[j] = std::abs(new_relative_position.dot(constraints[j]));
+      new_cost += weights[j];
+    }
 
     // Check for convergence.
     const double delta = std::max(std::abs(cost - new_cost),
@@ -187,8 +201,9 @@ bool OptimizeRelativePositionWithKnownRotation(
   // position. We can determine the sign by choosing the sign that puts the most
   // points in front of the camera.
   if (!MajorityOfPointsInFrontOfCameras(correspondences,
-                                        rotation1,
-                                        rotation2,
+                                        num_correspondences,
+                                        rotation_matrix1,
+                                        rotation_matrix2,
                                         *relative_position)) {
     *relative_position *= -1.0;
   }
@@ -55,6 +55,25 @@ bool OptimizeRelativePositionWithKnownRotation(
     const Eigen::Vector3d& rotation2,
     Eigen::Vector3d* relative_position);
 
+// Scratch memory for the IRLS solver below. The buffers only grow, so reusing a
+// single instance across many view pairs avoids any heap allocation once it is
+// large enough for the largest pair.
+struct RelativePositionOptimizationBuffer {
+  std::vector<Eigen::Vector3d> constraints;
+  std::vector<double> weights;
+};
+
+// Same as above, but operates on a contiguous array of correspondences and
+// reuses the given scratch buffer. This is the kernel used when refining the
+// relative positions of many view pairs at once.
+bool OptimizeRelativePositionWithKnownRotation(
+    const FeatureCorrespondence* correspondences,
+    const int num_correspondences,
+    const Eigen::Vector3d& rotation1,
+    const Eigen::Vector3d& rotation2,
+    RelativePositionOptimizationBuffer* buffer,
+    Eigen::Vector3d* relative_position);
+
 }  // namespace theia
 
 #endif  // THEIA_SFM_BUNDLE_ADJUSTMENT_OPTIMIZE_RELATIVE_POSITION_WITH_KNOWN_ROTATION_H_
@@ -218,4 +218,51 @@ TEST(OptimizeRelativePositionWithKnownRotationTest, PixelAndTranslationNoise) {
                    kTolerance);
 }
 
+// The batched kernel must give the same result as the vector interface when the
+// scratch buffer is reused for problems of different sizes.
+TEST(OptimizeRelativePositionWithKnownRotationTest, ReusedBuffer) {
+  static const double kPixelNoise = 1.0;
+  static const int kNumPoints[3] = { 100, 20, 60 };
+
+  RelativePositionOptimizationBuffer buffer;
+  for (int i = 0; i < 3; i++) {
+    Camera camera1 = RandomCamera();
+    Camera camera2 = RandomCamera();
+    camera2.SetPosition(camera2.GetPosition().normalized());
+
+    std::vector<FeatureCorrespondence> matches;
+    for (int j = 0; j < kNumPoints[i]; j++) {
+      const Eigen::Vector4d point(rng.RandDouble(-2.0, 2.0),
+                                  rng.RandDouble(-2.0, 2.0),
+                                  rng.RandDouble(8.0, 10.0),
+                                  1.0);
+      FeatureCorrespondence match;
+      camera1.ProjectPoint(point, &match.feature1);
+      camera2.ProjectPoint(point, &match.feature2);
+      AddNoiseToProjection(kPixelNoise, &rng, &match.feature1);
+      AddNoiseToProjection(kPixelNoise, &rng, &match.feature2);
+      match.feature1 =
+          camera1.PixelToNormalizedCoordinates(match.feature1).hnormalized();
+      match.feature2 =
+          camera2.PixelToNormalizedCoordinates(match.feature2).hnormalized();
+      matches.emplace_back(match);
+    }
+
+    Eigen::Vector3d expected_position, position;
+    EXPECT_TRUE(OptimizeRelativePositionWithKnownRotation(
+        matches,
+        camera1.GetOrientationAsAngleAxis(),
+        camera2.GetOrientationAsAngleAxis(),
+        &expected_position));
+    EXPECT_TRUE(OptimizeRelativePositionWithKnownRotation(
+        matches.data(),
+        matches.size(),
+        camera1.GetOrientationAsAngleAxis(),
+        camera2.GetOrientationAsAngleAxis(),
+        &buffer,
+        &position));
+    EXPECT_EQ(expected_position, position);
+  }
+}
+
 }  // namespace theia
@@ -0,0 +1,1164 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/sfm/bundle_adjustment/partitioned_bundle_adjustment.h"
+
+#include <cereal/archives/portable_binary.hpp>
+#include <cereal/types/vector.hpp>
+#include <ceres/ceres.h>
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <glog/logging.h>
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// The environment of the worker processes.
+extern char** environ;
+#endif  // _WIN32
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>  // NOLINT
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "theia/io/eigen_serializable.h"
+#include "theia/math/graph/normalized_graph_cut.h"
+#include "theia/sfm/bundle_adjustment/bundle_adjuster.h"
+#include "theia/sfm/bundle_adjustment/create_loss_function.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera/create_reprojection_error_cost_function.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/view.h"
+#include "theia/util/filesystem.h"
+#include "theia/util/hash.h"
+#include "theia/util/map_util.h"
+#include "theia/util/stringprintf.h"
+#include "theia/util/threadpool.h"
+#include "theia/util/timer.h"
+
+namespace theia {
+
+namespace {
+
+// The spectral solver of the normalized graph cut is not reliable for very
+// small graphs, so smaller sets of views are simply split by their ids.
+static const int kMinNumViewsForGraphCut = 16;
+
+// The number of homogeneous coordinates of a track.
+static const int kTrackSize = 4;
+
+// The consensus weights are regularized by this fraction of their mean diagonal
+// so that directions that the reprojection errors do not constrain (e.g. the
+// scale of homogeneous points) remain well defined.
+static const double kWeightRegularization = 1e-6;
+
+typedef std::unordered_map<ViewIdPair, double> CovisibilityGraph;
+
+// Returns the graph of estimated views where the weight of each edge is the
+// number of estimated tracks that both views observe.
+CovisibilityGraph ComputeCovisibilityGraph(
+    const Reconstruction& reconstruction) {
+  CovisibilityGraph covisibility_graph;
+  std::vector<ViewId> view_ids;
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    const Track* track = reconstruction.Track(track_id);
+    if (!track->IsEstimated()) {
+      continue;
+    }
+
+    view_ids.clear();
+    for (const ViewId view_id : track->ViewIds()) {
+      const View* view = reconstruction.View(view_id);
+      if (view != nullptr && view->IsEstimated()) {
+        view_ids.emplace_back(view_id);
+      }
+    }
+    std::sort(view_ids.begin(), view_ids.end());
+
+    for (int i = 0; i < view_ids.size(); i++) {
+      for (int j = i + 1; j < view_ids.size(); j++) {
+        covisibility_graph[ViewIdPair(view_ids[i], view_ids[j])] += 1.0;
+      }
+    }
+  }
+  return covisibility_graph;
+}
+
+// Splits the views in two with a normalized graph cut of the covisibility graph
+// between them.
+void BisectViews(const std::unordered_set<ViewId>& view_ids,
+                 const CovisibilityGraph& covisibility_graph,
+                 std::unordered_set<ViewId>* subset1,
+                 std::unordered_set<ViewId>* subset2) {
+  if (view_ids.size() >= kMinNumViewsForGraphCut) {
+    CovisibilityGraph subgraph;
+    for (const auto& edge : covisibility_graph) {
+      if (ContainsKey(view_ids, edge.first.first) &&
+          ContainsKey(view_ids, edge.first.second)) {
+        subgraph.emplace(edge);
+      }
+    }
+
+    NormalizedGraphCut<ViewId>::Options ncut_options;
+    NormalizedGraphCut<ViewId> ncut(ncut_options);
+    if (ncut.ComputeCut(subgraph, subset1, subset2, nullptr) &&
+        !subset1->empty() && !subset2->empty()) {
+      // Views that share no tracks with the other views are not part of the
+      // graph, so add them to the smaller subset.
+      for (const ViewId view_id : view_ids) {
+        if (!ContainsKey(*subset1, view_id) &&
+            !ContainsKey(*subset2, view_id)) {
+          if (subset1->size() <= subset2->size()) {
+            subset1->emplace(view_id);
+          } else {
+            subset2->emplace(view_id);
+          }
+        }
+      }
+      return;
+    }
+  }
+
+  // Fall back to splitting the views in half by their ids.
+  subset1->clear();
+  subset2->clear();
+  std::vector<ViewId> sorted_view_ids(view_ids.begin(), view_ids.end());
+  std::sort(sorted_view_ids.begin(), sorted_view_ids.end());
+  for (int i = 0; i < sorted_view_ids.size(); i++) {
+    if (i < sorted_view_ids.size() / 2) {
+      subset1->emplace(sorted_view_ids[i]);
+    } else {
+      subset2->emplace(sorted_view_ids[i]);
+    }
+  }
+}
+
+// Returns the intrinsics parameters that BundleAdjuster optimizes for the
+// intrinsics group, i.e. those of a representative view of the group.
+double* MutableIntrinsicsOfGroup(const CameraIntrinsicsGroupId group_id,
+                                 Reconstruction* reconstruction) {
+  const auto& view_ids =
+      reconstruction->GetViewsInCameraIntrinsicGroup(group_id);
+  CHECK(!view_ids.empty());
+  return reconstruction->MutableView(*view_ids.begin())
+      ->MutableCamera()
+      ->mutable_intrinsics();
+}
+
+// Returns the cost of the reprojection errors of all estimated tracks in the
+// estimated views, as it is computed by bundle adjustment.
+double ComputeReprojectionCost(const BundleAdjustmentOptions& options,
+                               const Reconstruction& reconstruction) {
+  const std::unique_ptr<ceres::LossFunction> loss_function =
+      CreateLossFunction(options.loss_function_type, options.robust_loss_width);
+
+  double cost = 0.0;
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    const Track* track = reconstruction.Track(track_id);
+    if (!track->IsEstimated()) {
+      continue;
+    }
+
+    for (const ViewId view_id : track->ViewIds()) {
+      const View* view = reconstruction.View(view_id);
+      if (view == nullptr || !view->IsEstimated()) {
+        continue;
+      }
+
+      Eigen::Vector2d projection;
+      view->Camera().ProjectPoint(track->Point(), &projection);
+      const Feature* feature = CHECK_NOTNULL(view->GetFeature(track_id));
+      double rho[3];
+      loss_function->Evaluate((projection - *feature).squaredNorm(), rho);
+      cost += 0.5 * rho[0];
+    }
+  }
+  return cost;
+}
+
+// The ADMM penalty 1/2 * ||x - target||^2_W, given the upper triangular
+// square root S of the weight W = S^T * S, that pulls the estimate x of a
+// separator parameter block towards its consensus value.
+class ConsensusPenaltyError : public ceres::CostFunction {
+ public:
+  ConsensusPenaltyError(const Eigen::VectorXd& target,
+                        const Eigen::MatrixXd& sqrt_weight)
+      : target_(target), sqrt_weight_(sqrt_weight) {
+    set_num_residuals(target_.size());
+    mutable_parameter_block_sizes()->push_back(target_.size());
+  }
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const {
+    const int size = target_.size();
+    Eigen::Map<Eigen::VectorXd>(residuals, size) =
+        sqrt_weight_ *
+        (Eigen::Map<const Eigen::VectorXd>(parameters[0], size) - target_);
+    if (jacobians != nullptr && jacobians[0] != nullptr) {
+      Eigen::Map<
+          Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+                        Eigen::RowMajor> >(jacobians[0], size, size) =
+          sqrt_weight_;
+    }
+    return true;
+  }
+
+ private:
+  const Eigen::VectorXd target_;
+  const Eigen::MatrixXd sqrt_weight_;
+};
+
+// A bundle adjuster that additionally penalizes the deviation of parameter
+// blocks from their consensus targets.
+class ConsensusBundleAdjuster : public BundleAdjuster {
+ public:
+  ConsensusBundleAdjuster(const BundleAdjustmentOptions& options,
+                          Reconstruction* reconstruction)
+      : BundleAdjuster(options, reconstruction) {}
+
+  // The parameter block must already be part of the problem, i.e. this must be
+  // called after AddView and AddTrack.
+  void AddConsensusPenalty(double* parameters,
+                           const Eigen::VectorXd& target,
+                           const Eigen::MatrixXd& sqrt_weight) {
+    CHECK(problem_->HasParameterBlock(parameters));
+    problem_->AddResidualBlock(new ConsensusPenaltyError(target, sqrt_weight),
+                               nullptr,
+                               parameters);
+  }
+};
+
+// Identifies a parameter block by its type and the id of the view, camera
+// intrinsics group, or track that it belongs to. The ids are the same in the
+// input reconstruction and in the partitions, so that the parameter blocks of a
+// partition may be addressed even when it is not held in memory.
+struct ParameterBlockId {
+  enum Type { EXTRINSICS = 0, INTRINSICS = 1, POINT = 2 };
+
+  Type type;
+  uint32_t id;
+
+  template <class Archive>
+  void serialize(Archive& ar) {  // NOLINT
+    ar(type, id);
+  }
+};
+
+double* MutableParameterBlock(const ParameterBlockId& parameter_block,
+                              Reconstruction* reconstruction) {
+  switch (parameter_block.type) {
+    case ParameterBlockId::EXTRINSICS:
+      return reconstruction->MutableView(parameter_block.id)
+          ->MutableCamera()
+          ->mutable_extrinsics();
+    case ParameterBlockId::INTRINSICS:
+      return MutableIntrinsicsOfGroup(parameter_block.id, reconstruction);
+    case ParameterBlockId::POINT:
+      return reconstruction->MutableTrack(parameter_block.id)
+          ->MutablePoint()
+          ->data();
+  }
+  LOG(FATAL) << "Invalid parameter block type.";
+  return nullptr;
+}
+
+int ParameterBlockSize(const ParameterBlockId& parameter_block,
+                       const Reconstruction& reconstruction) {
+  switch (parameter_block.type) {
+    case ParameterBlockId::EXTRINSICS:
+      return Camera::kExtrinsicsSize;
+    case ParameterBlockId::INTRINSICS:
+      return reconstruction
+          .View(*reconstruction
+                     .GetViewsInCameraIntrinsicGroup(parameter_block.id)
+                     .begin())
+          ->Camera()
+          .CameraIntrinsics()
+          ->NumParameters();
+    case ParameterBlockId::POINT:
+      return kTrackSize;
+  }
+  LOG(FATAL) << "Invalid parameter block type.";
+  return 0;
+}
+
+// The consensus penalty of a separator in one partition.
+struct ConsensusPenalty {
+  ParameterBlockId parameter_block;
+  Eigen::VectorXd target;
+  Eigen::MatrixXd sqrt_weight;
+
+  template <class Archive>
+  void serialize(Archive& ar) {  // NOLINT
+    ar(parameter_block, target, sqrt_weight);
+  }
+};
+
+// A parameter block that is optimized by one or more partitions. The consensus
+// value of the block is held in the input reconstruction.
+struct ConsensusVariable {
+  ParameterBlockId parameter_block;
+  double* consensus;
+  int size;
+  // The partitions that optimize the parameter block.
+  std::vector<int> partitions;
+  // The estimate of each partition, the scaled dual variable of each estimate,
+  // and the weight of the consensus penalty. These are only used when the block
+  // is a separator, i.e. when it is optimized by multiple partitions.
+  std::vector<Eigen::VectorXd> estimates;
+  std::vector<Eigen::VectorXd> duals;
+  Eigen::MatrixXd weight;
+
+  bool IsSeparator() const { return partitions.size() > 1; }
+};
+
+struct Partition {
+  // The partition is held in memory when it is bundle adjusted by threads and
+  // stored in a file otherwise.
+  std::unique_ptr<Reconstruction> reconstruction;
+  std::string filepath;
+  std::string input_filepath;
+  // The variables optimized by this partition given as the index of the
+  // variable and the index of this partition in the partitions of the variable.
+  std::vector<std::pair<int, int> > variables;
+};
+
+// The partitions that contain each view, in increasing order.
+typedef std::unordered_map<ViewId, std::vector<int> > PartitionsOfViews;
+
+// Consensus ADMM minimizes the sum of the partition costs, so an observation
+// must be added to only one partition for the sum to be the cost of the full
+// problem. The observations of views that several partitions contain are
+// distributed among these partitions by track id, so that each partition keeps
+// some of the observations of its overlapping views.
+bool IsObservationInPartition(const PartitionsOfViews& partitions_of_views,
+                              const ViewId view_id,
+                              const TrackId track_id,
+                              const int partition) {
+  const std::vector<int>& partitions =
+      FindOrDie(partitions_of_views, view_id);
+  return partitions[track_id % partitions.size()] == partition;
+}
+
+// Returns the views of the partition that have observations of estimated tracks
+// in the partition and these tracks.
+void GetPartitionViewsAndTracks(
+    const Reconstruction& reconstruction,
+    const std::unordered_set<ViewId>& view_ids,
+    const int partition,
+    const PartitionsOfViews& partitions_of_views,
+    std::unordered_set<ViewId>* partition_view_ids,
+    std::unordered_set<TrackId>* partition_track_ids) {
+  for (const ViewId view_id : view_ids) {
+    for (const TrackId track_id : reconstruction.View(view_id)->TrackIds()) {
+      if (reconstruction.Track(track_id)->IsEstimated() &&
+          IsObservationInPartition(
+              partitions_of_views, view_id, track_id, partition)) {
+        partition_view_ids->emplace(view_id);
+        partition_track_ids->emplace(track_id);
+      }
+    }
+  }
+}
+
+// Copies the views of the partition, the tracks they observe, and the
+// observations that belong to the partition. Each partition owns a deep copy of
+// the camera intrinsics so that the partitions may be optimized independently.
+void CreatePartitionReconstruction(const Reconstruction& reconstruction,
+                                   const std::unordered_set<ViewId>& view_ids,
+                                   const int partition,
+                                   const PartitionsOfViews& partitions_of_views,
+                                   Reconstruction* partition_reconstruction) {
+  std::unordered_set<ViewId> partition_view_ids;
+  std::unordered_set<TrackId> partition_track_ids;
+  GetPartitionViewsAndTracks(reconstruction, view_ids, partition,
+                             partitions_of_views, &partition_view_ids,
+                             &partition_track_ids);
+  reconstruction.GetSubReconstruction(partition_view_ids,
+                                      partition_reconstruction);
+
+  // Remove the observations that belong to other partitions and the estimated
+  // tracks that are left without observations.
+  for (const ViewId view_id : partition_view_ids) {
+    View* view = partition_reconstruction->MutableView(view_id);
+    for (const TrackId track_id : view->TrackIds()) {
+      Track* track = partition_reconstruction->MutableTrack(track_id);
+      if (track->IsEstimated() &&
+          !IsObservationInPartition(
+              partitions_of_views, view_id, track_id, partition)) {
+        view->RemoveFeature(track_id);
+        track->RemoveView(view_id);
+      }
+    }
+  }
+  for (const TrackId track_id : partition_reconstruction->TrackIds()) {
+    if (partition_reconstruction->Track(track_id)->IsEstimated() &&
+        !ContainsKey(partition_track_ids, track_id)) {
+      partition_reconstruction->RemoveTrack(track_id);
+    }
+  }
+
+  for (const CameraIntrinsicsGroupId group_id :
+       partition_reconstruction->CameraIntrinsicsGroupIds()) {
+    const auto& group_view_ids =
+        partition_reconstruction->GetViewsInCameraIntrinsicGroup(group_id);
+    Camera camera;
+    camera.DeepCopy(
+        partition_reconstruction->View(*group_view_ids.begin())->Camera());
+    for (const ViewId view_id : group_view_ids) {
+      partition_reconstruction->MutableView(view_id)
+          ->MutableCamera()
+          ->MutableCameraIntrinsics() = camera.MutableCameraIntrinsics();
+    }
+  }
+}
+
+// Returns the parameter blocks that the partition optimizes, i.e. those of the
+// views and tracks that CreatePartitionReconstruction copies.
+std::vector<ParameterBlockId> GetPartitionParameterBlocks(
+    const Reconstruction& reconstruction,
+    const std::unordered_set<ViewId>& view_ids,
+    const int partition,
+    const PartitionsOfViews& partitions_of_views) {
+  std::unordered_set<ViewId> partition_view_ids;
+  std::unordered_set<TrackId> partition_track_ids;
+  GetPartitionViewsAndTracks(reconstruction, view_ids, partition,
+                             partitions_of_views, &partition_view_ids,
+                             &partition_track_ids);
+
+  std::vector<ParameterBlockId> parameter_blocks;
+  std::unordered_set<CameraIntrinsicsGroupId> group_ids;
+  for (const ViewId view_id : partition_view_ids) {
+    parameter_blocks.push_back({ParameterBlockId::EXTRINSICS, view_id});
+    group_ids.emplace(
+        reconstruction.CameraIntrinsicsGroupIdFromViewId(view_id));
+  }
+  for (const CameraIntrinsicsGroupId group_id : group_ids) {
+    parameter_blocks.push_back({ParameterBlockId::INTRINSICS, group_id});
+  }
+  for (const TrackId track_id : partition_track_ids) {
+    parameter_blocks.push_back({ParameterBlockId::POINT, track_id});
+  }
+  return parameter_blocks;
+}
+
+// Accumulates the Gauss-Newton approximation J^T * J of the Hessian of the
+// reprojection errors in the reconstruction with respect to each parameter
+// block.
+void ComputeParameterBlockHessians(
+    Reconstruction* reconstruction,
+    std::unordered_map<double*, Eigen::MatrixXd>* hessians) {
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      RowMajorMatrixXd;
+  for (const TrackId track_id : reconstruction->TrackIds()) {
+    Track* track = reconstruction->MutableTrack(track_id);
+    if (!track->IsEstimated()) {
+      continue;
+    }
+
+    for (const ViewId view_id : track->ViewIds()) {
+      View* view = reconstruction->MutableView(view_id);
+      if (!view->IsEstimated()) {
+        continue;
+      }
+
+      Camera* camera = view->MutableCamera();
+      const std::unique_ptr<ceres::CostFunction> cost_function(
+          CreateReprojectionErrorCostFunction(
+              camera->GetCameraIntrinsicsModelType(),
+              *view->GetFeature(track_id)));
+      double* parameters[3] = {camera->mutable_extrinsics(),
+                               camera->mutable_intrinsics(),
+                               track->MutablePoint()->data()};
+      const std::vector<int>& sizes = cost_function->parameter_block_sizes();
+      std::vector<RowMajorMatrixXd> jacobians(3);
+      double* jacobian_pointers[3];
+      for (int i = 0; i < 3; i++) {
+        jacobians[i].resize(cost_function->num_residuals(), sizes[i]);
+        jacobian_pointers[i] = jacobians[i].data();
+      }
+      Eigen::Vector2d residuals;
+      if (!cost_function->Evaluate(
+              parameters, residuals.data(), jacobian_pointers)) {
+        continue;
+      }
+
+      for (int i = 0; i < 3; i++) {
+        Eigen::MatrixXd& hessian = (*hessians)[parameters[i]];
+        if (hessian.size() == 0) {
+          hessian.setZero(sizes[i], sizes[i]);
+        }
+        hessian += jacobians[i].transpose() * jacobians[i];
+      }
+    }
+  }
+}
+
+// Returns the consensus penalties of the separators of the partition. The ADMM
+// update pulls each estimate towards the consensus value minus its scaled dual
+// variable.
+std::vector<ConsensusPenalty> GetConsensusPenalties(
+    const std::vector<ConsensusVariable>& variables,
+    const double penalty,
+    const Partition& partition) {
+  std::vector<ConsensusPenalty> penalties;
+  for (const auto& partition_variable : partition.variables) {
+    const ConsensusVariable& variable = variables[partition_variable.first];
+    if (!variable.IsSeparator()) {
+      continue;
+    }
+
+    penalties.emplace_back();
+    ConsensusPenalty& consensus_penalty = penalties.back();
+    consensus_penalty.parameter_block = variable.parameter_block;
+    consensus_penalty.target =
+        Eigen::Map<const Eigen::VectorXd>(variable.consensus, variable.size) -
+        variable.duals[partition_variable.second];
+    Eigen::MatrixXd weight = variable.weight;
+    // The reprojection errors leave the scale of a homogeneous point free, so
+    // a point that few observations in the partition constrain may drift
+    // towards zero or infinity. Penalize its scale as strongly as the rest.
+    if (variable.parameter_block.type == ParameterBlockId::POINT) {
+      const Eigen::VectorXd direction = consensus_penalty.target.normalized();
+      weight += weight.trace() / variable.size * direction *
+                direction.transpose();
+    }
+    consensus_penalty.sqrt_weight =
+        std::sqrt(penalty) * weight.llt().matrixU().toDenseMatrix();
+  }
+  return penalties;
+}
+
+// Bundle adjusts the partition with the consensus penalties on its separators.
+bool OptimizePartition(const BundleAdjustmentOptions& options,
+                       const std::vector<ConsensusPenalty>& penalties,
+                       Reconstruction* reconstruction) {
+  ConsensusBundleAdjuster bundle_adjuster(options, reconstruction);
+  for (const ViewId view_id : reconstruction->ViewIds()) {
+    bundle_adjuster.AddView(view_id);
+  }
+  for (const TrackId track_id : reconstruction->TrackIds()) {
+    bundle_adjuster.AddTrack(track_id);
+  }
+
+  for (const ConsensusPenalty& penalty : penalties) {
+    double* parameters =
+        MutableParameterBlock(penalty.parameter_block, reconstruction);
+    // The reprojection errors do not constrain the scale of homogeneous points
+    // so the partition may have scaled them arbitrarily. Scale the estimate to
+    // the target before penalizing their difference.
+    if (penalty.parameter_block.type == ParameterBlockId::POINT) {
+      Eigen::Map<Eigen::Vector4d> point(parameters);
+      point *= penalty.target.squaredNorm() / point.dot(penalty.target);
+    }
+    bundle_adjuster.AddConsensusPenalty(
+        parameters, penalty.target, penalty.sqrt_weight);
+  }
+
+  return bundle_adjuster.Optimize().success;
+}
+
+template <typename T>
+bool WriteToFile(const T& value, const std::string& filepath) {
+  std::ofstream output_writer(filepath, std::ios::out | std::ios::binary);
+  if (!output_writer.is_open()) {
+    LOG(ERROR) << "Could not open the file: " << filepath << " for writing.";
+    return false;
+  }
+
+  // Make sure that Cereal is able to finish executing before returning.
+  {
+    cereal::PortableBinaryOutputArchive output_archive(output_writer);
+    output_archive(value);
+  }
+  return output_writer.good();
+}
+
+template <typename T>
+bool ReadFromFile(const std::string& filepath, T* value) {
+  std::ifstream input_reader(filepath, std::ios::in | std::ios::binary);
+  if (!input_reader.is_open()) {
+    LOG(ERROR) << "Could not open the file: " << filepath << " for reading.";
+    return false;
+  }
+
+  // Make sure that Cereal is able to finish executing before returning.
+  {
+    cereal::PortableBinaryInputArchive input_archive(input_reader);
+    input_archive(*value);
+  }
+  return true;
+}
+
+// The input of a worker process that is written next to its partition.
+struct PartitionWorkerInput {
+  BundleAdjustmentOptions options;
+  std::vector<ConsensusPenalty> penalties;
+
+  template <class Archive>
+  void serialize(Archive& ar) {  // NOLINT
+    ar(options.loss_function_type,
+       options.robust_loss_width,
+       options.solver_type,
+       options.linear_solver_type,
+       options.preconditioner_type,
+       options.visibility_clustering_type,
+       options.verbose,
+       options.constant_camera_orientation,
+       options.constant_camera_position,
+       options.intrinsics_to_optimize,
+       options.num_threads,
+       options.max_num_iterations,
+       options.max_solver_time_in_seconds,
+       options.use_inner_iterations,
+       options.reprojection_error_evaluation_type,
+       options.function_tolerance,
+       options.gradient_tolerance,
+       options.parameter_tolerance,
+       options.max_trust_region_radius,
+       penalties);
+  }
+};
+
+// Bundle adjusts each partition with the consensus penalties of the current
+// consensus estimates.
+void OptimizePartitions(const PartitionedBundleAdjustmentOptions& options,
+                        const std::vector<ConsensusVariable>& variables,
+                        const double penalty,
+                        ThreadPool* pool,
+                        std::vector<Partition>* partitions,
+                        std::vector<char>* partition_success) {
+  if (options.worker_type == PartitionedBundleAdjustmentWorkerType::THREADS) {
+    ParallelFor(pool, 0, partitions->size(), 1,
+                [&](const int start, const int end) {
+                  for (int i = start; i < end; i++) {
+                    (*partition_success)[i] = OptimizePartition(
+                        options.bundle_adjustment_options,
+                        GetConsensusPenalties(variables, penalty,
+                                              (*partitions)[i]),
+                        (*partitions)[i].reconstruction.get());
+                  }
+                });
+    return;
+  }
+
+#ifdef _WIN32
+  LOG(ERROR) << "Worker processes are not supported on Windows.";
+  std::fill(partition_success->begin(), partition_success->end(), 0);
+#else
+  // Each worker process is spawned once the input of its partition is written.
+  // At most num_threads workers run at a time. The workers are waited for by
+  // their pids so that other child processes of the caller are left alone.
+  std::deque<std::pair<pid_t, int> > workers;
+  const auto wait_for_oldest_worker = [&]() {
+    int status;
+    const pid_t pid = workers.front().first;
+    (*partition_success)[workers.front().second] =
+        waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+        WEXITSTATUS(status) == EXIT_SUCCESS;
+    workers.pop_front();
+  };
+  for (int i = 0; i < partitions->size(); i++) {
+    const Partition& partition = (*partitions)[i];
+    PartitionWorkerInput input;
+    input.options = options.bundle_adjustment_options;
+    input.penalties = GetConsensusPenalties(variables, penalty, partition);
+    if (!WriteToFile(input, partition.input_filepath)) {
+      (*partition_success)[i] = false;
+      continue;
+    }
+
+    if (workers.size() == options.num_threads) {
+      wait_for_oldest_worker();
+    }
+    std::vector<std::string> arguments = {
+        options.worker_executable,
+        "--partition=" + partition.filepath,
+        "--input=" + partition.input_filepath};
+    std::vector<char*> argv;
+    for (std::string& argument : arguments) {
+      argv.emplace_back(&argument[0]);
+    }
+    argv.emplace_back(nullptr);
+    pid_t pid;
+    const int error = posix_spawn(&pid, options.worker_executable.c_str(),
+                                  nullptr, nullptr, argv.data(), environ);
+    if (error != 0) {
+      LOG(ERROR) << "Could not run the worker " << options.worker_executable
+                 << ": " << std::strerror(error);
+      (*partition_success)[i] = false;
+      continue;
+    }
+    workers.emplace_back(pid, i);
+  }
+  while (!workers.empty()) {
+    wait_for_oldest_worker();
+  }
+#endif  // _WIN32
+}
+
+// Returns the partition from memory or, if it is stored on disk, reads it into
+// storage.
+Reconstruction* GetPartitionReconstruction(
+    const Partition& partition, std::unique_ptr<Reconstruction>* storage) {
+  if (partition.reconstruction != nullptr) {
+    return partition.reconstruction.get();
+  }
+  storage->reset(new Reconstruction());
+  if (!ReadFromFile(partition.filepath, storage->get())) {
+    return nullptr;
+  }
+  return storage->get();
+}
+
+}  // namespace
+
+bool BundleAdjustPartitionFile(const std::string& partition_filepath,
+                               const std::string& input_filepath) {
+  Reconstruction reconstruction;
+  PartitionWorkerInput input;
+  return ReadFromFile(partition_filepath, &reconstruction) &&
+         ReadFromFile(input_filepath, &input) &&
+         OptimizePartition(input.options, input.penalties, &reconstruction) &&
+         WriteToFile(reconstruction, partition_filepath);
+}
+
+void PartitionReconstructionViews(
+    const PartitionedBundleAdjustmentOptions& options,
+    const Reconstruction& reconstruction,
+    std::vector<std::unordered_set<ViewId> >* partitions) {
+  CHECK_NOTNULL(partitions)->clear();
+  CHECK_GT(options.max_num_views_per_partition, 0);
+  CHECK_GE(options.partition_overlap_ratio, 0.0);
+
+  std::unordered_set<ViewId> estimated_view_ids;
+  for (const ViewId view_id : reconstruction.ViewIds()) {
+    if (reconstruction.View(view_id)->IsEstimated()) {
+      estimated_view_ids.emplace(view_id);
+    }
+  }
+  if (estimated_view_ids.empty()) {
+    return;
+  }
+
+  // Recursively bisect the views until each partition is small enough.
+  const CovisibilityGraph covisibility_graph =
+      ComputeCovisibilityGraph(reconstruction);
+  std::vector<std::unordered_set<ViewId> > views_to_partition;
+  views_to_partition.emplace_back(std::move(estimated_view_ids));
+  while (!views_to_partition.empty()) {
+    std::unordered_set<ViewId> view_ids = std::move(views_to_partition.back());
+    views_to_partition.pop_back();
+    if (view_ids.size() <= options.max_num_views_per_partition) {
+      partitions->emplace_back(std::move(view_ids));
+      continue;
+    }
+
+    std::unordered_set<ViewId> subset1, subset2;
+    BisectViews(view_ids, covisibility_graph, &subset1, &subset2);
+    views_to_partition.emplace_back(std::move(subset1));
+    views_to_partition.emplace_back(std::move(subset2));
+  }
+
+  if (partitions->size() < 2 || options.partition_overlap_ratio == 0.0) {
+    return;
+  }
+
+  // Accumulate the number of tracks that each view of another partition shares
+  // with the partition.
+  std::unordered_map<ViewId, int> partition_of_view;
+  for (int i = 0; i < partitions->size(); i++) {
+    for (const ViewId view_id : (*partitions)[i]) {
+      partition_of_view[view_id] = i;
+    }
+  }
+  std::vector<std::unordered_map<ViewId, double> > neighbor_weights(
+      partitions->size());
+  for (const auto& edge : covisibility_graph) {
+    const int partition1 = FindOrDie(partition_of_view, edge.first.first);
+    const int partition2 = FindOrDie(partition_of_view, edge.first.second);
+    if (partition1 != partition2) {
+      neighbor_weights[partition1][edge.first.second] += edge.second;
+      neighbor_weights[partition2][edge.first.first] += edge.second;
+    }
+  }
+
+  // Expand each partition with the neighboring views that share the most
+  // tracks with it.
+  for (int i = 0; i < partitions->size(); i++) {
+    std::vector<std::pair<double, ViewId> > neighbors;
+    neighbors.reserve(neighbor_weights[i].size());
+    for (const auto& neighbor : neighbor_weights[i]) {
+      neighbors.emplace_back(neighbor.second, neighbor.first);
+    }
+    std::sort(neighbors.begin(), neighbors.end(),
+              std::greater<std::pair<double, ViewId> >());
+
+    const int num_overlapping_views =
+        std::max(1,
+                 static_cast<int>(std::ceil(options.partition_overlap_ratio *
+                                            (*partitions)[i].size())));
+    for (int j = 0; j < std::min<int>(num_overlapping_views, neighbors.size());
+         j++) {
+      (*partitions)[i].emplace(neighbors[j].second);
+    }
+  }
+}
+
+PartitionedBundleAdjustmentSummary PartitionedBundleAdjustReconstruction(
+    const PartitionedBundleAdjustmentOptions& options,
+    Reconstruction* reconstruction) {
+  CHECK_NOTNULL(reconstruction);
+  CHECK_GT(options.num_threads, 0);
+  CHECK_GT(options.max_num_consensus_iterations, 0);
+  CHECK_GT(options.initial_penalty, 0.0);
+
+  Timer timer;
+  PartitionedBundleAdjustmentSummary summary;
+  summary.initial_cost = ComputeReprojectionCost(
+      options.bundle_adjustment_options, *reconstruction);
+
+  std::vector<std::unordered_set<ViewId> > partition_view_ids;
+  PartitionReconstructionViews(options, *reconstruction, &partition_view_ids);
+  summary.num_partitions = partition_view_ids.size();
+
+  // Small reconstructions are bundle adjusted as a whole.
+  if (partition_view_ids.size() <= 1) {
+    summary.setup_time_in_seconds = timer.ElapsedTimeInSeconds();
+    const BundleAdjustmentSummary ba_summary = BundleAdjustReconstruction(
+        options.bundle_adjustment_options, reconstruction);
+    summary.success = ba_summary.success;
+    summary.final_cost = ba_summary.final_cost;
+    summary.num_consensus_iterations = 1;
+    summary.solve_time_in_seconds =
+        timer.ElapsedTimeInSeconds() - summary.setup_time_in_seconds;
+    return summary;
+  }
+
+  const bool use_worker_processes =
+      options.worker_type == PartitionedBundleAdjustmentWorkerType::PROCESSES;
+  if (use_worker_processes) {
+    CHECK(!options.working_directory.empty())
+        << "A working directory is required for worker processes.";
+    CHECK(!options.worker_executable.empty())
+        << "A worker executable is required for worker processes.";
+    if (!DirectoryExists(options.working_directory) &&
+        !CreateNewDirectory(options.working_directory)) {
+      LOG(ERROR) << "Could not create the working directory "
+                 << options.working_directory;
+      return summary;
+    }
+  }
+
+  PartitionsOfViews partitions_of_views;
+  for (int i = 0; i < partition_view_ids.size(); i++) {
+    for (const ViewId view_id : partition_view_ids[i]) {
+      partitions_of_views[view_id].emplace_back(i);
+    }
+  }
+
+  // Collect the parameter blocks that each partition optimizes.
+  std::vector<Partition> partitions(partition_view_ids.size());
+  std::vector<ConsensusVariable> variables;
+  std::unordered_map<double*, int> variable_index;
+  for (int i = 0; i < partitions.size(); i++) {
+    for (const ParameterBlockId& parameter_block :
+         GetPartitionParameterBlocks(*reconstruction, partition_view_ids[i],
+                                     i, partitions_of_views)) {
+      double* consensus =
+          MutableParameterBlock(parameter_block, reconstruction);
+      const auto it = variable_index.emplace(consensus, variables.size());
+      if (it.second) {
+        variables.emplace_back();
+        variables.back().parameter_block = parameter_block;
+        variables.back().consensus = consensus;
+        variables.back().size =
+            ParameterBlockSize(parameter_block, *reconstruction);
+      }
+      ConsensusVariable& variable = variables[it.first->second];
+      partitions[i].variables.emplace_back(it.first->second,
+                                           variable.partitions.size());
+      variable.partitions.emplace_back(i);
+    }
+  }
+
+  const auto remove_partition_files = [&]() {
+    for (const Partition& partition : partitions) {
+      if (!partition.filepath.empty()) {
+        std::remove(partition.filepath.c_str());
+        std::remove(partition.input_filepath.c_str());
+      }
+    }
+  };
+
+  // Copy the views and tracks of each partition and accumulate the weights of
+  // the separators, which are the parameter blocks that are optimized by
+  // multiple partitions and must be reconciled. The consensus penalty of each
+  // separator is weighted by its Hessian in the full problem so that the
+  // penalty is comparable for all parameters regardless of their units and
+  // constrains the directions that any of the partitions observes well. When
+  // worker processes are used, the partitions are written to the working
+  // directory one at a time.
+  int num_separator_entries = 0;
+  for (ConsensusVariable& variable : variables) {
+    if (variable.IsSeparator()) {
+      num_separator_entries += variable.partitions.size() * variable.size;
+      variable.estimates.resize(variable.partitions.size());
+      variable.duals.resize(variable.partitions.size(),
+                            Eigen::VectorXd::Zero(variable.size));
+      variable.weight.setZero(variable.size, variable.size);
+    }
+  }
+  for (int i = 0; i < partitions.size(); i++) {
+    Partition& partition = partitions[i];
+    partition.reconstruction.reset(new Reconstruction());
+    CreatePartitionReconstruction(*reconstruction,
+                                  partition_view_ids[i],
+                                  i,
+                                  partitions_of_views,
+                                  partition.reconstruction.get());
+
+    std::unordered_map<double*, Eigen::MatrixXd> hessians;
+    ComputeParameterBlockHessians(partition.reconstruction.get(), &hessians);
+    for (const auto& partition_variable : partition.variables) {
+      ConsensusVariable& variable = variables[partition_variable.first];
+      if (!variable.IsSeparator()) {
+        continue;
+      }
+      const Eigen::MatrixXd* hessian = FindOrNull(
+          hessians,
+          MutableParameterBlock(variable.parameter_block,
+                                partition.reconstruction.get()));
+      if (hessian != nullptr) {
+        variable.weight += *hessian;
+      }
+    }
+
+    if (use_worker_processes) {
+      const std::string filename = StringPrintf("partition_%d", i);
+      partition.filepath = options.working_directory + "/" + filename;
+      partition.input_filepath =
+          options.working_directory + "/" + filename + "_input";
+      const bool written =
+          WriteToFile(*partition.reconstruction, partition.filepath);
+      partition.reconstruction.reset();
+      if (!written) {
+        remove_partition_files();
+        return summary;
+      }
+    }
+  }
+  for (ConsensusVariable& variable : variables) {
+    if (variable.IsSeparator()) {
+      variable.weight.diagonal().array() +=
+          kWeightRegularization * variable.weight.trace() / variable.size +
+          std::numeric_limits<double>::epsilon();
+    }
+  }
+  summary.setup_time_in_seconds = timer.ElapsedTimeInSeconds();
+
+  std::unique_ptr<ThreadPool> pool;
+  if (!use_worker_processes && options.num_threads > 1) {
+    pool.reset(new ThreadPool(options.num_threads));
+  }
+
+  double penalty = options.initial_penalty;
+  std::vector<char> partition_success(partitions.size());
+  summary.success = true;
+  for (int i = 0; i < options.max_num_consensus_iterations; i++) {
+    // Optimize each partition with the current consensus estimates.
+    OptimizePartitions(options, variables, penalty, pool.get(), &partitions,
+                       &partition_success);
+    summary.num_consensus_iterations = i + 1;
+    if (std::find(partition_success.begin(), partition_success.end(), 0) !=
+        partition_success.end()) {
+      LOG(WARNING) << "Bundle adjustment of a partition failed.";
+      summary.success = false;
+      break;
+    }
+    if (num_separator_entries == 0) {
+      break;
+    }
+
+    // Gather the estimates of the separators from the partitions.
+    for (const Partition& partition : partitions) {
+      std::unique_ptr<Reconstruction> storage;
+      Reconstruction* partition_reconstruction =
+          GetPartitionReconstruction(partition, &storage);
+      if (partition_reconstruction == nullptr) {
+        summary.success = false;
+        break;
+      }
+      for (const auto& partition_variable : partition.variables) {
+        ConsensusVariable& variable = variables[partition_variable.first];
+        if (variable.IsSeparator()) {
+          variable.estimates[partition_variable.second] =
+              Eigen::Map<const Eigen::VectorXd>(
+                  MutableParameterBlock(variable.parameter_block,
+                                        partition_reconstruction),
+                  variable.size);
+        }
+      }
+    }
+    if (!summary.success) {
+      break;
+    }
+
+    // Set the consensus estimates to the average of the partition estimates
+    // (shifted by their scaled duals) and update the duals with the remaining
+    // disagreement. The weighted norms of the residuals are used to balance
+    // the penalty.
+    double squared_primal_residual = 0.0;
+    double squared_consensus_change = 0.0;
+    double squared_weighted_primal_residual = 0.0;
+    double squared_weighted_consensus_change = 0.0;
+    for (ConsensusVariable& variable : variables) {
+      if (!variable.IsSeparator()) {
+        continue;
+      }
+
+      Eigen::Map<Eigen::VectorXd> consensus(variable.consensus, variable.size);
+      // The reprojection errors do not constrain the scale of homogeneous
+      // points so the partitions may have scaled them arbitrarily. Scale the
+      // estimates to the consensus before comparing them.
+      if (variable.parameter_block.type == ParameterBlockId::POINT) {
+        for (Eigen::VectorXd& estimate : variable.estimates) {
+          estimate *= consensus.squaredNorm() / estimate.dot(consensus);
+        }
+      }
+
+      Eigen::VectorXd sum = Eigen::VectorXd::Zero(variable.size);
+      for (int j = 0; j < variable.estimates.size(); j++) {
+        sum += variable.estimates[j] + variable.duals[j];
+      }
+      const Eigen::VectorXd consensus_change =
+          sum / static_cast<double>(variable.estimates.size()) - consensus;
+      consensus += consensus_change;
+
+      for (int j = 0; j < variable.estimates.size(); j++) {
+        const Eigen::VectorXd primal_residual =
+            variable.estimates[j] - consensus;
+        variable.duals[j] += primal_residual;
+
+        squared_primal_residual += primal_residual.squaredNorm();
+        squared_weighted_primal_residual +=
+            primal_residual.dot(variable.weight * primal_residual);
+      }
+      squared_consensus_change +=
+          variable.estimates.size() * consensus_change.squaredNorm();
+      squared_weighted_consensus_change +=
+          variable.estimates.size() *
+          consensus_change.dot(variable.weight * consensus_change);
+    }
+    summary.primal_residual =
+        std::sqrt(squared_primal_residual / num_separator_entries);
+    summary.dual_residual =
+        std::sqrt(squared_consensus_change / num_separator_entries);
+    VLOG(2) << "Consensus iteration " << i
+            << ": primal residual = " << summary.primal_residual
+            << ", dual residual = " << summary.dual_residual
+            << ", penalty = " << penalty;
+
+    if (summary.primal_residual < options.consensus_tolerance &&
+        summary.dual_residual < options.consensus_tolerance) {
+      break;
+    }
+
+    // Balance the primal and dual residuals by adapting the penalty. The scaled
+    // duals must be rescaled accordingly.
+    const double weighted_primal_residual =
+        std::sqrt(squared_weighted_primal_residual);
+    const double weighted_dual_residual =
+        penalty * std::sqrt(squared_weighted_consensus_change);
+    double dual_scale = 1.0;
+    if (weighted_primal_residual > 10.0 * weighted_dual_residual) {
+      dual_scale = 0.5;
+    } else if (weighted_dual_residual > 10.0 * weighted_primal_residual) {
+      dual_scale = 2.0;
+    }
+    if (dual_scale != 1.0) {
+      penalty /= dual_scale;
+      for (ConsensusVariable& variable : variables) {
+        for (Eigen::VectorXd& dual : variable.duals) {
+          dual *= dual_scale;
+        }
+      }
+    }
+  }
+
+  // Parameter blocks that are not separators are copied from the only
+  // partition that optimizes them.
+  for (const Partition& partition : partitions) {
+    std::unique_ptr<Reconstruction> storage;
+    Reconstruction* partition_reconstruction =
+        GetPartitionReconstruction(partition, &storage);
+    if (partition_reconstruction == nullptr) {
+      summary.success = false;
+      continue;
+    }
+    for (const auto& partition_variable : partition.variables) {
+      const ConsensusVariable& variable = variables[partition_variable.first];
+      if (!variable.IsSeparator()) {
+        const double* estimate = MutableParameterBlock(
+            variable.parameter_block, partition_reconstruction);
+        std::copy(estimate, estimate + variable.size, variable.consensus);
+      }
+    }
+  }
+  remove_partition_files();
+
+  summary.final_cost = ComputeReprojectionCost(
+      options.bundle_adjustment_options, *reconstruction);
+  summary.solve_time_in_seconds =
+      timer.ElapsedTimeInSeconds() - summary.setup_time_in_seconds;
+  return summary;
+}
+
+}  // namespace theia
@@ -0,0 +1,184 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_SFM_BUNDLE_ADJUSTMENT_PARTITIONED_BUNDLE_ADJUSTMENT_H_
+#define THEIA_SFM_BUNDLE_ADJUSTMENT_PARTITIONED_BUNDLE_ADJUSTMENT_H_
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/types.h"
+
+namespace theia {
+
+class Reconstruction;
+
+// How the clusters are bundle adjusted in parallel.
+enum class PartitionedBundleAdjustmentWorkerType {
+  // All clusters are held in memory and bundle adjusted by a thread pool.
+  THREADS = 0,
+  // The clusters are stored in a working directory and each is bundle adjusted
+  // by a worker process that runs the worker executable, which reads the
+  // cluster and its consensus penalties from disk and writes the adjusted
+  // cluster back. Only the input reconstruction and the clusters that are
+  // currently being bundle adjusted are held in memory. Worker processes are
+  // not available on Windows.
+  PROCESSES = 1,
+};
+
+// Partitioned bundle adjustment optimizes reconstructions that are too large to
+// be solved as a single bundle adjustment problem. The cameras are partitioned
+// into overlapping clusters by recursively applying normalized graph cuts to
+// the camera co-visibility graph, where the weight of each edge is the number
+// of tracks the two cameras observe in common. Each cluster is then bundle
+// adjusted independently (and in parallel) on its own copy of the cameras and
+// tracks it observes. The observations of cameras that several clusters contain
+// are divided among these clusters so that the sum of the cluster costs is the
+// cost of the full problem.
+//
+// Cameras, tracks, and camera intrinsics that appear in more than one cluster
+// are "separator" variables that are reconciled with consensus ADMM. Each
+// round, every cluster is bundle adjusted with an additional quadratic penalty
+// that pulls its separator variables towards the current consensus estimate,
+// the consensus estimate is set to the weighted average of the cluster
+// estimates, and the (scaled) dual variables of each cluster are updated with
+// the remaining disagreement. The penalty of each separator is weighted by the
+// Gauss-Newton Hessian of the cluster's reprojection errors with respect to it
+// so that a single penalty weight suits cameras, points, and intrinsics alike.
+// The penalty weight is adapted with residual balancing as in "Distributed
+// Optimization and Statistical Learning via the Alternating Direction Method of
+// Multipliers" by Boyd et al. (FnT in ML 2011). Upon
+// convergence the clusters agree on the separators and the solution is a
+// stationary point of the full bundle adjustment problem.
+//
+// This is similar in spirit to "Distributed Very Large Scale Bundle Adjustment
+// by Global Camera Consensus" by Zhang et al. (ICCV 2017).
+struct PartitionedBundleAdjustmentOptions {
+  // The options used to bundle adjust each cluster. Each cluster uses
+  // bundle_adjustment_options.num_threads threads, so up to num_threads times
+  // as many threads are used in total.
+  BundleAdjustmentOptions bundle_adjustment_options;
+
+  // The camera co-visibility graph is recursively cut until each cluster
+  // contains at most this many cameras (not counting the overlapping cameras).
+  int max_num_views_per_partition = 500;
+
+  // After partitioning, each cluster is expanded with the cameras of other
+  // clusters that share the most tracks with it. The number of cameras added is
+  // this fraction of the cluster size (and at least 1).
+  double partition_overlap_ratio = 0.1;
+
+  // The number of clusters that are bundle adjusted in parallel, i.e. the
+  // number of threads or of worker processes.
+  int num_threads = 1;
+
+  PartitionedBundleAdjustmentWorkerType worker_type =
+      PartitionedBundleAdjustmentWorkerType::THREADS;
+
+  // The directory in which the clusters are stored when worker processes are
+  // used. It is created if it does not exist, and the files written to it are
+  // removed before returning.
+  std::string working_directory;
+
+  // The path of the program run by the worker processes. It must call
+  // BundleAdjustPartitionFile with the paths given by its --partition and
+  // --input flags, as applications/partitioned_bundle_adjustment_worker does.
+  std::string worker_executable;
+
+  // The maximum number of consensus rounds. Each round bundle adjusts every
+  // cluster once.
+  int max_num_consensus_iterations = 20;
+
+  // The initial weight of the consensus penalty relative to the Hessian of the
+  // reprojection errors. The weight is adjusted during the optimization to
+  // balance the primal and dual residuals.
+  double initial_penalty = 1.0;
+
+  // The optimization stops once the RMS disagreement between the clusters and
+  // the consensus estimate, as well as the RMS change of the consensus estimate
+  // in the last round, are below this tolerance.
+  double consensus_tolerance = 1e-6;
+};
+
+struct PartitionedBundleAdjustmentSummary {
+  // This only indicates whether the optimization was successfully run and makes
+  // no guarantees on the quality or convergence.
+  bool success = false;
+  // The reprojection costs of the full reconstruction, evaluated with the loss
+  // function of the bundle adjustment options.
+  double initial_cost = 0.0;
+  double final_cost = 0.0;
+
+  int num_partitions = 0;
+  int num_consensus_iterations = 0;
+
+  // The RMS disagreement between the clusters and the consensus estimate
+  // (primal residual) and the RMS change of the consensus estimate (dual
+  // residual) in the final consensus round.
+  double primal_residual = 0.0;
+  double dual_residual = 0.0;
+
+  double setup_time_in_seconds = 0.0;
+  double solve_time_in_seconds = 0.0;
+};
+
+// Partitions the estimated views of the reconstruction into clusters of at most
+// max_num_views_per_partition views with normalized graph cuts, then expands
+// each cluster with overlapping views as described above. Every estimated view
+// appears in at least one cluster.
+void PartitionReconstructionViews(
+    const PartitionedBundleAdjustmentOptions& options,
+    const Reconstruction& reconstruction,
+    std::vector<std::unordered_set<ViewId> >* partitions);
+
+// Bundle adjusts all estimated views and tracks of the reconstruction with
+// partitioned bundle adjustment. If the reconstruction fits in a single
+// partition, this is equivalent to BundleAdjustReconstruction.
+PartitionedBundleAdjustmentSummary PartitionedBundleAdjustReconstruction(
+    const PartitionedBundleAdjustmentOptions& options,
+    Reconstruction* reconstruction);
+
+// Bundle adjusts a cluster that PartitionedBundleAdjustReconstruction stored in
+// the working directory, with the bundle adjustment options and consensus
+// penalties stored in the input file, and writes the adjusted cluster back.
+// This is the work of each worker process. Returns false if the files could not
+// be read or written or if bundle adjustment failed.
+bool BundleAdjustPartitionFile(const std::string& partition_filepath,
+                               const std::string& input_filepath);
+
+}  // namespace theia
+
+#endif  // THEIA_SFM_BUNDLE_ADJUSTMENT_PARTITIONED_BUNDLE_ADJUSTMENT_H_
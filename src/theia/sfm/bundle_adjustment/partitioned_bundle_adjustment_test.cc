@@ -0,0 +1,299 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/partitioned_bundle_adjustment.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/transformation/align_point_clouds.h"
+#include "theia/sfm/transformation/transform_reconstruction.h"
+#include "theia/sfm/types.h"
+#include "theia/util/filesystem.h"
+#include "theia/util/random.h"
+#include "theia/util/stringprintf.h"
+
+namespace theia {
+
+namespace {
+
+RandomNumberGenerator rng(59);
+
+// Creates a reconstruction of cameras moving along a street that observe the
+// points within a few meters of them. All cameras share their intrinsics, and
+// the camera heights vary so that the focal length is not confounded with the
+// depth of the points. The observations are noisy and the estimates are
+// perturbed.
+void CreateStreetReconstruction(const int num_views,
+                                const int num_tracks,
+                                Reconstruction* reconstruction) {
+  static const double kViewSpacing = 0.5;
+  static const double kMaxObservationDistance = 2.5;
+  static const double kPixelNoise = 0.5;
+  static const double kHeightVariation = 1.0;
+
+  std::vector<ViewId> view_ids;
+  for (int i = 0; i < num_views; i++) {
+    const ViewId view_id =
+        reconstruction->AddView(StringPrintf("%d", i), 0);
+    View* view = reconstruction->MutableView(view_id);
+    view->SetEstimated(true);
+    Camera* camera = view->MutableCamera();
+    camera->SetPosition(
+        Eigen::Vector3d(kViewSpacing * i, 0.0, kHeightVariation * (i % 3)));
+    camera->SetFocalLength(800.0);
+    camera->SetPrincipalPoint(400.0, 300.0);
+    view_ids.emplace_back(view_id);
+  }
+
+  const double street_length = kViewSpacing * (num_views - 1);
+  for (int i = 0; i < num_tracks; i++) {
+    const Eigen::Vector4d point(rng.RandDouble(-1.0, street_length + 1.0),
+                                rng.RandDouble(-2.0, 2.0),
+                                rng.RandDouble(4.0, 12.0),
+                                1.0);
+    std::vector<std::pair<ViewId, Feature> > observations;
+    for (const ViewId view_id : view_ids) {
+      const Camera& camera = reconstruction->View(view_id)->Camera();
+      if (std::abs(camera.GetPosition().x() - point.x()) >
+          kMaxObservationDistance) {
+        continue;
+      }
+      Feature feature;
+      camera.ProjectPoint(point, &feature);
+      feature += kPixelNoise * Feature(rng.RandGaussian(0.0, 1.0),
+                                       rng.RandGaussian(0.0, 1.0));
+      observations.emplace_back(view_id, feature);
+    }
+    if (observations.size() < 2) {
+      continue;
+    }
+
+    const TrackId track_id = reconstruction->AddTrack(observations);
+    Track* track = reconstruction->MutableTrack(track_id);
+    track->SetEstimated(true);
+    *track->MutablePoint() = point;
+    track->MutablePoint()->head<3>() += 0.05 * rng.RandVector3d();
+  }
+
+  // Perturb the cameras.
+  for (const ViewId view_id : view_ids) {
+    Camera* camera = reconstruction->MutableView(view_id)->MutableCamera();
+    camera->SetPosition(camera->GetPosition() + 0.01 * rng.RandVector3d());
+    camera->SetOrientationFromAngleAxis(0.002 * rng.RandVector3d());
+  }
+}
+
+// Copies the reconstruction created by CreateStreetReconstruction. Copying a
+// reconstruction shares the camera intrinsics, so the copy is given its own
+// intrinsics.
+void CopyStreetReconstruction(const Reconstruction& reconstruction,
+                              Reconstruction* copy) {
+  *copy = reconstruction;
+  Camera intrinsics_camera;
+  intrinsics_camera.DeepCopy(reconstruction.View(0)->Camera());
+  for (const ViewId view_id : copy->ViewIds()) {
+    copy->MutableView(view_id)->MutableCamera()->MutableCameraIntrinsics() =
+        intrinsics_camera.MutableCameraIntrinsics();
+  }
+}
+
+}  // namespace
+
+TEST(PartitionedBundleAdjustment, PartitionsCoverAllViews) {
+  static const int kNumViews = 60;
+  Reconstruction reconstruction;
+  CreateStreetReconstruction(kNumViews, 3000, &reconstruction);
+
+  PartitionedBundleAdjustmentOptions options;
+  options.max_num_views_per_partition = 20;
+  options.partition_overlap_ratio = 0.1;
+  std::vector<std::unordered_set<ViewId> > partitions;
+  PartitionReconstructionViews(options, reconstruction, &partitions);
+  EXPECT_GE(partitions.size(), kNumViews / options.max_num_views_per_partition);
+
+  std::unordered_set<ViewId> partitioned_views;
+  int num_partitioned_views = 0;
+  for (const auto& partition : partitions) {
+    // Each partition contains 10% more views from other partitions.
+    EXPECT_LE(partition.size(), 22);
+    partitioned_views.insert(partition.begin(), partition.end());
+    num_partitioned_views += partition.size();
+  }
+  EXPECT_EQ(partitioned_views.size(), kNumViews);
+  // The partitions must overlap.
+  EXPECT_GT(num_partitioned_views, kNumViews);
+}
+
+TEST(PartitionedBundleAdjustment, SinglePartition) {
+  Reconstruction reconstruction;
+  CreateStreetReconstruction(10, 1000, &reconstruction);
+
+  PartitionedBundleAdjustmentOptions options;
+  const PartitionedBundleAdjustmentSummary summary =
+      PartitionedBundleAdjustReconstruction(options, &reconstruction);
+  EXPECT_TRUE(summary.success);
+  EXPECT_EQ(summary.num_partitions, 1);
+  EXPECT_LT(summary.final_cost, summary.initial_cost);
+}
+
+TEST(PartitionedBundleAdjustment, ConvergesToGlobalBundleAdjustmentCost) {
+  static const double kRelativeCostTolerance = 0.01;
+  static const double kRelativeFocalLengthTolerance = 1e-3;
+  // The cameras are 0.5 apart and the points 4 to 12 in front of them.
+  static const double kPositionTolerance = 5e-2;
+  static const double kPointTolerance = 5e-2;
+
+  Reconstruction reconstruction;
+  CreateStreetReconstruction(40, 2000, &reconstruction);
+  Reconstruction global_reconstruction;
+  CopyStreetReconstruction(reconstruction, &global_reconstruction);
+
+  PartitionedBundleAdjustmentOptions options;
+  options.max_num_views_per_partition = 15;
+  options.num_threads = 2;
+  const PartitionedBundleAdjustmentSummary summary =
+      PartitionedBundleAdjustReconstruction(options, &reconstruction);
+  EXPECT_TRUE(summary.success);
+  EXPECT_GE(summary.num_partitions, 3);
+  EXPECT_LT(summary.final_cost, summary.initial_cost);
+
+  const BundleAdjustmentSummary global_summary = BundleAdjustReconstruction(
+      options.bundle_adjustment_options, &global_reconstruction);
+  ASSERT_TRUE(global_summary.success);
+  EXPECT_NEAR(global_summary.initial_cost, summary.initial_cost,
+              1e-6 * summary.initial_cost);
+  EXPECT_LT(summary.final_cost,
+            (1.0 + kRelativeCostTolerance) * global_summary.final_cost);
+
+  // All views share their intrinsics, so the consensus over them must agree
+  // with the focal length that the global bundle adjustment estimates.
+  const double focal_length = reconstruction.View(0)->Camera().FocalLength();
+  const double global_focal_length =
+      global_reconstruction.View(0)->Camera().FocalLength();
+  EXPECT_NEAR(focal_length, global_focal_length,
+              kRelativeFocalLengthTolerance * global_focal_length);
+
+  // The solutions must also agree up to the gauge freedom of bundle adjustment.
+  // The camera positions along the street are nearly collinear, so the points
+  // are used as well to determine the similarity transformation.
+  std::vector<Eigen::Vector3d> positions, global_positions;
+  for (const ViewId view_id : reconstruction.ViewIds()) {
+    positions.emplace_back(
+        reconstruction.View(view_id)->Camera().GetPosition());
+    global_positions.emplace_back(
+        global_reconstruction.View(view_id)->Camera().GetPosition());
+  }
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    positions.emplace_back(
+        reconstruction.Track(track_id)->Point().hnormalized());
+    global_positions.emplace_back(
+        global_reconstruction.Track(track_id)->Point().hnormalized());
+  }
+  Eigen::Matrix3d rotation;
+  Eigen::Vector3d translation;
+  double scale;
+  AlignPointCloudsUmeyama(positions, global_positions, &rotation, &translation,
+                          &scale);
+  TransformReconstruction(rotation, translation, scale, &reconstruction);
+  for (const ViewId view_id : reconstruction.ViewIds()) {
+    const Eigen::Vector3d position =
+        reconstruction.View(view_id)->Camera().GetPosition();
+    const Eigen::Vector3d global_position =
+        global_reconstruction.View(view_id)->Camera().GetPosition();
+    EXPECT_LT((position - global_position).norm(), kPositionTolerance)
+        << "View " << view_id;
+  }
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    const Eigen::Vector3d point =
+        reconstruction.Track(track_id)->Point().hnormalized();
+    const Eigen::Vector3d global_point =
+        global_reconstruction.Track(track_id)->Point().hnormalized();
+    EXPECT_LT((point - global_point).norm(), kPointTolerance)
+        << "Track " << track_id;
+  }
+}
+
+TEST(PartitionedBundleAdjustment, WorkerProcessesMatchThreads) {
+  Reconstruction reconstruction;
+  CreateStreetReconstruction(30, 1000, &reconstruction);
+  Reconstruction process_reconstruction;
+  CopyStreetReconstruction(reconstruction, &process_reconstruction);
+
+  PartitionedBundleAdjustmentOptions options;
+  options.max_num_views_per_partition = 10;
+  options.max_num_consensus_iterations = 5;
+  options.num_threads = 2;
+  const PartitionedBundleAdjustmentSummary summary =
+      PartitionedBundleAdjustReconstruction(options, &reconstruction);
+  EXPECT_TRUE(summary.success);
+
+  options.worker_type = PartitionedBundleAdjustmentWorkerType::PROCESSES;
+  options.working_directory =
+      THEIA_DATA_DIR + std::string("/partitioned_bundle_adjustment");
+  options.worker_executable = THEIA_PARTITIONED_BUNDLE_ADJUSTMENT_WORKER;
+  const PartitionedBundleAdjustmentSummary process_summary =
+      PartitionedBundleAdjustReconstruction(options, &process_reconstruction);
+  EXPECT_TRUE(process_summary.success);
+  EXPECT_EQ(process_summary.num_partitions, summary.num_partitions);
+  EXPECT_EQ(process_summary.num_consensus_iterations,
+            summary.num_consensus_iterations);
+  // The worker processes read the partitions in full precision, but the order
+  // in which the residuals are summed depends on the order of the tracks in
+  // the partitions, so the solutions agree up to rounding.
+  EXPECT_NEAR(process_summary.final_cost, summary.final_cost,
+              1e-4 * summary.final_cost);
+  for (const ViewId view_id : reconstruction.ViewIds()) {
+    const Eigen::Vector3d position =
+        reconstruction.View(view_id)->Camera().GetPosition();
+    const Eigen::Vector3d process_position =
+        process_reconstruction.View(view_id)->Camera().GetPosition();
+    EXPECT_LT((position - process_position).norm(), 1e-5)
+        << "View " << view_id;
+  }
+
+  // The partition files are removed.
+  for (int i = 0; i < process_summary.num_partitions; i++) {
+    EXPECT_FALSE(FileExists(options.working_directory +
+                            StringPrintf("/partition_%d", i)));
+  }
+}
+
+}  // namespace theia
@@ -0,0 +1,379 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/sfm/bundle_adjustment/pinhole_reprojection_error_batch.h"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "theia/util/map_util.h"
+#include "theia/util/threadpool.h"
+
+namespace theia {
+
+namespace {
+
+// Returns the skew-symmetric cross product matrix of v.
+Eigen::Matrix3d CrossProductMatrix(const Eigen::Vector3d& v) {
+  Eigen::Matrix3d cross;
+  cross << 0.0, -v[2], v[1],
+           v[2], 0.0, -v[0],
+           -v[1], v[0], 0.0;
+  return cross;
+}
+
+// Computes the rotation matrix R of the angle-axis rotation and the derivative
+// of R * a with respect to the angle-axis parameters in the form
+// -[R * a]_x * R * J_r, where J_r is the right Jacobian of SO(3). This returns
+// R and R * J_r.
+void RotationAndDerivative(const double* angle_axis,
+                           Eigen::Matrix3d* rotation,
+                           Eigen::Matrix3d* rotation_derivative) {
+  const Eigen::Map<const Eigen::Vector3d> omega(angle_axis);
+  const double theta_sq = omega.squaredNorm();
+  const Eigen::Matrix3d omega_cross = CrossProductMatrix(omega);
+  const Eigen::Matrix3d omega_cross_sq = omega_cross * omega_cross;
+
+  Eigen::Matrix3d right_jacobian;
+  if (theta_sq > std::numeric_limits<double>::epsilon()) {
+    const double theta = std::sqrt(theta_sq);
+    *rotation = Eigen::AngleAxisd(theta, omega / theta).toRotationMatrix();
+    right_jacobian = Eigen::Matrix3d::Identity() -
+                     (1.0 - std::cos(theta)) / theta_sq * omega_cross +
+                     (theta - std::sin(theta)) / (theta_sq * theta) *
+                         omega_cross_sq;
+  } else {
+    // Use the first order Taylor expansions near zero, as Ceres does.
+    *rotation = Eigen::Matrix3d::Identity() + omega_cross;
+    right_jacobian = Eigen::Matrix3d::Identity() - 0.5 * omega_cross +
+                     omega_cross_sq / 6.0;
+  }
+  *rotation_derivative = *rotation * right_jacobian;
+}
+
+}  // namespace
+
+PinholeReprojectionErrorBatch::PinholeReprojectionErrorBatch(
+    const bool use_single_precision, const int num_threads)
+    : use_single_precision_(use_single_precision),
+      chunks_are_valid_(false),
+      has_jacobians_(false) {
+  CHECK_GT(num_threads, 0);
+  if (num_threads > 1) {
+    thread_pool_.reset(new ThreadPool(num_threads));
+  }
+}
+
+PinholeReprojectionErrorBatch::~PinholeReprojectionErrorBatch() {}
+
+int PinholeReprojectionErrorBatch::AddObservation(const Feature& feature,
+                                                  const double* extrinsics,
+                                                  const double* intrinsics,
+                                                  const double* point) {
+  CHECK_NOTNULL(extrinsics);
+  CHECK_NOTNULL(intrinsics);
+  CHECK_NOTNULL(point);
+
+  int camera_index = FindWithDefault(camera_index_from_extrinsics_,
+                                     extrinsics, -1);
+  if (camera_index < 0) {
+    camera_index = cameras_.size();
+    camera_index_from_extrinsics_.emplace(extrinsics, camera_index);
+    cameras_.push_back({extrinsics, intrinsics});
+  }
+  CHECK_EQ(cameras_[camera_index].intrinsics, intrinsics)
+      << "A camera may only be observed with one intrinsics parameter block.";
+
+  observations_.push_back({feature, camera_index, point});
+  chunks_are_valid_ = false;
+  has_jacobians_ = false;
+  return observations_.size() - 1;
+}
+
+void PinholeReprojectionErrorBatch::BuildChunks() {
+  // Counting sort the observations by camera so that the observations of each
+  // camera are contiguous.
+  std::vector<int> camera_offsets(cameras_.size() + 1, 0);
+  for (const Observation& observation : observations_) {
+    ++camera_offsets[observation.camera_index + 1];
+  }
+  for (int i = 0; i < cameras_.size(); i++) {
+    camera_offsets[i + 1] += camera_offsets[i];
+  }
+
+  observation_order_.resize(observations_.size());
+  std::vector<int> insert_position(camera_offsets.begin(),
+                                   camera_offsets.end() - 1);
+  for (int i = 0; i < observations_.size(); i++) {
+    observation_order_[insert_position[observations_[i].camera_index]++] = i;
+  }
+
+  chunks_.clear();
+  for (int i = 0; i < cameras_.size(); i++) {
+    for (int begin = camera_offsets[i]; begin < camera_offsets[i + 1];
+         begin += kChunkSize) {
+      chunks_.push_back(
+          {i, begin, std::min(begin + kChunkSize, camera_offsets[i + 1])});
+    }
+  }
+
+  is_valid_.resize(observations_.size());
+  residuals_.resize(kResidualSize * observations_.size());
+  chunks_are_valid_ = true;
+}
+
+void PinholeReprojectionErrorBatch::Evaluate(const bool evaluate_jacobians) {
+  if (!chunks_are_valid_) {
+    BuildChunks();
+  }
+  if (evaluate_jacobians) {
+    extrinsics_jacobians_.resize(kExtrinsicsJacobianSize *
+                                 observations_.size());
+    intrinsics_jacobians_.resize(kIntrinsicsJacobianSize *
+                                 observations_.size());
+    point_jacobians_.resize(kPointJacobianSize * observations_.size());
+  }
+
+  ParallelFor(thread_pool_.get(), 0, chunks_.size(), 1,
+              [&](const int begin, const int end) {
+                for (int i = begin; i < end; i++) {
+                  if (use_single_precision_) {
+                    EvaluateChunk<float>(chunks_[i], evaluate_jacobians);
+                  } else {
+                    EvaluateChunk<double>(chunks_[i], evaluate_jacobians);
+                  }
+                }
+              });
+  has_jacobians_ = evaluate_jacobians;
+}
+
+template <typename T>
+void PinholeReprojectionErrorBatch::EvaluateChunk(
+    const Chunk& chunk, const bool evaluate_jacobians) {
+  typedef Eigen::Array<T, kChunkSize, 1> ArrayT;
+  static const double kVerySmallNumber = 1e-8;
+
+  const CameraParameterBlocks& camera = cameras_[chunk.camera_index];
+  const Eigen::Map<const Eigen::Vector3d> position(camera.extrinsics +
+                                                   Camera::POSITION);
+  Eigen::Matrix3d rotation_d, rotation_derivative_d;
+  RotationAndDerivative(camera.extrinsics + Camera::ORIENTATION,
+                        &rotation_d,
+                        &rotation_derivative_d);
+  const Eigen::Matrix<T, 3, 3> rotation = rotation_d.cast<T>();
+
+  const double* intrinsics = camera.intrinsics;
+  const T focal_length = intrinsics[PinholeCameraModel::FOCAL_LENGTH];
+  const T aspect_ratio = intrinsics[PinholeCameraModel::ASPECT_RATIO];
+  const T skew = intrinsics[PinholeCameraModel::SKEW];
+  const T k1 = intrinsics[PinholeCameraModel::RADIAL_DISTORTION_1];
+  const T k2 = intrinsics[PinholeCameraModel::RADIAL_DISTORTION_2];
+  const T focal_length_y = focal_length * aspect_ratio;
+
+  // Gather the points relative to the camera center. The centering is done in
+  // double precision since the point and camera center may both be far from
+  // the origin. Unused entries are padded with a point on the optical axis.
+  const int num_observations = chunk.end - chunk.begin;
+  ArrayT ax, ay, az, w;
+  ax.setZero();
+  ay.setZero();
+  az.setOnes();
+  w.setZero();
+  for (int i = 0; i < num_observations; i++) {
+    const int index = observation_order_[chunk.begin + i];
+    const Observation& observation = observations_[index];
+    const Eigen::Vector3d adjusted_point =
+        Eigen::Map<const Eigen::Vector3d>(observation.point) -
+        observation.point[3] * position;
+    // The reprojection error is not defined for points at the camera center.
+    is_valid_[index] = adjusted_point.squaredNorm() >= kVerySmallNumber;
+    ax[i] = adjusted_point[0];
+    ay[i] = adjusted_point[1];
+    az[i] = adjusted_point[2];
+    w[i] = observation.point[3];
+  }
+
+  // Rotate the points into the camera coordinate system and project them.
+  const ArrayT px = rotation(0, 0) * ax + rotation(0, 1) * ay +
+                    rotation(0, 2) * az;
+  const ArrayT py = rotation(1, 0) * ax + rotation(1, 1) * ay +
+                    rotation(1, 2) * az;
+  const ArrayT pz = rotation(2, 0) * ax + rotation(2, 1) * ay +
+                    rotation(2, 2) * az;
+  const ArrayT inv_depth = pz.inverse();
+  const ArrayT u = px * inv_depth;
+  const ArrayT v = py * inv_depth;
+
+  // Apply the radial distortion and the calibration.
+  const ArrayT r_sq = u.square() + v.square();
+  const ArrayT d = T(1) + r_sq * (k1 + k2 * r_sq);
+  const ArrayT distorted_u = u * d;
+  const ArrayT distorted_v = v * d;
+  const ArrayT reprojection_x = focal_length * distorted_u + skew * distorted_v;
+  const ArrayT reprojection_y = focal_length_y * distorted_v;
+
+  // The principal point and the feature are applied in double precision.
+  for (int i = 0; i < num_observations; i++) {
+    const int index = observation_order_[chunk.begin + i];
+    const Observation& observation = observations_[index];
+    double* residual = residuals_.data() + kResidualSize * index;
+    residual[0] = static_cast<double>(reprojection_x[i]) +
+                  (intrinsics[PinholeCameraModel::PRINCIPAL_POINT_X] -
+                   observation.feature.x());
+    residual[1] = static_cast<double>(reprojection_y[i]) +
+                  (intrinsics[PinholeCameraModel::PRINCIPAL_POINT_Y] -
+                   observation.feature.y());
+  }
+
+  if (!evaluate_jacobians) {
+    return;
+  }
+
+  // M = K * D, the derivative of the reprojection with respect to the
+  // undistorted normalized point (u, v), where K is the upper triangular
+  // calibration matrix and D is the derivative of the distortion.
+  const ArrayT dd_common = T(2) * (k1 + T(2) * k2 * r_sq);
+  const ArrayT d00 = d + dd_common * u.square();
+  const ArrayT d01 = dd_common * u * v;
+  const ArrayT d11 = d + dd_common * v.square();
+  const ArrayT m00 = focal_length * d00 + skew * d01;
+  const ArrayT m01 = focal_length * d01 + skew * d11;
+  const ArrayT m10 = focal_length_y * d01;
+  const ArrayT m11 = focal_length_y * d11;
+
+  // The derivative of the reprojection with respect to the rotated point.
+  const ArrayT jp00 = m00 * inv_depth;
+  const ArrayT jp01 = m01 * inv_depth;
+  const ArrayT jp02 = -(m00 * u + m01 * v) * inv_depth;
+  const ArrayT jp10 = m10 * inv_depth;
+  const ArrayT jp11 = m11 * inv_depth;
+  const ArrayT jp12 = -(m10 * u + m11 * v) * inv_depth;
+
+  // The derivative with respect to the (unhomogenized) point, Jp * R.
+  const ArrayT jx00 =
+      jp00 * rotation(0, 0) + jp01 * rotation(1, 0) + jp02 * rotation(2, 0);
+  const ArrayT jx01 =
+      jp00 * rotation(0, 1) + jp01 * rotation(1, 1) + jp02 * rotation(2, 1);
+  const ArrayT jx02 =
+      jp00 * rotation(0, 2) + jp01 * rotation(1, 2) + jp02 * rotation(2, 2);
+  const ArrayT jx10 =
+      jp10 * rotation(0, 0) + jp11 * rotation(1, 0) + jp12 * rotation(2, 0);
+  const ArrayT jx11 =
+      jp10 * rotation(0, 1) + jp11 * rotation(1, 1) + jp12 * rotation(2, 1);
+  const ArrayT jx12 =
+      jp10 * rotation(0, 2) + jp11 * rotation(1, 2) + jp12 * rotation(2, 2);
+
+  // The derivative with respect to the angle-axis rotation is
+  // -Jp * [p]_x * R * J_r. The rows of -Jp * [p]_x are p x Jp_row.
+  const Eigen::Matrix<T, 3, 3> q = rotation_derivative_d.cast<T>();
+  const ArrayT g00 = py * jp02 - pz * jp01;
+  const ArrayT g01 = pz * jp00 - px * jp02;
+  const ArrayT g02 = px * jp01 - py * jp00;
+  const ArrayT g10 = py * jp12 - pz * jp11;
+  const ArrayT g11 = pz * jp10 - px * jp12;
+  const ArrayT g12 = px * jp11 - py * jp10;
+
+  const T cx = position[0];
+  const T cy = position[1];
+  const T cz = position[2];
+  for (int i = 0; i < num_observations; i++) {
+    const int index = observation_order_[chunk.begin + i];
+    double* extrinsics_jacobian =
+        extrinsics_jacobians_.data() + kExtrinsicsJacobianSize * index;
+    double* intrinsics_jacobian =
+        intrinsics_jacobians_.data() + kIntrinsicsJacobianSize * index;
+    double* point_jacobian =
+        point_jacobians_.data() + kPointJacobianSize * index;
+
+    // Point.
+    point_jacobian[0] = jx00[i];
+    point_jacobian[1] = jx01[i];
+    point_jacobian[2] = jx02[i];
+    point_jacobian[3] = -(jx00[i] * cx + jx01[i] * cy + jx02[i] * cz);
+    point_jacobian[4] = jx10[i];
+    point_jacobian[5] = jx11[i];
+    point_jacobian[6] = jx12[i];
+    point_jacobian[7] = -(jx10[i] * cx + jx11[i] * cy + jx12[i] * cz);
+
+    // Camera position.
+    extrinsics_jacobian[Camera::POSITION + 0] = -w[i] * jx00[i];
+    extrinsics_jacobian[Camera::POSITION + 1] = -w[i] * jx01[i];
+    extrinsics_jacobian[Camera::POSITION + 2] = -w[i] * jx02[i];
+    extrinsics_jacobian[Camera::kExtrinsicsSize + Camera::POSITION + 0] =
+        -w[i] * jx10[i];
+    extrinsics_jacobian[Camera::kExtrinsicsSize + Camera::POSITION + 1] =
+        -w[i] * jx11[i];
+    extrinsics_jacobian[Camera::kExtrinsicsSize + Camera::POSITION + 2] =
+        -w[i] * jx12[i];
+
+    // Camera orientation.
+    for (int j = 0; j < 3; j++) {
+      extrinsics_jacobian[Camera::ORIENTATION + j] =
+          g00[i] * q(0, j) + g01[i] * q(1, j) + g02[i] * q(2, j);
+      extrinsics_jacobian[Camera::kExtrinsicsSize + Camera::ORIENTATION + j] =
+          g10[i] * q(0, j) + g11[i] * q(1, j) + g12[i] * q(2, j);
+    }
+
+    // Intrinsics.
+    const int kRow = PinholeCameraModel::kIntrinsicsSize;
+    const T r_sq_u = r_sq[i] * (focal_length * u[i] + skew * v[i]);
+    const T r_sq_v = r_sq[i] * focal_length_y * v[i];
+    intrinsics_jacobian[PinholeCameraModel::FOCAL_LENGTH] = distorted_u[i];
+    intrinsics_jacobian[PinholeCameraModel::ASPECT_RATIO] = 0.0;
+    intrinsics_jacobian[PinholeCameraModel::SKEW] = distorted_v[i];
+    intrinsics_jacobian[PinholeCameraModel::PRINCIPAL_POINT_X] = 1.0;
+    intrinsics_jacobian[PinholeCameraModel::PRINCIPAL_POINT_Y] = 0.0;
+    intrinsics_jacobian[PinholeCameraModel::RADIAL_DISTORTION_1] = r_sq_u;
+    intrinsics_jacobian[PinholeCameraModel::RADIAL_DISTORTION_2] =
+        r_sq[i] * r_sq_u;
+    intrinsics_jacobian[kRow + PinholeCameraModel::FOCAL_LENGTH] =
+        aspect_ratio * distorted_v[i];
+    intrinsics_jacobian[kRow + PinholeCameraModel::ASPECT_RATIO] =
+        focal_length * distorted_v[i];
+    intrinsics_jacobian[kRow + PinholeCameraModel::SKEW] = 0.0;
+    intrinsics_jacobian[kRow + PinholeCameraModel::PRINCIPAL_POINT_X] = 0.0;
+    intrinsics_jacobian[kRow + PinholeCameraModel::PRINCIPAL_POINT_Y] = 1.0;
+    intrinsics_jacobian[kRow + PinholeCameraModel::RADIAL_DISTORTION_1] =
+        r_sq_v;
+    intrinsics_jacobian[kRow + PinholeCameraModel::RADIAL_DISTORTION_2] =
+        r_sq[i] * r_sq_v;
+  }
+}
+
+}  // namespace theia
@@ -0,0 +1,178 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_SFM_BUNDLE_ADJUSTMENT_PINHOLE_REPROJECTION_ERROR_BATCH_H_
+#define THEIA_SFM_BUNDLE_ADJUSTMENT_PINHOLE_REPROJECTION_ERROR_BATCH_H_
+
+#include <Eigen/Core>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera/pinhole_camera_model.h"
+#include "theia/sfm/feature.h"
+#include "theia/util/util.h"
+
+namespace theia {
+
+class ThreadPool;
+
+// Evaluates the reprojection errors of many observations of pinhole cameras at
+// once, along with their analytic Jacobians. This produces the same residuals
+// and Jacobians as the auto-differentiated ReprojectionError for the
+// PinholeCameraModel but avoids evaluating every observation with Jets.
+//
+// The observations are grouped by camera and each camera's observations are
+// processed in fixed-size chunks stored as a structure of arrays, so the
+// arithmetic is vectorized by Eigen over the observations of a chunk. Chunks
+// are evaluated in parallel. All per-camera quantities (the rotation and its
+// derivative with respect to the angle-axis parameters) are computed once per
+// chunk.
+//
+// The evaluation may optionally be done in single precision, which doubles the
+// SIMD width. The point is centered on the camera and the residual is offset by
+// the principal point minus the observed feature in double precision so that
+// only well-conditioned quantities are computed in single precision.
+//
+// The parameter blocks are referenced by pointer and are read each time
+// Evaluate is called, so the batch follows the values that the optimizer
+// writes to the parameter blocks.
+class PinholeReprojectionErrorBatch {
+ public:
+  static const int kResidualSize = 2;
+  static const int kPointSize = 4;
+  static const int kExtrinsicsJacobianSize =
+      kResidualSize * Camera::kExtrinsicsSize;
+  static const int kIntrinsicsJacobianSize =
+      kResidualSize * PinholeCameraModel::kIntrinsicsSize;
+  static const int kPointJacobianSize = kResidualSize * kPointSize;
+
+  PinholeReprojectionErrorBatch(const bool use_single_precision,
+                                const int num_threads);
+  ~PinholeReprojectionErrorBatch();
+
+  // Adds the observation of the (homogeneous) point by the camera with the
+  // given extrinsics and pinhole intrinsics parameter blocks and returns the
+  // index of the observation.
+  int AddObservation(const Feature& feature,
+                     const double* extrinsics,
+                     const double* intrinsics,
+                     const double* point);
+
+  int NumObservations() const { return observations_.size(); }
+
+  // Evaluates the residuals, and the Jacobians if requested, of all
+  // observations at the current values of the parameter blocks.
+  void Evaluate(const bool evaluate_jacobians);
+
+  // Returns true if the Jacobians were computed by the last call to Evaluate.
+  bool HasJacobians() const { return has_jacobians_; }
+
+  // Returns false if the observed point was too close to the camera center for
+  // the reprojection error to be defined at the last evaluation.
+  bool IsValid(const int observation) const {
+    return is_valid_[observation] != 0;
+  }
+
+  // The residuals and the row-major Jacobians with respect to each parameter
+  // block of an observation, as laid out by ceres::CostFunction.
+  const double* Residuals(const int observation) const {
+    return residuals_.data() + kResidualSize * observation;
+  }
+  const double* ExtrinsicsJacobian(const int observation) const {
+    return extrinsics_jacobians_.data() + kExtrinsicsJacobianSize * observation;
+  }
+  const double* IntrinsicsJacobian(const int observation) const {
+    return intrinsics_jacobians_.data() + kIntrinsicsJacobianSize * observation;
+  }
+  const double* PointJacobian(const int observation) const {
+    return point_jacobians_.data() + kPointJacobianSize * observation;
+  }
+
+ private:
+  // The number of observations that are evaluated together with SIMD.
+  static const int kChunkSize = 64;
+
+  struct Observation {
+    Feature feature;
+    int camera_index;
+    const double* point;
+  };
+
+  struct CameraParameterBlocks {
+    const double* extrinsics;
+    const double* intrinsics;
+  };
+
+  // A contiguous range of observations in observation_order_ of one camera.
+  struct Chunk {
+    int camera_index;
+    int begin;
+    int end;
+  };
+
+  // Groups the observations by camera and splits them into chunks.
+  void BuildChunks();
+
+  // Evaluates the observations of the chunk with the scalar type T.
+  template <typename T>
+  void EvaluateChunk(const Chunk& chunk, const bool evaluate_jacobians);
+
+  const bool use_single_precision_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+
+  std::vector<Observation> observations_;
+  std::vector<CameraParameterBlocks> cameras_;
+  std::unordered_map<const double*, int> camera_index_from_extrinsics_;
+
+  // The observation indices sorted by camera and the chunks that partition
+  // them. These are rebuilt lazily when observations are added.
+  std::vector<int> observation_order_;
+  std::vector<Chunk> chunks_;
+  bool chunks_are_valid_;
+
+  bool has_jacobians_;
+  std::vector<char> is_valid_;
+  std::vector<double> residuals_;
+  std::vector<double> extrinsics_jacobians_;
+  std::vector<double> intrinsics_jacobians_;
+  std::vector<double> point_jacobians_;
+
+  DISALLOW_COPY_AND_ASSIGN(PinholeReprojectionErrorBatch);
+};
+
+}  // namespace theia
+
+#endif  // THEIA_SFM_BUNDLE_ADJUSTMENT_PINHOLE_REPROJECTION_ERROR_BATCH_H_
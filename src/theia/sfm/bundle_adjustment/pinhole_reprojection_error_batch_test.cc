@@ -0,0 +1,232 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <ceres/ceres.h>
+#include <Eigen/Core>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/sfm/bundle_adjustment/batched_reprojection_error.h"
+#include "theia/sfm/bundle_adjustment/pinhole_reprojection_error_batch.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera/camera_intrinsics_model_type.h"
+#include "theia/sfm/camera/create_reprojection_error_cost_function.h"
+#include "theia/sfm/camera/pinhole_camera_model.h"
+#include "theia/util/random.h"
+
+namespace theia {
+
+namespace {
+
+RandomNumberGenerator rng(59);
+
+typedef std::array<double, Camera::kExtrinsicsSize> Extrinsics;
+typedef std::array<double, PinholeCameraModel::kIntrinsicsSize> Intrinsics;
+typedef std::array<double, 4> Point;
+
+struct TestObservation {
+  int camera;
+  int point;
+  Feature feature;
+};
+
+// Returns the maximum absolute difference between the arrays relative to the
+// magnitude of the expected values.
+double MaxRelativeDifference(const double* expected,
+                             const double* actual,
+                             const int size) {
+  double max_difference = 0.0;
+  for (int i = 0; i < size; i++) {
+    max_difference =
+        std::max(max_difference, std::abs(expected[i] - actual[i]) /
+                                     std::max(1.0, std::abs(expected[i])));
+  }
+  return max_difference;
+}
+
+void TestBatchMatchesAutodiff(const bool use_single_precision,
+                              const double tolerance) {
+  static const int kNumCameras = 5;
+  static const int kNumPoints = 200;
+  static const int kNumThreads = 4;
+
+  // Set up cameras looking down the z-axis. The first camera has a nearly zero
+  // rotation to exercise the small angle approximations.
+  std::vector<Extrinsics> extrinsics(kNumCameras);
+  std::vector<Intrinsics> intrinsics(kNumCameras);
+  for (int i = 0; i < kNumCameras; i++) {
+    const Eigen::Vector3d position = 0.5 * rng.RandVector3d();
+    const Eigen::Vector3d rotation =
+        (i == 0 ? 1e-10 : 0.2) * rng.RandVector3d();
+    std::copy(position.data(), position.data() + 3,
+              extrinsics[i].begin() + Camera::POSITION);
+    std::copy(rotation.data(), rotation.data() + 3,
+              extrinsics[i].begin() + Camera::ORIENTATION);
+    intrinsics[i] = {rng.RandDouble(600.0, 1200.0), 1.1, 0.2, 500.0, 400.0,
+                     -0.1, 0.01};
+  }
+
+  // Homogeneous points in front of the cameras.
+  std::vector<Point> points(kNumPoints);
+  for (int i = 0; i < kNumPoints; i++) {
+    const Eigen::Vector3d point = rng.RandVector3d() + Eigen::Vector3d(0, 0, 8);
+    const double w = rng.RandDouble(0.5, 2.0);
+    points[i] = {w * point.x(), w * point.y(), w * point.z(), w};
+  }
+
+  // Most cameras observe most points, in an arbitrary order.
+  PinholeReprojectionErrorBatch batch(use_single_precision, kNumThreads);
+  std::vector<TestObservation> observations;
+  for (int i = 0; i < kNumPoints; i++) {
+    for (int j = 0; j < kNumCameras; j++) {
+      if (rng.RandDouble(0.0, 1.0) < 0.2) {
+        continue;
+      }
+      const TestObservation observation = {
+          j, i, Feature(rng.RandDouble(0.0, 1000.0),
+                        rng.RandDouble(0.0, 800.0))};
+      EXPECT_EQ(batch.AddObservation(observation.feature,
+                                     extrinsics[j].data(),
+                                     intrinsics[j].data(),
+                                     points[i].data()),
+                static_cast<int>(observations.size()));
+      observations.push_back(observation);
+    }
+  }
+  EXPECT_EQ(batch.NumObservations(), static_cast<int>(observations.size()));
+
+  ReprojectionErrorBatchEvaluationCallback callback(&batch);
+  callback.PrepareForEvaluation(true, true);
+  ASSERT_TRUE(batch.HasJacobians());
+
+  for (int i = 0; i < observations.size(); i++) {
+    const TestObservation& observation = observations[i];
+    const double* parameters[3] = {extrinsics[observation.camera].data(),
+                                   intrinsics[observation.camera].data(),
+                                   points[observation.point].data()};
+
+    std::unique_ptr<ceres::CostFunction> autodiff_cost_function(
+        CreateReprojectionErrorCostFunction(CameraIntrinsicsModelType::PINHOLE,
+                                            observation.feature));
+    double expected_residuals[2];
+    double expected_extrinsics_jacobian[2 * Camera::kExtrinsicsSize];
+    double expected_intrinsics_jacobian[2 *
+                                        PinholeCameraModel::kIntrinsicsSize];
+    double expected_point_jacobian[2 * 4];
+    double* expected_jacobians[3] = {expected_extrinsics_jacobian,
+                                     expected_intrinsics_jacobian,
+                                     expected_point_jacobian};
+    ASSERT_TRUE(autodiff_cost_function->Evaluate(
+        parameters, expected_residuals, expected_jacobians));
+
+    // The point is held constant so that its Jacobian is not requested.
+    BatchedReprojectionError batched_cost_function(&batch, i);
+    double residuals[2];
+    double extrinsics_jacobian[2 * Camera::kExtrinsicsSize];
+    double intrinsics_jacobian[2 * PinholeCameraModel::kIntrinsicsSize];
+    double* jacobians[3] = {extrinsics_jacobian, intrinsics_jacobian, nullptr};
+    ASSERT_TRUE(
+        batched_cost_function.Evaluate(parameters, residuals, jacobians));
+
+    EXPECT_LT(MaxRelativeDifference(expected_residuals, residuals, 2),
+              tolerance);
+    EXPECT_LT(MaxRelativeDifference(expected_extrinsics_jacobian,
+                                    extrinsics_jacobian,
+                                    2 * Camera::kExtrinsicsSize),
+              tolerance);
+    EXPECT_LT(MaxRelativeDifference(expected_intrinsics_jacobian,
+                                    intrinsics_jacobian,
+                                    2 * PinholeCameraModel::kIntrinsicsSize),
+              tolerance);
+    EXPECT_LT(MaxRelativeDifference(expected_point_jacobian,
+                                    batch.PointJacobian(i),
+                                    2 * 4),
+              tolerance);
+  }
+}
+
+}  // namespace
+
+TEST(PinholeReprojectionErrorBatch, DoublePrecisionMatchesAutodiff) {
+  static const double kTolerance = 1e-8;
+  TestBatchMatchesAutodiff(false, kTolerance);
+}
+
+TEST(PinholeReprojectionErrorBatch, SinglePrecisionMatchesAutodiff) {
+  static const double kTolerance = 1e-3;
+  TestBatchMatchesAutodiff(true, kTolerance);
+}
+
+TEST(PinholeReprojectionErrorBatch, FollowsParameterUpdates) {
+  Extrinsics extrinsics = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  Intrinsics intrinsics = {500.0, 1.0, 0.0, 250.0, 250.0, 0.0, 0.0};
+  Point point = {0.0, 0.0, 4.0, 1.0};
+  const Feature feature(250.0, 250.0);
+
+  PinholeReprojectionErrorBatch batch(false, 1);
+  ReprojectionErrorBatchEvaluationCallback callback(&batch);
+  BatchedReprojectionError cost_function(
+      &batch, batch.AddObservation(feature, extrinsics.data(),
+                                   intrinsics.data(), point.data()));
+  const double* parameters[3] = {extrinsics.data(), intrinsics.data(),
+                                 point.data()};
+
+  double residuals[2];
+  callback.PrepareForEvaluation(false, true);
+  EXPECT_FALSE(batch.HasJacobians());
+  ASSERT_TRUE(cost_function.Evaluate(parameters, residuals, nullptr));
+  EXPECT_NEAR(residuals[0], 0.0, 1e-12);
+  EXPECT_NEAR(residuals[1], 0.0, 1e-12);
+
+  // Jacobians are computed at the same point when they are requested.
+  callback.PrepareForEvaluation(true, false);
+  EXPECT_TRUE(batch.HasJacobians());
+
+  // Moving the point updates the residuals once the callback is invoked.
+  point[0] = 1.0;
+  callback.PrepareForEvaluation(false, true);
+  ASSERT_TRUE(cost_function.Evaluate(parameters, residuals, nullptr));
+  EXPECT_NEAR(residuals[0], 125.0, 1e-9);
+  EXPECT_NEAR(residuals[1], 0.0, 1e-12);
+
+  // Points at the camera center have no reprojection error.
+  point = {0.0, 0.0, 0.0, 1.0};
+  callback.PrepareForEvaluation(false, true);
+  EXPECT_FALSE(batch.IsValid(0));
+  EXPECT_FALSE(cost_function.Evaluate(parameters, residuals, nullptr));
+}
+
+}  // namespace theia
@@ -0,0 +1,886 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/sfm/bundle_adjustment/schur_bundle_adjustment_solver.h"
+
+#include <ceres/ceres.h>
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "theia/util/map_util.h"
+#include "theia/util/stringprintf.h"
+#include "theia/util/threadpool.h"
+#include "theia/util/timer.h"
+
+namespace theia {
+
+namespace {
+
+// The same constants that Ceres uses for Levenberg-Marquardt.
+static const double kMinRelativeDecrease = 1e-3;
+static const double kMinTrustRegionRadius = 1e-32;
+static const double kMinDiagonal = 1e-6;
+static const double kMaxDiagonal = 1e32;
+
+// The minimum number of items processed by each task of a ParallelFor.
+static const int kMinResidualsPerTask = 256;
+static const int kMinBlocksPerTask = 16;
+
+// Applies the robust loss to the residuals and Jacobians so that the Gauss-
+// Newton approximation of the robustified cost is J^T * J. This is the
+// correction of Triggs et al. that Ceres uses.
+void ApplyLossFunction(const double rho[3],
+                       const double sq_norm,
+                       const int num_residuals,
+                       const std::vector<std::pair<double*, int> >& jacobians,
+                       double* residuals) {
+  const double sqrt_rho1 = std::sqrt(rho[1]);
+  double residual_scaling = sqrt_rho1;
+  double alpha_sq_norm = 0.0;
+  if (sq_norm != 0.0 && rho[2] > 0.0) {
+    const double d = 1.0 + 2.0 * sq_norm * rho[2] / rho[1];
+    const double alpha = 1.0 - std::sqrt(d);
+    residual_scaling = sqrt_rho1 / (1.0 - alpha);
+    alpha_sq_norm = alpha / sq_norm;
+  }
+
+  for (const auto& jacobian : jacobians) {
+    Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+                             Eigen::RowMajor> >
+        jacobian_map(jacobian.first, num_residuals, jacobian.second);
+    const Eigen::Map<const Eigen::VectorXd> residual_map(residuals,
+                                                         num_residuals);
+    if (alpha_sq_norm != 0.0) {
+      const Eigen::RowVectorXd residual_transpose_jacobian =
+          residual_map.transpose() * jacobian_map;
+      jacobian_map -=
+          alpha_sq_norm * residual_map * residual_transpose_jacobian;
+    }
+    jacobian_map *= sqrt_rho1;
+  }
+
+  for (int i = 0; i < num_residuals; i++) {
+    residuals[i] *= residual_scaling;
+  }
+}
+
+// Returns the diagonal damping values of the block in the same way that Ceres
+// scales the LM diagonal.
+void ComputeDamping(const double* hessian, const int size, double* damping) {
+  for (int i = 0; i < size; i++) {
+    damping[i] =
+        std::min(std::max(hessian[i * size + i], kMinDiagonal), kMaxDiagonal);
+  }
+}
+
+}  // namespace
+
+SchurBundleAdjustmentSolver::SchurBundleAdjustmentSolver(
+    const Options& options,
+    const std::vector<double*>& eliminated_parameter_blocks,
+    ceres::Problem* problem)
+    : options_(options), problem_(CHECK_NOTNULL(problem)) {
+  CHECK_GT(options_.num_threads, 0);
+  if (options_.num_threads > 1) {
+    thread_pool_.reset(new ThreadPool(options_.num_threads));
+  }
+  BuildProblemStructure(eliminated_parameter_blocks);
+}
+
+SchurBundleAdjustmentSolver::~SchurBundleAdjustmentSolver() {}
+
+void SchurBundleAdjustmentSolver::BuildProblemStructure(
+    const std::vector<double*>& eliminated_parameter_blocks) {
+  const std::unordered_set<double*> eliminated(
+      eliminated_parameter_blocks.begin(), eliminated_parameter_blocks.end());
+
+  std::vector<ceres::ResidualBlockId> residual_block_ids;
+  problem_->GetResidualBlocks(&residual_block_ids);
+
+  // Gather the residual blocks and the parameter blocks that they depend on.
+  std::unordered_map<double*, int> parameter_block_index;
+  residual_blocks_.resize(residual_block_ids.size());
+  num_residuals_ = 0;
+  int jacobian_size = 0;
+  for (int i = 0; i < residual_block_ids.size(); i++) {
+    ResidualBlock& residual_block = residual_blocks_[i];
+    residual_block.cost_function =
+        problem_->GetCostFunctionForResidualBlock(residual_block_ids[i]);
+    residual_block.loss_function =
+        problem_->GetLossFunctionForResidualBlock(residual_block_ids[i]);
+    problem_->GetParameterBlocksForResidualBlock(residual_block_ids[i],
+                                                 &residual_block.parameters);
+    residual_block.num_residuals =
+        residual_block.cost_function->num_residuals();
+    residual_block.residual_offset = num_residuals_;
+    residual_block.point = -1;
+    residual_block.point_slot = -1;
+    num_residuals_ += residual_block.num_residuals;
+
+    for (double* values : residual_block.parameters) {
+      if (problem_->IsParameterBlockConstant(values)) {
+        residual_block.parameter_block_indices.push_back(-1);
+        residual_block.jacobian_offsets.push_back(-1);
+        continue;
+      }
+
+      int index = FindWithDefault(parameter_block_index, values, -1);
+      if (index < 0) {
+        index = parameter_blocks_.size();
+        parameter_block_index.emplace(values, index);
+        ParameterBlock parameter_block;
+        parameter_block.values = values;
+        parameter_block.size = problem_->ParameterBlockSize(values);
+        parameter_block.local_size = problem_->ParameterBlockLocalSize(values);
+        parameter_block.parameterization =
+            problem_->GetParameterization(values);
+        parameter_block.is_eliminated = ContainsKey(eliminated, values);
+        parameter_blocks_.emplace_back(parameter_block);
+      }
+
+      const ParameterBlock& parameter_block = parameter_blocks_[index];
+      if (parameter_block.is_eliminated) {
+        CHECK_EQ(residual_block.point, -1)
+            << "Each residual block may depend on at most one eliminated "
+               "parameter block.";
+        residual_block.point = index;
+        residual_block.point_slot =
+            residual_block.parameter_block_indices.size();
+      }
+      residual_block.parameter_block_indices.push_back(index);
+      residual_block.jacobian_offsets.push_back(jacobian_size);
+      jacobian_size +=
+          residual_block.num_residuals * parameter_block.local_size;
+    }
+  }
+
+  // Assign the offsets of the camera and point blocks.
+  num_camera_parameters_ = 0;
+  num_point_parameters_ = 0;
+  int num_camera_matrix_entries = 0;
+  int num_point_matrix_entries = 0;
+  for (int i = 0; i < parameter_blocks_.size(); i++) {
+    ParameterBlock& parameter_block = parameter_blocks_[i];
+    const int local_size = parameter_block.local_size;
+    if (parameter_block.is_eliminated) {
+      point_blocks_.emplace_back(i);
+      parameter_block.offset = num_point_parameters_;
+      parameter_block.matrix_offset = num_point_matrix_entries;
+      num_point_parameters_ += local_size;
+      num_point_matrix_entries += local_size * local_size;
+    } else {
+      camera_blocks_.emplace_back(i);
+      parameter_block.offset = num_camera_parameters_;
+      parameter_block.matrix_offset = num_camera_matrix_entries;
+      num_camera_parameters_ += local_size;
+      num_camera_matrix_entries += local_size * local_size;
+    }
+  }
+
+  // Record the residuals of each parameter block. The residuals of each camera
+  // block are sorted by point so that the contributions of each point to the
+  // diagonal blocks of the Schur complement are contiguous.
+  for (int i = 0; i < residual_blocks_.size(); i++) {
+    const ResidualBlock& residual_block = residual_blocks_[i];
+    if (residual_block.point < 0) {
+      camera_only_residual_blocks_.emplace_back(i);
+    }
+    for (int j = 0; j < residual_block.parameter_block_indices.size(); j++) {
+      const int index = residual_block.parameter_block_indices[j];
+      if (index >= 0) {
+        parameter_blocks_[index].residual_entries.emplace_back(i, j);
+      }
+    }
+  }
+  for (const int camera_block : camera_blocks_) {
+    auto& residual_entries = parameter_blocks_[camera_block].residual_entries;
+    std::stable_sort(residual_entries.begin(), residual_entries.end(),
+                     [this](const std::pair<int, int>& entry1,
+                            const std::pair<int, int>& entry2) {
+                       return residual_blocks_[entry1.first].point <
+                              residual_blocks_[entry2.first].point;
+                     });
+  }
+
+  residuals_.resize(num_residuals_);
+  candidate_residuals_.resize(num_residuals_);
+  residual_workspace_.resize(num_residuals_);
+  residual_block_costs_.resize(residual_blocks_.size());
+  residual_block_is_valid_.resize(residual_blocks_.size());
+  jacobians_.resize(jacobian_size);
+
+  camera_gradient_.resize(num_camera_parameters_);
+  point_gradient_.resize(num_point_parameters_);
+  camera_damping_.resize(num_camera_parameters_);
+  point_damping_.resize(num_point_parameters_);
+  camera_step_.resize(num_camera_parameters_);
+  point_step_.resize(num_point_parameters_);
+  camera_block_hessians_.resize(num_camera_matrix_entries);
+  camera_preconditioner_.resize(num_camera_matrix_entries);
+  point_block_hessians_.resize(num_point_matrix_entries);
+  inverse_point_block_hessians_.resize(num_point_matrix_entries);
+}
+
+bool SchurBundleAdjustmentSolver::Evaluate(const bool evaluate_jacobians,
+                                           std::vector<double>* residuals,
+                                           double* cost) {
+  if (options_.evaluation_callback != nullptr) {
+    options_.evaluation_callback->PrepareForEvaluation(evaluate_jacobians,
+                                                       true);
+  }
+
+  // The Jacobians of the parameterizations at the current parameters.
+  if (evaluate_jacobians) {
+    ParallelFor(thread_pool_.get(), 0, parameter_blocks_.size(),
+                kMinBlocksPerTask, [&](const int begin, const int end) {
+      for (int i = begin; i < end; i++) {
+        ParameterBlock& parameter_block = parameter_blocks_[i];
+        if (parameter_block.parameterization != nullptr) {
+          parameter_block.plus_jacobian.resize(parameter_block.size *
+                                               parameter_block.local_size);
+          parameter_block.parameterization->ComputeJacobian(
+              parameter_block.values, parameter_block.plus_jacobian.data());
+        }
+      }
+    });
+  }
+
+  ParallelFor(thread_pool_.get(), 0, residual_blocks_.size(),
+              kMinResidualsPerTask, [&](const int begin, const int end) {
+    // The Jacobians in the ambient space of parameter blocks that have a
+    // parameterization are written here before being projected.
+    std::vector<std::vector<double> > ambient_jacobians;
+    std::vector<double*> jacobian_pointers;
+    std::vector<std::pair<double*, int> > local_jacobians;
+    for (int i = begin; i < end; i++) {
+      const ResidualBlock& residual_block = residual_blocks_[i];
+      const int num_parameters = residual_block.parameters.size();
+      const int num_residuals = residual_block.num_residuals;
+      double* residual = residuals->data() + residual_block.residual_offset;
+
+      jacobian_pointers.assign(num_parameters, nullptr);
+      local_jacobians.clear();
+      if (evaluate_jacobians) {
+        ambient_jacobians.resize(std::max<int>(ambient_jacobians.size(),
+                                               num_parameters));
+        for (int j = 0; j < num_parameters; j++) {
+          const int index = residual_block.parameter_block_indices[j];
+          if (index < 0) {
+            continue;
+          }
+          const ParameterBlock& parameter_block = parameter_blocks_[index];
+          double* local_jacobian =
+              jacobians_.data() + residual_block.jacobian_offsets[j];
+          local_jacobians.emplace_back(local_jacobian,
+                                       parameter_block.local_size);
+          if (parameter_block.parameterization == nullptr) {
+            jacobian_pointers[j] = local_jacobian;
+          } else {
+            ambient_jacobians[j].resize(num_residuals * parameter_block.size);
+            jacobian_pointers[j] = ambient_jacobians[j].data();
+          }
+        }
+      }
+
+      bool is_valid = residual_block.cost_function->Evaluate(
+          residual_block.parameters.data(),
+          residual,
+          evaluate_jacobians ? jacobian_pointers.data() : nullptr);
+      for (int j = 0; is_valid && j < num_residuals; j++) {
+        is_valid = std::isfinite(residual[j]);
+      }
+      residual_block_is_valid_[i] = is_valid;
+      if (!is_valid) {
+        continue;
+      }
+
+      // Project the Jacobians onto the tangent spaces of the parameter blocks.
+      if (evaluate_jacobians) {
+        for (int j = 0; j < num_parameters; j++) {
+          const int index = residual_block.parameter_block_indices[j];
+          if (index < 0 ||
+              parameter_blocks_[index].parameterization == nullptr) {
+            continue;
+          }
+          const ParameterBlock& parameter_block = parameter_blocks_[index];
+          MatrixRef(jacobians_.data() + residual_block.jacobian_offsets[j],
+                    num_residuals, parameter_block.local_size) =
+              ConstMatrixRef(ambient_jacobians[j].data(), num_residuals,
+                             parameter_block.size) *
+              ConstMatrixRef(parameter_block.plus_jacobian.data(),
+                             parameter_block.size, parameter_block.local_size);
+        }
+      }
+
+      const double sq_norm =
+          ConstVectorRef(residual, num_residuals).squaredNorm();
+      if (residual_block.loss_function == nullptr) {
+        residual_block_costs_[i] = 0.5 * sq_norm;
+        continue;
+      }
+      double rho[3];
+      residual_block.loss_function->Evaluate(sq_norm, rho);
+      residual_block_costs_[i] = 0.5 * rho[0];
+      ApplyLossFunction(rho, sq_norm, num_residuals,
+                        local_jacobians, residual);
+    }
+  });
+
+  *cost = 0.0;
+  for (int i = 0; i < residual_blocks_.size(); i++) {
+    if (!residual_block_is_valid_[i]) {
+      return false;
+    }
+    *cost += residual_block_costs_[i];
+  }
+  return std::isfinite(*cost);
+}
+
+void SchurBundleAdjustmentSolver::Linearize() {
+  // Accumulates g = J^T * f and the diagonal block J^T * J for a block.
+  const auto linearize_block = [this](const ParameterBlock& parameter_block,
+                                      double* gradient,
+                                      double* hessian) {
+    const int local_size = parameter_block.local_size;
+    VectorRef gradient_map(gradient, local_size);
+    MatrixRef hessian_map(hessian, local_size, local_size);
+    gradient_map.setZero();
+    hessian_map.setZero();
+    for (const auto& entry : parameter_block.residual_entries) {
+      const ResidualBlock& residual_block = residual_blocks_[entry.first];
+      const ConstMatrixRef jacobian = Jacobian(residual_block, entry.second);
+      const ConstVectorRef residual(
+          residuals_.data() + residual_block.residual_offset,
+          residual_block.num_residuals);
+      gradient_map.noalias() += jacobian.transpose() * residual;
+      hessian_map.noalias() += jacobian.transpose() * jacobian;
+    }
+  };
+
+  ParallelFor(thread_pool_.get(), 0, camera_blocks_.size(), kMinBlocksPerTask,
+              [&](const int begin, const int end) {
+    for (int i = begin; i < end; i++) {
+      const ParameterBlock& parameter_block =
+          parameter_blocks_[camera_blocks_[i]];
+      linearize_block(
+          parameter_block,
+          camera_gradient_.data() + parameter_block.offset,
+          camera_block_hessians_.data() + parameter_block.matrix_offset);
+      ComputeDamping(
+          camera_block_hessians_.data() + parameter_block.matrix_offset,
+          parameter_block.local_size,
+          camera_damping_.data() + parameter_block.offset);
+    }
+  });
+
+  ParallelFor(thread_pool_.get(), 0, point_blocks_.size(), kMinBlocksPerTask,
+              [&](const int begin, const int end) {
+    for (int i = begin; i < end; i++) {
+      const ParameterBlock& parameter_block =
+          parameter_blocks_[point_blocks_[i]];
+      linearize_block(
+          parameter_block,
+          point_gradient_.data() + parameter_block.offset,
+          point_block_hessians_.data() + parameter_block.matrix_offset);
+      ComputeDamping(
+          point_block_hessians_.data() + parameter_block.matrix_offset,
+          parameter_block.local_size,
+          point_damping_.data() + parameter_block.offset);
+    }
+  });
+}
+
+void SchurBundleAdjustmentSolver::SchurComplementProduct(
+    const double mu, const Eigen::VectorXd& x, Eigen::VectorXd* y) {
+  // Computes z = J_c * x and q = z - J_p * V^-1 * J_p^T * z for the residuals
+  // of the residual block into the residual workspace.
+  const auto camera_jacobian_product =
+      [&](const ResidualBlock& residual_block) {
+    VectorRef z = Workspace(residual_block);
+    z.setZero();
+    for (int j = 0; j < residual_block.parameters.size(); j++) {
+      const int index = residual_block.parameter_block_indices[j];
+      if (index < 0 || index == residual_block.point) {
+        continue;
+      }
+      const ParameterBlock& parameter_block = parameter_blocks_[index];
+      z.noalias() +=
+          Jacobian(residual_block, j) *
+          x.segment(parameter_block.offset, parameter_block.local_size);
+    }
+  };
+
+  // Eliminate the points in parallel.
+  ParallelFor(thread_pool_.get(), 0, point_blocks_.size(), kMinBlocksPerTask,
+              [&](const int begin, const int end) {
+    Eigen::VectorXd point_product;
+    for (int i = begin; i < end; i++) {
+      const ParameterBlock& point = parameter_blocks_[point_blocks_[i]];
+      point_product.setZero(point.local_size);
+      for (const auto& entry : point.residual_entries) {
+        const ResidualBlock& residual_block = residual_blocks_[entry.first];
+        camera_jacobian_product(residual_block);
+        point_product.noalias() +=
+            Jacobian(residual_block, entry.second).transpose() *
+            Workspace(residual_block);
+      }
+
+      const Eigen::VectorXd point_solution =
+          InversePointHessian(point) * point_product;
+      for (const auto& entry : point.residual_entries) {
+        const ResidualBlock& residual_block = residual_blocks_[entry.first];
+        Workspace(residual_block).noalias() -=
+            Jacobian(residual_block, entry.second) * point_solution;
+      }
+    }
+  });
+  for (const int residual_block_index : camera_only_residual_blocks_) {
+    camera_jacobian_product(residual_blocks_[residual_block_index]);
+  }
+
+  // Accumulate y = J_c^T * q + mu * D * x over the camera blocks in parallel.
+  y->resize(num_camera_parameters_);
+  ParallelFor(thread_pool_.get(), 0, camera_blocks_.size(), kMinBlocksPerTask,
+              [&](const int begin, const int end) {
+    for (int i = begin; i < end; i++) {
+      const ParameterBlock& camera = parameter_blocks_[camera_blocks_[i]];
+      auto y_block = y->segment(camera.offset, camera.local_size);
+      y_block = mu *
+                camera_damping_.segment(camera.offset, camera.local_size)
+                    .cwiseProduct(x.segment(camera.offset, camera.local_size));
+      for (const auto& entry : camera.residual_entries) {
+        const ResidualBlock& residual_block = residual_blocks_[entry.first];
+        y_block.noalias() +=
+            Jacobian(residual_block, entry.second).transpose() *
+            Workspace(residual_block);
+      }
+    }
+  });
+}
+
+int SchurBundleAdjustmentSolver::ComputeStep(const double mu) {
+  // Invert the damped point blocks V + mu * D.
+  ParallelFor(thread_pool_.get(), 0, point_blocks_.size(), kMinBlocksPerTask,
+              [&](const int begin, const int end) {
+    for (int i = begin; i < end; i++) {
+      const ParameterBlock& point = parameter_blocks_[point_blocks_[i]];
+      Matrix damped_hessian =
+          ConstMatrixRef(point_block_hessians_.data() + point.matrix_offset,
+                         point.local_size, point.local_size);
+      damped_hessian.diagonal() +=
+          mu * point_damping_.segment(point.offset, point.local_size);
+      MatrixRef(inverse_point_block_hessians_.data() + point.matrix_offset,
+                point.local_size, point.local_size) =
+          damped_hessian.llt().solve(
+              Matrix::Identity(point.local_size, point.local_size));
+    }
+  });
+
+  // The right hand side of the reduced camera system is
+  // -g_c + W * V^-1 * g_p. The products J_p * V^-1 * g_p of each residual are
+  // first stored in the residual workspace.
+  ParallelFor(thread_pool_.get(), 0, point_blocks_.size(), kMinBlocksPerTask,
+              [&](const int begin, const int end) {
+    for (int i = begin; i < end; i++) {
+      const ParameterBlock& point = parameter_blocks_[point_blocks_[i]];
+      const Eigen::VectorXd point_solution =
+          InversePointHessian(point) *
+          point_gradient_.segment(point.offset, point.local_size);
+      for (const auto& entry : point.residual_entries) {
+        const ResidualBlock& residual_block = residual_blocks_[entry.first];
+        Workspace(residual_block) =
+            Jacobian(residual_block, entry.second) * point_solution;
+      }
+    }
+  });
+  for (const int residual_block_index : camera_only_residual_blocks_) {
+    Workspace(residual_blocks_[residual_block_index]).setZero();
+  }
+
+  // Compute the right hand side and the block-Jacobi preconditioner, i.e., the
+  // inverses of the diagonal blocks U_i + mu * D_i - W_i * V^-1 * W_i^T of the
+  // Schur complement. The residuals of each camera are sorted by point so that
+  // W_ip is accumulated over consecutive residuals.
+  Eigen::VectorXd rhs(num_camera_parameters_);
+  ParallelFor(thread_pool_.get(), 0, camera_blocks_.size(), kMinBlocksPerTask,
+              [&](const int begin, const int end) {
+    Matrix point_coupling;
+    for (int i = begin; i < end; i++) {
+      const ParameterBlock& camera = parameter_blocks_[camera_blocks_[i]];
+      const int local_size = camera.local_size;
+      auto rhs_block = rhs.segment(camera.offset, local_size);
+      rhs_block = -camera_gradient_.segment(camera.offset, local_size);
+
+      Matrix block =
+          ConstMatrixRef(camera_block_hessians_.data() + camera.matrix_offset,
+                         local_size, local_size);
+      block.diagonal() +=
+          mu * camera_damping_.segment(camera.offset, local_size);
+
+      const auto& entries = camera.residual_entries;
+      for (int j = 0; j < entries.size();) {
+        const int point_index = residual_blocks_[entries[j].first].point;
+        const ParameterBlock* point =
+            point_index >= 0 ? &parameter_blocks_[point_index] : nullptr;
+        if (point != nullptr) {
+          point_coupling.setZero(local_size, point->local_size);
+        }
+
+        // Accumulate over all residuals of this camera and point.
+        for (; j < entries.size() &&
+               residual_blocks_[entries[j].first].point == point_index;
+             j++) {
+          const ResidualBlock& residual_block =
+              residual_blocks_[entries[j].first];
+          const ConstMatrixRef camera_jacobian =
+              Jacobian(residual_block, entries[j].second);
+          rhs_block.noalias() +=
+              camera_jacobian.transpose() *
+              Workspace(residual_block);
+          if (point == nullptr) {
+            continue;
+          }
+          point_coupling.noalias() +=
+              camera_jacobian.transpose() *
+              Jacobian(residual_block, residual_block.point_slot);
+        }
+
+        if (point != nullptr) {
+          block.noalias() -=
+              point_coupling *
+              InversePointHessian(*point) *
+              point_coupling.transpose();
+        }
+      }
+
+      // Fall back to the damped diagonal if the block is numerically
+      // indefinite.
+      MatrixRef preconditioner(
+          camera_preconditioner_.data() + camera.matrix_offset, local_size,
+          local_size);
+      const Eigen::LLT<Matrix> llt(block);
+      if (llt.info() == Eigen::Success) {
+        preconditioner = llt.solve(Matrix::Identity(local_size, local_size));
+      } else {
+        preconditioner.setZero();
+        preconditioner.diagonal() =
+            (mu * camera_damping_.segment(camera.offset, local_size))
+                .cwiseInverse();
+      }
+    }
+  });
+
+  const auto apply_preconditioner = [this](const Eigen::VectorXd& x,
+                                           Eigen::VectorXd* y) {
+    y->resize(x.size());
+    ParallelFor(thread_pool_.get(), 0, camera_blocks_.size(),
+                kMinBlocksPerTask, [&](const int begin, const int end) {
+      for (int i = begin; i < end; i++) {
+        const ParameterBlock& camera = parameter_blocks_[camera_blocks_[i]];
+        y->segment(camera.offset, camera.local_size).noalias() =
+            ConstMatrixRef(camera_preconditioner_.data() + camera.matrix_offset,
+                           camera.local_size, camera.local_size) *
+            x.segment(camera.offset, camera.local_size);
+      }
+    });
+  };
+
+  // Solve the reduced camera system with preconditioned conjugate gradients.
+  camera_step_.setZero();
+  int num_iterations = 0;
+  const double rhs_norm = rhs.norm();
+  if (rhs_norm > 0.0) {
+    const double tolerance = options_.linear_solver_tolerance * rhs_norm;
+    Eigen::VectorXd r = rhs;
+    Eigen::VectorXd z, p, q;
+    apply_preconditioner(r, &z);
+    p = z;
+    double rz = r.dot(z);
+    while (num_iterations < options_.max_num_linear_solver_iterations) {
+      ++num_iterations;
+      SchurComplementProduct(mu, p, &q);
+      const double pq = p.dot(q);
+      if (pq <= 0.0 || !std::isfinite(pq)) {
+        break;
+      }
+      const double alpha = rz / pq;
+      camera_step_ += alpha * p;
+      r -= alpha * q;
+      if (r.norm() <= tolerance) {
+        break;
+      }
+      apply_preconditioner(r, &z);
+      const double previous_rz = rz;
+      rz = r.dot(z);
+      p = z + (rz / previous_rz) * p;
+    }
+  }
+
+  // Back substitute to obtain the point steps
+  // dp = V^-1 * (-g_p - W^T * dc).
+  ParallelFor(thread_pool_.get(), 0, point_blocks_.size(), kMinBlocksPerTask,
+              [&](const int begin, const int end) {
+    Eigen::VectorXd point_rhs;
+    for (int i = begin; i < end; i++) {
+      const ParameterBlock& point = parameter_blocks_[point_blocks_[i]];
+      point_rhs = -point_gradient_.segment(point.offset, point.local_size);
+      for (const auto& entry : point.residual_entries) {
+        const ResidualBlock& residual_block = residual_blocks_[entry.first];
+        Eigen::VectorXd camera_product =
+            Eigen::VectorXd::Zero(residual_block.num_residuals);
+        for (int j = 0; j < residual_block.parameters.size(); j++) {
+          const int index = residual_block.parameter_block_indices[j];
+          if (index < 0 || index == residual_block.point) {
+            continue;
+          }
+          const ParameterBlock& camera = parameter_blocks_[index];
+          camera_product.noalias() +=
+              Jacobian(residual_block, j) *
+              camera_step_.segment(camera.offset, camera.local_size);
+        }
+        point_rhs.noalias() -=
+            Jacobian(residual_block, entry.second).transpose() * camera_product;
+      }
+      point_step_.segment(point.offset, point.local_size).noalias() =
+          InversePointHessian(point) * point_rhs;
+    }
+  });
+
+  return num_iterations;
+}
+
+double SchurBundleAdjustmentSolver::ModelCostChange() {
+  // The change is -f^T * J * dx - 0.5 * |J * dx|^2 summed over the residual
+  // blocks.
+  ParallelFor(thread_pool_.get(), 0, residual_blocks_.size(),
+              kMinResidualsPerTask, [&](const int begin, const int end) {
+    Eigen::VectorXd jacobian_step;
+    for (int i = begin; i < end; i++) {
+      const ResidualBlock& residual_block = residual_blocks_[i];
+      jacobian_step.setZero(residual_block.num_residuals);
+      for (int j = 0; j < residual_block.parameters.size(); j++) {
+        const int index = residual_block.parameter_block_indices[j];
+        if (index < 0) {
+          continue;
+        }
+        const ParameterBlock& parameter_block = parameter_blocks_[index];
+        const Eigen::VectorXd& step =
+            parameter_block.is_eliminated ? point_step_ : camera_step_;
+        jacobian_step.noalias() +=
+            Jacobian(residual_block, j) *
+            step.segment(parameter_block.offset, parameter_block.local_size);
+      }
+      const ConstVectorRef residual(
+          residuals_.data() + residual_block.residual_offset,
+          residual_block.num_residuals);
+      residual_block_costs_[i] =
+          -residual.dot(jacobian_step) - 0.5 * jacobian_step.squaredNorm();
+    }
+  });
+
+  double model_cost_change = 0.0;
+  for (const double residual_block_cost_change : residual_block_costs_) {
+    model_cost_change += residual_block_cost_change;
+  }
+  return model_cost_change;
+}
+
+void SchurBundleAdjustmentSolver::ApplyStep() {
+  saved_parameters_.clear();
+  for (const ParameterBlock& parameter_block : parameter_blocks_) {
+    saved_parameters_.insert(saved_parameters_.end(),
+                             parameter_block.values,
+                             parameter_block.values + parameter_block.size);
+  }
+
+  ParallelFor(thread_pool_.get(), 0, parameter_blocks_.size(),
+              kMinBlocksPerTask, [&](const int begin, const int end) {
+    std::vector<double> x;
+    for (int i = begin; i < end; i++) {
+      const ParameterBlock& parameter_block = parameter_blocks_[i];
+      const Eigen::VectorXd& step =
+          parameter_block.is_eliminated ? point_step_ : camera_step_;
+      const double* delta = step.data() + parameter_block.offset;
+      if (parameter_block.parameterization == nullptr) {
+        for (int j = 0; j < parameter_block.size; j++) {
+          parameter_block.values[j] += delta[j];
+        }
+      } else {
+        x.assign(parameter_block.values,
+                 parameter_block.values + parameter_block.size);
+        parameter_block.parameterization->Plus(x.data(), delta,
+                                               parameter_block.values);
+      }
+    }
+  });
+}
+
+void SchurBundleAdjustmentSolver::RestoreParameters() {
+  int offset = 0;
+  for (const ParameterBlock& parameter_block : parameter_blocks_) {
+    std::copy(saved_parameters_.begin() + offset,
+              saved_parameters_.begin() + offset + parameter_block.size,
+              parameter_block.values);
+    offset += parameter_block.size;
+  }
+}
+
+double SchurBundleAdjustmentSolver::ParameterNorm() const {
+  double sq_norm = 0.0;
+  for (const ParameterBlock& parameter_block : parameter_blocks_) {
+    sq_norm += ConstVectorRef(parameter_block.values, parameter_block.size)
+                   .squaredNorm();
+  }
+  return std::sqrt(sq_norm);
+}
+
+SchurBundleAdjustmentSolver::Summary SchurBundleAdjustmentSolver::Solve() {
+  Timer timer;
+  Summary summary;
+
+  double cost;
+  if (!Evaluate(true, &residuals_, &cost)) {
+    summary.message = "The residuals could not be evaluated at the initial "
+                      "parameters.";
+    summary.total_time_in_seconds = timer.ElapsedTimeInSeconds();
+    return summary;
+  }
+  summary.success = true;
+  summary.initial_cost = cost;
+  Linearize();
+
+  double radius = options_.initial_trust_region_radius;
+  double decrease_factor = 2.0;
+  summary.message = "Maximum number of iterations reached.";
+  while (summary.num_iterations < options_.max_num_iterations) {
+    if (timer.ElapsedTimeInSeconds() > options_.max_solver_time_in_seconds) {
+      summary.message = "Maximum solver time reached.";
+      break;
+    }
+
+    const double gradient_max_norm =
+        std::max(camera_gradient_.lpNorm<Eigen::Infinity>(),
+                 point_gradient_.lpNorm<Eigen::Infinity>());
+    if (gradient_max_norm <= options_.gradient_tolerance) {
+      summary.message = "Gradient tolerance reached.";
+      break;
+    }
+
+    ++summary.num_iterations;
+    const int num_linear_solver_iterations = ComputeStep(1.0 / radius);
+    summary.num_linear_solver_iterations += num_linear_solver_iterations;
+    const double model_cost_change = ModelCostChange();
+
+    const double step_norm = std::sqrt(camera_step_.squaredNorm() +
+                                       point_step_.squaredNorm());
+    const double parameter_norm = ParameterNorm();
+    if (step_norm <= options_.parameter_tolerance *
+                         (parameter_norm + options_.parameter_tolerance)) {
+      summary.message = "Parameter tolerance reached.";
+      break;
+    }
+
+    // Evaluate the cost at the new parameters and accept the step if the cost
+    // decreased sufficiently relative to the decrease predicted by the model.
+    ApplyStep();
+    double new_cost = std::numeric_limits<double>::max();
+    const bool step_is_valid =
+        Evaluate(false, &candidate_residuals_, &new_cost) &&
+        model_cost_change > 0.0;
+    const double relative_decrease =
+        step_is_valid ? (cost - new_cost) / model_cost_change : 0.0;
+
+    LOG_IF(INFO, options_.verbose) << StringPrintf(
+        "% 4d: f:% 8e d:% 3.2e g:% 3.2e h:% 3.2e rho:% 3.2e mu:% 3.2e "
+        "li:% 3d",
+        summary.num_iterations, cost, cost - new_cost, gradient_max_norm,
+        step_norm, relative_decrease, radius, num_linear_solver_iterations);
+
+    if (!step_is_valid || relative_decrease <= kMinRelativeDecrease) {
+      RestoreParameters();
+      radius /= decrease_factor;
+      decrease_factor *= 2.0;
+      if (radius < kMinTrustRegionRadius) {
+        summary.message = "Minimum trust region radius reached.";
+        break;
+      }
+      continue;
+    }
+
+    // The step is successful. Relinearize at the new parameters.
+    ++summary.num_successful_steps;
+    const double cost_change = cost - new_cost;
+    const double previous_cost = cost;
+    if (!Evaluate(true, &residuals_, &cost)) {
+      // Return the parameters of the last successful step.
+      RestoreParameters();
+      summary.success = false;
+      summary.message = "The jacobians could not be evaluated at the new "
+                        "parameters.";
+      summary.final_cost = previous_cost;
+      summary.total_time_in_seconds = timer.ElapsedTimeInSeconds();
+      return summary;
+    }
+    Linearize();
+    radius = std::min(
+        options_.max_trust_region_radius,
+        radius / std::max(1.0 / 3.0,
+                          1.0 - std::pow(2.0 * relative_decrease - 1.0, 3)));
+    decrease_factor = 2.0;
+
+    if (cost_change <= options_.function_tolerance * previous_cost) {
+      summary.message = "Function tolerance reached.";
+      break;
+    }
+  }
+
+  summary.final_cost = cost;
+  summary.total_time_in_seconds = timer.ElapsedTimeInSeconds();
+  LOG_IF(INFO, options_.verbose)
+      << "Schur bundle adjustment: " << summary.message
+      << " Iterations: " << summary.num_iterations
+      << ", initial cost: " << summary.initial_cost
+      << ", final cost: " << summary.final_cost;
+  return summary;
+}
+
+}  // namespace theia
@@ -0,0 +1,274 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_SFM_BUNDLE_ADJUSTMENT_SCHUR_BUNDLE_ADJUSTMENT_SOLVER_H_
+#define THEIA_SFM_BUNDLE_ADJUSTMENT_SCHUR_BUNDLE_ADJUSTMENT_SOLVER_H_
+
+#include <ceres/ceres.h>
+#include <Eigen/Core>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "theia/util/util.h"
+
+namespace theia {
+
+class ThreadPool;
+
+// A Levenberg-Marquardt solver specialized for bundle adjustment problems. The
+// residual blocks, parameterizations, and constant parameter blocks are taken
+// from a ceres::Problem so that the problem is set up exactly as it would be
+// for Ceres, but the minimization is done natively:
+//
+//   - The parameter blocks are split into the eliminated blocks (the points)
+//     and the remaining blocks (the cameras). Each residual may depend on at
+//     most one eliminated block.
+//   - Each LM step is computed by solving the reduced camera system
+//     S * dc = b with S = U - W * V^-1 * W^T with preconditioned conjugate
+//     gradients. S is never formed; products with S are computed from the
+//     residual Jacobians (the "implicit Schur complement").
+//   - The preconditioner is the block diagonal of S, i.e., block-Jacobi over
+//     the camera parameter blocks.
+//   - The point blocks are eliminated and back-substituted in parallel, and the
+//     residuals, Jacobians, and implicit products are all evaluated in
+//     parallel.
+//
+// The trust region strategy and termination criteria mirror those of Ceres'
+// Levenberg-Marquardt solver so that both converge to the same costs.
+class SchurBundleAdjustmentSolver {
+ public:
+  struct Options {
+    int num_threads = 1;
+    int max_num_iterations = 100;
+    double max_solver_time_in_seconds = 3600.0;
+
+    // Convergence criteria. These have the same meaning as in Ceres.
+    double function_tolerance = 1e-6;
+    double gradient_tolerance = 1e-10;
+    double parameter_tolerance = 1e-8;
+
+    double initial_trust_region_radius = 1e4;
+    double max_trust_region_radius = 1e12;
+
+    // The conjugate gradients iterations for the reduced camera system stop
+    // once the residual norm has been reduced by this factor.
+    int max_num_linear_solver_iterations = 500;
+    double linear_solver_tolerance = 0.1;
+
+    // If the problem uses an evaluation callback then it must be provided here
+    // so that it is invoked before each evaluation.
+    ceres::EvaluationCallback* evaluation_callback = nullptr;
+
+    bool verbose = false;
+  };
+
+  struct Summary {
+    // This is false if the problem could not be evaluated at the initial
+    // parameters, or if the Jacobians could not be evaluated after a successful
+    // step. In the latter case the parameter blocks hold the parameters of the
+    // last step for which the Jacobians were evaluated.
+    bool success = false;
+    double initial_cost = 0.0;
+    double final_cost = 0.0;
+    int num_iterations = 0;
+    int num_successful_steps = 0;
+    int num_linear_solver_iterations = 0;
+    double total_time_in_seconds = 0.0;
+    std::string message;
+  };
+
+  // The parameter blocks in eliminated_parameter_blocks are eliminated with
+  // the Schur complement; constant blocks in the list are ignored. The problem
+  // must outlive the solver.
+  SchurBundleAdjustmentSolver(
+      const Options& options,
+      const std::vector<double*>& eliminated_parameter_blocks,
+      ceres::Problem* problem);
+  ~SchurBundleAdjustmentSolver();
+
+  // Minimizes the problem starting from the current values of the parameter
+  // blocks. The parameter blocks hold the solution upon return.
+  Summary Solve();
+
+ private:
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+                        Eigen::RowMajor> Matrix;
+  typedef Eigen::Map<Matrix> MatrixRef;
+  typedef Eigen::Map<const Matrix> ConstMatrixRef;
+  typedef Eigen::Map<Eigen::VectorXd> VectorRef;
+  typedef Eigen::Map<const Eigen::VectorXd> ConstVectorRef;
+
+  struct ParameterBlock {
+    double* values;
+    int size;
+    int local_size;
+    const ceres::LocalParameterization* parameterization;
+    bool is_eliminated;
+    // The offset of the block in the camera or point tangent space vectors.
+    int offset;
+    // The offset of the block's local_size x local_size matrices.
+    int matrix_offset;
+    // The (residual, parameter slot) pairs that depend on this block. For
+    // camera blocks these are sorted by the point of the residual.
+    std::vector<std::pair<int, int> > residual_entries;
+    // The Jacobian of the parameterization's Plus operation at the current
+    // values, size x local_size.
+    std::vector<double> plus_jacobian;
+  };
+
+  struct ResidualBlock {
+    const ceres::CostFunction* cost_function;
+    const ceres::LossFunction* loss_function;
+    std::vector<double*> parameters;
+    // The index in parameter_blocks_ of each parameter, or -1 if constant.
+    std::vector<int> parameter_block_indices;
+    // The offsets into jacobians_ of each parameter's local Jacobian.
+    std::vector<int> jacobian_offsets;
+    // The index in parameter_blocks_ of the eliminated block and its slot in
+    // parameters, or -1 if the residual does not depend on a point.
+    int point;
+    int point_slot;
+    int num_residuals;
+    int residual_offset;
+  };
+
+  // Returns the tangent space Jacobian of the residual block with respect to
+  // the parameter block in the given slot.
+  ConstMatrixRef Jacobian(const ResidualBlock& residual_block,
+                          const int slot) const {
+    return ConstMatrixRef(
+        jacobians_.data() + residual_block.jacobian_offsets[slot],
+        residual_block.num_residuals,
+        parameter_blocks_[residual_block.parameter_block_indices[slot]]
+            .local_size);
+  }
+
+  // Returns the inverse of the damped diagonal block of J^T * J of the point.
+  ConstMatrixRef InversePointHessian(const ParameterBlock& point) const {
+    return ConstMatrixRef(
+        inverse_point_block_hessians_.data() + point.matrix_offset,
+        point.local_size,
+        point.local_size);
+  }
+
+  // Returns the residual block's entries of the residual workspace.
+  VectorRef Workspace(const ResidualBlock& residual_block) {
+    return VectorRef(
+        residual_workspace_.data() + residual_block.residual_offset,
+        residual_block.num_residuals);
+  }
+
+  // Gathers the problem structure from the ceres::Problem.
+  void BuildProblemStructure(
+      const std::vector<double*>& eliminated_parameter_blocks);
+
+  // Evaluates the (robustified) residuals and optionally the Jacobians in the
+  // tangent space at the current parameter values. Returns false if any
+  // residual block could not be evaluated.
+  bool Evaluate(const bool evaluate_jacobians,
+                std::vector<double>* residuals,
+                double* cost);
+
+  // Computes the gradient and the diagonal blocks of J^T * J from the current
+  // residuals and Jacobians.
+  void Linearize();
+
+  // Computes the LM step for the damping parameter mu. Returns the number of
+  // conjugate gradients iterations.
+  int ComputeStep(const double mu);
+
+  // Computes y = S * x for the damped reduced camera system.
+  void SchurComplementProduct(const double mu,
+                              const Eigen::VectorXd& x,
+                              Eigen::VectorXd* y);
+
+  // Returns the decrease in cost predicted by the linearized model for the
+  // current step.
+  double ModelCostChange();
+
+  // Applies the current step to the parameter blocks, saving the current
+  // values so that the step may be undone with RestoreParameters.
+  void ApplyStep();
+  void RestoreParameters();
+  double ParameterNorm() const;
+
+  const Options options_;
+  ceres::Problem* problem_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+
+  std::vector<ParameterBlock> parameter_blocks_;
+  std::vector<int> camera_blocks_;
+  std::vector<int> point_blocks_;
+  std::vector<ResidualBlock> residual_blocks_;
+  // Residual blocks that do not depend on any eliminated block.
+  std::vector<int> camera_only_residual_blocks_;
+  int num_camera_parameters_;
+  int num_point_parameters_;
+  int num_residuals_;
+
+  // The residuals and tangent space Jacobians at the current parameters.
+  std::vector<double> residuals_;
+  std::vector<double> candidate_residuals_;
+  std::vector<double> residual_block_costs_;
+  std::vector<double> jacobians_;
+  std::vector<char> residual_block_is_valid_;
+
+  // The gradient and the diagonal blocks of J^T * J.
+  Eigen::VectorXd camera_gradient_;
+  Eigen::VectorXd point_gradient_;
+  std::vector<double> camera_block_hessians_;
+  std::vector<double> point_block_hessians_;
+
+  // Quantities that depend on the damping parameter.
+  std::vector<double> inverse_point_block_hessians_;
+  std::vector<double> camera_preconditioner_;
+  Eigen::VectorXd camera_damping_;
+  Eigen::VectorXd point_damping_;
+
+  // Per residual scratch space for the implicit products.
+  std::vector<double> residual_workspace_;
+
+  // The current step and the parameter values before it was applied.
+  Eigen::VectorXd camera_step_;
+  Eigen::VectorXd point_step_;
+  std::vector<double> saved_parameters_;
+
+  DISALLOW_COPY_AND_ASSIGN(SchurBundleAdjustmentSolver);
+};
+
+}  // namespace theia
+
+#endif  // THEIA_SFM_BUNDLE_ADJUSTMENT_SCHUR_BUNDLE_ADJUSTMENT_SOLVER_H_
@@ -0,0 +1,291 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <ceres/ceres.h>
+#include <Eigen/Core>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/sfm/bundle_adjustment/batched_reprojection_error.h"
+#include "theia/sfm/bundle_adjustment/pinhole_reprojection_error_batch.h"
+#include "theia/sfm/bundle_adjustment/schur_bundle_adjustment_solver.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera/camera_intrinsics_model_type.h"
+#include "theia/sfm/camera/create_reprojection_error_cost_function.h"
+#include "theia/sfm/camera/pinhole_camera_model.h"
+#include "theia/sfm/camera/reprojection_error.h"
+#include "theia/util/random.h"
+
+namespace theia {
+
+namespace {
+
+RandomNumberGenerator rng(61);
+
+struct Observation {
+  int camera;
+  int point;
+  Feature feature;
+};
+
+// A synthetic bundle adjustment problem with shared pinhole intrinsics and
+// perturbed cameras and points.
+struct TestScene {
+  std::vector<std::array<double, Camera::kExtrinsicsSize> > extrinsics;
+  std::array<double, PinholeCameraModel::kIntrinsicsSize> intrinsics;
+  std::vector<std::array<double, 4> > points;
+  std::vector<Observation> observations;
+};
+
+TestScene CreateTestScene(const int num_cameras,
+                          const int num_points,
+                          const double pixel_noise) {
+  TestScene scene;
+  scene.extrinsics.resize(num_cameras);
+  for (int i = 0; i < num_cameras; i++) {
+    const Eigen::Vector3d position = 0.5 * rng.RandVector3d();
+    const Eigen::Vector3d rotation = 0.1 * rng.RandVector3d();
+    std::copy(position.data(), position.data() + 3,
+              scene.extrinsics[i].begin() + Camera::POSITION);
+    std::copy(rotation.data(), rotation.data() + 3,
+              scene.extrinsics[i].begin() + Camera::ORIENTATION);
+  }
+  scene.intrinsics = {900.0, 1.0, 0.0, 500.0, 400.0, -0.05, 0.01};
+
+  scene.points.resize(num_points);
+  for (int i = 0; i < num_points; i++) {
+    const Eigen::Vector3d point = rng.RandVector3d() + Eigen::Vector3d(0, 0, 8);
+    scene.points[i] = {point.x(), point.y(), point.z(), 1.0};
+  }
+
+  // Observe the points with noise.
+  for (int i = 0; i < num_cameras; i++) {
+    for (int j = 0; j < num_points; j++) {
+      if (rng.RandDouble(0.0, 1.0) < 0.25) {
+        continue;
+      }
+      const ReprojectionError<PinholeCameraModel> reprojection_error(
+          Feature(0.0, 0.0));
+      Feature feature;
+      reprojection_error(scene.extrinsics[i].data(),
+                         scene.intrinsics.data(),
+                         scene.points[j].data(),
+                         feature.data());
+      feature += pixel_noise * Feature(rng.RandGaussian(0.0, 1.0),
+                                       rng.RandGaussian(0.0, 1.0));
+      scene.observations.push_back({i, j, feature});
+    }
+  }
+
+  // Perturb the estimates.
+  for (int i = 1; i < num_cameras; i++) {
+    for (int j = 0; j < Camera::kExtrinsicsSize; j++) {
+      scene.extrinsics[i][j] += rng.RandGaussian(0.0, 0.01);
+    }
+  }
+  for (int i = 0; i < num_points; i++) {
+    for (int j = 0; j < 3; j++) {
+      scene.points[i][j] += rng.RandGaussian(0.0, 0.05);
+    }
+  }
+  scene.intrinsics[PinholeCameraModel::FOCAL_LENGTH] *= 1.05;
+  scene.intrinsics[PinholeCameraModel::RADIAL_DISTORTION_1] = 0.0;
+  return scene;
+}
+
+// Adds the residuals of the scene to the problem. The first camera is held
+// constant and only the focal length and radial distortion are optimized.
+void AddSceneToProblem(TestScene* scene,
+                       ceres::LossFunction* loss_function,
+                       PinholeReprojectionErrorBatch* batch,
+                       ceres::Problem* problem) {
+  for (const Observation& observation : scene->observations) {
+    double* extrinsics = scene->extrinsics[observation.camera].data();
+    double* intrinsics = scene->intrinsics.data();
+    double* point = scene->points[observation.point].data();
+    ceres::CostFunction* cost_function;
+    if (batch != nullptr) {
+      cost_function = new BatchedReprojectionError(
+          batch, batch->AddObservation(observation.feature, extrinsics,
+                                       intrinsics, point));
+    } else {
+      cost_function = CreateReprojectionErrorCostFunction(
+          CameraIntrinsicsModelType::PINHOLE, observation.feature);
+    }
+    problem->AddResidualBlock(cost_function, loss_function, extrinsics,
+                              intrinsics, point);
+  }
+
+  problem->SetParameterBlockConstant(scene->extrinsics[0].data());
+  const std::vector<int> constant_intrinsics = {
+      PinholeCameraModel::ASPECT_RATIO, PinholeCameraModel::SKEW,
+      PinholeCameraModel::PRINCIPAL_POINT_X,
+      PinholeCameraModel::PRINCIPAL_POINT_Y};
+  problem->SetParameterization(
+      scene->intrinsics.data(),
+      new ceres::SubsetParameterization(PinholeCameraModel::kIntrinsicsSize,
+                                        constant_intrinsics));
+}
+
+void TestConvergesToCeresCost(const bool use_loss_function,
+                              const bool use_batch) {
+  static const int kNumCameras = 10;
+  static const int kNumPoints = 300;
+  static const double kPixelNoise = 0.5;
+  static const double kRelativeCostTolerance = 1e-4;
+
+  TestScene ceres_scene =
+      CreateTestScene(kNumCameras, kNumPoints, kPixelNoise);
+  TestScene schur_scene = ceres_scene;
+
+  std::unique_ptr<ceres::LossFunction> loss_function;
+  if (use_loss_function) {
+    loss_function.reset(new ceres::HuberLoss(2.0));
+  }
+  ceres::Problem::Options problem_options;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+
+  // Solve the problem with Ceres.
+  ceres::Problem ceres_problem(problem_options);
+  AddSceneToProblem(&ceres_scene, loss_function.get(), nullptr,
+                    &ceres_problem);
+  ceres::Solver::Options ceres_options;
+  ceres_options.linear_solver_type = ceres::DENSE_SCHUR;
+  ceres_options.function_tolerance = 1e-10;
+  ceres_options.max_num_iterations = 200;
+  ceres::Solver::Summary ceres_summary;
+  ceres::Solve(ceres_options, &ceres_problem, &ceres_summary);
+  ASSERT_TRUE(ceres_summary.IsSolutionUsable());
+
+  // Solve the same problem with the Schur solver.
+  PinholeReprojectionErrorBatch batch(false, 1);
+  ReprojectionErrorBatchEvaluationCallback evaluation_callback(&batch);
+  ceres::Problem schur_problem(problem_options);
+  AddSceneToProblem(&schur_scene, loss_function.get(),
+                    use_batch ? &batch : nullptr, &schur_problem);
+
+  SchurBundleAdjustmentSolver::Options schur_options;
+  schur_options.num_threads = 4;
+  schur_options.function_tolerance = 1e-10;
+  schur_options.max_num_iterations = 200;
+  if (use_batch) {
+    schur_options.evaluation_callback = &evaluation_callback;
+  }
+  std::vector<double*> points;
+  for (auto& point : schur_scene.points) {
+    points.emplace_back(point.data());
+  }
+  SchurBundleAdjustmentSolver solver(schur_options, points, &schur_problem);
+  const SchurBundleAdjustmentSolver::Summary schur_summary = solver.Solve();
+  ASSERT_TRUE(schur_summary.success);
+
+  EXPECT_NEAR(schur_summary.initial_cost, ceres_summary.initial_cost,
+              kRelativeCostTolerance * ceres_summary.initial_cost);
+  EXPECT_LT(schur_summary.final_cost, schur_summary.initial_cost);
+  EXPECT_NEAR(schur_summary.final_cost, ceres_summary.final_cost,
+              kRelativeCostTolerance * ceres_summary.final_cost);
+
+  // The constant parameters must not change.
+  EXPECT_EQ(schur_scene.extrinsics[0], ceres_scene.extrinsics[0]);
+  EXPECT_EQ(schur_scene.intrinsics[PinholeCameraModel::PRINCIPAL_POINT_X],
+            ceres_scene.intrinsics[PinholeCameraModel::PRINCIPAL_POINT_X]);
+  EXPECT_NEAR(schur_scene.intrinsics[PinholeCameraModel::FOCAL_LENGTH],
+              ceres_scene.intrinsics[PinholeCameraModel::FOCAL_LENGTH], 1.0);
+}
+
+// The residual x - 1 of a single parameter. The Jacobian can only be evaluated
+// at x = 0 so that the solver fails to relinearize after its first step.
+class JacobianOnlyAtZeroCostFunction : public ceres::SizedCostFunction<1, 1> {
+ public:
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const {
+    residuals[0] = parameters[0][0] - 1.0;
+    if (jacobians == nullptr || jacobians[0] == nullptr) {
+      return true;
+    }
+    jacobians[0][0] = 1.0;
+    return parameters[0][0] == 0.0;
+  }
+};
+
+}  // namespace
+
+TEST(SchurBundleAdjustmentSolver, ConvergesToCeresCost) {
+  TestConvergesToCeresCost(false, false);
+}
+
+TEST(SchurBundleAdjustmentSolver, ConvergesToCeresCostWithLossFunction) {
+  TestConvergesToCeresCost(true, false);
+}
+
+TEST(SchurBundleAdjustmentSolver, ConvergesToCeresCostWithBatchedResiduals) {
+  TestConvergesToCeresCost(true, true);
+}
+
+TEST(SchurBundleAdjustmentSolver, NoEliminatedParameters) {
+  // With every point held constant only the cameras are optimized.
+  TestScene scene = CreateTestScene(5, 100, 0.5);
+  ceres::Problem problem;
+  AddSceneToProblem(&scene, nullptr, nullptr, &problem);
+  for (auto& point : scene.points) {
+    problem.SetParameterBlockConstant(point.data());
+  }
+
+  SchurBundleAdjustmentSolver::Options options;
+  SchurBundleAdjustmentSolver solver(options, std::vector<double*>(),
+                                     &problem);
+  const SchurBundleAdjustmentSolver::Summary summary = solver.Solve();
+  ASSERT_TRUE(summary.success);
+  EXPECT_LT(summary.final_cost, summary.initial_cost);
+}
+
+TEST(SchurBundleAdjustmentSolver, FailsIfJacobiansCannotBeEvaluated) {
+  double x = 0.0;
+  ceres::Problem problem;
+  problem.AddResidualBlock(new JacobianOnlyAtZeroCostFunction, nullptr, &x);
+
+  SchurBundleAdjustmentSolver::Options options;
+  SchurBundleAdjustmentSolver solver(options, std::vector<double*>(),
+                                     &problem);
+  const SchurBundleAdjustmentSolver::Summary summary = solver.Solve();
+  EXPECT_FALSE(summary.success);
+  EXPECT_EQ(summary.num_successful_steps, 1);
+  EXPECT_EQ(summary.final_cost, summary.initial_cost);
+  EXPECT_EQ(x, 0.0);
+}
+
+}  // namespace theia
@@ -37,9 +37,11 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <fstream>  // NOLINT
 #include <iostream>  // NOLINT
+#include <memory>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -48,6 +50,7 @@
 #include "theia/image/image.h"
 #include "theia/sfm/camera_intrinsics_prior.h"
 #include "theia/util/map_util.h"
+#include "theia/util/threadpool.h"
 
 // Generated file
 #include "camera_sensor_database.h"
@@ -123,8 +126,17 @@ bool ExifReader::ExtractEXIFMetadata(
     CameraIntrinsicsPrior* camera_intrinsics_prior) const {
   CHECK_NOTNULL(camera_intrinsics_prior);
 
-  oiio::ImageBuf image(image_file);
-  oiio::ImageSpec image_spec = image.spec();
+  // Only open the file to read its header. This avoids the image cache that
+  // oiio::ImageBuf goes through and never decodes any pixels.
+  std::unique_ptr<oiio::ImageInput> image_input(
+      oiio::ImageInput::open(image_file));
+  if (image_input == nullptr) {
+    LOG(ERROR) << "Could not open the image " << image_file << ": "
+               << oiio::geterror();
+    return false;
+  }
+  const oiio::ImageSpec image_spec = image_input->spec();
+  image_input->close();
 
   // Set the image dimensions.
   camera_intrinsics_prior->image_width = image_spec.width;
@@ -200,6 +212,29 @@ bool ExifReader::ExtractEXIFMetadata(
   return true;
 }
 
+bool ExifReader::ExtractEXIFMetadata(
+    const std::vector<std::string>& image_files,
+    const int num_threads,
+    std::vector<CameraIntrinsicsPrior>* camera_intrinsics_priors) const {
+  CHECK_NOTNULL(camera_intrinsics_priors)->resize(image_files.size());
+
+  // Reading a header is dominated by the latency of opening the file, so
+  // images are probed in small blocks to keep all threads busy.
+  static const int kMinImagesPerTask = 4;
+  std::atomic<int> num_failures(0);
+  ThreadPool pool(num_threads);
+  ParallelFor(&pool, 0, image_files.size(), kMinImagesPerTask,
+              [&](const int start, const int end) {
+    for (int i = start; i < end; i++) {
+      if (!ExtractEXIFMetadata(image_files[i],
+                               &(*camera_intrinsics_priors)[i])) {
+        ++num_failures;
+      }
+    }
+  });
+  return num_failures == 0;
+}
+
 bool ExifReader::SetFocalLengthFromExif(
     const oiio::ImageSpec& image_spec,
     CameraIntrinsicsPrior* camera_intrinsics_prior) const {
@@ -38,6 +38,7 @@
 #include <OpenImageIO/imageio.h>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "theia/util/hash.h"
 #include "theia/util/util.h"
@@ -63,7 +64,8 @@ class ExifReader {
   ExifReader();
 
   // Extracts EXIF metadata from the image file and populates the intrinsics
-  // prior object. If the file could not be opened then the function returns
+  // prior object. Only the header of the file is read; the pixels are never
+  // decoded. If the file could not be opened then the function returns
   // false. If no EXIF data is found in the image, then it will be a valid
   // CameraIntrinsicsPrior object with the is_set field set to false for all
   // metadata field. The function will return true in this case.
@@ -71,6 +73,16 @@ class ExifReader {
       const std::string& image_file,
       CameraIntrinsicsPrior* camera_intrinsics_prior) const;
 
+  // Extracts the EXIF metadata of many image files in parallel using
+  // num_threads threads. The priors vector is resized to hold one prior per
+  // image file and each prior is populated as above, so priors that were
+  // already present are updated in place. Returns false if any of the files
+  // could not be opened, in which case the prior of that file is unchanged.
+  bool ExtractEXIFMetadata(
+      const std::vector<std::string>& image_files,
+      const int num_threads,
+      std::vector<CameraIntrinsicsPrior>* camera_intrinsics_priors) const;
+
  private:
   void LoadSensorWidthDatabase();
 
@@ -33,6 +33,8 @@
 // Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
 
 #include <glog/logging.h>
+#include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -75,4 +77,44 @@ TEST(ExtractEXIFMetadata, GPS) {
               kAltitudeTolerance);
 }
 
+TEST(ExtractEXIFMetadata, MultipleImagesInParallel) {
+  static const int kNumThreads = 4;
+  ExifReader exif_reader;
+  std::vector<std::string> image_files;
+  for (int i = 0; i < 8; i++) {
+    image_files.emplace_back(i % 2 == 0 ? exif_img_filename
+                                        : gps_exif_img_filename);
+  }
+
+  std::vector<CameraIntrinsicsPrior> camera_intrinsics_priors;
+  EXPECT_TRUE(exif_reader.ExtractEXIFMetadata(image_files, kNumThreads,
+                                              &camera_intrinsics_priors));
+  ASSERT_EQ(camera_intrinsics_priors.size(), image_files.size());
+  for (int i = 0; i < image_files.size(); i++) {
+    CameraIntrinsicsPrior expected_prior;
+    EXPECT_TRUE(
+        exif_reader.ExtractEXIFMetadata(image_files[i], &expected_prior));
+    EXPECT_EQ(camera_intrinsics_priors[i].image_width,
+              expected_prior.image_width);
+    EXPECT_EQ(camera_intrinsics_priors[i].image_height,
+              expected_prior.image_height);
+    EXPECT_EQ(camera_intrinsics_priors[i].focal_length.is_set,
+              expected_prior.focal_length.is_set);
+    EXPECT_EQ(camera_intrinsics_priors[i].focal_length.value[0],
+              expected_prior.focal_length.value[0]);
+    EXPECT_EQ(camera_intrinsics_priors[i].latitude.is_set,
+              expected_prior.latitude.is_set);
+  }
+
+  // A missing file leaves its prior unchanged and is reported.
+  image_files.emplace_back(THEIA_DATA_DIR +
+                           std::string("/image/does_not_exist.jpg"));
+  camera_intrinsics_priors.clear();
+  EXPECT_FALSE(exif_reader.ExtractEXIFMetadata(image_files, kNumThreads,
+                                               &camera_intrinsics_priors));
+  ASSERT_EQ(camera_intrinsics_priors.size(), image_files.size());
+  EXPECT_EQ(camera_intrinsics_priors.back().image_width, 0);
+  EXPECT_FALSE(camera_intrinsics_priors.back().focal_length.is_set);
+}
+
 }  // namespace theia
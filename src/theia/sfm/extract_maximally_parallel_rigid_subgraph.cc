@@ -36,12 +36,18 @@
 
 #include <ceres/rotation.h>
 #include <Eigen/Core>
-#include <Eigen/LU>
+#include <Eigen/SparseCore>
+#include <glog/logging.h>
 
 #include <algorithm>
+#include <cmath>
+#include <random>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "spectra/include/SymEigsShiftSolver.h"
+#include "theia/math/matrix/spectra_linear_operator.h"
 #include "theia/sfm/pose/util.h"
 #include "theia/sfm/types.h"
 #include "theia/sfm/view_graph/view_graph.h"
@@ -50,13 +56,21 @@
 namespace theia {
 namespace {
 
+// Maximum cosine distance between two null space rows for them to be
+// considered parallel.
+static const double kMaxCosDistance = 1e-5;
+
 void FormAngleMeasurementMatrix(
     const std::unordered_map<ViewId, Eigen::Vector3d>& orientations,
     const ViewGraph& view_graph,
     const std::unordered_map<ViewId, int>& view_ids_to_index,
-    Eigen::MatrixXd* angle_measurements) {
+    Eigen::SparseMatrix<double>* angle_measurements) {
   const auto& view_pairs = view_graph.GetAllEdges();
-  angle_measurements->setZero();
+
+  // Each edge contributes two 3x3 cross product matrices, each of which has 6
+  // non-zero entries.
+  std::vector<Eigen::Triplet<double> > triplets;
+  triplets.reserve(12 * view_pairs.size());
 
   // Set up the matrix such that t_{i,j} x (c_j - c_i) = 0.
   int i = 0;
@@ -78,10 +92,82 @@ void FormAngleMeasurementMatrix(
     const int view2_col =
         3 * FindOrDie(view_ids_to_index, view_pair.first.second);
 
-    angle_measurements->block<3, 3>(3 * i, view1_col) = -cross_product_mat;
-    angle_measurements->block<3, 3>(3 * i, view2_col) = cross_product_mat;
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) {
+        // The diagonal of a cross product matrix is always zero.
+        if (r == c) {
+          continue;
+        }
+        triplets.emplace_back(3 * i + r, view1_col + c,
+                              -cross_product_mat(r, c));
+        triplets.emplace_back(3 * i + r, view2_col + c,
+                              cross_product_mat(r, c));
+      }
+    }
     ++i;
   }
+
+  angle_measurements->resize(3 * view_pairs.size(),
+                             3 * view_ids_to_index.size());
+  angle_measurements->setFromTriplets(triplets.begin(), triplets.end());
+}
+
+// Computes a basis for the null space of the symmetric positive semi-definite
+// matrix with a sparse shift-and-invert eigensolver. The dimension of the null
+// space is not known in advance, so the number of requested eigenvectors is
+// doubled until an eigenvalue that is not (numerically) zero is found.
+void ComputeNullSpace(const Eigen::SparseMatrix<double>& ata,
+                      Eigen::MatrixXd* null_space) {
+  // The null space is at least 4-dimensional (translation and scale).
+  static const int kInitialNullSpaceDimension = 8;
+  static const int kMinNumLanczosVectors = 20;
+  static const double kRegularization = 1e-10;
+  static const double kNullSpaceTolerance = 1e-8;
+
+  const int num_rows = ata.rows();
+  const double max_diagonal = std::max(ata.diagonal().maxCoeff(), 1.0);
+
+  // The shift-solve operator factorizes the matrix it is given, so shift the
+  // spectrum by a small multiple of identity to make the matrix positive
+  // definite. The eigenvectors do not change and the eigenvalues are shifted by
+  // the same amount.
+  const double shift = kRegularization * max_diagonal;
+  Eigen::SparseMatrix<double> identity(num_rows, num_rows);
+  identity.setIdentity();
+  const Eigen::SparseMatrix<double> shifted_ata = ata + shift * identity;
+  SparseSymShiftSolveLLT op(shifted_ata);
+
+  int num_eigenvectors = std::min(kInitialNullSpaceDimension, num_rows - 1);
+  while (true) {
+    const int num_lanczos_vectors = std::min(
+        num_rows, std::max(2 * num_eigenvectors + 1, kMinNumLanczosVectors));
+    Spectra::SymEigsShiftSolver<double, Spectra::LARGEST_MAGN,
+                                SparseSymShiftSolveLLT>
+        eigs(&op, num_eigenvectors, num_lanczos_vectors, 0.0);
+    eigs.init();
+    eigs.compute();
+    if (eigs.info() != Spectra::SUCCESSFUL) {
+      LOG(WARNING) << "The eigensolver did not converge while computing the "
+                      "null space of the angle measurements.";
+    }
+
+    // The eigenvalues are sorted in decreasing order so the null space
+    // eigenvectors are the last columns.
+    const Eigen::VectorXd eigenvalues = eigs.eigenvalues();
+    int null_space_dimension = 0;
+    for (int i = 0; i < eigenvalues.size(); i++) {
+      if (eigenvalues(i) - shift < kNullSpaceTolerance * max_diagonal) {
+        ++null_space_dimension;
+      }
+    }
+
+    if (null_space_dimension < eigenvalues.size() ||
+        num_eigenvectors == num_rows - 1) {
+      *null_space = eigs.eigenvectors().rightCols(null_space_dimension);
+      return;
+    }
+    num_eigenvectors = std::min(2 * num_eigenvectors, num_rows - 1);
+  }
 }
 
 // Computes the cosine distance in each dimension x, y, and z and returns the
@@ -101,11 +187,21 @@ double ComputeCosineDistance(const Eigen::MatrixXd& mat1,
 // examining which nodes are parallel when removing node fixed_node from the
 // null space. The nodes are only parallel if they are part of the maximal rigid
 // component with fixed_node.
+//
+// Instead of comparing all pairs of nodes, each node is hashed to a scalar key
+// that is invariant to the sign of its (normalized) rows and that changes by at
+// most max_key_distance between parallel nodes. After sorting the nodes by key,
+// each node only needs to be compared to the representatives of the clusters
+// with a nearby key.
 void FindMaximalParallelRigidComponent(const Eigen::MatrixXd& null_space,
+                                       const Eigen::MatrixXd& projections,
                                        const int fixed_node,
                                        std::unordered_set<int>* largest_cc) {
-  static const double kMaxCosDistance = 1e-5;
   static const double kMaxNorm = 1e-10;
+  // Parallel unit rows u, v satisfy |u - v| <= sqrt(2 * kMaxCosDistance) (or
+  // |u + v| for anti-parallel rows) so the keys of parallel nodes differ by at
+  // most three times that.
+  static const double kMaxKeyDistance = 3.0 * std::sqrt(2.0 * kMaxCosDistance);
 
   const int num_nodes = null_space.rows() / 3;
 
@@ -124,9 +220,9 @@ void FindMaximalParallelRigidComponent(const Eigen::MatrixXd& null_space,
 
   modified_null_space.rowwise().normalize();
 
-  // Find the pairs to match. Add all indices that are close to 0-vectors, as
+  // Find the nodes to match. Add all indices that are close to 0-vectors, as
   // they are clearly part of the rigid component.
-  std::vector<int> indices_to_match;
+  std::vector<std::pair<double, int> > keys_and_indices;
   for (int i = 0; i < num_nodes; i++) {
     // Skip this index if it is fixed.
     if (i == fixed_node) {
@@ -142,28 +238,56 @@ void FindMaximalParallelRigidComponent(const Eigen::MatrixXd& null_space,
       continue;
     }
 
-    indices_to_match.emplace_back(i);
+    const double key =
+        (modified_null_space.block(3 * i, 0, 3, null_space.cols())
+             .cwiseProduct(projections))
+            .rowwise()
+            .sum()
+            .cwiseAbs()
+            .sum();
+    keys_and_indices.emplace_back(key, i);
   }
+  std::sort(keys_and_indices.begin(), keys_and_indices.end());
 
   // Each node has three dimensions (x, y, z). We only compare parallel-ness
   // between similar dimensions. If all x, y, z dimensions are parallel then
-  // the two nodes will be parallel.
-  for (int i = 0; i < indices_to_match.size(); i++) {
-    // Test all other nodes (that have not been tested) to determine if they are
-    // parallel to this node.
-    const Eigen::MatrixXd& block1 = modified_null_space.block(
-        3 * indices_to_match[i], 0, 3, null_space.cols());
-
-    for (int j = i + 1; j < indices_to_match.size(); j++) {
-      const Eigen::MatrixXd& block2 = modified_null_space.block(
-          3 * indices_to_match[j], 0, 3, null_space.cols());
+  // the two nodes will be parallel. Nodes are clustered greedily in key order:
+  // a node joins the first nearby cluster whose representative it is parallel
+  // to.
+  std::vector<int> cluster_representatives;
+  std::vector<double> cluster_keys;
+  std::vector<std::vector<int> > clusters;
+  for (const auto& key_and_index : keys_and_indices) {
+    const int index = key_and_index.second;
+    const Eigen::MatrixXd& block1 =
+        modified_null_space.block(3 * index, 0, 3, null_space.cols());
 
-      const double cos_distance = ComputeCosineDistance(block1, block2);
-      if (cos_distance < kMaxCosDistance) {
-        largest_cc->insert(indices_to_match[i]);
-        largest_cc->insert(indices_to_match[j]);
+    int cluster = -1;
+    for (int c = clusters.size() - 1;
+         c >= 0 && key_and_index.first - cluster_keys[c] <= kMaxKeyDistance;
+         --c) {
+      const Eigen::MatrixXd& block2 = modified_null_space.block(
+          3 * cluster_representatives[c], 0, 3, null_space.cols());
+      if (ComputeCosineDistance(block1, block2) < kMaxCosDistance) {
+        cluster = c;
+        break;
       }
     }
+
+    if (cluster == -1) {
+      cluster_representatives.emplace_back(index);
+      cluster_keys.emplace_back(key_and_index.first);
+      clusters.emplace_back(1, index);
+    } else {
+      clusters[cluster].emplace_back(index);
+    }
+  }
+
+  // All nodes that are parallel to at least one other node are added.
+  for (const std::vector<int>& cluster : clusters) {
+    if (cluster.size() > 1) {
+      largest_cc->insert(cluster.begin(), cluster.end());
+    }
   }
 }
 
@@ -182,20 +306,34 @@ void ExtractMaximallyParallelRigidSubgraph(
     const int current_index = view_ids_to_index.size();
     InsertIfNotPresent(&view_ids_to_index, orientation.first, current_index);
   }
+  const int num_views = view_ids_to_index.size();
+  if (num_views < 2) {
+    return;
+  }
 
   // Form the global angle measurements matrix from:
   //    t_{i,j} x (c_j - c_i) = 0.
-  Eigen::MatrixXd angle_measurements(3 * view_graph->NumEdges(),
-                                     3 * orientations.size());
+  Eigen::SparseMatrix<double> angle_measurements;
   FormAngleMeasurementMatrix(orientations,
                              *view_graph,
                              view_ids_to_index,
                              &angle_measurements);
 
   // Extract the null space of the angle measurements matrix.
-  Eigen::FullPivLU<Eigen::MatrixXd> lu(angle_measurements.transpose() *
-                                       angle_measurements);
-  const Eigen::MatrixXd null_space = lu.kernel();
+  const Eigen::SparseMatrix<double> ata =
+      angle_measurements.transpose() * angle_measurements;
+  Eigen::MatrixXd null_space;
+  ComputeNullSpace(ata, &null_space);
+
+  // Random projections of the x, y, and z rows of the null space that are used
+  // to hash the nodes. A fixed seed keeps the results deterministic.
+  std::mt19937 generator(59);
+  std::normal_distribution<double> distribution(0.0, 1.0);
+  Eigen::MatrixXd projections(3, null_space.cols());
+  for (int i = 0; i < projections.size(); i++) {
+    projections(i) = distribution(generator);
+  }
+  projections.rowwise().normalize();
 
   // For each node in the graph (i.e. each camera), set the null space component
   // to be zero such that the camera position would be fixed at the origin. If
@@ -203,25 +341,33 @@ void ExtractMaximallyParallelRigidSubgraph(
   // will be parallel because the camera positions may only change by a
   // scale. We find all components that are parallel to find the rigid
   // components. The largest of such component is the maximally parallel rigid
-  // component of the graph.
+  // component of the graph. Fixing any node of a component yields the same
+  // component, so nodes that were already found to be part of a component are
+  // not used as the fixed node again.
   std::unordered_set<int> maximal_rigid_component;
-  for (int i = 0; i < orientations.size(); i++) {
+  std::vector<bool> is_in_component(num_views, false);
+  for (int i = 0; i < num_views; i++) {
+    if (is_in_component[i]) {
+      continue;
+    }
+
     std::unordered_set<int> temp_cc;
-    FindMaximalParallelRigidComponent(null_space, i, &temp_cc);
+    FindMaximalParallelRigidComponent(null_space, projections, i, &temp_cc);
+    for (const int node : temp_cc) {
+      is_in_component[node] = true;
+    }
     if (temp_cc.size() > maximal_rigid_component.size()) {
       std::swap(temp_cc, maximal_rigid_component);
     }
   }
 
   // Only keep the nodes in the largest maximally parallel rigid component.
-  for (const auto& orientation : orientations) {
-    const int index = FindOrDie(view_ids_to_index, orientation.first);
+  for (const auto& view_id_and_index : view_ids_to_index) {
     // If the view is not in the maximal rigid component then remove it from the
     // view graph.
-    if (!ContainsKey(maximal_rigid_component, index) &&
-        view_graph->HasView(orientation.first)) {
-      CHECK(view_graph->RemoveView(orientation.first))
-          << "Could not remove view id " << orientation.first
+    if (!ContainsKey(maximal_rigid_component, view_id_and_index.second)) {
+      CHECK(view_graph->RemoveView(view_id_and_index.first))
+          << "Could not remove view id " << view_id_and_index.first
           << " from the view graph because it does not exist.";
     }
   }
@@ -184,4 +184,44 @@ TEST(ExtractMaximallyParallelRigidSubgraph, ManyBadRotations) {
   TestExtractMaximallyParallelRigidSubgraph(30, 100, 30);
 }
 
+TEST(ExtractMaximallyParallelRigidSubgraph, LargeGraph) {
+  TestExtractMaximallyParallelRigidSubgraph(500, 2500, 0);
+}
+
+TEST(ExtractMaximallyParallelRigidSubgraph, RemovesNonRigidViews) {
+  static const int kNumRigidViews = 10;
+  static const int kNumNonRigidViews = 8;
+  std::unordered_map<ViewId, Vector3d> orientations;
+  std::unordered_map<ViewId, Vector3d> positions;
+  CreateViewsWithRandomPoses(kNumRigidViews + kNumNonRigidViews,
+                             &orientations,
+                             &positions);
+
+  std::unordered_map<ViewId, Vector3d> rigid_orientations;
+  std::unordered_map<ViewId, Vector3d> rigid_positions;
+  for (int i = 0; i < kNumRigidViews; i++) {
+    rigid_orientations[i] = orientations[i];
+    rigid_positions[i] = positions[i];
+  }
+  ViewGraph view_graph;
+  CreateValidViewPairs(30, rigid_orientations, rigid_positions, &view_graph);
+
+  // Each of the remaining views is only constrained by a single edge so its
+  // position may slide along the edge direction. These views are not part of
+  // the rigid component and each of them adds a dimension to the null space.
+  for (int i = kNumRigidViews; i < kNumRigidViews + kNumNonRigidViews; i++) {
+    const ViewIdPair view_id_pair(i % kNumRigidViews, i);
+    view_graph.AddEdge(view_id_pair.first,
+                       view_id_pair.second,
+                       CreateTwoViewInfo(orientations, positions, view_id_pair));
+  }
+
+  ExtractMaximallyParallelRigidSubgraph(orientations, &view_graph);
+  EXPECT_EQ(view_graph.NumViews(), kNumRigidViews);
+  EXPECT_EQ(view_graph.NumEdges(), 30);
+  for (int i = kNumRigidViews; i < kNumRigidViews + kNumNonRigidViews; i++) {
+    EXPECT_FALSE(view_graph.HasView(i));
+  }
+}
+
 }  // namespace theia
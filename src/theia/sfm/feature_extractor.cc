@@ -36,15 +36,18 @@
 
 #include <Eigen/Core>
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "theia/image/descriptor/create_descriptor_extractor.h"
 #include "theia/image/descriptor/descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
 #include "theia/io/write_keypoints_and_descriptors.h"
 #include "theia/image/image.h"
 #include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/image/keypoint_detector/keypoint_selection.h"
 #include "theia/util/filesystem.h"
 #include "theia/util/threadpool.h"
 
@@ -63,6 +66,7 @@ bool FeatureExtractor::Extract(
   // The thread pool will wait to finish all jobs when it goes out of scope.
   const int num_threads =
       std::min(options_.num_threads, static_cast<int>(filenames.size()));
+  InitializeDescriptorExtractorPool(num_threads);
   ThreadPool feature_extractor_pool(num_threads);
   for (int i = 0; i < filenames.size(); i++) {
     if (!FileExists(filenames[i])) {
@@ -94,12 +98,13 @@ bool FeatureExtractor::Extract(
   // The thread pool will wait to finish all jobs when it goes out of scope.
   const int num_threads =
           std::min(options_.num_threads, static_cast<int>(images.size()));
+  InitializeDescriptorExtractorPool(num_threads);
   ThreadPool feature_extractor_pool(num_threads);
   for (int i = 0; i < images.size(); i++) {
     feature_extractor_pool.Add(
             &FeatureExtractor::ExtractFeaturesFromImage,
             this,
-            images[i],
+            std::cref(images[i]),
             &(*keypoints)[i],
             &(*descriptors)[i]);
   }
@@ -126,11 +131,27 @@ bool FeatureExtractor::ExtractFeatures(
     const std::string& filename,
     std::vector<Keypoint>* keypoints,
     std::vector<Eigen::VectorXf>* descriptors) {
-  std::unique_ptr<FloatImage> image(new FloatImage(filename));
-  if (!ExtractFeaturesFromImage(*image, keypoints, descriptors)) {
+  // The image is read into the image buffer of the borrowed workspace so that
+  // it is reused by all images of the same size.
+  DescriptorExtractorPool::ScopedWorkspace workspace(
+      descriptor_extractor_pool_.get());
+  FloatImage* image = &workspace->image;
+  int downsampling_factor = 1;
+  if (!image->ReadGrayscale(filename,
+                            options_.max_image_dimension_for_feature_extraction,
+                            &downsampling_factor)) {
+    LOG(ERROR) << "Could not read image " << filename;
+    return false;
+  }
+
+  if (!DetectAndExtractDescriptors(workspace->descriptor_extractor.get(),
+                                   *image,
+                                   keypoints,
+                                   descriptors)) {
     LOG(ERROR) << "Could not extract descriptors in image " << filename;
     return false;
   } else {
+    RescaleKeypointsToFullResolution(downsampling_factor, keypoints);
     VLOG(1) << "Successfully extracted " << descriptors->size()
             << " features from image " << filename;
   }
@@ -163,30 +184,44 @@ bool FeatureExtractor::ExtractFeaturesFromImage(
     const FloatImage& image,
     std::vector<Keypoint>* keypoints,
     std::vector<Eigen::VectorXf>* descriptors) {
-  // We create these variable here instead of upon the construction of the
-  // object so that they can be thread-safe. We *should* be able to use the
-  // static thread_local keywords, but apparently Mac OS-X's version of clang
-  // does not actually support it!
-  //
-  // TODO(cmsweeney): Change this so that each thread in the threadpool receives
-  // exactly one object.
-  std::unique_ptr<DescriptorExtractor> descriptor_extractor =
-      CreateDescriptorExtractor(options_.descriptor_extractor_type,
-                                options_.feature_density);
+  DescriptorExtractorPool::ScopedWorkspace workspace(
+      descriptor_extractor_pool_.get());
+  return DetectAndExtractDescriptors(workspace->descriptor_extractor.get(),
+                                     image,
+                                     keypoints,
+                                     descriptors);
+}
+
+bool FeatureExtractor::DetectAndExtractDescriptors(
+    DescriptorExtractor* descriptor_extractor,
+    const FloatImage& image,
+    std::vector<Keypoint>* keypoints,
+    std::vector<Eigen::VectorXf>* descriptors) {
+  // Keypoints are selected by their strength and spatial distribution before
+  // descriptors are computed.
+  KeypointSelectionOptions selection_options;
+  selection_options.max_num_keypoints = options_.max_num_features;
+  selection_options.grid_size = options_.keypoint_selection_grid_size;
 
   // Exit if the descriptor extraction fails.
-  if (!descriptor_extractor->DetectAndExtractDescriptors(image,
-                                                         keypoints,
-                                                         descriptors)) {
-    return false;
-  }
+  return descriptor_extractor->DetectAndExtractSelectedDescriptors(
+      image, selection_options, keypoints, descriptors);
+}
 
-  if (keypoints->size() > options_.max_num_features) {
-    keypoints->resize(options_.max_num_features);
-    descriptors->resize(options_.max_num_features);
+void FeatureExtractor::InitializeDescriptorExtractorPool(
+    const int num_threads) {
+  // The extractors of previous calls are kept so that their buffers are reused
+  // unless they should use a different number of threads per image.
+  const int num_threads_per_image =
+      std::max(1, options_.num_threads / std::max(1, num_threads));
+  if (descriptor_extractor_pool_ == nullptr ||
+      num_threads_per_image != num_threads_per_image_) {
+    num_threads_per_image_ = num_threads_per_image;
+    descriptor_extractor_pool_.reset(
+        new DescriptorExtractorPool(options_.descriptor_extractor_type,
+                                    options_.feature_density,
+                                    num_threads_per_image_));
   }
-
-  return true;
 }
 
 }  // namespace theia
@@ -36,10 +36,12 @@
 #define THEIA_SFM_FEATURE_EXTRACTOR_H_
 
 #include <Eigen/Core>
+#include <memory>
 #include <string>
 
 #include "theia/alignment/alignment.h"
 #include "theia/image/descriptor/create_descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
 #include "theia/util/util.h"
 #include "theia/image/image.h"
 
@@ -63,6 +65,19 @@ class FeatureExtractor {
     // The features returned will be no larger than this size.
     int max_num_features = 16384;
 
+    // When more than max_num_features keypoints are detected, the image is
+    // divided into a grid of this size and the strongest keypoints of each
+    // cell are kept first so that the features are spread over the image.
+    // Descriptors are only computed for the kept keypoints.
+    int keypoint_selection_grid_size = 4;
+
+    // Images read from file are decoded directly to grayscale and, if this is
+    // positive, box filtered down by an integer factor until neither dimension
+    // exceeds this size before features are extracted. The keypoints are
+    // mapped back to the full resolution image. Images passed in memory are
+    // used as they are.
+    int max_image_dimension_for_feature_extraction = 0;
+
     // If we wish to write the features to disk, they will be output in this
     // directory with the same name as the input image and a ".features"
     // appended.
@@ -70,7 +85,9 @@ class FeatureExtractor {
   };
 
   explicit FeatureExtractor(const Options& options)
-      : options_(options), write_features_to_disk_(false) {}
+      : options_(options),
+        write_features_to_disk_(false),
+        num_threads_per_image_(1) {}
   ~FeatureExtractor() {}
 
   // Method to extract descriptors.
@@ -99,9 +116,28 @@ class FeatureExtractor {
                                 std::vector<Keypoint>* keypoints,
                                 std::vector<Eigen::VectorXf>* descriptors);
 
+  // Detects the keypoints, selects the ones to keep, and computes their
+  // descriptors with the given extractor.
+  bool DetectAndExtractDescriptors(DescriptorExtractor* descriptor_extractor,
+                                   const FloatImage& image,
+                                   std::vector<Keypoint>* keypoints,
+                                   std::vector<Eigen::VectorXf>* descriptors);
+
+  // Creates the descriptor extractor pool for extracting features with
+  // num_threads images in parallel if the current pool cannot be reused.
+  void InitializeDescriptorExtractorPool(const int num_threads);
+
   const Options options_;
   bool write_features_to_disk_;
 
+  // Threads that are not needed for extracting features from different images
+  // in parallel are used to extract features within each image.
+  int num_threads_per_image_;
+
+  // Descriptor extractors and image buffers that are reused by the threads
+  // extracting features, including across calls to Extract.
+  std::unique_ptr<DescriptorExtractorPool> descriptor_extractor_pool_;
+
   DISALLOW_COPY_AND_ASSIGN(FeatureExtractor);
 };
 
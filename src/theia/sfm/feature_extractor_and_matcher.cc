@@ -38,14 +38,18 @@
 #include <algorithm>
 #include <glog/logging.h>
 #include <memory>
+#include <numeric>
 #include <string>
 #include <thread>  // NOLINT
+#include <unordered_set>
 #include <vector>
 
 #include "theia/image/descriptor/create_descriptor_extractor.h"
 #include "theia/image/descriptor/descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
 #include "theia/image/image.h"
 #include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/image/keypoint_detector/keypoint_selection.h"
 #include "theia/matching/create_feature_matcher.h"
 #include "theia/matching/feature_correspondence.h"
 #include "theia/matching/feature_matcher_options.h"
@@ -53,11 +57,13 @@
 #include "theia/matching/fisher_vector_extractor.h"
 #include "theia/matching/global_descriptor_extractor.h"
 #include "theia/matching/image_pair_match.h"
+#include "theia/matching/keypoints_and_descriptors.h"
 #include "theia/sfm/camera_intrinsics_prior.h"
 #include "theia/sfm/estimate_twoview_info.h"
 #include "theia/sfm/exif_reader.h"
 #include "theia/sfm/two_view_match_geometric_verification.h"
 #include "theia/util/filesystem.h"
+#include "theia/util/map_util.h"
 #include "theia/util/string.h"
 #include "theia/util/threadpool.h"
 
@@ -69,66 +75,159 @@ struct MatchedImages {
   std::unordered_set<int> expanded_matches;
 };
 
+// Computes the K nearest neighbors of the global descriptors given by the
+// query indices among all global descriptors with a blocked GEMM. The squared
+// distances between all pairs of descriptors in a block of query images and all
+// images are given by
+//   |a - b|^2 = |a|^2 + |b|^2 - 2 a^T b
+// so that each block only requires a single matrix product. Blocks are
+// processed in parallel.
+void FindNearestNeighborsOfGlobalDescriptors(
+    const std::vector<Eigen::VectorXf>& global_descriptors,
+    const std::vector<int>& query_indices,
+    const int num_nearest_neighbors,
+    const int num_threads,
+    std::vector<std::vector<int>>* nearest_neighbors) {
+  static const int kQueryBlockSize = 256;
+
+  const int num_images = global_descriptors.size();
+  const int num_queries = query_indices.size();
+  nearest_neighbors->resize(num_queries);
+  if (num_queries == 0 || num_nearest_neighbors <= 0) {
+    return;
+  }
+
+  Eigen::MatrixXf descriptors(global_descriptors[0].size(), num_images);
+  for (int i = 0; i < num_images; i++) {
+    descriptors.col(i) = global_descriptors[i];
+  }
+  const Eigen::VectorXf squared_norms =
+      descriptors.colwise().squaredNorm().transpose();
+
+  ThreadPool pool(std::max(1, num_threads));
+  for (int i = 0; i < num_queries; i += kQueryBlockSize) {
+    pool.Add(
+        [&](const int block_start) {
+          const int block_size =
+              std::min(kQueryBlockSize, num_queries - block_start);
+          Eigen::MatrixXf query_descriptors(descriptors.rows(), block_size);
+          for (int j = 0; j < block_size; j++) {
+            query_descriptors.col(j) =
+                descriptors.col(query_indices[block_start + j]);
+          }
+          Eigen::MatrixXf distances(num_images, block_size);
+          distances.noalias() =
+              -2.0f * descriptors.transpose() * query_descriptors;
+          distances.colwise() += squared_norms;
+
+          std::vector<std::pair<float, int>> scores;
+          scores.reserve(num_images - 1);
+          for (int j = 0; j < block_size; j++) {
+            const int query_index = query_indices[block_start + j];
+            const float query_squared_norm = squared_norms(query_index);
+            scores.clear();
+            for (int k = 0; k < num_images; k++) {
+              if (k != query_index) {
+                scores.emplace_back(distances(k, j) + query_squared_norm, k);
+              }
+            }
+
+            // Find the top K matching results for the query image.
+            std::partial_sort(scores.begin(),
+                              scores.begin() + num_nearest_neighbors,
+                              scores.end());
+            std::vector<int>& neighbors =
+                (*nearest_neighbors)[block_start + j];
+            neighbors.reserve(num_nearest_neighbors);
+            for (int k = 0; k < num_nearest_neighbors; k++) {
+              neighbors.emplace_back(scores[k].second);
+            }
+          }
+        },
+        i);
+  }
+}
+
+// Extracts the keypoints and the float or binary descriptors (depending on the
+// descriptor extractor type) into features.
 void ExtractFeatures(const FeatureExtractorAndMatcher::Options& options,
                      const std::string& image_filepath,
                      const std::string& imagemask_filepath,
-                     std::vector<Keypoint>* keypoints,
-                     std::vector<Eigen::VectorXf>* descriptors) {
+                     DescriptorExtractorPool* descriptor_extractor_pool,
+                     KeypointsAndDescriptors* features) {
   static const float kMaskThreshold = 0.5;
-  std::unique_ptr<FloatImage> image(new FloatImage(image_filepath));
-  // We create these variable here instead of upon the construction of the
-  // object so that they can be thread-safe. We *should* be able to use the
-  // static thread_local keywords, but apparently Mac OS-X's version of clang
-  // does not actually support it!
-  //
-  // TODO(cmsweeney): Change this so that each thread in the threadpool receives
-  // exactly one object.
-  std::unique_ptr<DescriptorExtractor> descriptor_extractor =
-      CreateDescriptorExtractor(options.descriptor_extractor_type,
-                                options.feature_density);
-
-  // Exit if the descriptor extraction fails.
-  if (!descriptor_extractor->DetectAndExtractDescriptors(
-          *image, keypoints, descriptors)) {
-    LOG(ERROR) << "Could not extract descriptors in image " << image_filepath;
+  // Borrow a descriptor extractor and image buffer that are reused across
+  // the images processed by this thread.
+  DescriptorExtractorPool::ScopedWorkspace workspace(descriptor_extractor_pool);
+  DescriptorExtractor* descriptor_extractor =
+      workspace->descriptor_extractor.get();
+
+  // The image is decoded straight to a (possibly downsampled) grayscale image
+  // since all descriptor extractors operate on grayscale images anyways.
+  FloatImage* image = &workspace->image;
+  int downsampling_factor = 1;
+  if (!image->ReadGrayscale(image_filepath,
+                            options.max_image_dimension_for_feature_extraction,
+                            &downsampling_factor)) {
+    LOG(ERROR) << "Could not read image " << image_filepath;
     return;
   }
 
+  // Keypoints are selected by the mask, their strength, and their spatial
+  // distribution before descriptors are computed.
+  KeypointSelectionOptions selection_options;
+  selection_options.max_num_keypoints = options.max_num_features;
+  selection_options.grid_size = options.keypoint_selection_grid_size;
+  std::unique_ptr<FloatImage> image_mask;
   if (imagemask_filepath.size() > 0) {
-    std::unique_ptr<FloatImage> image_mask(new FloatImage(imagemask_filepath));
+    // The mask is downsampled in the same way as the image and is read as a
+    // grayscale image. Keypoints in the black part of the mask are removed.
+    image_mask.reset(new FloatImage());
+    int mask_downsampling_factor = 1;
+    CHECK(image_mask->ReadGrayscale(
+        imagemask_filepath,
+        options.max_image_dimension_for_feature_extraction,
+        &mask_downsampling_factor))
+        << "Could not read the image mask " << imagemask_filepath;
     // Check the size of the image and its associated mask.
-    CHECK(image_mask->Width() == image->Width() &&
+    CHECK(mask_downsampling_factor == downsampling_factor &&
+          image_mask->Width() == image->Width() &&
           image_mask->Height() == image->Height())
         << "The image and the mask don't have the same size. \n"
         << "- Image: " << image_filepath << "\t(" << image->Width() << " x "
         << image->Height() << ")\n"
         << "- Mask: " << imagemask_filepath << "\t(" << image_mask->Width()
         << " x " << image_mask->Height() << ")";
-
-    // Convert the mask to grayscale.
-    image_mask->ConvertToGrayscaleImage();
-    // Remove keypoints according to the associated mask (remove kp. in black
-    // part).
-    for (int i = keypoints->size() - 1; i > -1; i--) {
-      if (image_mask->BilinearInterpolate(
-              keypoints->at(i).x(), keypoints->at(i).y(), 0) < kMaskThreshold) {
-        keypoints->erase(keypoints->begin() + i);
-        descriptors->erase(descriptors->begin() + i);
-      }
-    }
+    selection_options.mask = image_mask.get();
+    selection_options.mask_threshold = kMaskThreshold;
   }
 
-  if (keypoints->size() > options.max_num_features) {
-    keypoints->resize(options.max_num_features);
-    descriptors->resize(options.max_num_features);
+  // Exit if the descriptor extraction fails.
+  std::vector<Keypoint>* keypoints = &features->keypoints;
+  std::vector<Eigen::VectorXf>* descriptors = &features->descriptors;
+  std::vector<BinaryVectorX>* binary_descriptors =
+      &features->binary_descriptors;
+  const bool extracted =
+      descriptor_extractor->HasBinaryDescriptors()
+          ? descriptor_extractor->DetectAndExtractSelectedBinaryDescriptors(
+                *image, selection_options, keypoints, binary_descriptors)
+          : descriptor_extractor->DetectAndExtractSelectedDescriptors(
+                *image, selection_options, keypoints, descriptors);
+  if (!extracted) {
+    LOG(ERROR) << "Could not extract descriptors in image " << image_filepath;
+    keypoints->clear();
+    descriptors->clear();
+    binary_descriptors->clear();
+    return;
   }
+  RescaleKeypointsToFullResolution(downsampling_factor, keypoints);
 
   if (imagemask_filepath.size() > 0) {
-    VLOG(1) << "Successfully extracted " << descriptors->size()
+    VLOG(1) << "Successfully extracted " << keypoints->size()
             << " features from image " << image_filepath
             << " with an image mask.";
   } else {
-    VLOG(1) << "Successfully extracted " << descriptors->size()
+    VLOG(1) << "Successfully extracted " << keypoints->size()
             << " features from image " << image_filepath;
   }
 }
@@ -140,6 +239,12 @@ FeatureExtractorAndMatcher::FeatureExtractorAndMatcher(
     FeaturesAndMatchesDatabase* features_and_matches_database)
     : options_(options),
       features_and_matches_database_(features_and_matches_database) {
+  // Binary descriptors can only be matched with the Hamming distance and float
+  // descriptors only with the L2 distance.
+  CHECK_EQ(IsBinaryDescriptorExtractorType(options_.descriptor_extractor_type),
+           IsBinaryMatchingStrategy(options_.matching_strategy))
+      << "The matching strategy is not compatible with the descriptor type.";
+
   // Create the feature matcher.
   FeatureMatcherOptions matcher_options = options_.feature_matcher_options;
   matcher_options.num_threads = options_.num_threads;
@@ -154,10 +259,15 @@ FeatureExtractorAndMatcher::FeatureExtractorAndMatcher(
 
   // Initialize the global image descriptor extractor if desired.
   if (options_.select_image_pairs_with_global_image_descriptor_matching) {
+    CHECK(!IsBinaryDescriptorExtractorType(options_.descriptor_extractor_type))
+        << "Global image descriptors cannot be computed from binary "
+           "descriptors.";
     FisherVectorExtractor::Options fv_options;
     fv_options.num_gmm_clusters = options_.num_gmm_clusters_for_fisher_vector;
     fv_options.max_num_features_for_training =
         options_.max_num_features_for_fisher_vector_training;
+    fv_options.num_threads = options_.num_threads;
+    fv_options.rng = options_.rng;
     global_image_descriptor_extractor_.reset(
         new FisherVectorExtractor(fv_options));
   }
@@ -217,9 +327,25 @@ void FeatureExtractorAndMatcher::SetPairsToMatch(
 void FeatureExtractorAndMatcher::ExtractAndMatchFeatures() {
   CHECK_NOTNULL(matcher_.get());
 
+  // Reuse the global descriptor extractor model from previous runs if possible
+  // so that only new images need to be processed.
+  if (options_.select_image_pairs_with_global_image_descriptor_matching) {
+    global_descriptor_extractor_is_trained_ =
+        LoadGlobalDescriptorExtractorModel();
+  }
+
+  // Read the intrinsics priors of all images before extracting any features.
+  ReadCameraIntrinsicsPriors();
+
   // For each image, process the features and add it to the matcher.
   const int num_threads =
       std::min(options_.num_threads, static_cast<int>(image_filepaths_.size()));
+  const int num_threads_per_image =
+      std::max(1, options_.num_threads / std::max(1, num_threads));
+  descriptor_extractor_pool_.reset(
+      new DescriptorExtractorPool(options_.descriptor_extractor_type,
+                                  options_.feature_density,
+                                  num_threads_per_image));
   std::unique_ptr<ThreadPool> thread_pool(new ThreadPool(num_threads));
   for (int i = 0; i < image_filepaths_.size(); i++) {
     if (!FileExists(image_filepaths_[i])) {
@@ -231,16 +357,66 @@ void FeatureExtractorAndMatcher::ExtractAndMatchFeatures() {
   }
   // This forces all tasks to complete before proceeding.
   thread_pool.reset(nullptr);
+  VLOG(1) << "Extracted features with "
+          << descriptor_extractor_pool_->NumWorkspaces()
+          << " descriptor extractors.";
+  descriptor_extractor_pool_.reset();
+
+  // Find the images that must be matched when matching incrementally.
+  if (options_.feature_matcher_options.incremental_matching) {
+    FindNewImages();
+  }
 
   // After all threads complete feature extraction, perform matching.
-  SelectImagePairsWithGlobalDescriptorMatching();
-  // Free up memory.
-  global_image_descriptor_extractor_.release();
+  if (options_.select_image_pairs_with_global_image_descriptor_matching) {
+    SelectImagePairsWithGlobalDescriptorMatching();
+    // Free up memory.
+    global_image_descriptor_extractor_.reset();
+  }
   
   LOG(INFO) << "Matching images...";
+  matcher_->SetNewImages(new_image_names_);
   matcher_->MatchImages();
 }
 
+void FeatureExtractorAndMatcher::ReadCameraIntrinsicsPriors() {
+  intrinsics_priors_.clear();
+  intrinsics_priors_.resize(image_filepaths_.size());
+
+  // Use the priors in the database and gather the images without a focal
+  // length so that their EXIF metadata may be read.
+  std::vector<int> exif_image_indices;
+  std::vector<std::string> exif_image_filepaths;
+  std::vector<CameraIntrinsicsPrior> exif_intrinsics;
+  for (int i = 0; i < image_filepaths_.size(); i++) {
+    std::string image_filename;
+    CHECK(GetFilenameFromFilepath(image_filepaths_[i], true, &image_filename));
+    if (features_and_matches_database_->ContainsCameraIntrinsicsPrior(
+            image_filename)) {
+      intrinsics_priors_[i] =
+          features_and_matches_database_->GetCameraIntrinsicsPrior(
+              image_filename);
+    }
+
+    if (!intrinsics_priors_[i].focal_length.is_set &&
+        FileExists(image_filepaths_[i])) {
+      exif_image_indices.emplace_back(i);
+      exif_image_filepaths.emplace_back(image_filepaths_[i]);
+      exif_intrinsics.emplace_back(intrinsics_priors_[i]);
+    }
+  }
+
+  // Only the image headers are read, in parallel over all images.
+  if (exif_image_filepaths.size() > 0 &&
+      !exif_reader_.ExtractEXIFMetadata(
+          exif_image_filepaths, options_.num_threads, &exif_intrinsics)) {
+    LOG(WARNING) << "Could not read the EXIF metadata of all images.";
+  }
+  for (int i = 0; i < exif_image_indices.size(); i++) {
+    intrinsics_priors_[exif_image_indices[i]] = exif_intrinsics[i];
+  }
+}
+
 void FeatureExtractorAndMatcher::ProcessImage(const int i) {
   const std::string& image_filepath = image_filepaths_[i];
 
@@ -248,24 +424,23 @@ void FeatureExtractorAndMatcher::ProcessImage(const int i) {
   std::string image_filename;
   CHECK(GetFilenameFromFilepath(image_filepath, true, &image_filename));
 
-  // Get the camera intrinsics prior if it was provided.
-  CameraIntrinsicsPrior intrinsics;
-  if (features_and_matches_database_->ContainsCameraIntrinsicsPrior(
-          image_filename)) {
-    intrinsics = features_and_matches_database_->GetCameraIntrinsicsPrior(
-        image_filename);
-  }
+  // The camera intrinsics prior from the database, updated with the EXIF
+  // metadata if the focal length was not provided.
+  CameraIntrinsicsPrior intrinsics = intrinsics_priors_[i];
 
   // Get the associated mask if it was provided.
   const std::string mask_filepath =
       FindWithDefault(image_masks_, image_filepath, "");
 
-  // Extract an EXIF focal length if it was not provided.
   if (!intrinsics.focal_length.is_set) {
-    CHECK(exif_reader_.ExtractEXIFMetadata(image_filepath, &intrinsics));
+    if (intrinsics.image_width == 0) {
+      LOG(ERROR) << "Could not read the header of image " << image_filepath
+                 << ". Skipping this image.";
+      return;
+    }
 
-    // If the focal length still could not be extracted, set it to a reasonable
-    // value based on a median viewing angle.
+    // If the focal length could not be extracted from EXIF, set it to a
+    // reasonable value based on a median viewing angle.
     if (!options_.only_calibrated_views && !intrinsics.focal_length.is_set) {
       VLOG(2) << "Exif was not detected. Setting it to a reasonable value.";
       intrinsics.focal_length.is_set = true;
@@ -301,11 +476,11 @@ void FeatureExtractorAndMatcher::ProcessImage(const int i) {
     ExtractFeatures(options_,
                     image_filepath,
                     mask_filepath,
-                    &features.keypoints,
-                    &features.descriptors);
+                    descriptor_extractor_pool_.get(),
+                    &features);
 
     // Skip the image if not descriptors were extracted.
-    if (features.descriptors.size() == 0) {
+    if (features.keypoints.size() == 0) {
       return;
     }
 
@@ -314,8 +489,9 @@ void FeatureExtractorAndMatcher::ProcessImage(const int i) {
   }
 
   // Add the descriptors to the global image descriptor extractor for training
-  // if using a global image descriptor extractor.
-  if (options_.select_image_pairs_with_global_image_descriptor_matching) {
+  // if using a global image descriptor extractor that has not been trained.
+  if (options_.select_image_pairs_with_global_image_descriptor_matching &&
+      !global_descriptor_extractor_is_trained_) {
     const KeypointsAndDescriptors& features =
         features_and_matches_database_->GetFeatures(image_filename);
     CHECK_GT(features.descriptors.size(), 0);
@@ -326,24 +502,73 @@ void FeatureExtractorAndMatcher::ProcessImage(const int i) {
   // Add the image to the matcher.
   std::lock_guard<std::mutex> lock(matcher_mutex_);
   matcher_->AddImage(image_filename);
+  image_names_.emplace_back(image_filename);
   return;
 }
 
+void FeatureExtractorAndMatcher::FindNewImages() {
+  new_image_names_.clear();
+  for (const std::string& image_name : image_names_) {
+    if (!features_and_matches_database_->ContainsMatchedImage(image_name)) {
+      new_image_names_.emplace_back(image_name);
+    }
+  }
+}
+
+bool FeatureExtractorAndMatcher::LoadGlobalDescriptorExtractorModel() {
+  if (!options_.reuse_global_descriptors_from_database) {
+    return false;
+  }
+
+  std::string serialized_model;
+  if (!features_and_matches_database_->GetGlobalDescriptorExtractorModel(
+          &serialized_model)) {
+    return false;
+  }
+  if (!global_image_descriptor_extractor_->DeserializeModel(serialized_model)) {
+    LOG(WARNING) << "The global descriptor extractor model in the database "
+                    "could not be used. The model will be retrained.";
+    return false;
+  }
+  LOG(INFO) << "Loaded the global descriptor extractor model from the "
+               "database.";
+  return true;
+}
+
 void FeatureExtractorAndMatcher::ExtractGlobalDesriptors(
     const std::vector<std::string>& image_names,
     std::vector<Eigen::VectorXf>* global_descriptors) {
+  // Global descriptors in the database may only be reused if they were computed
+  // with the current model, i.e. the model was loaded from the database.
+  const bool reuse_global_descriptors =
+      options_.reuse_global_descriptors_from_database &&
+      global_descriptor_extractor_is_trained_;
+
   // Extract the global descriptors in parallel.
   ThreadPool pool(options_.num_threads);
   global_descriptors->resize(image_names.size());
   for (int i = 0; i < image_names.size(); i++) {
     pool.Add(
         [&](const int i) {
+          if (reuse_global_descriptors &&
+              features_and_matches_database_->ContainsGlobalDescriptor(
+                  image_names[i])) {
+            (*global_descriptors)[i] =
+                features_and_matches_database_->GetGlobalDescriptor(
+                    image_names[i]);
+            return;
+          }
+
           const KeypointsAndDescriptors& features =
               features_and_matches_database_->GetFeatures(image_names[i]);
           // Extract the global descriptors
           (*global_descriptors)[i] =
               global_image_descriptor_extractor_->ExtractGlobalDescriptor(
                   features.descriptors);
+          if (options_.reuse_global_descriptors_from_database) {
+            features_and_matches_database_->PutGlobalDescriptor(
+                image_names[i], (*global_descriptors)[i]);
+          }
         },
         i);
   }
@@ -351,18 +576,43 @@ void FeatureExtractorAndMatcher::ExtractGlobalDesriptors(
 
 void FeatureExtractorAndMatcher::
     SelectImagePairsWithGlobalDescriptorMatching() {
-  // Train the global descriptor extractor based on the input features.
-  VLOG(2) << "Training global image descriptor...";
-  CHECK(global_image_descriptor_extractor_->Train());
+  // Train the global descriptor extractor based on the input features unless
+  // a trained model was loaded from the database.
+  const bool train_global_descriptor_extractor =
+      !global_descriptor_extractor_is_trained_;
+  if (train_global_descriptor_extractor) {
+    VLOG(2) << "Training global image descriptor...";
+    CHECK(global_image_descriptor_extractor_->Train());
+
+    // Clear any stored model first since the global descriptors in the
+    // database are overwritten below with descriptors of the new model.
+    if (options_.reuse_global_descriptors_from_database) {
+      features_and_matches_database_->PutGlobalDescriptorExtractorModel("");
+    }
+  }
 
   // Get the image filename without the directory.
   const std::vector<std::string> image_names =
       features_and_matches_database_->ImageNamesOfFeatures();
 
-  // Extract global image descriptors.
+  // Extract global image descriptors. Any global descriptors in the database
+  // were computed with a different model if the model was just trained, and so
+  // they are all recomputed.
   std::vector<Eigen::VectorXf> global_descriptors;
   ExtractGlobalDesriptors(image_names, &global_descriptors);
 
+  // Store the model so that subsequent runs may reuse it. The model is only
+  // stored after all of the global descriptors have been recomputed with it so
+  // that a run that stops early never pairs a stored model with descriptors of
+  // a different model.
+  std::string serialized_model;
+  if (train_global_descriptor_extractor &&
+      options_.reuse_global_descriptors_from_database &&
+      global_image_descriptor_extractor_->SerializeModel(&serialized_model)) {
+    features_and_matches_database_->PutGlobalDescriptorExtractorModel(
+        serialized_model);
+  }
+
   VLOG(2) << "Computing image-to-image similarity scores with global "
              "descriptors...";
 
@@ -371,32 +621,68 @@ void FeatureExtractorAndMatcher::
       std::min(static_cast<int>(image_names.size() - 1),
                options_.num_nearest_neighbors_for_global_descriptor_matching);
 
-  std::unordered_map<int, MatchedImages> pairs_to_match;
-
-  // Match all pairs of global descriptors. For each image, the K most similar
-  // image (i.e. the ones with the lowest distance between global descriptors)
-  // are set for matching.
-  std::vector<std::vector<std::pair<float, int>>> global_matching_scores(
-      global_descriptors.size());
-  for (int i = 0; i < global_descriptors.size(); i++) {
-    // Compute the matching scores between all (i, j) pairs.
-    for (int j = i + 1; j < global_descriptors.size(); j++) {
-      const float global_feature_match_score =
-          (global_descriptors[i] - global_descriptors[j]).squaredNorm();
-      // Add the global feature matching score to both images.
-      global_matching_scores[i].emplace_back(global_feature_match_score, j);
-      global_matching_scores[j].emplace_back(global_feature_match_score, i);
+  // When matching incrementally, only the new images are used as queries. Their
+  // K nearest neighbors are matched so that the cost of selecting pairs is
+  // proportional to the number of new images.
+  std::unordered_map<std::string, int> image_name_to_index;
+  for (int i = 0; i < image_names.size(); i++) {
+    image_name_to_index[image_names[i]] = i;
+  }
+  std::vector<int> new_image_indices;
+  for (const std::string& new_image_name : new_image_names_) {
+    const int* index = FindOrNull(image_name_to_index, new_image_name);
+    if (index != nullptr) {
+      new_image_indices.emplace_back(*index);
+    }
+  }
+  if (options_.feature_matcher_options.incremental_matching &&
+      new_image_indices.size() < image_names.size()) {
+    VLOG(2) << "Selecting image pairs for " << new_image_indices.size()
+            << " new images out of " << image_names.size() << " images.";
+    std::vector<std::vector<int>> nearest_neighbors;
+    FindNearestNeighborsOfGlobalDescriptors(global_descriptors,
+                                            new_image_indices,
+                                            num_nearest_neighbors,
+                                            options_.num_threads,
+                                            &nearest_neighbors);
+
+    std::vector<std::pair<std::string, std::string>> image_names_to_match;
+    image_names_to_match.reserve(num_nearest_neighbors *
+                                 new_image_indices.size());
+    for (int i = 0; i < new_image_indices.size(); i++) {
+      for (const int neighbor : nearest_neighbors[i]) {
+        const int image_index = new_image_indices[i];
+        image_names_to_match.emplace_back(
+            image_names[std::min(image_index, neighbor)],
+            image_names[std::max(image_index, neighbor)]);
+      }
     }
 
-    // Find the top K matching results for image i.
-    std::partial_sort(global_matching_scores[i].begin(),
-                      global_matching_scores[i].begin() + num_nearest_neighbors,
-                      global_matching_scores[i].end());
+    // Uniquify the matches.
+    std::sort(image_names_to_match.begin(), image_names_to_match.end());
+    image_names_to_match.erase(
+        std::unique(image_names_to_match.begin(), image_names_to_match.end()),
+        image_names_to_match.end());
+    matcher_->SetImagePairsToMatch(image_names_to_match);
+    return;
+  }
 
+  // Find the K most similar images (i.e. the ones with the lowest distance
+  // between global descriptors) for each image.
+  std::vector<int> query_indices(image_names.size());
+  std::iota(query_indices.begin(), query_indices.end(), 0);
+  std::vector<std::vector<int>> nearest_neighbors;
+  FindNearestNeighborsOfGlobalDescriptors(global_descriptors,
+                                          query_indices,
+                                          num_nearest_neighbors,
+                                          options_.num_threads,
+                                          &nearest_neighbors);
+
+  // The K nearest neighbors of each image are set for matching.
+  std::unordered_map<int, MatchedImages> pairs_to_match;
+  for (int i = 0; i < nearest_neighbors.size(); i++) {
     // Add each of the kNN to the output indices.
-    for (int j = 0; j < num_nearest_neighbors; j++) {
-      const int second_id = global_matching_scores[i][j].second;
-
+    for (const int second_id : nearest_neighbors[i]) {
       // Perform query expansion by adding image i as a candidate match to all of its matches neighbors.
       const auto& neighbors_of_second_id = pairs_to_match[second_id].ranked_matches;
       for (const int neighbor_of_second_id : neighbors_of_second_id) {
@@ -408,12 +694,8 @@ void FeatureExtractorAndMatcher::
       pairs_to_match[second_id].ranked_matches.insert(i);
 
     }
-
-    // Remove the matching scores for image i to free up memory.
-    global_matching_scores[i].clear();
   }
 
-
   // Collect all matches into one container.
   std::vector<std::pair<std::string, std::string>> image_names_to_match;
   image_names_to_match.reserve(num_nearest_neighbors * global_descriptors.size());
@@ -36,6 +36,7 @@
 #define THEIA_SFM_FEATURE_EXTRACTOR_AND_MATCHER_H_
 
 #include <Eigen/Core>
+#include <memory>
 #include <mutex>  // NOLINT
 #include <string>
 #include <thread>  // NOLINT
@@ -45,11 +46,13 @@
 #include "theia/matching/create_feature_matcher.h"
 #include "theia/matching/feature_matcher.h"
 #include "theia/matching/feature_matcher_options.h"
+#include "theia/sfm/camera_intrinsics_prior.h"
 #include "theia/sfm/exif_reader.h"
+#include "theia/util/random.h"
 
 namespace theia {
+class DescriptorExtractorPool;
 class GlobalDescriptorExtractor;
-struct CameraIntrinsicsPrior;
 struct ImagePairMatch;
 
 class FeatureExtractorAndMatcher {
@@ -75,11 +78,24 @@ class FeatureExtractorAndMatcher {
     // The features returned will be no larger than this size.
     int max_num_features = 16384;
 
+    // When more than max_num_features keypoints are detected, the image is
+    // divided into a grid of this size and the strongest keypoints of each
+    // cell are kept first so that the features are spread over the image.
+    // Descriptors are only computed for the kept keypoints.
+    int keypoint_selection_grid_size = 4;
+
+    // Images are decoded directly to grayscale and, if this is positive, box
+    // filtered down by an integer factor until neither dimension exceeds this
+    // size before features are extracted. The keypoints are mapped back to
+    // the full resolution image. Very large images gain little from full
+    // resolution extraction since SIFT already starts at a coarser octave.
+    int max_image_dimension_for_feature_extraction = 0;
+
     // Minimum number of inliers to consider the matches a good match.
     int min_num_inlier_matches = 30;
 
     // Matching strategy to use for establishing feature correspondences.
-    MatchingStrategy matching_strategy;
+    MatchingStrategy matching_strategy = MatchingStrategy::BRUTE_FORCE;
 
     // Matching options for determining which feature matches are good matches.
     FeatureMatcherOptions feature_matcher_options;
@@ -94,6 +110,17 @@ class FeatureExtractorAndMatcher {
     // Specific options for Fisher Vector global feature extraction.
     int num_gmm_clusters_for_fisher_vector = 16;
     int max_num_features_for_fisher_vector_training = 1000000;
+    // The random number generator used to train the Fisher Vector GMM. If rng
+    // is not supplied, the seed is initialized based on the time.
+    std::shared_ptr<RandomNumberGenerator> rng;
+
+    // If true, the trained global descriptor extractor model and the global
+    // descriptors of each image are read from the features and matches
+    // database when available, and are written to the database after they are
+    // computed. This allows incremental runs to only compute global descriptors
+    // for new images instead of retraining the model and re-extracting the
+    // descriptors for the whole collection.
+    bool reuse_global_descriptors_from_database = true;
   };
 
   explicit FeatureExtractorAndMatcher(
@@ -127,7 +154,12 @@ class FeatureExtractorAndMatcher {
   void ExtractAndMatchFeatures();
 
  protected:
-  // Processes a single image by extracting EXIF information, extracting
+  // Gathers the intrinsics prior of each image from the database. The EXIF
+  // metadata of images without a focal length prior is read in parallel
+  // beforehand. Only the image headers are read for this.
+  void ReadCameraIntrinsicsPriors();
+
+  // Processes a single image by setting its intrinsics prior, extracting
   // features and descriptors, and adding the image to the matcher.
   void ProcessImage(const int i);
 
@@ -139,6 +171,15 @@ class FeatureExtractorAndMatcher {
       const std::vector<std::string>& image_names,
       std::vector<Eigen::VectorXf>* global_descriptors);
 
+  // Loads the global descriptor extractor model from the database if one is
+  // available and compatible with the options. Returns true if the model was
+  // loaded, in which case the extractor does not need to be retrained.
+  bool LoadGlobalDescriptorExtractorModel();
+
+  // Sets new_image_names_ to the images that the database does not record as
+  // matched.
+  void FindNewImages();
+
   const Options options_;
   FeaturesAndMatchesDatabase* features_and_matches_database_;
 
@@ -147,6 +188,25 @@ class FeatureExtractorAndMatcher {
   std::vector<std::string> image_filepaths_;
   std::unordered_map<std::string, std::string> image_masks_;
 
+  // The names of the images that were added to the matcher.
+  std::vector<std::string> image_names_;
+
+  // The names of images that the features and matches database does not record
+  // as matched. This includes images whose features were extracted by an
+  // earlier run that stopped before matching them. These are the images that
+  // must be matched when matching incrementally.
+  std::vector<std::string> new_image_names_;
+
+  // The intrinsics prior of each image in image_filepaths_, from the database
+  // or from the EXIF metadata.
+  std::vector<CameraIntrinsicsPrior> intrinsics_priors_;
+
+  // Descriptor extractors and image buffers that are reused by the threads
+  // extracting features. Threads that are not needed for extracting features
+  // from different images in parallel are used by each extractor to extract
+  // features within an image.
+  std::unique_ptr<DescriptorExtractorPool> descriptor_extractor_pool_;
+
   // Exif reader for loading exif information. This object is created once so
   // that the EXIF focal length database does not have to be loaded multiple
   // times.
@@ -157,6 +217,11 @@ class FeatureExtractorAndMatcher {
   // perform explicit (and expensive) feature matching.
   std::unique_ptr<GlobalDescriptorExtractor> global_image_descriptor_extractor_;
 
+  // True if the global descriptor extractor model was loaded from the database.
+  // In that case the extractor is not retrained and the global descriptors
+  // stored in the database are valid and reused.
+  bool global_descriptor_extractor_is_trained_ = false;
+
   // Feature matcher and mutex for thread-safe access.
   std::unique_ptr<FeatureMatcher> matcher_;
   std::mutex matcher_mutex_;
@@ -37,111 +37,252 @@
 #include <Eigen/Core>
 #include <ceres/rotation.h>
 #include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
-#include "theia/math/graph/triplet_extractor.h"
 #include "theia/math/util.h"
 #include "theia/sfm/twoview_info.h"
 #include "theia/sfm/types.h"
 #include "theia/sfm/view_graph/view_graph.h"
-#include "theia/sfm/view_triplet.h"
+#include "theia/sfm/view_graph/view_graph_snapshot.h"
 #include "theia/util/hash.h"
+#include "theia/util/threadpool.h"
 
 namespace theia {
 namespace {
 
-double ComputeLoopRotationError(const TwoViewInfo& info_one_two,
-                                const TwoViewInfo& info_one_three,
-                                const TwoViewInfo& info_two_three) {
-  // Get relative rotation matrices.
-  Eigen::Matrix3d rotation1_2, rotation1_3, rotation2_3;
-  ceres::AngleAxisToRotationMatrix(
-      info_one_two.rotation_2.data(),
-      ceres::ColumnMajorAdapter3x3(rotation1_2.data()));
-  ceres::AngleAxisToRotationMatrix(
-      info_one_three.rotation_2.data(),
-      ceres::ColumnMajorAdapter3x3(rotation1_3.data()));
-  ceres::AngleAxisToRotationMatrix(
-      info_two_three.rotation_2.data(),
-      ceres::ColumnMajorAdapter3x3(rotation2_3.data()));
-
-  // Compute loop rotation.
-  const Eigen::Matrix3d loop_rotation =
-      rotation2_3 * rotation1_2 * rotation1_3.transpose();
-  Eigen::Vector3d loop_rotation_angle_axis;
-  ceres::RotationMatrixToAngleAxis(
-      ceres::ColumnMajorAdapter3x3(loop_rotation.data()),
-      loop_rotation_angle_axis.data());
-
-  // Return the angle of the loop rotation which is the error of the
-  // concatenated triplet rotation.
-  return RadToDeg(loop_rotation_angle_axis.norm());
+// The view graph in compressed row form over dense vertex indices. Vertices are
+// numbered by their rank in the (degree, view id) ordering and each undirected
+// edge is only stored at its lower ranked endpoint, with the forward neighbors
+// of each vertex sorted by rank. Intersecting the forward neighbors of the two
+// endpoints of every edge then visits each triangle exactly once, and no vertex
+// has more than O(sqrt(num_edges)) forward neighbors.
+struct ForwardAdjacency {
+  std::vector<int> offsets;
+  std::vector<int> neighbors;
+  std::vector<int> edges;
+
+  int NumVertices() const { return offsets.size() - 1; }
+};
+
+// The rotations of the view pairs as matrices along with the ranks of the two
+// views of each pair.
+struct EdgeRotations {
+  // The rotation from the first to the second view of each view pair (sorted by
+  // view id).
+  std::vector<Eigen::Matrix3d> rotations;
+  // The ranks of the first and second view of each view pair.
+  std::vector<std::pair<int, int> > ranks;
+};
+
+void BuildForwardAdjacency(const ViewGraphSnapshot& snapshot,
+                           EdgeRotations* edge_rotations,
+                           ForwardAdjacency* adjacency) {
+  const int num_views = snapshot.NumViews();
+  const int num_edges = snapshot.NumEdges();
+
+  // Rank the views by degree, breaking ties by view id (i.e. view index).
+  std::vector<int> order(num_views);
+  for (int i = 0; i < num_views; i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](const int i, const int j) {
+    return snapshot.Degree(i) < snapshot.Degree(j) ||
+           (snapshot.Degree(i) == snapshot.Degree(j) && i < j);
+  });
+  std::vector<int> ranks(num_views);
+  for (int i = 0; i < num_views; i++) {
+    ranks[order[i]] = i;
+  }
+
+  // Store each edge at its lower ranked endpoint.
+  edge_rotations->rotations.resize(num_edges);
+  edge_rotations->ranks.resize(num_edges);
+  adjacency->offsets.assign(num_views + 1, 0);
+  for (int i = 0; i < num_edges; i++) {
+    ceres::AngleAxisToRotationMatrix(
+        snapshot.Rotations2()[i].data(),
+        ceres::ColumnMajorAdapter3x3(edge_rotations->rotations[i].data()));
+    edge_rotations->ranks[i].first = ranks[snapshot.EdgeViewIndex1(i)];
+    edge_rotations->ranks[i].second = ranks[snapshot.EdgeViewIndex2(i)];
+    const int lower_rank = std::min(edge_rotations->ranks[i].first,
+                                    edge_rotations->ranks[i].second);
+    ++adjacency->offsets[lower_rank + 1];
+  }
+  for (int i = 0; i < num_views; i++) {
+    adjacency->offsets[i + 1] += adjacency->offsets[i];
+  }
+
+  std::vector<std::pair<int, int> > forward_edges(num_edges);
+  std::vector<int> next_forward_edge(adjacency->offsets.begin(),
+                                     adjacency->offsets.end() - 1);
+  for (int i = 0; i < num_edges; i++) {
+    const int rank1 = edge_rotations->ranks[i].first;
+    const int rank2 = edge_rotations->ranks[i].second;
+    forward_edges[next_forward_edge[std::min(rank1, rank2)]++] =
+        std::make_pair(std::max(rank1, rank2), i);
+  }
+
+  adjacency->neighbors.resize(num_edges);
+  adjacency->edges.resize(num_edges);
+  for (int i = 0; i < num_views; i++) {
+    std::sort(forward_edges.begin() + adjacency->offsets[i],
+              forward_edges.begin() + adjacency->offsets[i + 1]);
+    for (int j = adjacency->offsets[i]; j < adjacency->offsets[i + 1]; j++) {
+      adjacency->neighbors[j] = forward_edges[j].first;
+      adjacency->edges[j] = forward_edges[j].second;
+    }
+  }
 }
 
-void RemoveTripletEdgesFromInvalidViewPairs(
-    const ViewIdTriplet& triplet,
-    std::unordered_set<ViewIdPair>* invalid_view_pairs) {
-  const ViewIdPair pair_01(std::get<0>(triplet), std::get<1>(triplet));
-  const ViewIdPair pair_02(std::get<0>(triplet), std::get<2>(triplet));
-  const ViewIdPair pair_12(std::get<1>(triplet), std::get<2>(triplet));
-  invalid_view_pairs->erase(pair_01);
-  invalid_view_pairs->erase(pair_02);
-  invalid_view_pairs->erase(pair_12);
+// Returns the rotation of the edge from the view with the given rank to the
+// other view of the edge.
+Eigen::Matrix3d RotationFromView(const EdgeRotations& edge_rotations,
+                                 const int edge,
+                                 const int from_rank) {
+  if (edge_rotations.ranks[edge].first == from_rank) {
+    return edge_rotations.rotations[edge];
+  }
+  return edge_rotations.rotations[edge].transpose();
 }
 
-}  // namespace
+// Returns the angle of the loop rotation u -> v -> w -> u which is the error of
+// the concatenated triplet rotation.
+double ComputeLoopRotationError(const EdgeRotations& edge_rotations,
+                                const int u,
+                                const int v,
+                                const int edge_uv,
+                                const int edge_uw,
+                                const int edge_vw) {
+  const Eigen::Matrix3d rotation_u_v =
+      RotationFromView(edge_rotations, edge_uv, u);
+  const Eigen::Matrix3d rotation_v_w =
+      RotationFromView(edge_rotations, edge_vw, v);
+  const Eigen::Matrix3d rotation_u_w =
+      RotationFromView(edge_rotations, edge_uw, u);
 
-void FilterViewGraphCyclesByRotation(const double max_loop_error_degrees,
-                                     ViewGraph* view_graph) {
-  const std::unordered_map<ViewIdPair, TwoViewInfo>& view_pairs =
-      view_graph->GetAllEdges();
-
-  // Initialize a list of invalid view pairs to all view pairs. View pairs
-  // deemed valid will be removed from this list.
-  std::unordered_set<ViewIdPair> invalid_view_pairs;
-  invalid_view_pairs.reserve(view_pairs.size());
-  for (const auto& view_pair : view_pairs) {
-    invalid_view_pairs.insert(view_pair.first);
-  }
+  // The trace of the loop rotation R_wu * R_vw * R_uv where R_wu = R_uw^t.
+  const Eigen::Matrix3d rotation_u_v_w = rotation_v_w * rotation_u_v;
+  const double trace = rotation_u_w.cwiseProduct(rotation_u_v_w).sum();
+  return RadToDeg(std::acos(Clamp((trace - 1.0) / 2.0, -1.0, 1.0)));
+}
 
-  // Find all triplets.
-  TripletExtractor<ViewId> triplet_extractor;
-  std::vector<std::vector<ViewIdTriplet> > connected_triplets;
-  CHECK(triplet_extractor.ExtractTriplets(invalid_view_pairs,
-                                          &connected_triplets))
-      << "Could not extract triplets from view pairs.";
-
-  // Examine the cycles of size 3 to determine invalid view pairs from the
-  // rotations.
-  for (const auto& triplets : connected_triplets) {
-    for (const ViewIdTriplet& triplet : triplets) {
-      const TwoViewInfo& info_one_two =
-          *view_graph->GetEdge(std::get<0>(triplet), std::get<1>(triplet));
-      const TwoViewInfo& info_one_three =
-          *view_graph->GetEdge(std::get<0>(triplet), std::get<2>(triplet));
-      const TwoViewInfo& info_two_three =
-          *view_graph->GetEdge(std::get<1>(triplet), std::get<2>(triplet));
-
-      // Compute loop rotation error.
+// Checks the triplets anchored at the edges of the given vertex and marks the
+// edges of all valid triplets.
+void CheckTripletsOfVertex(
+    const FilterViewGraphCyclesByRotationOptions& options,
+    const ForwardAdjacency& adjacency,
+    const EdgeRotations& edge_rotations,
+    const int u,
+    std::vector<char>* valid_edges) {
+  const int u_begin = adjacency.offsets[u];
+  const int u_end = adjacency.offsets[u + 1];
+  for (int i = u_begin; i < u_end; i++) {
+    const int v = adjacency.neighbors[i];
+    const int edge_uv = adjacency.edges[i];
+
+    // The common forward neighbors of u and v ranked after v close a triangle
+    // with the edge (u, v).
+    int num_triplets = 0;
+    int j = i + 1;
+    int k = adjacency.offsets[v];
+    const int v_end = adjacency.offsets[v + 1];
+    while (j < u_end && k < v_end) {
+      if (adjacency.neighbors[j] < adjacency.neighbors[k]) {
+        ++j;
+        continue;
+      }
+      if (adjacency.neighbors[k] < adjacency.neighbors[j]) {
+        ++k;
+        continue;
+      }
+
+      const int edge_uw = adjacency.edges[j];
+      const int edge_vw = adjacency.edges[k];
+      ++j;
+      ++k;
+
+      // Mark the view pairs as valid if the loop error is within the designated
+      // tolerance.
       const double loop_rotation_error_degrees = ComputeLoopRotationError(
-          info_one_two, info_one_three, info_two_three);
+          edge_rotations, u, v, edge_uv, edge_uw, edge_vw);
+      if (loop_rotation_error_degrees < options.max_loop_error_degrees) {
+        (*valid_edges)[edge_uv] = 1;
+        (*valid_edges)[edge_uw] = 1;
+        (*valid_edges)[edge_vw] = 1;
+      }
 
-      // Add the view pairs to the list of valid view pairs if the loop error is
-      // within the designated tolerance.
-      if (loop_rotation_error_degrees < max_loop_error_degrees) {
-        RemoveTripletEdgesFromInvalidViewPairs(triplet, &invalid_view_pairs);
+      ++num_triplets;
+      if (num_triplets == options.max_triplets_per_edge) {
+        break;
       }
     }
   }
+}
+
+}  // namespace
+
+void FilterViewGraphCyclesByRotation(
+    const FilterViewGraphCyclesByRotationOptions& options,
+    ViewGraph* view_graph) {
+  CHECK_GT(options.num_threads, 0);
+  CHECK_GE(options.max_triplets_per_edge, 0);
+  const ViewGraphSnapshot snapshot(*view_graph);
+  EdgeRotations edge_rotations;
+  ForwardAdjacency adjacency;
+  BuildForwardAdjacency(snapshot, &edge_rotations, &adjacency);
 
-  VLOG(1) << "Removing " << invalid_view_pairs.size() << " of "
-          << view_pairs.size() << " view pairs from loop rotation filtering.";
+  // Examine the cycles of size 3 to determine valid view pairs from the
+  // rotations. Each thread checks a strided subset of the vertices and marks
+  // valid edges in its own buffer so that no locking is required.
+  const int num_vertices = adjacency.NumVertices();
+  const int num_threads =
+      std::max(1, std::min(options.num_threads, num_vertices));
+  std::vector<std::vector<char> > valid_edges(
+      num_threads, std::vector<char>(snapshot.NumEdges(), 0));
+  const auto check_triplets = [&](const int thread_index) {
+    for (int u = thread_index; u < num_vertices; u += num_threads) {
+      CheckTripletsOfVertex(options, adjacency, edge_rotations, u,
+                            &valid_edges[thread_index]);
+    }
+  };
+  if (num_threads == 1) {
+    check_triplets(0);
+  } else {
+    ThreadPool pool(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+      pool.Add(check_triplets, i);
+    }
+    // The thread pool destructor waits for all vertices to be checked.
+  }
 
-  // Remove any view pairs not in the list of valid edges.
-  for (const ViewIdPair& view_pair_id : invalid_view_pairs) {
-    view_graph->RemoveEdge(view_pair_id.first, view_pair_id.second);
+  // Remove any view pairs that do not participate in a valid triplet.
+  int num_invalid_view_pairs = 0;
+  for (int i = 0; i < snapshot.NumEdges(); i++) {
+    bool is_valid = false;
+    for (int j = 0; j < num_threads && !is_valid; j++) {
+      is_valid = valid_edges[j][i];
+    }
+    if (!is_valid) {
+      view_graph->RemoveEdge(snapshot.GetViewId(snapshot.EdgeViewIndex1(i)),
+                             snapshot.GetViewId(snapshot.EdgeViewIndex2(i)));
+      ++num_invalid_view_pairs;
+    }
   }
+
+  VLOG(1) << "Removed " << num_invalid_view_pairs << " of "
+          << snapshot.NumEdges()
+          << " view pairs from loop rotation filtering.";
+}
+
+void FilterViewGraphCyclesByRotation(const double max_loop_error_degrees,
+                                     ViewGraph* view_graph) {
+  FilterViewGraphCyclesByRotationOptions options;
+  options.max_loop_error_degrees = max_loop_error_degrees;
+  FilterViewGraphCyclesByRotation(options, view_graph);
 }
 
 }  // namespace theia
@@ -38,12 +38,35 @@
 namespace theia {
 class ViewGraph;
 
+struct FilterViewGraphCyclesByRotationOptions {
+  // Triplets whose loop rotation error is below this threshold are valid.
+  double max_loop_error_degrees = 2.0;
+
+  // The triplets are enumerated and checked in parallel with this many
+  // threads.
+  int num_threads = 1;
+
+  // Each triplet is enumerated from exactly one of its edges. If this is
+  // positive, at most this many triplets are checked for each edge, which caps
+  // the cost on very dense view graphs at the expense of possibly missing the
+  // only valid triplet of an edge. A value of 0 checks all triplets.
+  int max_triplets_per_edge = 0;
+};
+
 // Finds all cycles of size 3 (i.e., "triplets") and sets each triplet to
 // "valid" if the loop rotation error is less than 2 degree. The loop rotation
 // error is defined as the angle of the concatenated rotations (compared to the
 // identity). This is because the concatenated rotations of a perfect loop
 // should result in a zero angle loop rotation. Any view pairs that do not
 // participate in a valid triplet are removed.
+//
+// The triplets are streamed from a degree-ordered adjacency so that each
+// triplet is visited exactly once without ever being stored.
+void FilterViewGraphCyclesByRotation(
+    const FilterViewGraphCyclesByRotationOptions& options,
+    ViewGraph* view_graph);
+
+// Same as above, using a single thread and checking all triplets.
 void FilterViewGraphCyclesByRotation(const double max_loop_error_degrees,
                                      ViewGraph* view_pairs);
 
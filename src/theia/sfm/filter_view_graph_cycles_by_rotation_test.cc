@@ -149,7 +149,8 @@ void CreateInvalidViewPairs(
 
 void TestFilterViewGraphCyclesByRotation(const int num_views,
                                          const int num_valid_view_pairs,
-                                         const int num_invalid_view_pairs) {
+                                         const int num_invalid_view_pairs,
+                                         const int num_threads = 1) {
   static const double kMaxRelativeRotationDifferenceDegrees = 4.0;
   std::unordered_map<ViewId, Vector3d> orientations;
   CreateViewsWithRandomOrientations(num_views, &orientations);
@@ -157,11 +158,39 @@ void TestFilterViewGraphCyclesByRotation(const int num_views,
   ViewGraph view_graph;
   CreateValidViewPairs(num_valid_view_pairs, orientations, &view_graph);
   CreateInvalidViewPairs(num_invalid_view_pairs, orientations, &view_graph);
-  FilterViewGraphCyclesByRotation(kMaxRelativeRotationDifferenceDegrees,
-                                  &view_graph);
+  FilterViewGraphCyclesByRotationOptions options;
+  options.max_loop_error_degrees = kMaxRelativeRotationDifferenceDegrees;
+  options.num_threads = num_threads;
+  FilterViewGraphCyclesByRotation(options, &view_graph);
   EXPECT_EQ(view_graph.NumEdges(), num_valid_view_pairs);
 }
 
+// Creates a clique of views 2, ..., num_clique_views + 1 and connects views 0
+// and 1 to each other and to every view of the clique. All views have the same
+// degree, so the triplets (0, 1, w) are all enumerated from the edge (0, 1) in
+// the order of w. The edges (1, w) are corrupted for all but the last clique
+// view, so that the last triplet of the edge (0, 1) is its only valid one.
+void CreateViewGraphWithOneValidTripletOnEdge(
+    const int num_clique_views,
+    const std::unordered_map<ViewId, Vector3d>& orientations,
+    ViewGraph* view_graph) {
+  const ViewId last_clique_view = num_clique_views + 1;
+  view_graph->AddEdge(0, 1, CreateTwoViewInfo(orientations, ViewIdPair(0, 1)));
+  for (ViewId i = 2; i <= last_clique_view; i++) {
+    view_graph->AddEdge(0, i,
+                        CreateTwoViewInfo(orientations, ViewIdPair(0, i)));
+    TwoViewInfo info = CreateTwoViewInfo(orientations, ViewIdPair(1, i));
+    if (i != last_clique_view) {
+      info.rotation_2 = rng.RandVector3d();
+    }
+    view_graph->AddEdge(1, i, info);
+    for (ViewId j = i + 1; j <= last_clique_view; j++) {
+      view_graph->AddEdge(i, j,
+                          CreateTwoViewInfo(orientations, ViewIdPair(i, j)));
+    }
+  }
+}
+
 }  // namespace
 
 TEST(FilterViewGraphCyclesByRotation, NoBadRotations) {
@@ -176,4 +205,45 @@ TEST(FilterViewGraphCyclesByRotation, ManyBadRotations) {
   TestFilterViewGraphCyclesByRotation(10, 30, 15);
 }
 
+TEST(FilterViewGraphCyclesByRotation, ManyBadRotationsMultithreaded) {
+  TestFilterViewGraphCyclesByRotation(10, 30, 15, 4);
+}
+
+TEST(FilterViewGraphCyclesByRotation, MaxTripletsPerEdge) {
+  static const int kNumCliqueViews = 5;
+  static const double kMaxRelativeRotationDifferenceDegrees = 4.0;
+  std::unordered_map<ViewId, Vector3d> orientations;
+  CreateViewsWithRandomOrientations(kNumCliqueViews + 2, &orientations);
+
+  ViewGraph input_view_graph;
+  CreateViewGraphWithOneValidTripletOnEdge(kNumCliqueViews, orientations,
+                                           &input_view_graph);
+  const int num_corrupted_edges = kNumCliqueViews - 1;
+  const int num_valid_edges = input_view_graph.NumEdges() - num_corrupted_edges;
+
+  FilterViewGraphCyclesByRotationOptions options;
+  options.max_loop_error_degrees = kMaxRelativeRotationDifferenceDegrees;
+  for (int max_triplets_per_edge = 0; max_triplets_per_edge <= kNumCliqueViews;
+       max_triplets_per_edge++) {
+    ViewGraph view_graph = input_view_graph;
+    options.max_triplets_per_edge = max_triplets_per_edge;
+    FilterViewGraphCyclesByRotation(options, &view_graph);
+
+    // The corrupted edges are removed regardless of the cap.
+    for (ViewId i = 2; i <= kNumCliqueViews; i++) {
+      EXPECT_FALSE(view_graph.HasEdge(1, i));
+    }
+
+    // The only valid triplet of the edge (0, 1) is the last one enumerated from
+    // it. If fewer triplets are checked, the edge (0, 1) and the edge (1, w)
+    // that is only valid in that triplet are removed as well.
+    const bool checks_all_triplets =
+        max_triplets_per_edge == 0 || max_triplets_per_edge >= kNumCliqueViews;
+    EXPECT_EQ(view_graph.HasEdge(0, 1), checks_all_triplets);
+    EXPECT_EQ(view_graph.HasEdge(1, kNumCliqueViews + 1), checks_all_triplets);
+    EXPECT_EQ(view_graph.NumEdges(),
+              checks_all_triplets ? num_valid_edges : num_valid_edges - 2);
+  }
+}
+
 }  // namespace theia
@@ -37,9 +37,11 @@
 #include <ceres/rotation.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <algorithm>
 #include <memory>
-#include <mutex>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "theia/math/util.h"
 #include "theia/util/hash.h"
@@ -49,204 +51,220 @@
 #include "theia/sfm/twoview_info.h"
 #include "theia/sfm/types.h"
 #include "theia/sfm/view_graph/view_graph.h"
+#include "theia/sfm/view_graph/view_graph_snapshot.h"
 
 namespace theia {
 using Eigen::Vector3d;
 
 namespace {
 
-// Helper struct to maintain the graph for the translation projection problem.
-struct MFASNode {
-  std::unordered_map<ViewId, double> incoming_nodes;
-  std::unordered_map<ViewId, double> outgoing_nodes;
-  double incoming_weight = 0;
-  double outgoing_weight = 0;
+// The view graph snapshot shared read-only by all iterations along with the
+// relative translations of its edges rotated into the global frame.
+struct TranslationFilteringGraph {
+  explicit TranslationFilteringGraph(const ViewGraphSnapshot& snapshot)
+      : snapshot(snapshot) {}
+
+  int NumViews() const { return snapshot.NumViews(); }
+  int NumEdges() const { return snapshot.NumEdges(); }
+
+  const ViewGraphSnapshot& snapshot;
+  std::vector<Vector3d> rotated_translations;
 };
 
 // Rotate the translation direction based on the known orientation such that the
 // translation is in the global reference frame.
-std::unordered_map<ViewIdPair, Vector3d>
-      RotateRelativeTranslationsToGlobalFrame(
-          const std::unordered_map<ViewId, Vector3d>& orientations,
-          const std::unordered_map<ViewIdPair, TwoViewInfo>& view_pairs) {
-  std::unordered_map<ViewIdPair, Vector3d> rotated_translations;
-  rotated_translations.reserve(orientations.size());
-
-  for (const auto& view_pair : view_pairs) {
+void RotateRelativeTranslationsToGlobalFrame(
+    const std::unordered_map<ViewId, Vector3d>& orientations,
+    TranslationFilteringGraph* graph) {
+  const ViewGraphSnapshot& snapshot = graph->snapshot;
+  graph->rotated_translations.resize(snapshot.NumEdges());
+  for (int i = 0; i < snapshot.NumEdges(); i++) {
+    const ViewId view_id1 = snapshot.GetViewId(snapshot.EdgeViewIndex1(i));
     const Vector3d view_to_world_rotation =
-        -1.0 * FindOrDie(orientations, view_pair.first.first);
-    Vector3d rotated_translation;
+        -1.0 * FindOrDie(orientations, view_id1);
     ceres::AngleAxisRotatePoint(view_to_world_rotation.data(),
-                                view_pair.second.position_2.data(),
-                                rotated_translation.data());
-    rotated_translations.emplace(view_pair.first, rotated_translation);
+                                snapshot.Positions2()[i].data(),
+                                graph->rotated_translations[i].data());
   }
-  return rotated_translations;
 }
 
-// Find the next view to add to the order. We attempt to choose a source (i.e.,
-// a node with no incoming edges) or choose a node based on a heuristic such
-// that it has the most source-like properties.
-ViewId FindNextViewInOrder(
-    const std::unordered_map<ViewId, MFASNode>& degrees_for_view) {
-  ViewId best_choice = kInvalidViewId;
-  double best_score = 0;
-  for (const auto& view : degrees_for_view) {
-    // If the view is a source view, return it.
-    if (view.second.incoming_nodes.size() == 0) {
-      return view.first;
-    }
-
-    // Otherwise, keep track of the max score seen so far.
-    const double score = (view.second.outgoing_weight + 1.0) /
-                         (view.second.incoming_weight + 1.0);
-    if (score > best_score) {
-      best_choice = view.first;
-      best_score = score;
+// Per-thread storage for the translation filtering iterations. The buffers are
+// sized once and reused for every iteration run by the same thread.
+struct TranslationFilteringBuffer {
+  explicit TranslationFilteringBuffer(const TranslationFilteringGraph& graph)
+      : projections(graph.NumEdges()),
+        bad_edge_weight(graph.NumEdges(), 0.0),
+        incoming_weight(graph.NumViews()),
+        outgoing_weight(graph.NumViews()),
+        num_incoming_edges(graph.NumViews()),
+        version(graph.NumViews()),
+        ordered(graph.NumViews()),
+        ordering(graph.NumViews()) {}
+
+  // A candidate for the next view in the ordering. Candidates become stale when
+  // the view is ordered or its degrees change, and stale candidates are skipped
+  // when they reach the top of the heap.
+  struct Candidate {
+    bool is_source;
+    double score;
+    int view_index;
+    int version;
+
+    // The heap pops the largest candidate first. Sources are always preferred,
+    // then higher scores, then lower view indices.
+    bool operator<(const Candidate& other) const {
+      if (is_source != other.is_source) {
+        return !is_source;
+      }
+      if (score != other.score) {
+        return score < other.score;
+      }
+      return view_index > other.view_index;
     }
-  }
+  };
+
+  std::vector<double> projections;
+  // The accumulated bad edge weights of all iterations run with this buffer.
+  std::vector<double> bad_edge_weight;
+
+  std::vector<double> incoming_weight;
+  std::vector<double> outgoing_weight;
+  std::vector<int> num_incoming_edges;
+  std::vector<int> version;
+  std::vector<char> ordered;
+  std::vector<int> ordering;
+  std::vector<Candidate> heap;
+};
 
-  return best_choice;
+// Pushes the current state of the view as a candidate for the ordering.
+void PushOrderingCandidate(const int view_index,
+                           TranslationFilteringBuffer* buffer) {
+  TranslationFilteringBuffer::Candidate candidate;
+  candidate.is_source = buffer->num_incoming_edges[view_index] == 0;
+  candidate.score = (buffer->outgoing_weight[view_index] + 1.0) /
+                    (buffer->incoming_weight[view_index] + 1.0);
+  candidate.view_index = view_index;
+  candidate.version = ++buffer->version[view_index];
+  buffer->heap.emplace_back(candidate);
+  std::push_heap(buffer->heap.begin(), buffer->heap.end());
 }
 
 // Based on the 1D translation projections, compute an ordering of the
-// translations.
-std::unordered_map<ViewId, int> OrderTranslationsFromProjections(
-    const std::unordered_map<ViewIdPair, double>&
-        translation_direction_projections) {
+// translations. We greedily choose a source (i.e., a node with no incoming
+// edges) or a node based on a heuristic such that it has the most source-like
+// properties. A lazily updated heap keeps each choice logarithmic rather than
+// scanning all remaining views.
+void OrderTranslationsFromProjections(const TranslationFilteringGraph& graph,
+                                      TranslationFilteringBuffer* buffer) {
+  const int num_views = graph.NumViews();
+
   // Compute the degrees of all vertices as the sum of weights coming in or out.
-  std::unordered_map<ViewId, MFASNode> degrees_for_view;
-  for (const auto& translation_projection : translation_direction_projections) {
-    const ViewIdPair view_id_pair =
-        (translation_projection.second > 0)
-            ? translation_projection.first
-            : ViewIdPair(translation_projection.first.second,
-                         translation_projection.first.first);
-
-    // Update the MFAS entry.
-    const double weight = std::abs(translation_projection.second);
-    degrees_for_view[view_id_pair.second].incoming_weight += weight;
-    degrees_for_view[view_id_pair.first].outgoing_weight += weight;
-    degrees_for_view[view_id_pair.second].incoming_nodes.emplace(
-        view_id_pair.first, weight);
-    degrees_for_view[view_id_pair.first].outgoing_nodes.emplace(
-        view_id_pair.second, weight);
+  std::fill(buffer->incoming_weight.begin(), buffer->incoming_weight.end(), 0);
+  std::fill(buffer->outgoing_weight.begin(), buffer->outgoing_weight.end(), 0);
+  std::fill(buffer->num_incoming_edges.begin(),
+            buffer->num_incoming_edges.end(),
+            0);
+  std::fill(buffer->ordered.begin(), buffer->ordered.end(), 0);
+  const ViewGraphSnapshot& snapshot = graph.snapshot;
+  for (int i = 0; i < graph.NumEdges(); i++) {
+    const int source = buffer->projections[i] > 0 ? snapshot.EdgeViewIndex1(i)
+                                                  : snapshot.EdgeViewIndex2(i);
+    const int target = buffer->projections[i] > 0 ? snapshot.EdgeViewIndex2(i)
+                                                  : snapshot.EdgeViewIndex1(i);
+    const double weight = std::abs(buffer->projections[i]);
+    buffer->incoming_weight[target] += weight;
+    buffer->outgoing_weight[source] += weight;
+    ++buffer->num_incoming_edges[target];
+  }
+
+  buffer->heap.clear();
+  for (int i = 0; i < num_views; i++) {
+    PushOrderingCandidate(i, buffer);
   }
 
   // Compute the ordering.
-  const int num_views = degrees_for_view.size();
-  std::unordered_map<ViewId, int> translation_ordering;
   for (int i = 0; i < num_views; i++) {
-    // Find the next view to add.
-    const ViewId next_view_in_order = FindNextViewInOrder(degrees_for_view);
-    translation_ordering[next_view_in_order] = i;
-
-    // Update the MFAS graph and remove the next view from the degrees_for_view.
-    const auto& next_view_info =
-        FindOrDie(degrees_for_view, next_view_in_order);
-    for (auto& neighbor_info : next_view_info.incoming_nodes) {
-      degrees_for_view[neighbor_info.first].outgoing_weight -=
-          neighbor_info.second;
-      degrees_for_view[neighbor_info.first].outgoing_nodes.erase(
-          next_view_in_order);
+    // Find the next view to add, skipping stale candidates.
+    int next_view = -1;
+    while (next_view < 0) {
+      std::pop_heap(buffer->heap.begin(), buffer->heap.end());
+      const TranslationFilteringBuffer::Candidate candidate =
+          buffer->heap.back();
+      buffer->heap.pop_back();
+      if (!buffer->ordered[candidate.view_index] &&
+          candidate.version == buffer->version[candidate.view_index]) {
+        next_view = candidate.view_index;
+      }
     }
-    for (auto& neighbor_info : next_view_info.outgoing_nodes) {
-      degrees_for_view[neighbor_info.first].incoming_weight -=
-          neighbor_info.second;
-      degrees_for_view[neighbor_info.first].incoming_nodes.erase(
-          next_view_in_order);
+    buffer->ordering[next_view] = i;
+    buffer->ordered[next_view] = 1;
+
+    // Remove the next view from the graph and update its remaining neighbors.
+    for (int j = 0; j < snapshot.Degree(next_view); j++) {
+      const int neighbor = snapshot.Neighbors(next_view)[j];
+      if (buffer->ordered[neighbor]) {
+        continue;
+      }
+
+      const int edge_index = snapshot.IncidentEdges(next_view)[j];
+      const double weight = std::abs(buffer->projections[edge_index]);
+      const bool next_view_is_source =
+          (buffer->projections[edge_index] > 0) ==
+          (snapshot.EdgeViewIndex1(edge_index) == next_view);
+      if (next_view_is_source) {
+        buffer->incoming_weight[neighbor] -= weight;
+        --buffer->num_incoming_edges[neighbor];
+      } else {
+        buffer->outgoing_weight[neighbor] -= weight;
+      }
+      PushOrderingCandidate(neighbor, buffer);
     }
-    degrees_for_view.erase(next_view_in_order);
   }
-
-  return translation_ordering;
-}
-
-// Projects all the of the translation onto the given axis.
-std::unordered_map<ViewIdPair, double> ProjectTranslationsOntoAxis(
-    const Vector3d& axis,
-    const std::unordered_map<ViewIdPair, Vector3d>& relative_translations) {
-  std::unordered_map<ViewIdPair, double> projection_weights;
-  projection_weights.reserve(relative_translations.size());
-
-  for (const auto& relative_translation : relative_translations) {
-    const double projection_weight = relative_translation.second.dot(axis);
-    projection_weights.emplace(relative_translation.first, projection_weight);
-  }
-  return projection_weights;
 }
 
 // This chooses a random axis based on the given relative translations.
-void ComputeMeanVariance(
-    const std::unordered_map<ViewIdPair, Vector3d>& relative_translations,
-    Vector3d* mean,
-    Vector3d* variance) {
+void ComputeMeanVariance(const std::vector<Vector3d>& relative_translations,
+                         Vector3d* mean,
+                         Vector3d* variance) {
   mean->setZero();
   variance->setZero();
-  for (const auto& translation : relative_translations) {
-    *mean += translation.second;
+  for (const Vector3d& translation : relative_translations) {
+    *mean += translation;
   }
   *mean /= static_cast<double>(relative_translations.size());
 
-  for (const auto& translation : relative_translations) {
-    *variance += (translation.second - *mean).cwiseAbs2();
+  for (const Vector3d& translation : relative_translations) {
+    *variance += (translation - *mean).cwiseAbs2();
   }
   *variance /= static_cast<double>(relative_translations.size() - 1);
 }
 
-// Performs a single iterations of the translation filtering. This method is
-// thread-safe.
-void TranslationFilteringIteration(
-    const std::unordered_map<ViewIdPair, Vector3d>& relative_translations,
-    const Vector3d& direction_mean,
-    const Vector3d& direction_variance,
-    const std::shared_ptr<RandomNumberGenerator>& rng,
-    std::mutex* mutex,
-    std::unordered_map<ViewIdPair, double>* bad_edge_weight) {
-  // Create the random number generator within each thread. If the random number
-  // generator is not supplied then create a new one within each thread.
-  std::shared_ptr<RandomNumberGenerator> local_rng;
-  if (rng.get() == nullptr) {
-    local_rng = std::make_shared<RandomNumberGenerator>();
-  } else {
-    local_rng = rng;
-  }
-
-  // Get a random vector to project all relative translations on to.
-  const Vector3d random_axis =
-      Vector3d(
-          local_rng->RandGaussian(direction_mean[0], direction_variance[0]),
-          local_rng->RandGaussian(direction_mean[1], direction_variance[1]),
-          local_rng->RandGaussian(direction_mean[2], direction_variance[2]))
-          .normalized();
-
+// Performs a single iterations of the translation filtering, accumulating the
+// bad edge weights into the buffer. This method is thread-safe as long as each
+// thread uses its own buffer.
+void TranslationFilteringIteration(const TranslationFilteringGraph& graph,
+                                   const Vector3d& axis,
+                                   TranslationFilteringBuffer* buffer) {
   // Project all vectors.
-  const std::unordered_map<ViewIdPair, double>&
-      translation_direction_projections =
-          ProjectTranslationsOntoAxis(random_axis, relative_translations);
+  for (int i = 0; i < graph.NumEdges(); i++) {
+    buffer->projections[i] = graph.rotated_translations[i].dot(axis);
+  }
 
   // Compute ordering.
-  const std::unordered_map<ViewId, int>& translation_ordering =
-      OrderTranslationsFromProjections(translation_direction_projections);
+  OrderTranslationsFromProjections(graph, buffer);
 
   // Compute bad edge weights.
-  for (auto& edge : *bad_edge_weight) {
+  for (int i = 0; i < graph.NumEdges(); i++) {
     const int ordering_diff =
-        FindOrDie(translation_ordering, edge.first.second) -
-        FindOrDie(translation_ordering, edge.first.first);
-    const double& projection_weight_of_edge =
-        FindOrDieNoPrint(translation_direction_projections, edge.first);
-
-    VLOG(3) << "Edge (" << edge.first.first << ", " << edge.first.second
-            << ") has ordering diff of " << ordering_diff
-            << " and a projection of " << projection_weight_of_edge << " from "
-            << FindOrDieNoPrint(relative_translations, edge.first).transpose();
+        buffer->ordering[graph.snapshot.EdgeViewIndex2(i)] -
+        buffer->ordering[graph.snapshot.EdgeViewIndex1(i)];
+    const double projection_weight_of_edge = buffer->projections[i];
+
     // If the ordering is inconsistent, add the absolute value of the bad weight
     // to the aggregate bad weight.
     if ((ordering_diff < 0 && projection_weight_of_edge > 0) ||
         (ordering_diff > 0 && projection_weight_of_edge < 0)) {
-      std::lock_guard<std::mutex> lock(*mutex);
-      edge.second += std::abs(projection_weight_of_edge);
+      buffer->bad_edge_weight[i] += std::abs(projection_weight_of_edge);
     }
   }
 }
@@ -257,48 +275,80 @@ void FilterViewPairsFromRelativeTranslation(
     const FilterViewPairsFromRelativeTranslationOptions& options,
     const std::unordered_map<ViewId, Vector3d>& orientations,
     ViewGraph* view_graph) {
-  const auto& view_pairs = view_graph->GetAllEdges();
-
-  // Weights of edges that have been accumulated throughout the iterations. A
-  // higher weight means the edge is more likely to be bad.
-  std::unordered_map<ViewIdPair, double> bad_edge_weight;
-  for (const auto& view_pair : view_pairs) {
-    bad_edge_weight[view_pair.first] = 0.0;
-  }
+  CHECK_GT(options.num_threads, 0);
+  CHECK_GT(options.num_iterations, 0);
 
   // Compute the adjusted translations so that they are oriented in the global
   // frame.
-  const std::unordered_map<ViewIdPair, Vector3d>& rotated_translations =
-      RotateRelativeTranslationsToGlobalFrame(orientations, view_pairs);
+  const ViewGraphSnapshot snapshot(*view_graph);
+  TranslationFilteringGraph graph(snapshot);
+  RotateRelativeTranslationsToGlobalFrame(orientations, &graph);
 
   Vector3d translation_mean, translation_variance;
-  ComputeMeanVariance(rotated_translations,
+  ComputeMeanVariance(graph.rotated_translations,
                       &translation_mean,
                       &translation_variance);
 
-  std::unique_ptr<ThreadPool> pool(new ThreadPool(options.num_threads));
-  std::mutex mutex;
+  // Get a random vector to project all relative translations on to for each
+  // iteration. These are drawn up front so that the random number generator is
+  // never shared between threads.
+  std::shared_ptr<RandomNumberGenerator> rng = options.rng;
+  if (rng.get() == nullptr) {
+    rng = std::make_shared<RandomNumberGenerator>();
+  }
+  std::vector<Vector3d> random_axes(options.num_iterations);
   for (int i = 0; i < options.num_iterations; i++) {
-    pool->Add(TranslationFilteringIteration,
-              rotated_translations,
-              translation_mean,
-              translation_variance,
-              options.rng,
-              &mutex,
-              &bad_edge_weight);
+    for (int j = 0; j < 3; j++) {
+      random_axes[i][j] =
+          rng->RandGaussian(translation_mean[j], translation_variance[j]);
+    }
+    random_axes[i].normalize();
+  }
+
+  // Each thread runs a fixed subset of the iterations and accumulates the bad
+  // edge weights into its own buffer so that no locking is required.
+  const int num_threads = std::min(options.num_threads, options.num_iterations);
+  std::vector<std::unique_ptr<TranslationFilteringBuffer> > buffers(
+      num_threads);
+  const auto run_iterations = [&](const int thread_index) {
+    buffers[thread_index].reset(new TranslationFilteringBuffer(graph));
+    for (int i = thread_index; i < options.num_iterations; i += num_threads) {
+      TranslationFilteringIteration(graph,
+                                    random_axes[i],
+                                    buffers[thread_index].get());
+    }
+  };
+  if (num_threads == 1) {
+    run_iterations(0);
+  } else {
+    ThreadPool pool(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+      pool.Add(run_iterations, i);
+    }
+    // The thread pool destructor waits for all iterations to finish.
+  }
+
+  // Reduce the bad edge weights of all threads. Weights of edges that have been
+  // accumulated throughout the iterations. A higher weight means the edge is
+  // more likely to be bad.
+  std::vector<double>& bad_edge_weight = buffers[0]->bad_edge_weight;
+  for (int i = 1; i < num_threads; i++) {
+    for (int j = 0; j < graph.NumEdges(); j++) {
+      bad_edge_weight[j] += buffers[i]->bad_edge_weight[j];
+    }
   }
-  // Wait for tasks to finish.
-  pool.reset(nullptr);
 
   // Remove all the bad edges.
   const double max_aggregated_projection_tolerance =
       options.translation_projection_tolerance * options.num_iterations;
   int num_view_pairs_removed = 0;
-  for (const auto& view_pair : bad_edge_weight) {
-    VLOG(3) << "View pair (" << view_pair.first.first << ", "
-            << view_pair.first.second << ") projection = " << view_pair.second;
-    if (view_pair.second > max_aggregated_projection_tolerance) {
-      view_graph->RemoveEdge(view_pair.first.first, view_pair.first.second);
+  for (int i = 0; i < graph.NumEdges(); i++) {
+    const ViewId view_id1 = snapshot.GetViewId(snapshot.EdgeViewIndex1(i));
+    const ViewId view_id2 = snapshot.GetViewId(snapshot.EdgeViewIndex2(i));
+    VLOG(3) << "View pair (" << view_id1 << ", " << view_id2
+            << ") projection = " << bad_edge_weight[i];
+    if (bad_edge_weight[i] > max_aggregated_projection_tolerance) {
+      view_graph->RemoveEdge(view_id1, view_id2);
       ++num_view_pairs_removed;
     }
   }
@@ -37,6 +37,7 @@
 #include <ceres/rotation.h>
 #include <Eigen/Core>
 #include <Eigen/SparseCore>
+#include <algorithm>
 #include <unordered_map>
 
 #include "theia/math/l1_solver.h"
@@ -149,13 +150,33 @@ void RobustRotationEstimator::SetupLinearSystem() {
 bool RobustRotationEstimator::SolveL1Regression() {
   L1Solver<Eigen::SparseMatrix<double> >::Options options;
   options.max_num_iterations = 5;
+  options.adaptive_rho = options_.l1_adaptive_rho;
+  options.linear_solver_type = options_.l1_linear_solver_type;
   L1Solver<Eigen::SparseMatrix<double> > l1_solver(options, sparse_matrix_);
 
   tangent_space_step_.setZero();
   ComputeResiduals();
-  for (int i = 0; i < options_.max_num_l1_iterations; i++) {
+  int num_l1_iterations = options_.max_num_l1_iterations;
+  if (options_.warm_start_from_initial_orientations) {
+    // The residual of the step x = 0 is z = -b.
+    l1_solver.InitializeFromResidual(-tangent_space_residual_);
+    num_l1_iterations =
+        options_.max_num_l1_iterations_from_initial_orientations;
+  }
 
-    l1_solver.Solve(tangent_space_residual_, &tangent_space_step_);
+  for (int i = 0; i < num_l1_iterations; i++) {
+    // The first solve starts from the ADMM state of the initial orientations
+    // when warm starting from them. The residuals are relinearized about the
+    // updated rotations and the step is taken from them, so the auxiliary
+    // variable z = A * x - b is unchanged to first order and may be carried
+    // across the outer iterations as well.
+    if ((i == 0 && options_.warm_start_from_initial_orientations) ||
+        (i > 0 && options_.l1_warm_start_admm)) {
+      tangent_space_step_.setZero();
+      l1_solver.WarmStartSolve(tangent_space_residual_, &tangent_space_step_);
+    } else {
+      l1_solver.Solve(tangent_space_residual_, &tangent_space_step_);
+    }
     UpdateGlobalRotations();
     ComputeResiduals();
 
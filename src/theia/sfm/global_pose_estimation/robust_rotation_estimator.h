@@ -39,6 +39,7 @@
 #include <Eigen/SparseCore>
 #include <unordered_map>
 
+#include "theia/math/l1_solver.h"
 #include "theia/sfm/global_pose_estimation/rotation_estimator.h"
 #include "theia/sfm/types.h"
 #include "theia/math/util.h"
@@ -70,6 +71,40 @@ class RobustRotationEstimator : public RotationEstimator {
     // Average step size threshold to terminate the L1 minimization
     double l1_step_convergence_threshold = 0.001;
 
+    // The linear solver used by the ADMM iterations of the L1 minimization.
+    // The conjugate gradient solver is matrix-free and avoids the sparse
+    // Cholesky factorization, which is preferable for very large view graphs.
+    L1SolverLinearSolverType l1_linear_solver_type =
+        L1SolverLinearSolverType::SPARSE_CHOLESKY;
+
+    // If true, the ADMM penalty parameter of the L1 minimization is adapted to
+    // balance the primal and dual residuals. The L1 minimization is limited to
+    // a few ADMM iterations per relinearization, so adapting the penalty
+    // parameter changes the estimated rotations and it is off by default.
+    bool l1_adaptive_rho = false;
+
+    // If true, the ADMM state of the L1 minimization (the auxiliary and dual
+    // variables) is carried across relinearizations instead of being reset, so
+    // that each relinearized problem starts close to its solution. Like
+    // l1_adaptive_rho, this changes the estimated rotations and it is off by
+    // default.
+    bool l1_warm_start_admm = false;
+
+    // If true, the input global orientations are treated as a near-optimal
+    // solution (e.g. the output of a previous estimation on the same view graph
+    // before a small number of views or edges were added or removed) rather
+    // than as a rough initialization. The L1 minimization then starts from the
+    // fixed point of the input orientations instead of from the least-squares
+    // solution, so it typically converges within a few iterations. Any views
+    // that were added must still be given a reasonable initialization.
+    bool warm_start_from_initial_orientations = false;
+
+    // The maximum number of times to run L1 minimization when warm starting
+    // from the initial orientations. These are expected to be within the cone
+    // of convergence for L2 solving already, so a single relinearization is
+    // typically enough.
+    int max_num_l1_iterations_from_initial_orientations = 1;
+
     // The number of iterative reweighted least squares iterations to perform.
     int max_num_irls_iterations = 100;
 
@@ -126,17 +126,29 @@ class EstimateRotationsRobustTest : public ::testing::Test {
     CreateGTOrientations(num_views);
     GetRelativeRotations(num_view_pairs, rotation_noise);
 
-    // Estimate the rotations.
-    RobustRotationEstimator::Options options;
-    RobustRotationEstimator rotation_estimator(options);
-
     // Set the initial rotation estimations.
     std::unordered_map<ViewId, Vector3d> estimated_rotations;
     InitializeRotationsFromSpanningTree(&estimated_rotations);
 
+    // Estimate the rotations.
+    EstimateRotations(options_, &estimated_rotations);
+    CheckRotations(rotation_tolerance_degrees, &estimated_rotations);
+  }
+
+  void EstimateRotations(
+      const RobustRotationEstimator::Options& options,
+      std::unordered_map<ViewId, Vector3d>* estimated_rotations) {
+    RobustRotationEstimator rotation_estimator(options);
     EXPECT_TRUE(rotation_estimator.EstimateRotations(view_pairs_,
-                                                     &estimated_rotations));
-    EXPECT_EQ(estimated_rotations.size(), orientations_.size());
+                                                     estimated_rotations));
+    EXPECT_EQ(estimated_rotations->size(), orientations_.size());
+  }
+
+  void CheckRotations(
+      const double rotation_tolerance_degrees,
+      std::unordered_map<ViewId, Vector3d>* estimated_rotations_ptr) {
+    std::unordered_map<ViewId, Vector3d>& estimated_rotations =
+        *estimated_rotations_ptr;
 
     // Align the rotations and measure the error.
     AlignOrientations(orientations_, &estimated_rotations);
@@ -208,6 +220,7 @@ class EstimateRotationsRobustTest : public ::testing::Test {
     }
   }
 
+  RobustRotationEstimator::Options options_;
   std::unordered_map<ViewId, Vector3d> orientations_;
   std::unordered_map<ViewIdPair, TwoViewInfo> view_pairs_;
 };
@@ -241,4 +254,61 @@ TEST_F(EstimateRotationsRobustTest, LargeTestWithNoise) {
                               kToleranceDegrees);
 }
 
+TEST_F(EstimateRotationsRobustTest, LargeTestWithNoiseConjugateGradient) {
+  static const double kToleranceDegrees = 5.0;
+  static const int kNumViews = 100;
+  static const int kNumViewPairs = 800;
+  static const double kPoseNoiseDegrees = 2.0;
+  options_.l1_linear_solver_type = L1SolverLinearSolverType::CONJUGATE_GRADIENT;
+  TestRobustRotationEstimator(kNumViews,
+                              kNumViewPairs,
+                              kPoseNoiseDegrees,
+                              kToleranceDegrees);
+}
+
+TEST_F(EstimateRotationsRobustTest, LargeTestWithNoiseAdaptiveRho) {
+  static const double kToleranceDegrees = 5.0;
+  static const int kNumViews = 100;
+  static const int kNumViewPairs = 800;
+  static const double kPoseNoiseDegrees = 2.0;
+  options_.l1_adaptive_rho = true;
+  TestRobustRotationEstimator(kNumViews,
+                              kNumViewPairs,
+                              kPoseNoiseDegrees,
+                              kToleranceDegrees);
+}
+
+TEST_F(EstimateRotationsRobustTest, LargeTestWithNoiseWarmStartADMM) {
+  static const double kToleranceDegrees = 5.0;
+  static const int kNumViews = 100;
+  static const int kNumViewPairs = 800;
+  static const double kPoseNoiseDegrees = 2.0;
+  options_.l1_warm_start_admm = true;
+  TestRobustRotationEstimator(kNumViews,
+                              kNumViewPairs,
+                              kPoseNoiseDegrees,
+                              kToleranceDegrees);
+}
+
+TEST_F(EstimateRotationsRobustTest, WarmStartAfterAddingViewPairs) {
+  static const double kToleranceDegrees = 5.0;
+  static const int kNumViews = 100;
+  static const int kNumViewPairs = 800;
+  static const int kNumAddedViewPairs = 20;
+  static const double kPoseNoiseDegrees = 2.0;
+  CreateGTOrientations(kNumViews);
+  GetRelativeRotations(kNumViewPairs, kPoseNoiseDegrees);
+
+  std::unordered_map<ViewId, Vector3d> estimated_rotations;
+  InitializeRotationsFromSpanningTree(&estimated_rotations);
+  EstimateRotations(options_, &estimated_rotations);
+
+  // Re-estimate the rotations after a small edit to the view graph, starting
+  // from the previous solution.
+  GetRelativeRotations(kNumViewPairs + kNumAddedViewPairs, kPoseNoiseDegrees);
+  options_.warm_start_from_initial_orientations = true;
+  EstimateRotations(options_, &estimated_rotations);
+  CheckRotations(kToleranceDegrees, &estimated_rotations);
+}
+
 }  // namespace theia
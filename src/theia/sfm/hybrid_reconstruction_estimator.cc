@@ -47,6 +47,7 @@
 #include "theia/matching/feature_correspondence.h"
 #include "theia/math/util.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/incremental_bundle_adjuster.h"
 #include "theia/sfm/create_and_initialize_ransac_variant.h"
 #include "theia/sfm/estimators/estimate_relative_pose_with_known_orientation.h"
 #include "theia/sfm/find_common_tracks_in_views.h"
@@ -133,6 +134,7 @@ HybridReconstructionEstimator::HybridReconstructionEstimator(
   localization_options_.ba_options.verbose = false;
   localization_options_.min_num_inliers =
       options_.min_num_absolute_pose_inliers;
+  localization_options_.num_threads = options_.num_threads;
 
   num_optimized_views_ = 0;
 }
@@ -141,6 +143,7 @@ ReconstructionEstimatorSummary HybridReconstructionEstimator::Estimate(
     ViewGraph* view_graph, Reconstruction* reconstruction) {
   reconstruction_ = reconstruction;
   view_graph_ = view_graph;
+  bundle_adjuster_.reset(new IncrementalBundleAdjuster(reconstruction_));
 
   // Initialize the unlocalized_views_ variable.
   const auto& view_ids = reconstruction_->ViewIds();
@@ -200,22 +203,46 @@ ReconstructionEstimatorSummary HybridReconstructionEstimator::Estimate(
 
     // Attempt to localize all candidate views and estimate new 3D
     // points. Bundle Adjustment is run as either partial or full BA depending
-    // on the current state of the reconstruction.
-    for (int i = 0; i < views_to_localize.size(); i++) {
-      timer.Reset();
+    // on the current state of the reconstruction. The candidates are localized
+    // concurrently in batches of num_threads views against the current
+    // reconstruction, and only the first successfully localized view of each
+    // batch is added. The remaining views of the batch were localized before
+    // that view was triangulated and bundle adjusted, so they are localized
+    // again as part of the next batch.
+    const int batch_size = std::max(1, options_.num_threads);
+    std::vector<ViewId> batch;
+    std::vector<LocalizedView> localized_views;
+    int next_view_to_localize = 0;
+    while (next_view_to_localize < views_to_localize.size() ||
+           !batch.empty()) {
+      while (batch.size() < batch_size &&
+             next_view_to_localize < views_to_localize.size()) {
+        batch.emplace_back(views_to_localize[next_view_to_localize]);
+        ++next_view_to_localize;
+      }
 
-      // Localize the view to the reconstruciton. If the orientation was
+      // Localize the views to the reconstruction. If the orientation was
       // estimated from the global algorithm, this will first try to use a
       // simplified solver to estimate the camera position assuming the known
       // orientation.
-      if (!LocalizeView(views_to_localize[i])) {
-        ++failed_localization_attempts;
+      timer.Reset();
+      LocalizeViews(batch, &localized_views);
+      summary_.pose_estimation_time += timer.ElapsedTimeInSeconds();
+
+      const auto localized_view = std::find_if(
+          localized_views.begin(), localized_views.end(),
+          [](const LocalizedView& view) { return view.success; });
+      if (localized_view == localized_views.end()) {
+        failed_localization_attempts += batch.size();
+        batch.clear();
         continue;
       }
-      summary_.pose_estimation_time += timer.ElapsedTimeInSeconds();
+      batch.erase(
+          std::find(batch.begin(), batch.end(), localized_view->view_id));
+      AddLocalizedViewToReconstruction(*localized_view, reconstruction_);
 
-      reconstructed_views_.push_back(views_to_localize[i]);
-      unlocalized_views_.erase(views_to_localize[i]);
+      reconstructed_views_.push_back(localized_view->view_id);
+      unlocalized_views_.erase(localized_view->view_id);
 
       // Remove any tracks that have very bad 3D point reprojections after the
       // new view has been merged. This can happen when a new observation of a
@@ -245,7 +272,8 @@ ReconstructionEstimatorSummary HybridReconstructionEstimator::Estimate(
       } else {
         // Step 5: Perform triangulation on all views.
         timer.Reset();
-        TrackEstimator track_estimator(triangulation_options_, reconstruction_);
+        TrackEstimator track_estimator(triangulation_options_,
+                                       reconstruction_);
         const TrackEstimator::Summary triangulation_summary =
             track_estimator.EstimateAllTracks();
         summary_.triangulation_time += timer.ElapsedTimeInSeconds();
@@ -263,7 +291,6 @@ ReconstructionEstimatorSummary HybridReconstructionEstimator::Estimate(
         summary_.success = false;
         return summary_;
       }
-
     }
   }
 
@@ -283,27 +310,52 @@ ReconstructionEstimatorSummary HybridReconstructionEstimator::Estimate(
   return summary_;
 }
 
-bool HybridReconstructionEstimator::LocalizeView(const ViewId view_id) {
-  if (ContainsKey(orientations_, view_id)) {
+void HybridReconstructionEstimator::LocalizeViews(
+    const std::vector<ViewId>& views_to_localize,
+    std::vector<LocalizedView>* localized_views) {
+  localized_views->clear();
+  std::vector<ViewId> views_with_known_orientation;
+  std::vector<ViewId> views_with_unknown_orientation;
+  for (const ViewId view_id : views_to_localize) {
+    if (ContainsKey(orientations_, view_id)) {
+      views_with_known_orientation.emplace_back(view_id);
+    } else {
+      views_with_unknown_orientation.emplace_back(view_id);
+    }
+  }
+
+  if (!views_with_known_orientation.empty()) {
     localization_options_.assume_known_orientation = true;
-    RansacSummary unused_ransac_summary;
-    if (LocalizeViewToReconstruction(view_id,
-                                     localization_options_,
-                                     reconstruction_,
-                                     &unused_ransac_summary)) {
-      return true;
+    std::vector<LocalizedView> known_orientation_localized_views;
+    LocalizeViewsToReconstruction(views_with_known_orientation,
+                                  localization_options_,
+                                  *reconstruction_,
+                                  &known_orientation_localized_views);
+    for (const LocalizedView& localized_view :
+         known_orientation_localized_views) {
+      if (localized_view.success) {
+        localized_views->emplace_back(localized_view);
+      } else {
+        views_with_unknown_orientation.emplace_back(localized_view.view_id);
+      }
     }
   }
 
-  // If we reached here, then either the orientation of this view was not
+  // If we reached here, then either the orientation of these views was not
   // computed during global orientation estimation or the localization of
   // only the position failed.
+  if (views_with_unknown_orientation.empty()) {
+    return;
+  }
   localization_options_.assume_known_orientation = false;
-  RansacSummary unused_ransac_summary;
-  return LocalizeViewToReconstruction(view_id,
-                                      localization_options_,
-                                      reconstruction_,
-                                      &unused_ransac_summary);
+  std::vector<LocalizedView> unknown_orientation_localized_views;
+  LocalizeViewsToReconstruction(views_with_unknown_orientation,
+                                localization_options_,
+                                *reconstruction_,
+                                &unknown_orientation_localized_views);
+  localized_views->insert(localized_views->end(),
+                          unknown_orientation_localized_views.begin(),
+                          unknown_orientation_localized_views.end());
 }
 
 bool HybridReconstructionEstimator::EstimateCameraOrientations() {
@@ -742,11 +794,8 @@ bool HybridReconstructionEstimator::FullBundleAdjustment() {
   std::unordered_set<ViewId> views_to_optimize;
   GetEstimatedViewsFromReconstruction(*reconstruction_,
                                       &views_to_optimize);
-  const auto& ba_summary =
-      BundleAdjustPartialReconstruction(bundle_adjustment_options_,
-                                        views_to_optimize,
-                                        tracks_to_optimize,
-                                        reconstruction_);
+  const auto& ba_summary = bundle_adjuster_->Optimize(
+      bundle_adjustment_options_, views_to_optimize, tracks_to_optimize);
   num_optimized_views_ = reconstructed_views_.size();
 
   const auto& track_ids = reconstruction_->TrackIds();
@@ -823,10 +872,8 @@ bool HybridReconstructionEstimator::PartialBundleAdjustment() {
   // during partial BA. This would provide obvious speedups, however, it may
   // actually be beneficial to optimize the entire local reconstruction and only
   // perform track subset selection for full BA. More testing should be done.
-  ba_summary = BundleAdjustPartialReconstruction(bundle_adjustment_options_,
-                                                 views_to_optimize,
-                                                 tracks_to_optimize,
-                                                 reconstruction_);
+  ba_summary = bundle_adjuster_->Optimize(
+      bundle_adjustment_options_, views_to_optimize, tracks_to_optimize);
 
   RemoveOutlierTracks(tracks_to_optimize,
                       options_.max_reprojection_error_in_pixels);
@@ -35,10 +35,12 @@
 #ifndef THEIA_SFM_HYBRID_RECONSTRUCTION_ESTIMATOR_H_
 #define THEIA_SFM_HYBRID_RECONSTRUCTION_ESTIMATOR_H_
 
+#include <memory>
 #include <vector>
 #include <unordered_map>
 
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/incremental_bundle_adjuster.h"
 #include "theia/sfm/estimate_track.h"
 #include "theia/sfm/localize_view_to_reconstruction.h"
 #include "theia/sfm/reconstruction_estimator.h"
@@ -95,10 +97,12 @@ class HybridReconstructionEstimator : public ReconstructionEstimator {
                                           Reconstruction* reconstruction);
 
  private:
-  // Localize the view. If the camera orientation is known then first try to
-  // estimate the position assuming the known rotation. If that fails, or the
-  // orientation is not known use standard localization.
-  bool LocalizeView(const ViewId view_id);
+  // Localize the views concurrently. Views with a known camera orientation are
+  // first localized by estimating the position assuming the known rotation. If
+  // that fails, or the orientation is not known, standard localization is
+  // used. Views localized with a known orientation are ranked first.
+  void LocalizeViews(const std::vector<ViewId>& views_to_localize,
+                     std::vector<LocalizedView>* localized_views);
 
   // Estimate the camera orientations from the relative rotations using a global
   // rotation estimation algorithm.
@@ -169,6 +173,9 @@ class HybridReconstructionEstimator : public ReconstructionEstimator {
 
   ReconstructionEstimatorOptions options_;
   BundleAdjustmentOptions bundle_adjustment_options_;
+  // Full and partial BA reuse the same problem so that only the residuals of
+  // the views and tracks that changed are added or removed between calls.
+  std::unique_ptr<IncrementalBundleAdjuster> bundle_adjuster_;
   RansacParameters ransac_params_;
   TrackEstimator::Options triangulation_options_;
   LocalizeViewToReconstructionOptions localization_options_;
@@ -48,6 +48,7 @@
 #include "theia/matching/feature_correspondence.h"
 #include "theia/math/util.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/incremental_bundle_adjuster.h"
 #include "theia/sfm/create_and_initialize_ransac_variant.h"
 #include "theia/sfm/find_common_tracks_in_views.h"
 #include "theia/sfm/localize_view_to_reconstruction.h"
@@ -127,6 +128,7 @@ IncrementalReconstructionEstimator::IncrementalReconstructionEstimator(
   localization_options_.ba_options.verbose = false;
   localization_options_.min_num_inliers =
       options_.min_num_absolute_pose_inliers;
+  localization_options_.num_threads = options_.num_threads;
 
   num_optimized_views_ = 0;
 }
@@ -161,6 +163,7 @@ ReconstructionEstimatorSummary IncrementalReconstructionEstimator::Estimate(
     ViewGraph* view_graph, Reconstruction* reconstruction) {
   reconstruction_ = reconstruction;
   view_graph_ = view_graph;
+  bundle_adjuster_.reset(new IncrementalBundleAdjuster(reconstruction_));
 
   // Initialize the unlocalized_views_ variable.
   const auto& view_ids = view_graph_->ViewIds();
@@ -215,21 +218,32 @@ ReconstructionEstimatorSummary IncrementalReconstructionEstimator::Estimate(
 
     // Attempt to localize all candidate views and estimate new 3D
     // points. Bundle Adjustment is run as either partial or full BA depending
-    // on the current state of the reconstruction.
-    for (int i = 0; i < views_to_localize.size(); i++) {
+    // on the current state of the reconstruction. The candidates are localized
+    // concurrently in batches of num_threads views, and the best localized
+    // view of the first batch in which any view was localized is added.
+    const int batch_size = std::max(1, options_.num_threads);
+    std::vector<LocalizedView> localized_views;
+    for (int i = 0; i < views_to_localize.size(); i += batch_size) {
       timer.Reset();
-      RansacSummary unused_ransac_summary;
-      if (!LocalizeViewToReconstruction(views_to_localize[i],
-                                        localization_options_,
-                                        reconstruction_,
-                                        &unused_ransac_summary)) {
-        ++failed_localization_attempts;
+      const std::vector<ViewId> batch(
+          views_to_localize.begin() + i,
+          views_to_localize.begin() +
+              std::min(i + batch_size,
+                       static_cast<int>(views_to_localize.size())));
+      LocalizeViewsToReconstruction(
+          batch, localization_options_, *reconstruction_, &localized_views);
+      summary_.pose_estimation_time += timer.ElapsedTimeInSeconds();
+
+      // The localized views are ranked so only the first one must be checked.
+      const LocalizedView& localized_view = localized_views.front();
+      if (!localized_view.success) {
+        failed_localization_attempts += batch.size();
         continue;
       }
-      summary_.pose_estimation_time += timer.ElapsedTimeInSeconds();
+      AddLocalizedViewToReconstruction(localized_view, reconstruction_);
 
-      reconstructed_views_.push_back(views_to_localize[i]);
-      unlocalized_views_.erase(views_to_localize[i]);
+      reconstructed_views_.push_back(localized_view.view_id);
+      unlocalized_views_.erase(localized_view.view_id);
 
       // Remove any tracks that have very bad 3D point reprojections after the
       // new view has been merged. This can happen when a new observation of a
@@ -512,11 +526,8 @@ bool IncrementalReconstructionEstimator::FullBundleAdjustment() {
 
   std::unordered_set<ViewId> views_to_optimize;
   GetEstimatedViewsFromReconstruction(*reconstruction_, &views_to_optimize);
-  const auto& ba_summary =
-      BundleAdjustPartialReconstruction(bundle_adjustment_options_,
-                                        views_to_optimize,
-                                        tracks_to_optimize,
-                                        reconstruction_);
+  const auto& ba_summary = bundle_adjuster_->Optimize(
+      bundle_adjustment_options_, views_to_optimize, tracks_to_optimize);
   num_optimized_views_ = reconstructed_views_.size();
 
   const auto& track_ids = reconstruction_->TrackIds();
@@ -584,10 +595,8 @@ bool IncrementalReconstructionEstimator::PartialBundleAdjustment() {
             << " tracks to optimize.";
 
   // Perform partial BA.
-  ba_summary = BundleAdjustPartialReconstruction(bundle_adjustment_options_,
-                                                 views_to_optimize,
-                                                 tracks_to_optimize,
-                                                 reconstruction_);
+  ba_summary = bundle_adjuster_->Optimize(
+      bundle_adjustment_options_, views_to_optimize, tracks_to_optimize);
 
   RemoveOutlierTracks(tracks_to_optimize,
                       options_.max_reprojection_error_in_pixels);
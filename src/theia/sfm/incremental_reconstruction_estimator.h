@@ -35,10 +35,12 @@
 #ifndef THEIA_SFM_INCREMENTAL_RECONSTRUCTION_ESTIMATOR_H_
 #define THEIA_SFM_INCREMENTAL_RECONSTRUCTION_ESTIMATOR_H_
 
+#include <memory>
 #include <vector>
 #include <unordered_map>
 
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/incremental_bundle_adjuster.h"
 #include "theia/sfm/estimate_track.h"
 #include "theia/sfm/localize_view_to_reconstruction.h"
 #include "theia/sfm/reconstruction_estimator.h"
@@ -145,6 +147,9 @@ class IncrementalReconstructionEstimator : public ReconstructionEstimator {
 
   ReconstructionEstimatorOptions options_;
   BundleAdjustmentOptions bundle_adjustment_options_;
+  // Full and partial BA reuse the same problem so that only the residuals of
+  // the views and tracks that changed are added or removed between calls.
+  std::unique_ptr<IncrementalBundleAdjuster> bundle_adjuster_;
   RansacParameters ransac_params_;
   TrackEstimator::Options triangulation_options_;
   LocalizeViewToReconstructionOptions localization_options_;
@@ -34,11 +34,18 @@
 
 #include "theia/sfm/localize_view_to_reconstruction.h"
 
+#include <ceres/ceres.h>
 #include <glog/logging.h>
+#include <Eigen/Core>
+#include <algorithm>
+#include <memory>
 #include <vector>
 
+#include "theia/alignment/alignment.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/create_loss_function.h"
 #include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera/create_reprojection_error_cost_function.h"
 #include "theia/sfm/estimators/estimate_absolute_pose_with_known_orientation.h"
 #include "theia/sfm/estimators/estimate_calibrated_absolute_pose.h"
 #include "theia/sfm/estimators/estimate_uncalibrated_absolute_pose.h"
@@ -47,6 +54,7 @@
 #include "theia/sfm/reconstruction_estimator_utils.h"
 #include "theia/sfm/types.h"
 #include "theia/solvers/sample_consensus_estimator.h"
+#include "theia/util/threadpool.h"
 
 namespace theia {
 namespace {
@@ -74,12 +82,15 @@ bool DoesViewHaveKnownIntrinsics(const Reconstruction& reconstruction,
   return false;
 }
 
-void GetNormalized2D3DMatches(const Reconstruction& reconstruction,
-                              const View& view,
-                              std::vector<FeatureCorrespondence2D3D>* matches) {
-  const Camera& camera = view.Camera();
+// Gathers the features of the view that observe estimated tracks along with
+// the 3D points of those tracks.
+void GetEstimated2D3DObservations(const Reconstruction& reconstruction,
+                                  const View& view,
+                                  std::vector<Feature>* features,
+                                  std::vector<Eigen::Vector4d>* points) {
   const auto& tracks_in_view = view.TrackIds();
-  matches->reserve(tracks_in_view.size());
+  features->reserve(tracks_in_view.size());
+  points->reserve(tracks_in_view.size());
   for (const TrackId track_id : tracks_in_view) {
     const Track* track = reconstruction.Track(track_id);
     // We only use 3D points that have been estimated.
@@ -87,61 +98,65 @@ void GetNormalized2D3DMatches(const Reconstruction& reconstruction,
       continue;
     }
 
+    features->emplace_back(*view.GetFeature(track_id));
+    points->emplace_back(track->Point());
+  }
+}
+
+void GetNormalized2D3DMatches(const Camera& camera,
+                              const std::vector<Feature>& features,
+                              const std::vector<Eigen::Vector4d>& points,
+                              std::vector<FeatureCorrespondence2D3D>* matches) {
+  matches->reserve(features.size());
+  for (int i = 0; i < features.size(); i++) {
     FeatureCorrespondence2D3D correspondence;
-    const Feature& feature = *view.GetFeature(track_id);
     // Simply shift the pixel to remove the effect of the principal point.
     correspondence.feature =
-        feature -
+        features[i] -
         Eigen::Vector2d(camera.PrincipalPointX(), camera.PrincipalPointY());
-    correspondence.world_point = track->Point().hnormalized();
+    correspondence.world_point = points[i].hnormalized();
     matches->emplace_back(correspondence);
   }
 }
 
 void GetIntrinsicsNormalized2D3DMatches(
-    const Reconstruction& reconstruction,
-    const View& view,
+    const Camera& camera,
+    const std::vector<Feature>& features,
+    const std::vector<Eigen::Vector4d>& points,
     std::vector<FeatureCorrespondence2D3D>* matches) {
-  const Camera& camera = view.Camera();
-  const auto& tracks_in_view = view.TrackIds();
-  matches->reserve(tracks_in_view.size());
-  for (const TrackId track_id : tracks_in_view) {
-    const Track* track = reconstruction.Track(track_id);
-    // We only use 3D points that have been estimated.
-    if (!track->IsEstimated()) {
-      continue;
-    }
-
+  matches->reserve(features.size());
+  for (int i = 0; i < features.size(); i++) {
     FeatureCorrespondence2D3D correspondence;
-    const Feature& feature = *view.GetFeature(track_id);
     // Remove the camera intrinsics from the feature.
     correspondence.feature =
-        camera.PixelToNormalizedCoordinates(feature).hnormalized();
-    correspondence.world_point = track->Point().hnormalized();
+        camera.PixelToNormalizedCoordinates(features[i]).hnormalized();
+    correspondence.world_point = points[i].hnormalized();
     matches->emplace_back(correspondence);
   }
 }
 
+// Estimates the pose (and the focal length, if the intrinsics are not known) of
+// the camera from the 2D-3D observations of the view.
 bool EstimateCameraPose(const bool known_intrinsics,
                         const LocalizeViewToReconstructionOptions& options,
-                        const Reconstruction& reconstruction,
-                        View* view,
+                        const View& view,
+                        const std::vector<Feature>& features,
+                        const std::vector<Eigen::Vector4d>& points,
+                        Camera* camera,
                         RansacSummary* summary) {
-  Camera* camera = view->MutableCamera();
+  // Exit early if there are not enough putative matches.
+  if (features.size() < options.min_num_inliers) {
+    VLOG(2) << "Not enough 2D-3D correspondences to localize view "
+            << view.Name();
+    return false;
+  }
 
-  // Gather all 2D-3D correspondences.
+  // Normalize all 2D-3D correspondences.
   std::vector<FeatureCorrespondence2D3D> matches;
   if (known_intrinsics) {
-    GetIntrinsicsNormalized2D3DMatches(reconstruction, *view, &matches);
+    GetIntrinsicsNormalized2D3DMatches(*camera, features, points, &matches);
   } else {
-    GetNormalized2D3DMatches(reconstruction, *view, &matches);
-  }
-
-  // Exit early if there are not enough putative matches.
-  if (matches.size() < options.min_num_inliers) {
-    VLOG(2) << "Not enough 2D-3D correspondences to localize view "
-            << view->Name();
-    return false;
+    GetNormalized2D3DMatches(*camera, features, points, &matches);
   }
 
   // Set up the ransac parameters for absolute pose estimation.
@@ -216,6 +231,123 @@ bool EstimateCameraPose(const bool known_intrinsics,
   return false;
 }
 
+// Bundle adjusts the camera to the 2D-3D observations while the 3D points are
+// held constant. This is equivalent to BundleAdjustView but only modifies the
+// given camera, so it may be run on a copy of the view's camera.
+bool BundleAdjustCamera(const BundleAdjustmentOptions& options,
+                        const std::vector<Feature>& features,
+                        std::vector<Eigen::Vector4d>* points,
+                        Camera* camera) {
+  const std::unique_ptr<ceres::LossFunction> loss_function =
+      CreateLossFunction(options.loss_function_type, options.robust_loss_width);
+  ceres::Problem::Options problem_options;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem(problem_options);
+
+  double* extrinsics = camera->mutable_extrinsics();
+  double* intrinsics = camera->mutable_intrinsics();
+  for (int i = 0; i < features.size(); i++) {
+    problem.AddResidualBlock(
+        CreateReprojectionErrorCostFunction(
+            camera->GetCameraIntrinsicsModelType(), features[i]),
+        loss_function.get(),
+        extrinsics,
+        intrinsics,
+        (*points)[i].data());
+    problem.SetParameterBlockConstant((*points)[i].data());
+  }
+
+  if (options.constant_camera_orientation &&
+      options.constant_camera_position) {
+    problem.SetParameterBlockConstant(extrinsics);
+  } else if (options.constant_camera_orientation) {
+    const std::vector<int> constant_orientation = {Camera::ORIENTATION + 0,
+                                                   Camera::ORIENTATION + 1,
+                                                   Camera::ORIENTATION + 2};
+    problem.SetParameterization(
+        extrinsics,
+        new ceres::SubsetParameterization(Camera::kExtrinsicsSize,
+                                          constant_orientation));
+  } else if (options.constant_camera_position) {
+    const std::vector<int> constant_position = {
+        Camera::POSITION + 0, Camera::POSITION + 1, Camera::POSITION + 2};
+    problem.SetParameterization(
+        extrinsics,
+        new ceres::SubsetParameterization(Camera::kExtrinsicsSize,
+                                          constant_position));
+  }
+
+  const int num_intrinsics = camera->CameraIntrinsics()->NumParameters();
+  const std::vector<int> constant_intrinsics =
+      camera->CameraIntrinsics()->GetSubsetFromOptimizeIntrinsicsType(
+          options.intrinsics_to_optimize);
+  if (constant_intrinsics.size() == num_intrinsics) {
+    problem.SetParameterBlockConstant(intrinsics);
+  } else if (constant_intrinsics.size() > 0) {
+    problem.SetParameterization(
+        intrinsics,
+        new ceres::SubsetParameterization(num_intrinsics, constant_intrinsics));
+  }
+
+  // Candidates are already localized concurrently, so the solver is run with a
+  // single thread.
+  ceres::Solver::Options solver_options;
+  solver_options.linear_solver_type = ceres::DENSE_QR;
+  solver_options.logging_type = ceres::SILENT;
+  solver_options.num_threads = 1;
+  solver_options.max_num_iterations = options.max_num_iterations;
+  solver_options.max_solver_time_in_seconds =
+      options.max_solver_time_in_seconds;
+  solver_options.function_tolerance = options.function_tolerance;
+  solver_options.gradient_tolerance = options.gradient_tolerance;
+  solver_options.parameter_tolerance = options.parameter_tolerance;
+  solver_options.max_trust_region_radius = options.max_trust_region_radius;
+
+  ceres::Solver::Summary solver_summary;
+  ceres::Solve(solver_options, &problem, &solver_summary);
+  return solver_summary.IsSolutionUsable();
+}
+
+// Localizes a candidate view on a copy of its camera without modifying the
+// reconstruction.
+void LocalizeCandidateView(const ViewId view_id,
+                           const LocalizeViewToReconstructionOptions& options,
+                           const Reconstruction& reconstruction,
+                           LocalizedView* localized_view) {
+  const View* view = CHECK_NOTNULL(reconstruction.View(view_id));
+  localized_view->view_id = view_id;
+  localized_view->camera.DeepCopy(view->Camera());
+  RansacSummary* summary = &localized_view->ransac_summary;
+
+  // We assume that the intrinsics are known if the orientation is known.
+  const bool known_intrinsics =
+      options.assume_known_orientation ||
+      DoesViewHaveKnownIntrinsics(reconstruction, view_id);
+
+  std::vector<Feature> features;
+  std::vector<Eigen::Vector4d> points;
+  GetEstimated2D3DObservations(reconstruction, *view, &features, &points);
+  if (!EstimateCameraPose(known_intrinsics,
+                          options,
+                          *view,
+                          features,
+                          points,
+                          &localized_view->camera,
+                          summary) ||
+      summary->inliers.size() < options.min_num_inliers) {
+    VLOG(2) << "Failed to localize view id " << view_id << " with only "
+            << summary->inliers.size() << " out of "
+            << summary->num_input_data_points << " features as inliers.";
+    return;
+  }
+
+  localized_view->success = true;
+  if (options.bundle_adjust_view) {
+    localized_view->success = BundleAdjustCamera(
+        options.ba_options, features, &points, &localized_view->camera);
+  }
+}
+
 }  // namespace
 
 bool LocalizeViewToReconstruction(
@@ -232,10 +364,20 @@ bool LocalizeViewToReconstruction(
       options.assume_known_orientation ||
       DoesViewHaveKnownIntrinsics(*reconstruction, view_to_localize);
 
+  // Gather all 2D-3D correspondences.
+  std::vector<Feature> features;
+  std::vector<Eigen::Vector4d> points;
+  GetEstimated2D3DObservations(*reconstruction, *view, &features, &points);
+
   // If localization failed or did not produce a sufficient number of inliers
   // then return false.
-  bool success = EstimateCameraPose(
-      known_intrinsics, options, *reconstruction, view, summary);
+  bool success = EstimateCameraPose(known_intrinsics,
+                                    options,
+                                    *view,
+                                    features,
+                                    points,
+                                    view->MutableCamera(),
+                                    summary);
   if (!success || summary->inliers.size() < options.min_num_inliers) {
     VLOG(2) << "Failed to localize view id " << view_to_localize
             << " with only " << summary->inliers.size() << " out of "
@@ -257,4 +399,65 @@ bool LocalizeViewToReconstruction(
   return success;
 }
 
+void LocalizeViewsToReconstruction(
+    const std::vector<ViewId>& views_to_localize,
+    const LocalizeViewToReconstructionOptions& options,
+    const Reconstruction& reconstruction,
+    std::vector<LocalizedView>* localized_views) {
+  CHECK_NOTNULL(localized_views)->clear();
+  localized_views->resize(views_to_localize.size());
+
+  // Each candidate only reads the reconstruction and writes to its own result,
+  // so the candidates may be localized concurrently.
+  const int num_threads =
+      std::min(options.num_threads, static_cast<int>(views_to_localize.size()));
+  std::unique_ptr<ThreadPool> pool;
+  if (num_threads > 1) {
+    pool.reset(new ThreadPool(num_threads));
+  }
+  ParallelFor(pool.get(),
+              0,
+              views_to_localize.size(),
+              1,
+              [&](const int start, const int end) {
+                for (int i = start; i < end; i++) {
+                  LocalizeCandidateView(views_to_localize[i],
+                                        options,
+                                        reconstruction,
+                                        &(*localized_views)[i]);
+                }
+              });
+
+  std::stable_sort(localized_views->begin(),
+                   localized_views->end(),
+                   [](const LocalizedView& lhs, const LocalizedView& rhs) {
+                     if (lhs.success != rhs.success) {
+                       return lhs.success;
+                     }
+                     return lhs.success &&
+                            lhs.ransac_summary.inliers.size() >
+                                rhs.ransac_summary.inliers.size();
+                   });
+}
+
+void AddLocalizedViewToReconstruction(const LocalizedView& localized_view,
+                                      Reconstruction* reconstruction) {
+  CHECK(localized_view.success);
+  CHECK_NOTNULL(reconstruction);
+  View* view =
+      CHECK_NOTNULL(reconstruction->MutableView(localized_view.view_id));
+  Camera* camera = view->MutableCamera();
+  CHECK(camera->GetCameraIntrinsicsModelType() ==
+        localized_view.camera.GetCameraIntrinsicsModelType());
+
+  std::copy(localized_view.camera.extrinsics(),
+            localized_view.camera.extrinsics() + Camera::kExtrinsicsSize,
+            camera->mutable_extrinsics());
+  std::copy(localized_view.camera.intrinsics(),
+            localized_view.camera.intrinsics() +
+                camera->CameraIntrinsics()->NumParameters(),
+            camera->mutable_intrinsics());
+  view->SetEstimated(true);
+}
+
 }  // namespace theia
@@ -35,7 +35,10 @@
 #ifndef THEIA_SFM_LOCALIZE_VIEW_TO_RECONSTRUCTION_H_
 #define THEIA_SFM_LOCALIZE_VIEW_TO_RECONSTRUCTION_H_
 
+#include <vector>
+
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/camera/camera.h"
 #include "theia/sfm/types.h"
 #include "theia/solvers/sample_consensus_estimator.h"
 
@@ -72,6 +75,23 @@ struct LocalizeViewToReconstructionOptions {
   // The minimum number of inliers found from RANSAC in order to be considered
   // successful localization.
   int min_num_inliers = 30;
+
+  // The number of candidate views that LocalizeViewsToReconstruction localizes
+  // concurrently.
+  int num_threads = 1;
+};
+
+// The result of localizing a single candidate view with
+// LocalizeViewsToReconstruction.
+struct LocalizedView {
+  ViewId view_id = kInvalidViewId;
+  bool success = false;
+
+  // The camera of the view with the estimated pose (and focal length, if the
+  // intrinsics were unknown). The intrinsics are a deep copy and are not shared
+  // with the cameras in the reconstruction.
+  Camera camera;
+  RansacSummary ransac_summary;
 };
 
 // Localizes a view to the reconstruction using 2D-3D correspondences to
@@ -84,6 +104,27 @@ bool LocalizeViewToReconstruction(
     Reconstruction* reconstruction,
     RansacSummary* summary);
 
+// Localizes each of the candidate views to the reconstruction, which is only
+// read, so that the candidates may be localized concurrently with
+// options.num_threads threads. The 2D-3D correspondences of each candidate are
+// gathered once and used for both RANSAC and bundle adjustment of the view,
+// where the 3D points are held constant. The estimated cameras are returned
+// instead of being set in the reconstruction so that the caller may choose
+// which views to add with AddLocalizedViewToReconstruction. Views that were
+// successfully localized are ranked first by decreasing number of RANSAC
+// inliers, followed by the failed views; ties keep the input order.
+void LocalizeViewsToReconstruction(
+    const std::vector<ViewId>& views_to_localize,
+    const LocalizeViewToReconstructionOptions& options,
+    const Reconstruction& reconstruction,
+    std::vector<LocalizedView>* localized_views);
+
+// Sets the pose and intrinsics of the view's camera to those of a successfully
+// localized view and marks the view as estimated. The intrinsics are written
+// into the (possibly shared) intrinsics of the view's camera.
+void AddLocalizedViewToReconstruction(const LocalizedView& localized_view,
+                                      Reconstruction* reconstruction);
+
 }  // namespace theia
 
 #endif  // THEIA_SFM_LOCALIZE_VIEW_TO_RECONSTRUCTION_H_
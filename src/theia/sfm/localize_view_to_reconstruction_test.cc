@@ -0,0 +1,212 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/localize_view_to_reconstruction.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/types.h"
+#include "theia/util/random.h"
+#include "theia/util/stringprintf.h"
+
+namespace theia {
+
+namespace {
+
+static const int kNumTracks = 200;
+static const double kFocalLength = 800.0;
+
+// The number of estimated tracks observed by each of the views to localize.
+static const int kNumViewsToLocalize = 4;
+static const int kNumObservationsPerView[kNumViewsToLocalize] = {
+    10, 100, kNumTracks, 150};
+
+void SetCameraIntrinsics(Camera* camera) {
+  camera->SetFocalLength(kFocalLength);
+  camera->SetPrincipalPoint(400.0, 300.0);
+  camera->SetImageSize(800, 600);
+}
+
+// Creates a reconstruction with one estimated view that observes all of the
+// estimated tracks, and unestimated views that observe a varying number of the
+// tracks. The unestimated views have a focal length prior, and the true camera
+// of each unestimated view is returned.
+void CreateReconstruction(std::vector<ViewId>* views_to_localize,
+                          std::vector<Camera>* expected_cameras,
+                          Reconstruction* reconstruction) {
+  static const double kPixelNoise = 0.5;
+  RandomNumberGenerator rng(47);
+
+  std::vector<Camera> cameras;
+  std::vector<ViewId> view_ids;
+  const int num_views = 1 + kNumViewsToLocalize;
+  for (int i = 0; i < num_views; i++) {
+    const ViewId view_id = reconstruction->AddView(StringPrintf("%d", i));
+    View* view = reconstruction->MutableView(view_id);
+    view->MutableCameraIntrinsicsPrior()->focal_length.is_set = true;
+    view->MutableCameraIntrinsicsPrior()->focal_length.value[0] = kFocalLength;
+    SetCameraIntrinsics(view->MutableCamera());
+
+    Camera camera;
+    SetCameraIntrinsics(&camera);
+    camera.SetPosition(Eigen::Vector3d(i - 2.0, 0.3 * i, 0.0));
+    camera.SetOrientationFromAngleAxis(0.05 * rng.RandVector3d());
+    cameras.emplace_back(camera);
+    view_ids.emplace_back(view_id);
+  }
+
+  // The first view is estimated.
+  View* estimated_view = reconstruction->MutableView(view_ids[0]);
+  estimated_view->SetEstimated(true);
+  *estimated_view->MutableCamera() = cameras[0];
+
+  for (int i = 0; i < kNumTracks; i++) {
+    const Eigen::Vector4d point(rng.RandDouble(-2.0, 2.0),
+                                rng.RandDouble(-2.0, 2.0),
+                                rng.RandDouble(8.0, 12.0),
+                                1.0);
+    std::vector<std::pair<ViewId, Feature> > observations;
+    for (int j = 0; j < num_views; j++) {
+      if (j > 0 && i >= kNumObservationsPerView[j - 1]) {
+        continue;
+      }
+      Feature feature;
+      cameras[j].ProjectPoint(point, &feature);
+      feature += kPixelNoise * Feature(rng.RandGaussian(0.0, 1.0),
+                                       rng.RandGaussian(0.0, 1.0));
+      observations.emplace_back(view_ids[j], feature);
+    }
+
+    const TrackId track_id = reconstruction->AddTrack(observations);
+    Track* track = reconstruction->MutableTrack(track_id);
+    track->SetEstimated(true);
+    *track->MutablePoint() = point;
+  }
+
+  views_to_localize->assign(view_ids.begin() + 1, view_ids.end());
+  expected_cameras->assign(cameras.begin() + 1, cameras.end());
+}
+
+}  // namespace
+
+TEST(LocalizeViewsToReconstruction, RanksViewsByNumberOfInliers) {
+  static const double kPositionTolerance = 0.05;
+
+  Reconstruction reconstruction;
+  std::vector<ViewId> views_to_localize;
+  std::vector<Camera> expected_cameras;
+  CreateReconstruction(
+      &views_to_localize, &expected_cameras, &reconstruction);
+
+  LocalizeViewToReconstructionOptions options;
+  options.num_threads = 2;
+  std::vector<LocalizedView> localized_views;
+  LocalizeViewsToReconstruction(
+      views_to_localize, options, reconstruction, &localized_views);
+
+  // The views are ranked by the number of observed tracks, and the view with
+  // too few observations fails.
+  ASSERT_EQ(localized_views.size(), views_to_localize.size());
+  EXPECT_EQ(localized_views[0].view_id, views_to_localize[2]);
+  EXPECT_EQ(localized_views[1].view_id, views_to_localize[3]);
+  EXPECT_EQ(localized_views[2].view_id, views_to_localize[1]);
+  EXPECT_EQ(localized_views[3].view_id, views_to_localize[0]);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(localized_views[i].success);
+  }
+  EXPECT_FALSE(localized_views[3].success);
+
+  for (const LocalizedView& localized_view : localized_views) {
+    // The reconstruction is not modified.
+    EXPECT_FALSE(reconstruction.View(localized_view.view_id)->IsEstimated());
+    if (!localized_view.success) {
+      continue;
+    }
+
+    const int index = localized_view.view_id - views_to_localize[0];
+    EXPECT_LT((localized_view.camera.GetPosition() -
+               expected_cameras[index].GetPosition()).norm(),
+              kPositionTolerance);
+  }
+}
+
+TEST(LocalizeViewsToReconstruction, MatchesLocalizeViewToReconstruction) {
+  static const double kPositionTolerance = 1e-3;
+
+  Reconstruction reconstruction;
+  std::vector<ViewId> views_to_localize;
+  std::vector<Camera> expected_cameras;
+  CreateReconstruction(
+      &views_to_localize, &expected_cameras, &reconstruction);
+  Reconstruction expected_reconstruction;
+  CreateReconstruction(
+      &views_to_localize, &expected_cameras, &expected_reconstruction);
+
+  LocalizeViewToReconstructionOptions options;
+  options.num_threads = 2;
+  std::vector<LocalizedView> localized_views;
+  LocalizeViewsToReconstruction(
+      views_to_localize, options, reconstruction, &localized_views);
+
+  for (const LocalizedView& localized_view : localized_views) {
+    RansacSummary ransac_summary;
+    const bool success =
+        LocalizeViewToReconstruction(localized_view.view_id,
+                                     options,
+                                     &expected_reconstruction,
+                                     &ransac_summary);
+    ASSERT_EQ(localized_view.success, success);
+    if (!success) {
+      continue;
+    }
+
+    AddLocalizedViewToReconstruction(localized_view, &reconstruction);
+    const View* view = reconstruction.View(localized_view.view_id);
+    const View* expected_view =
+        expected_reconstruction.View(localized_view.view_id);
+    EXPECT_TRUE(view->IsEstimated());
+    EXPECT_LT((view->Camera().GetPosition() -
+               expected_view->Camera().GetPosition()).norm(),
+              kPositionTolerance);
+    EXPECT_NEAR(view->Camera().FocalLength(),
+                expected_view->Camera().FocalLength(),
+                kPositionTolerance * kFocalLength);
+  }
+}
+
+}  // namespace theia
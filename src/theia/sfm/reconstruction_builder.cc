@@ -35,10 +35,13 @@
 #include "theia/sfm/reconstruction_builder.h"
 
 #include <glog/logging.h>
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "theia/matching/feature_correspondence.h"
 #include "theia/matching/features_and_matches_database.h"
 #include "theia/matching/image_pair_match.h"
 #include "theia/matching/rocksdb_features_and_matches_database.h"
@@ -51,6 +54,7 @@
 #include "theia/sfm/view.h"
 #include "theia/sfm/view_graph/view_graph.h"
 #include "theia/util/filesystem.h"
+#include "theia/util/threadpool.h"
 
 namespace theia {
 
@@ -154,7 +158,8 @@ ReconstructionBuilder::ReconstructionBuilder(
     std::unique_ptr<ViewGraph> view_graph)
     : options_(options),
       reconstruction_(std::move(reconstruction)),
-      view_graph_(std::move(view_graph)) {
+      view_graph_(std::move(view_graph)),
+      features_and_matches_database_(nullptr) {
   CHECK_GT(options.num_threads, 0);
   options_.reconstruction_estimator_options.rng = options.rng;
 }
@@ -197,6 +202,7 @@ ReconstructionBuilder::ReconstructionBuilder(
       options_.num_gmm_clusters_for_fisher_vector;
   feam_options.max_num_features_for_fisher_vector_training =
       options_.max_num_features_for_fisher_vector_training;
+  feam_options.rng = options_.rng;
 
   feature_extractor_and_matcher_.reset(new FeatureExtractorAndMatcher(
       feam_options, features_and_matches_database_));
@@ -304,14 +310,18 @@ bool ReconstructionBuilder::ExtractAndMatchFeatures() {
   // Add the matches to the view graph and reconstruction.
   const auto& match_keys =
       features_and_matches_database_->ImageNamesOfMatches();
-  for (const auto& match_key : match_keys) {
-    const ImagePairMatch& match =
-        features_and_matches_database_->GetImagePairMatch(match_key.first,
-                                                          match_key.second);
-    AddTwoViewMatch(match_key.first, match_key.second, match);
-  }
+  return AddTwoViewMatches(match_keys);
+}
 
-  return true;
+bool ReconstructionBuilder::SkipMatchForUncalibratedViews(
+    const ViewId view_id1, const ViewId view_id2) const {
+  if (!options_.only_calibrated_views) {
+    return false;
+  }
+  const View* view1 = reconstruction_->View(view_id1);
+  const View* view2 = reconstruction_->View(view_id2);
+  return !view1->CameraIntrinsicsPrior().focal_length.is_set ||
+         !view2->CameraIntrinsicsPrior().focal_length.is_set;
 }
 
 bool ReconstructionBuilder::AddTwoViewMatch(const std::string& image1,
@@ -330,11 +340,7 @@ bool ReconstructionBuilder::AddTwoViewMatch(const std::string& image1,
 
   // If we only want calibrated views, do not add the match if it contains an
   // uncalibrated view since it will add uncalibrated views to the tracks.
-  const View* view1 = reconstruction_->View(view_id1);
-  const View* view2 = reconstruction_->View(view_id2);
-  if (options_.only_calibrated_views &&
-      (!view1->CameraIntrinsicsPrior().focal_length.is_set ||
-       !view2->CameraIntrinsicsPrior().focal_length.is_set)) {
+  if (SkipMatchForUncalibratedViews(view_id1, view_id2)) {
     return true;
   }
 
@@ -347,6 +353,117 @@ bool ReconstructionBuilder::AddTwoViewMatch(const std::string& image1,
   return true;
 }
 
+bool ReconstructionBuilder::AddTwoViewMatches(
+    const std::vector<std::pair<std::string, std::string> >& image_pairs) {
+  CHECK_NOTNULL(features_and_matches_database_);
+
+  // A match that has been fetched and decoded from the database. The
+  // correspondences are moved out of the decoded ImagePairMatch to avoid
+  // copying them.
+  struct DecodedMatch {
+    ViewId view_id1;
+    ViewId view_id2;
+    TwoViewInfo twoview_info;
+    std::vector<FeatureCorrespondence> correspondences;
+  };
+
+  // Split the pairs into a few contiguous blocks per thread so that the load
+  // stays balanced. Each block decodes into its own buffer so that no locking
+  // is needed, and merging the blocks in order preserves the order in which
+  // the pairs were given.
+  static const int kNumBlocksPerThread = 4;
+  const int num_pairs = image_pairs.size();
+  const int num_blocks = std::max(
+      1, std::min(num_pairs, kNumBlocksPerThread * options_.num_threads));
+  const int block_size = (num_pairs + num_blocks - 1) / num_blocks;
+  std::vector<std::vector<DecodedMatch> > decoded_matches(num_blocks);
+
+  const auto decode_block = [&](const int block) {
+    const int start = block * block_size;
+    const int end = std::min(start + block_size, num_pairs);
+    std::vector<DecodedMatch>& block_matches = decoded_matches[block];
+    block_matches.reserve(std::max(0, end - start));
+    for (int i = start; i < end; i++) {
+      const std::string& image1 = image_pairs[i].first;
+      const std::string& image2 = image_pairs[i].second;
+      const ViewId view_id1 = reconstruction_->ViewIdFromName(image1);
+      const ViewId view_id2 = reconstruction_->ViewIdFromName(image2);
+      CHECK_NE(view_id1, kInvalidViewId)
+          << "Tried to add a view with the name " << image1
+          << " to the view graph but does not exist in the reconstruction.";
+      CHECK_NE(view_id2, kInvalidViewId)
+          << "Tried to add a view with the name " << image2
+          << " to the view graph but does not exist in the reconstruction.";
+      if (SkipMatchForUncalibratedViews(view_id1, view_id2)) {
+        continue;
+      }
+
+      ImagePairMatch match =
+          features_and_matches_database_->GetImagePairMatch(image1, image2);
+      block_matches.emplace_back();
+      DecodedMatch& decoded_match = block_matches.back();
+      decoded_match.view_id1 = view_id1;
+      decoded_match.view_id2 = view_id2;
+      decoded_match.twoview_info = match.twoview_info;
+      if (view_id1 > view_id2) {
+        SwapCameras(&decoded_match.twoview_info);
+      }
+      decoded_match.correspondences = std::move(match.correspondences);
+    }
+  };
+
+  if (options_.num_threads == 1 || num_blocks == 1) {
+    for (int i = 0; i < num_blocks; i++) {
+      decode_block(i);
+    }
+  } else {
+    ThreadPool pool(std::min(options_.num_threads, num_blocks));
+    for (int i = 0; i < num_blocks; i++) {
+      pool.Add(decode_block, i);
+    }
+    // The thread pool destructor waits for all blocks to be decoded.
+  }
+
+  // Merge the buffers into the view graph and the track builder.
+  size_t num_correspondences = 0;
+  for (const auto& block_matches : decoded_matches) {
+    for (const DecodedMatch& decoded_match : block_matches) {
+      num_correspondences += decoded_match.correspondences.size();
+    }
+  }
+  track_builder_->Reserve(num_correspondences);
+
+  for (auto& block_matches : decoded_matches) {
+    for (const DecodedMatch& decoded_match : block_matches) {
+      view_graph_->AddEdge(decoded_match.view_id1,
+                           decoded_match.view_id2,
+                           decoded_match.twoview_info);
+      for (const auto& correspondence : decoded_match.correspondences) {
+        track_builder_->AddFeatureCorrespondence(decoded_match.view_id1,
+                                                 correspondence.feature1,
+                                                 decoded_match.view_id2,
+                                                 correspondence.feature2);
+      }
+    }
+    // Release each buffer as soon as it has been merged.
+    std::vector<DecodedMatch>().swap(block_matches);
+  }
+
+  return true;
+}
+
+void ReconstructionBuilder::BuildTracks() {
+  track_builder_->BuildTracks(reconstruction_.get());
+}
+
+const Reconstruction& ReconstructionBuilder::GetReconstruction() const {
+  return *reconstruction_;
+}
+
+const ViewGraph& ReconstructionBuilder::GetViewGraph() const {
+  return *view_graph_;
+}
+
 bool ReconstructionBuilder::BuildReconstruction(
     std::vector<Reconstruction*>* reconstructions) {
   CHECK_GE(view_graph_->NumViews(), 2) << "At least 2 images must be provided "
@@ -355,7 +472,7 @@ bool ReconstructionBuilder::BuildReconstruction(
 
   // Build tracks if they were not explicitly specified.
   if (reconstruction_->NumTracks() == 0) {
-    track_builder_->BuildTracks(reconstruction_.get());
+    BuildTracks();
   }
 
   // Remove uncalibrated views from the reconstruction and view graph.
@@ -37,6 +37,7 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "theia/image/descriptor/create_descriptor_extractor.h"
@@ -167,6 +168,15 @@ class ReconstructionBuilder {
                        const std::string& image2,
                        const ImagePairMatch& matches);
 
+  // Adds all of the given image pairs from the features and matches database
+  // to the view graph. The matches are fetched and decoded from the database in
+  // parallel into per-thread buffers, and the view graph edges and track
+  // correspondences are then merged in a single pass. The result is identical
+  // to calling AddTwoViewMatch for each pair in order, but is much faster when
+  // loading a large number of matches.
+  bool AddTwoViewMatches(
+      const std::vector<std::pair<std::string, std::string> >& image_pairs);
+
   // Assignes a mask to an image to indicate the area for keypoints extraction.
   bool AddMaskForFeaturesExtraction(const std::string& image_filepath,
                                     const std::string& mask_filepath);
@@ -174,6 +184,16 @@ class ReconstructionBuilder {
   // Extracts features and performs matching with geometric verification.
   bool ExtractAndMatchFeatures();
 
+  // Builds tracks in the reconstruction from the two view matches that have
+  // been added. BuildReconstruction calls this if the reconstruction does not
+  // have any tracks yet.
+  void BuildTracks();
+
+  // The reconstruction and view graph built from the added images and two view
+  // matches.
+  const Reconstruction& GetReconstruction() const;
+  const ViewGraph& GetViewGraph() const;
+
   // Estimates a Structure-from-Motion reconstruction using the specified
   // ReconstructionEstimator. Features are first extracted and matched if
   // necessary, then a reconstruction is estimated. Once a reconstruction has
@@ -195,6 +215,11 @@ class ReconstructionBuilder {
                          const ViewId view_id2,
                          const ImagePairMatch& image_matches);
 
+  // Returns true if the match between the two views should be skipped because
+  // only calibrated views were requested and one of the views is uncalibrated.
+  bool SkipMatchForUncalibratedViews(const ViewId view_id1,
+                                     const ViewId view_id2) const;
+
   // Removes all uncalibrated views from the reconstruction and view graph.
   void RemoveUncalibratedViews();
 
@@ -0,0 +1,185 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/matching/feature_correspondence.h"
+#include "theia/matching/image_pair_match.h"
+#include "theia/matching/in_memory_features_and_matches_database.h"
+#include "theia/sfm/camera_intrinsics_prior.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/reconstruction_builder.h"
+#include "theia/sfm/twoview_info.h"
+#include "theia/sfm/types.h"
+#include "theia/sfm/view_graph/view_graph.h"
+#include "theia/util/random.h"
+#include "theia/util/stringprintf.h"
+
+namespace theia {
+
+namespace {
+
+RandomNumberGenerator rng(59);
+
+// A track as the sorted list of its observations.
+typedef std::vector<std::pair<ViewId, std::pair<double, double> > >
+    TrackObservations;
+
+// Adds random matches between the images to the database. Feature k of each
+// image is at the same position in every match so that the matches form
+// tracks. Some image pairs are given in decreasing view id order so that the
+// two view info must be swapped.
+void AddRandomMatches(const std::vector<std::string>& image_names,
+                      InMemoryFeaturesAndMatchesDatabase* database,
+                      std::vector<std::pair<std::string, std::string> >*
+                          image_pairs) {
+  static const int kNumFeatures = 40;
+  static const double kMatchProbability = 0.6;
+  static const double kCorrespondenceProbability = 0.7;
+
+  for (int i = 0; i < image_names.size(); i++) {
+    for (int j = i + 1; j < image_names.size(); j++) {
+      if (rng.RandDouble(0.0, 1.0) > kMatchProbability) {
+        continue;
+      }
+
+      const bool swap_images = rng.RandDouble(0.0, 1.0) < 0.5;
+      const int image1 = swap_images ? j : i;
+      const int image2 = swap_images ? i : j;
+      ImagePairMatch match;
+      match.image1 = image_names[image1];
+      match.image2 = image_names[image2];
+      match.twoview_info.focal_length_1 = rng.RandDouble(500.0, 1500.0);
+      match.twoview_info.focal_length_2 = rng.RandDouble(500.0, 1500.0);
+      match.twoview_info.rotation_2 = rng.RandVector3d();
+      match.twoview_info.position_2 = rng.RandVector3d().normalized();
+      for (int k = 0; k < kNumFeatures; k++) {
+        if (rng.RandDouble(0.0, 1.0) > kCorrespondenceProbability) {
+          continue;
+        }
+        match.correspondences.emplace_back(Feature(k, image1),
+                                           Feature(k, image2));
+      }
+      match.twoview_info.num_verified_matches = match.correspondences.size();
+
+      database->PutImagePairMatch(match.image1, match.image2, match);
+      image_pairs->emplace_back(match.image1, match.image2);
+    }
+  }
+}
+
+std::set<TrackObservations> GetTracks(const Reconstruction& reconstruction) {
+  std::set<TrackObservations> tracks;
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    TrackObservations observations;
+    for (const ViewId view_id : reconstruction.Track(track_id)->ViewIds()) {
+      const Feature& feature =
+          *reconstruction.View(view_id)->GetFeature(track_id);
+      observations.emplace_back(
+          view_id, std::make_pair(feature.x(), feature.y()));
+    }
+    std::sort(observations.begin(), observations.end());
+    tracks.emplace(observations);
+  }
+  return tracks;
+}
+
+}  // namespace
+
+TEST(ReconstructionBuilder, AddTwoViewMatchesMatchesAddTwoViewMatch) {
+  static const int kNumImages = 12;
+  static const int kNumThreads = 4;
+
+  std::vector<std::string> image_names;
+  for (int i = 0; i < kNumImages; i++) {
+    image_names.emplace_back(StringPrintf("image_%d.jpg", i));
+  }
+  InMemoryFeaturesAndMatchesDatabase database;
+  std::vector<std::pair<std::string, std::string> > image_pairs;
+  AddRandomMatches(image_names, &database, &image_pairs);
+
+  ReconstructionBuilderOptions options;
+  options.num_threads = 1;
+  ReconstructionBuilder expected_builder(options, &database);
+  options.num_threads = kNumThreads;
+  ReconstructionBuilder builder(options, &database);
+  CameraIntrinsicsPrior prior;
+  for (const std::string& image_name : image_names) {
+    EXPECT_TRUE(
+        expected_builder.AddImageWithCameraIntrinsicsPrior(image_name, prior));
+    EXPECT_TRUE(builder.AddImageWithCameraIntrinsicsPrior(image_name, prior));
+  }
+
+  for (const auto& image_pair : image_pairs) {
+    EXPECT_TRUE(expected_builder.AddTwoViewMatch(
+        image_pair.first,
+        image_pair.second,
+        database.GetImagePairMatch(image_pair.first, image_pair.second)));
+  }
+  EXPECT_TRUE(builder.AddTwoViewMatches(image_pairs));
+
+  // The view graphs must be identical.
+  const ViewGraph& expected_view_graph = expected_builder.GetViewGraph();
+  const ViewGraph& view_graph = builder.GetViewGraph();
+  EXPECT_EQ(view_graph.NumEdges(), image_pairs.size());
+  EXPECT_EQ(view_graph.NumEdges(), expected_view_graph.NumEdges());
+  for (const auto& edge : expected_view_graph.GetAllEdges()) {
+    const TwoViewInfo* info =
+        view_graph.GetEdge(edge.first.first, edge.first.second);
+    ASSERT_NE(info, nullptr);
+    EXPECT_EQ(info->focal_length_1, edge.second.focal_length_1);
+    EXPECT_EQ(info->focal_length_2, edge.second.focal_length_2);
+    EXPECT_EQ(info->rotation_2, edge.second.rotation_2);
+    EXPECT_EQ(info->position_2, edge.second.position_2);
+    EXPECT_EQ(info->num_verified_matches, edge.second.num_verified_matches);
+  }
+
+  // The tracks must be identical.
+  expected_builder.BuildTracks();
+  builder.BuildTracks();
+  const std::set<TrackObservations> expected_tracks =
+      GetTracks(expected_builder.GetReconstruction());
+  EXPECT_GT(expected_tracks.size(), 0);
+  EXPECT_EQ(builder.GetReconstruction().NumTracks(),
+            expected_builder.GetReconstruction().NumTracks());
+  EXPECT_EQ(GetTracks(builder.GetReconstruction()), expected_tracks);
+}
+
+}  // namespace theia
@@ -245,6 +245,18 @@ struct ReconstructionEstimatorOptions {
   // constant loss when the error values are greater than this.
   double bundle_adjustment_robust_loss_width = 10.0;
 
+  // Bundle adjustment residuals of pinhole cameras may be evaluated in batches
+  // with vectorized analytic Jacobians instead of with autodiff. See
+  // //theia/sfm/bundle_adjustment/bundle_adjustment.h for details.
+  ReprojectionErrorEvaluationType
+      bundle_adjustment_reprojection_error_evaluation_type =
+          ReprojectionErrorEvaluationType::AUTODIFF;
+
+  // The nonlinear solver used for bundle adjustment. Theia's implicit Schur
+  // complement solver may be much faster than Ceres for very large problems.
+  BundleAdjustmentSolverType bundle_adjustment_solver_type =
+      BundleAdjustmentSolverType::CERES;
+
   // Use SPARSE_SCHUR for problems smaller than this size and ITERATIVE_SCHUR
   // for problems larger than this size.
   int min_cameras_for_iterative_solver = 1000;
@@ -40,8 +40,10 @@
 
 #include <algorithm>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "theia/alignment/alignment.h"
 #include "theia/matching/feature_correspondence.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
 #include "theia/sfm/bundle_adjustment/optimize_relative_position_with_known_rotation.h"
@@ -53,6 +55,7 @@
 #include "theia/sfm/triangulation/triangulation.h"
 #include "theia/sfm/twoview_info.h"
 #include "theia/sfm/view_graph/view_graph.h"
+#include "theia/sfm/view_graph/view_graph_snapshot.h"
 #include "theia/solvers/sample_consensus_estimator.h"
 #include "theia/util/map_util.h"
 #include "theia/util/threadpool.h"
@@ -60,33 +63,45 @@
 namespace theia {
 namespace {
 
+// The features of a view normalized by the camera intrinsics and sorted by
+// track id. Intersecting the observations of two views is then a linear merge
+// rather than a hash map lookup per track, and each feature is only normalized
+// once no matter how many view pairs it participates in.
+struct NormalizedViewObservations {
+  std::vector<TrackId> track_ids;
+  std::vector<Feature> features;
+};
+
+void GetNormalizedViewObservations(const View& view,
+                                   NormalizedViewObservations* observations) {
+  const Camera& camera = view.Camera();
+  observations->track_ids = view.TrackIds();
+  std::sort(observations->track_ids.begin(), observations->track_ids.end());
+  observations->features.resize(observations->track_ids.size());
+  for (int i = 0; i < observations->track_ids.size(); i++) {
+    const Feature* feature = view.GetFeature(observations->track_ids[i]);
+    observations->features[i] =
+        camera.PixelToNormalizedCoordinates(*feature).hnormalized();
+  }
+}
+
 // Accumulate all two view feature matches between the input views. The features
 // are normalized according to the camera intrinsics.
 void GetNormalizedFeatureCorrespondences(
-    const View& view1, const View& view2,
+    const NormalizedViewObservations& view1,
+    const NormalizedViewObservations& view2,
     std::vector<FeatureCorrespondence>* matches) {
-  const Camera& camera1 = view1.Camera();
-  const Camera& camera2 = view2.Camera();
-  const std::vector<TrackId>& tracks = view1.TrackIds();
-  for (const TrackId track_id : tracks) {
-    const Feature* feature2 = view2.GetFeature(track_id);
-    // If view 2 does not contain the current track then it cannot be a
-    // correspondence.
-    if (feature2 == nullptr) {
-      continue;
+  int i = 0, j = 0;
+  while (i < view1.track_ids.size() && j < view2.track_ids.size()) {
+    if (view1.track_ids[i] < view2.track_ids[j]) {
+      ++i;
+    } else if (view2.track_ids[j] < view1.track_ids[i]) {
+      ++j;
+    } else {
+      matches->emplace_back(view1.features[i], view2.features[j]);
+      ++i;
+      ++j;
     }
-
-    FeatureCorrespondence match;
-    const Feature* feature1 = view1.GetFeature(track_id);
-    match.feature1 = *feature1;
-    match.feature2 = *feature2;
-
-    // Normalize for camera intrinsics.
-    match.feature1 =
-        camera1.PixelToNormalizedCoordinates(match.feature1).hnormalized();
-    match.feature2 =
-        camera2.PixelToNormalizedCoordinates(match.feature2).hnormalized();
-    matches->emplace_back(match);
   }
 }
 
@@ -117,6 +132,9 @@ BundleAdjustmentOptions SetBundleAdjustmentOptions(
   ba_options.robust_loss_width = options.bundle_adjustment_robust_loss_width;
   ba_options.use_inner_iterations = true;
   ba_options.intrinsics_to_optimize = options.intrinsics_to_optimize;
+  ba_options.reprojection_error_evaluation_type =
+      options.bundle_adjustment_reprojection_error_evaluation_type;
+  ba_options.solver_type = options.bundle_adjustment_solver_type;
 
   if (num_views >= options.min_cameras_for_iterative_solver) {
     ba_options.linear_solver_type = ceres::ITERATIVE_SCHUR;
@@ -247,25 +265,56 @@ void RefineRelativeTranslationsWithKnownRotations(
     const int num_threads,
     ViewGraph* view_graph) {
   CHECK_GE(num_threads, 1);
-  const auto& view_pairs = view_graph->GetAllEdges();
+  static const int kMinViewsPerTask = 16;
+  static const int kMinViewPairsPerTask = 64;
+
+  // Take a snapshot of the view graph so that the views and view pairs can be
+  // processed in parallel chunks by index.
+  const ViewGraphSnapshot snapshot(*view_graph);
+  std::vector<TwoViewInfo*> infos(snapshot.NumEdges());
+  for (int i = 0; i < snapshot.NumEdges(); i++) {
+    infos[i] = view_graph->GetMutableEdge(
+        snapshot.GetViewId(snapshot.EdgeViewIndex1(i)),
+        snapshot.GetViewId(snapshot.EdgeViewIndex2(i)));
+  }
 
+  // Normalize and sort the observations of each view.
   ThreadPool pool(num_threads);
-  // Refine the translation estimation for each view pair.
-  for (const auto& view_pair : view_pairs) {
-    // Get all feature correspondences common to both views.
+  std::vector<NormalizedViewObservations> observations(snapshot.NumViews());
+  ParallelFor(&pool, 0, snapshot.NumViews(), kMinViewsPerTask,
+              [&](const int start, const int end) {
+    for (int i = start; i < end; i++) {
+      if (snapshot.Degree(i) > 0) {
+        GetNormalizedViewObservations(
+            *reconstruction.View(snapshot.GetViewId(i)), &observations[i]);
+      }
+    }
+  });
+
+  // Refine the translation estimation for each view pair. Each task reuses a
+  // single correspondence buffer and solver scratch for all of its view pairs.
+  ParallelFor(&pool, 0, infos.size(), kMinViewPairsPerTask,
+              [&](const int start, const int end) {
     std::vector<FeatureCorrespondence> matches;
-    const View* view1 = reconstruction.View(view_pair.first.first);
-    const View* view2 = reconstruction.View(view_pair.first.second);
-    GetNormalizedFeatureCorrespondences(*view1, *view2, &matches);
-
-    TwoViewInfo* info = view_graph->GetMutableEdge(view_pair.first.first,
-                                                   view_pair.first.second);
-    pool.Add(OptimizeRelativePositionWithKnownRotation,
-             matches,
-             FindOrDie(orientations, view_pair.first.first),
-             FindOrDie(orientations, view_pair.first.second),
-             &info->position_2);
-  }
+    RelativePositionOptimizationBuffer buffer;
+    for (int i = start; i < end; i++) {
+      // Get all feature correspondences common to both views.
+      const int view_index1 = snapshot.EdgeViewIndex1(i);
+      const int view_index2 = snapshot.EdgeViewIndex2(i);
+      matches.clear();
+      GetNormalizedFeatureCorrespondences(observations[view_index1],
+                                          observations[view_index2],
+                                          &matches);
+
+      OptimizeRelativePositionWithKnownRotation(
+          matches.data(),
+          matches.size(),
+          FindOrDie(orientations, snapshot.GetViewId(view_index1)),
+          FindOrDie(orientations, snapshot.GetViewId(view_index2)),
+          &buffer,
+          &infos[i]->position_2);
+    }
+  });
 }
 
 int SetUnderconstrainedTracksToUnestimated(Reconstruction* reconstruction) {
@@ -154,7 +154,7 @@ void SelectBestTracksFromEachImageGridCell(
     const int grid_cell_size,
     const std::unordered_map<TrackId, TrackStatistics>& track_statistics,
     std::unordered_set<TrackId>* tracks_to_optimize) {
-  static const double inv_grid_cell_size =  1.0 / grid_cell_size;
+  const double inv_grid_cell_size = 1.0 / grid_cell_size;
 
   // Hash each feature into a grid cell.
   ImageGrid image_grid;
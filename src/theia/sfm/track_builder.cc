@@ -76,6 +76,11 @@ void TrackBuilder::AddFeatureCorrespondence(const ViewId view_id1,
   connected_components_->AddEdge(feature1_id, feature2_id);
 }
 
+void TrackBuilder::Reserve(const size_t num_correspondences) {
+  // Each correspondence contributes at most two new features.
+  features_.reserve(features_.size() + 2 * num_correspondences);
+}
+
 void TrackBuilder::BuildTracks(Reconstruction* reconstruction) {
   CHECK_NOTNULL(reconstruction);
 
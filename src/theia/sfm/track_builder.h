@@ -65,6 +65,10 @@ class TrackBuilder {
   void AddFeatureCorrespondence(const ViewId view_id1, const Feature& feature1,
                                 const ViewId view_id2, const Feature& feature2);
 
+  // Reserves space for the given number of feature correspondences so that
+  // adding them in bulk does not repeatedly rehash the feature map.
+  void Reserve(const size_t num_correspondences);
+
   // Generates all tracks and adds them to the reconstruction.
   void BuildTracks(Reconstruction* reconstruction);
 
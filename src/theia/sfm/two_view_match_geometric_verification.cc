@@ -90,12 +90,14 @@ TwoViewMatchGeometricVerification::TwoViewMatchGeometricVerification(
     const CameraIntrinsicsPrior& intrinsics2,
     const KeypointsAndDescriptors& features1,
     const KeypointsAndDescriptors& features2,
-    const std::vector<IndexedFeatureMatch>& matches)
+    const std::vector<IndexedFeatureMatch>& matches,
+    const GuidedMatchingIndex* features2_guided_matching_index)
     : options_(options),
       intrinsics1_(intrinsics1),
       intrinsics2_(intrinsics2),
       features1_(features1),
       features2_(features2),
+      features2_guided_matching_index_(features2_guided_matching_index),
       matches_(matches) {}
 
 void TwoViewMatchGeometricVerification::CreateCorrespondencesFromIndexedMatches(
@@ -160,8 +162,12 @@ bool TwoViewMatchGeometricVerification::VerifyMatches(
         options_.guided_matching_max_distance_pixels;
     guided_matching_options.lowes_ratio = options_.guided_matching_lowes_ratio;
 
-    GuidedEpipolarMatcher guided_matcher(
-        guided_matching_options, camera1_, camera2_, features1_, features2_);
+    GuidedEpipolarMatcher guided_matcher(guided_matching_options,
+                                         camera1_,
+                                         camera2_,
+                                         features1_,
+                                         features2_,
+                                         features2_guided_matching_index_);
     if (!guided_matcher.GetMatches(&matches_)) {
       return false;
     }
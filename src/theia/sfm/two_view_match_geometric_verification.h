@@ -46,6 +46,7 @@
 #include "theia/util/util.h"
 
 namespace theia {
+class GuidedMatchingIndex;
 class TwoViewInfo;
 struct FeatureCorrespondence;
 
@@ -98,7 +99,8 @@ class TwoViewMatchGeometricVerification {
       const CameraIntrinsicsPrior& intrinsics2,
       const KeypointsAndDescriptors& features1,
       const KeypointsAndDescriptors& features2,
-      const std::vector<IndexedFeatureMatch>& matches);
+      const std::vector<IndexedFeatureMatch>& matches,
+      const GuidedMatchingIndex* features2_guided_matching_index = nullptr);
 
   // Perform 2-view geometric verification for the input. The verified matches
   // are returned along with the 2-view info. If the verification fails, false
@@ -128,6 +130,8 @@ class TwoViewMatchGeometricVerification {
   const Options options_;
   const CameraIntrinsicsPrior& intrinsics1_, intrinsics2_;
   const KeypointsAndDescriptors& features1_, features2_;
+  // An optional prebuilt index of features2 for guided matching.
+  const GuidedMatchingIndex* features2_guided_matching_index_;
 
   Camera camera1_, camera2_;
   // We keep a local copy of the matches so that we may add and remove matches
@@ -36,6 +36,7 @@
 
 #include <Eigen/Core>
 #include <ceres/rotation.h>
+#include <glog/logging.h>
 
 #include <algorithm>
 #include <unordered_map>
@@ -43,24 +44,17 @@
 #include <utility>
 #include <vector>
 
-#include "theia/math/graph/minimum_spanning_tree.h"
-#include "theia/sfm/twoview_info.h"
 #include "theia/sfm/types.h"
 #include "theia/sfm/view_graph/view_graph.h"
-#include "theia/util/map_util.h"
+#include "theia/sfm/view_graph/view_graph_snapshot.h"
 
 namespace theia {
 namespace {
-typedef std::pair<TwoViewInfo, ViewIdPair> HeapElement;
-
-bool SortHeapElement(const HeapElement& h1, const HeapElement& h2) {
-  return h1.first.num_verified_matches > h2.first.num_verified_matches;
-}
 
 // Computes the orientation of the neighbor camera based on the orientation of
 // the source camera and the relative rotation between the cameras.
 Eigen::Vector3d ComputeOrientation(const Eigen::Vector3d& source_orientation,
-                                   const TwoViewInfo& two_view_info,
+                                   const Eigen::Vector3d& relative_rotation_2,
                                    const ViewId source_view_id,
                                    const ViewId neighbor_view_id) {
   Eigen::Matrix3d source_rotation_mat, relative_rotation;
@@ -68,7 +62,7 @@ Eigen::Vector3d ComputeOrientation(const Eigen::Vector3d& source_orientation,
       source_orientation.data(),
       ceres::ColumnMajorAdapter3x3(source_rotation_mat.data()));
   ceres::AngleAxisToRotationMatrix(
-      two_view_info.rotation_2.data(),
+      relative_rotation_2.data(),
       ceres::ColumnMajorAdapter3x3(relative_rotation.data()));
 
   const Eigen::Matrix3d neighbor_orientation =
@@ -83,25 +77,15 @@ Eigen::Vector3d ComputeOrientation(const Eigen::Vector3d& source_orientation,
   return orientation;
 }
 
-// Adds all the edges of view_id to the heap. Only edges that do not already
-// have an orientation estimation are added.
-void AddEdgesToHeap(
-    const ViewGraph& view_graph,
-    const std::unordered_map<ViewId, Eigen::Vector3d>& orientations,
-    const ViewId view_id,
-    std::vector<HeapElement>* heap) {
-  const std::unordered_set<ViewId>* edge_ids =
-      view_graph.GetNeighborIdsForView(view_id);
-  for (const ViewId edge_id : *edge_ids) {
-    // Only add edges to the heap that contain a vertex that has not been seen.
-    if (ContainsKey(orientations, edge_id)) {
-      continue;
-    }
-
-    heap->emplace_back(*view_graph.GetEdge(view_id, edge_id),
-                       ViewIdPair(view_id, edge_id));
-    std::push_heap(heap->begin(), heap->end(), SortHeapElement);
+// Returns the root of the set containing the element, compressing the path
+// along the way.
+int FindRoot(const int element, std::vector<int>* parents) {
+  int root = element;
+  while ((*parents)[root] != root) {
+    (*parents)[root] = (*parents)[(*parents)[root]];
+    root = (*parents)[root];
   }
+  return root;
 }
 
 }  // namespace
@@ -109,72 +93,113 @@ void AddEdgesToHeap(
 bool OrientationsFromMaximumSpanningTree(
     const ViewGraph& view_graph,
     std::unordered_map<ViewId, Eigen::Vector3d>* orientations) {
-  CHECK_NOTNULL(orientations);
-
-  // Compute the largest connected component of the input view graph since the
-  // MST is only valid on a single connected component.
-  std::unordered_set<theia::ViewId> largest_cc;
-  view_graph.GetLargestConnectedComponentIds(&largest_cc);
-  ViewGraph largest_cc_subgraph;
-  view_graph.ExtractSubgraph(largest_cc, &largest_cc_subgraph);
-
-  // Compute maximum spanning tree.
-  const auto& all_edges = largest_cc_subgraph.GetAllEdges();
-  MinimumSpanningTree<ViewId, int> mst_extractor;
-  for (const auto& edge : all_edges) {
-    // Since we want the *maximum* spanning tree, we negate all of the edge
-    // weights in the *minimum* spanning tree extractor.
-    mst_extractor.AddEdge(
-        edge.first.first, edge.first.second, -edge.second.num_verified_matches);
-  }
+  const ViewGraphSnapshot snapshot(view_graph);
+  return OrientationsFromMaximumSpanningTree(snapshot, orientations);
+}
 
-  std::unordered_set<ViewIdPair> mst;
-  if (!mst_extractor.Extract(&mst)) {
+bool OrientationsFromMaximumSpanningTree(
+    const ViewGraphSnapshot& view_graph,
+    std::unordered_map<ViewId, Eigen::Vector3d>* orientations) {
+  CHECK_NOTNULL(orientations);
+  if (view_graph.NumEdges() == 0) {
     VLOG(2)
         << "Could not extract the maximum spanning tree from the view graph";
     return false;
   }
 
-  // Create an MST view graph.
-  ViewGraph mst_view_graph;
-  for (const ViewIdPair& edge : mst) {
-    mst_view_graph.AddEdge(
-        edge.first,
-        edge.second,
-        *largest_cc_subgraph.GetEdge(edge.first, edge.second));
+  // Compute the maximum spanning forest with Kruskal's algorithm by visiting
+  // the edges in decreasing order of the number of verified matches.
+  const int num_views = view_graph.NumViews();
+  const int num_edges = view_graph.NumEdges();
+  const std::vector<int>& num_verified_matches =
+      view_graph.NumVerifiedMatches();
+  std::vector<int> edge_order(num_edges);
+  for (int i = 0; i < num_edges; i++) {
+    edge_order[i] = i;
+  }
+  std::stable_sort(edge_order.begin(), edge_order.end(),
+                   [&](const int edge1, const int edge2) {
+                     return num_verified_matches[edge1] >
+                            num_verified_matches[edge2];
+                   });
+
+  std::vector<int> parents(num_views);
+  for (int i = 0; i < num_views; i++) {
+    parents[i] = i;
+  }
+  std::vector<int> tree_edges;
+  tree_edges.reserve(num_views - 1);
+  for (const int edge : edge_order) {
+    const int root1 = FindRoot(view_graph.EdgeViewIndex1(edge), &parents);
+    const int root2 = FindRoot(view_graph.EdgeViewIndex2(edge), &parents);
+    if (root1 != root2) {
+      parents[root2] = root1;
+      tree_edges.emplace_back(edge);
+    }
   }
 
-  // Chain the relative rotations together to compute orientations.  We use a
-  // heap to determine the next edges to add to the minimum spanning tree.
-  std::vector<HeapElement> heap;
-
-  // Set the root value.
-  const ViewId root_view_id = mst.begin()->first;
-  (*orientations)[root_view_id] = Eigen::Vector3d::Zero();
-  AddEdgesToHeap(mst_view_graph, *orientations, root_view_id, &heap);
-
-  while (!heap.empty()) {
-    const HeapElement next_edge = heap.front();
-    // Remove the best edge.
-    std::pop_heap(heap.begin(), heap.end(), SortHeapElement);
-    heap.pop_back();
-
-    // If the edge contains two vertices that have already been added then do
-    // nothing.
-    if (ContainsKey(*orientations, next_edge.second.second)) {
-      continue;
+  // The spanning tree is only valid on a single connected component so only the
+  // largest connected component is used.
+  std::vector<int> component_sizes(num_views, 0);
+  int largest_component = 0;
+  for (int i = 0; i < num_views; i++) {
+    const int root = FindRoot(i, &parents);
+    ++component_sizes[root];
+    if (component_sizes[root] > component_sizes[largest_component]) {
+      largest_component = root;
     }
+  }
 
-    // Compute the orientation for the vertex.
-    (*orientations)[next_edge.second.second] =
-        ComputeOrientation(FindOrDie(*orientations, next_edge.second.first),
-                           next_edge.first,
-                           next_edge.second.first,
-                           next_edge.second.second);
+  // Build the adjacency of the tree.
+  std::vector<int> tree_offsets(num_views + 1, 0);
+  for (const int edge : tree_edges) {
+    ++tree_offsets[view_graph.EdgeViewIndex1(edge) + 1];
+    ++tree_offsets[view_graph.EdgeViewIndex2(edge) + 1];
+  }
+  for (int i = 0; i < num_views; i++) {
+    tree_offsets[i + 1] += tree_offsets[i];
+  }
+  std::vector<int> tree_neighbor_edges(2 * tree_edges.size());
+  std::vector<int> next_neighbor(tree_offsets.begin(), tree_offsets.end() - 1);
+  for (const int edge : tree_edges) {
+    tree_neighbor_edges[next_neighbor[view_graph.EdgeViewIndex1(edge)]++] =
+        edge;
+    tree_neighbor_edges[next_neighbor[view_graph.EdgeViewIndex2(edge)]++] =
+        edge;
+  }
 
-    // Add all edges to the heap.
-    AddEdgesToHeap(
-        mst_view_graph, *orientations, next_edge.second.second, &heap);
+  // Chain the relative rotations together along the tree to compute
+  // orientations, starting from the root of the largest component.
+  std::vector<Eigen::Vector3d> tree_orientations(num_views);
+  std::vector<char> visited(num_views, 0);
+  std::vector<int> queue;
+  queue.reserve(component_sizes[largest_component]);
+  tree_orientations[largest_component].setZero();
+  visited[largest_component] = 1;
+  queue.emplace_back(largest_component);
+  for (int i = 0; i < queue.size(); i++) {
+    const int view_index = queue[i];
+    const ViewId view_id = view_graph.GetViewId(view_index);
+    (*orientations)[view_id] = tree_orientations[view_index];
+    for (int j = tree_offsets[view_index]; j < tree_offsets[view_index + 1];
+         j++) {
+      const int edge = tree_neighbor_edges[j];
+      const int neighbor = view_graph.EdgeViewIndex1(edge) == view_index
+                               ? view_graph.EdgeViewIndex2(edge)
+                               : view_graph.EdgeViewIndex1(edge);
+      if (visited[neighbor]) {
+        continue;
+      }
+
+      // Compute the orientation for the vertex.
+      tree_orientations[neighbor] =
+          ComputeOrientation(tree_orientations[view_index],
+                             view_graph.Rotations2()[edge],
+                             view_id,
+                             view_graph.GetViewId(neighbor));
+      visited[neighbor] = 1;
+      queue.emplace_back(neighbor);
+    }
   }
   return true;
 }
@@ -42,6 +42,7 @@
 
 namespace theia {
 class ViewGraph;
+class ViewGraphSnapshot;
 
 // Computes orientations of each view in the view graph by computing the maximum
 // spanning tree (by edge weight) and solving for the global orientations by
@@ -51,6 +52,11 @@ bool OrientationsFromMaximumSpanningTree(
     const ViewGraph& view_graph,
     std::unordered_map<ViewId, Eigen::Vector3d>* orientations);
 
+// Same as above, but operates directly on a snapshot of the view graph.
+bool OrientationsFromMaximumSpanningTree(
+    const ViewGraphSnapshot& view_graph,
+    std::unordered_map<ViewId, Eigen::Vector3d>* orientations);
+
 }  // namespace theia
 
 #endif  // THEIA_SFM_VIEW_GRAPH_ORIENTATIONS_FROM_MAXIMUM_SPANNING_TREE_H_
@@ -0,0 +1,150 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/sfm/view_graph/view_graph_snapshot.h"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "theia/sfm/twoview_info.h"
+#include "theia/sfm/types.h"
+#include "theia/sfm/view_graph/view_graph.h"
+
+namespace theia {
+
+ViewGraphSnapshot::ViewGraphSnapshot(const ViewGraph& view_graph) {
+  // Assign view indices in order of view id.
+  const std::unordered_set<ViewId> view_ids = view_graph.ViewIds();
+  view_ids_.assign(view_ids.begin(), view_ids.end());
+  std::sort(view_ids_.begin(), view_ids_.end());
+
+  // Sort the edges by the view indices of their endpoints.
+  const auto& view_pairs = view_graph.GetAllEdges();
+  std::vector<std::pair<std::pair<int, int>, const TwoViewInfo*> > edges;
+  edges.reserve(view_pairs.size());
+  for (const auto& view_pair : view_pairs) {
+    edges.emplace_back(std::make_pair(ViewIndex(view_pair.first.first),
+                                      ViewIndex(view_pair.first.second)),
+                       &view_pair.second);
+  }
+  std::sort(edges.begin(), edges.end(),
+            [](const std::pair<std::pair<int, int>, const TwoViewInfo*>& lhs,
+               const std::pair<std::pair<int, int>, const TwoViewInfo*>& rhs) {
+              return lhs.first < rhs.first;
+            });
+
+  const int num_edges = edges.size();
+  edge_view_index1_.resize(num_edges);
+  edge_view_index2_.resize(num_edges);
+  focal_length_1_.resize(num_edges);
+  focal_length_2_.resize(num_edges);
+  position_2_.resize(num_edges);
+  rotation_2_.resize(num_edges);
+  num_verified_matches_.resize(num_edges);
+  num_homography_inliers_.resize(num_edges);
+  visibility_score_.resize(num_edges);
+  for (int i = 0; i < num_edges; i++) {
+    const TwoViewInfo& info = *edges[i].second;
+    edge_view_index1_[i] = edges[i].first.first;
+    edge_view_index2_[i] = edges[i].first.second;
+    focal_length_1_[i] = info.focal_length_1;
+    focal_length_2_[i] = info.focal_length_2;
+    position_2_[i] = info.position_2;
+    rotation_2_[i] = info.rotation_2;
+    num_verified_matches_[i] = info.num_verified_matches;
+    num_homography_inliers_[i] = info.num_homography_inliers;
+    visibility_score_[i] = info.visibility_score;
+  }
+
+  // Build the adjacency. Since the edges are sorted, visiting them in order
+  // appends the neighbors of each view in increasing order of view index.
+  adjacency_offsets_.assign(view_ids_.size() + 1, 0);
+  for (int i = 0; i < num_edges; i++) {
+    ++adjacency_offsets_[edge_view_index1_[i] + 1];
+    ++adjacency_offsets_[edge_view_index2_[i] + 1];
+  }
+  for (int i = 0; i < view_ids_.size(); i++) {
+    adjacency_offsets_[i + 1] += adjacency_offsets_[i];
+  }
+  adjacency_neighbors_.resize(2 * num_edges);
+  adjacency_edges_.resize(2 * num_edges);
+  std::vector<int> next_entry(adjacency_offsets_.begin(),
+                              adjacency_offsets_.end() - 1);
+  for (int i = 0; i < num_edges; i++) {
+    const int view_index1 = edge_view_index1_[i];
+    const int view_index2 = edge_view_index2_[i];
+    adjacency_neighbors_[next_entry[view_index1]] = view_index2;
+    adjacency_edges_[next_entry[view_index1]++] = i;
+    adjacency_neighbors_[next_entry[view_index2]] = view_index1;
+    adjacency_edges_[next_entry[view_index2]++] = i;
+  }
+}
+
+int ViewGraphSnapshot::ViewIndex(const ViewId view_id) const {
+  const auto it =
+      std::lower_bound(view_ids_.begin(), view_ids_.end(), view_id);
+  if (it == view_ids_.end() || *it != view_id) {
+    return -1;
+  }
+  return it - view_ids_.begin();
+}
+
+TwoViewInfo ViewGraphSnapshot::GetTwoViewInfo(const int edge) const {
+  TwoViewInfo info;
+  info.focal_length_1 = focal_length_1_[edge];
+  info.focal_length_2 = focal_length_2_[edge];
+  info.position_2 = position_2_[edge];
+  info.rotation_2 = rotation_2_[edge];
+  info.num_verified_matches = num_verified_matches_[edge];
+  info.num_homography_inliers = num_homography_inliers_[edge];
+  info.visibility_score = visibility_score_[edge];
+  return info;
+}
+
+int ViewGraphSnapshot::FindEdge(const int view_index1,
+                                const int view_index2) const {
+  const int* neighbors_begin = Neighbors(view_index1);
+  const int* neighbors_end = neighbors_begin + Degree(view_index1);
+  const int* it = std::lower_bound(neighbors_begin, neighbors_end, view_index2);
+  if (it == neighbors_end || *it != view_index2) {
+    return -1;
+  }
+  return IncidentEdges(view_index1)[it - neighbors_begin];
+}
+
+}  // namespace theia
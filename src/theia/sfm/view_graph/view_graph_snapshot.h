@@ -0,0 +1,145 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_SFM_VIEW_GRAPH_VIEW_GRAPH_SNAPSHOT_H_
+#define THEIA_SFM_VIEW_GRAPH_VIEW_GRAPH_SNAPSHOT_H_
+
+#include <Eigen/Core>
+#include <vector>
+
+#include "theia/sfm/twoview_info.h"
+#include "theia/sfm/types.h"
+#include "theia/util/util.h"
+
+namespace theia {
+class ViewGraph;
+
+// An immutable snapshot of a ViewGraph in a compact, compressed sparse row
+// (CSR) form. Views are given dense indices in [0, NumViews()) in increasing
+// order of view id, and edges are given dense indices in [0, NumEdges()) sorted
+// by the view indices of their endpoints. The TwoViewInfo values of the edges
+// are stored as separate arrays (struct-of-arrays) so that algorithms that only
+// need e.g. the relative rotations touch contiguous memory.
+//
+// The snapshot is cheap to build (a single sort of the edges) and lets the
+// global SfM stages iterate over the view graph with plain array indexing
+// instead of hash lookups and without building their own view id to index
+// maps. Changes to the ViewGraph after the snapshot is taken are not reflected.
+// Since the global SfM stages remove edges or update the two view geometries of
+// the view graph in between them, each stage takes its own snapshot of the view
+// graph it is given rather than sharing one across the pipeline.
+class ViewGraphSnapshot {
+ public:
+  explicit ViewGraphSnapshot(const ViewGraph& view_graph);
+
+  int NumViews() const { return view_ids_.size(); }
+  int NumEdges() const { return edge_view_index1_.size(); }
+
+  // The view ids of all views, sorted in increasing order. The view index of a
+  // view is its position in this vector.
+  const std::vector<ViewId>& ViewIds() const { return view_ids_; }
+  ViewId GetViewId(const int view_index) const { return view_ids_[view_index]; }
+
+  // Returns the view index of the view id or -1 if the view is not in the view
+  // graph.
+  int ViewIndex(const ViewId view_id) const;
+
+  // The view indices of the endpoints of the edge. Since view indices are
+  // assigned in order of view id, EdgeViewIndex1(e) < EdgeViewIndex2(e) and the
+  // TwoViewInfo of the edge describes the second view relative to the first.
+  int EdgeViewIndex1(const int edge) const { return edge_view_index1_[edge]; }
+  int EdgeViewIndex2(const int edge) const { return edge_view_index2_[edge]; }
+
+  // The values of the TwoViewInfo of each edge.
+  const std::vector<double>& FocalLengths1() const { return focal_length_1_; }
+  const std::vector<double>& FocalLengths2() const { return focal_length_2_; }
+  const std::vector<Eigen::Vector3d>& Positions2() const { return position_2_; }
+  const std::vector<Eigen::Vector3d>& Rotations2() const { return rotation_2_; }
+  const std::vector<int>& NumVerifiedMatches() const {
+    return num_verified_matches_;
+  }
+  const std::vector<int>& NumHomographyInliers() const {
+    return num_homography_inliers_;
+  }
+  const std::vector<int>& VisibilityScores() const { return visibility_score_; }
+
+  // Reassembles the TwoViewInfo of the edge.
+  TwoViewInfo GetTwoViewInfo(const int edge) const;
+
+  // The number of edges incident to the view.
+  int Degree(const int view_index) const {
+    return adjacency_offsets_[view_index + 1] - adjacency_offsets_[view_index];
+  }
+
+  // The neighbors of the view and the edges connecting the view to them,
+  // sorted by the view index of the neighbor. Both ranges have Degree()
+  // elements.
+  const int* Neighbors(const int view_index) const {
+    return adjacency_neighbors_.data() + adjacency_offsets_[view_index];
+  }
+  const int* IncidentEdges(const int view_index) const {
+    return adjacency_edges_.data() + adjacency_offsets_[view_index];
+  }
+
+  // Returns the index of the edge between the two views or -1 if the views are
+  // not connected.
+  int FindEdge(const int view_index1, const int view_index2) const;
+
+ private:
+  std::vector<ViewId> view_ids_;
+
+  // Edge endpoints.
+  std::vector<int> edge_view_index1_;
+  std::vector<int> edge_view_index2_;
+
+  // Edge values.
+  std::vector<double> focal_length_1_;
+  std::vector<double> focal_length_2_;
+  std::vector<Eigen::Vector3d> position_2_;
+  std::vector<Eigen::Vector3d> rotation_2_;
+  std::vector<int> num_verified_matches_;
+  std::vector<int> num_homography_inliers_;
+  std::vector<int> visibility_score_;
+
+  // Adjacency of each view in CSR form.
+  std::vector<int> adjacency_offsets_;
+  std::vector<int> adjacency_neighbors_;
+  std::vector<int> adjacency_edges_;
+
+  DISALLOW_COPY_AND_ASSIGN(ViewGraphSnapshot);
+};
+
+}  // namespace theia
+
+#endif  // THEIA_SFM_VIEW_GRAPH_VIEW_GRAPH_SNAPSHOT_H_
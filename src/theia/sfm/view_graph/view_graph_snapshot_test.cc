@@ -0,0 +1,149 @@
+// Copyright (C) 2018 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "theia/util/random.h"
+#include "theia/sfm/twoview_info.h"
+#include "theia/sfm/types.h"
+#include "theia/sfm/view_graph/view_graph.h"
+#include "theia/sfm/view_graph/view_graph_snapshot.h"
+
+namespace theia {
+
+namespace {
+
+RandomNumberGenerator rng(49);
+
+}  // namespace
+
+TEST(ViewGraphSnapshot, Empty) {
+  ViewGraph view_graph;
+  const ViewGraphSnapshot snapshot(view_graph);
+  EXPECT_EQ(snapshot.NumViews(), 0);
+  EXPECT_EQ(snapshot.NumEdges(), 0);
+  EXPECT_EQ(snapshot.ViewIndex(0), -1);
+}
+
+TEST(ViewGraphSnapshot, MatchesViewGraph) {
+  static const int kNumViews = 40;
+  static const int kNumEdges = 200;
+
+  // Use sparse view ids so that view indices and view ids differ.
+  ViewGraph view_graph;
+  while (view_graph.NumEdges() < kNumEdges) {
+    const ViewId view_id1 = 3 * rng.RandInt(0, kNumViews - 1);
+    const ViewId view_id2 = 3 * rng.RandInt(0, kNumViews - 1);
+    if (view_id1 == view_id2 || view_graph.HasEdge(view_id1, view_id2)) {
+      continue;
+    }
+    TwoViewInfo info;
+    info.focal_length_1 = rng.RandDouble(100.0, 1000.0);
+    info.focal_length_2 = rng.RandDouble(100.0, 1000.0);
+    info.position_2 = rng.RandVector3d();
+    info.rotation_2 = rng.RandVector3d();
+    info.num_verified_matches = rng.RandInt(0, 1000);
+    info.num_homography_inliers = rng.RandInt(0, 1000);
+    info.visibility_score = rng.RandInt(0, 1000);
+    view_graph.AddEdge(view_id1, view_id2, info);
+  }
+
+  const ViewGraphSnapshot snapshot(view_graph);
+  EXPECT_EQ(snapshot.NumViews(), view_graph.NumViews());
+  EXPECT_EQ(snapshot.NumEdges(), view_graph.NumEdges());
+
+  // The view ids are sorted and map back to their indices.
+  for (int i = 0; i < snapshot.NumViews(); i++) {
+    EXPECT_TRUE(view_graph.HasView(snapshot.GetViewId(i)));
+    EXPECT_EQ(snapshot.ViewIndex(snapshot.GetViewId(i)), i);
+    if (i > 0) {
+      EXPECT_LT(snapshot.GetViewId(i - 1), snapshot.GetViewId(i));
+    }
+  }
+  EXPECT_EQ(snapshot.ViewIndex(1), -1);
+
+  // The edges are sorted and hold the same values as the view graph.
+  for (int i = 0; i < snapshot.NumEdges(); i++) {
+    const int view_index1 = snapshot.EdgeViewIndex1(i);
+    const int view_index2 = snapshot.EdgeViewIndex2(i);
+    EXPECT_LT(view_index1, view_index2);
+    if (i > 0) {
+      EXPECT_LT(std::make_pair(snapshot.EdgeViewIndex1(i - 1),
+                               snapshot.EdgeViewIndex2(i - 1)),
+                std::make_pair(view_index1, view_index2));
+    }
+
+    const TwoViewInfo* info = view_graph.GetEdge(
+        snapshot.GetViewId(view_index1), snapshot.GetViewId(view_index2));
+    ASSERT_NE(info, nullptr);
+    const TwoViewInfo snapshot_info = snapshot.GetTwoViewInfo(i);
+    EXPECT_EQ(snapshot_info.focal_length_1, info->focal_length_1);
+    EXPECT_EQ(snapshot_info.focal_length_2, info->focal_length_2);
+    EXPECT_EQ(snapshot_info.position_2, info->position_2);
+    EXPECT_EQ(snapshot_info.rotation_2, info->rotation_2);
+    EXPECT_EQ(snapshot_info.num_verified_matches, info->num_verified_matches);
+    EXPECT_EQ(snapshot_info.num_homography_inliers,
+              info->num_homography_inliers);
+    EXPECT_EQ(snapshot_info.visibility_score, info->visibility_score);
+    EXPECT_EQ(snapshot.Rotations2()[i], info->rotation_2);
+
+    EXPECT_EQ(snapshot.FindEdge(view_index1, view_index2), i);
+    EXPECT_EQ(snapshot.FindEdge(view_index2, view_index1), i);
+  }
+
+  // The adjacency of each view is sorted and consistent with the edges.
+  for (int i = 0; i < snapshot.NumViews(); i++) {
+    const ViewId view_id = snapshot.GetViewId(i);
+    EXPECT_EQ(snapshot.Degree(i),
+              view_graph.GetNeighborIdsForView(view_id)->size());
+    for (int j = 0; j < snapshot.Degree(i); j++) {
+      const int neighbor = snapshot.Neighbors(i)[j];
+      const int edge = snapshot.IncidentEdges(i)[j];
+      if (j > 0) {
+        EXPECT_LT(snapshot.Neighbors(i)[j - 1], neighbor);
+      }
+      EXPECT_TRUE(view_graph.HasEdge(view_id, snapshot.GetViewId(neighbor)));
+      EXPECT_TRUE((snapshot.EdgeViewIndex1(edge) == i &&
+                   snapshot.EdgeViewIndex2(edge) == neighbor) ||
+                  (snapshot.EdgeViewIndex1(edge) == neighbor &&
+                   snapshot.EdgeViewIndex2(edge) == i));
+    }
+  }
+}
+
+}  // namespace theia
@@ -78,9 +78,22 @@ class LRUCache {
     cache_hits_ = 0;
   }
 
+  // Creates a cache without a cache miss function. The cache must then be
+  // filled with Insert or InsertIfMissing and accessed with FetchIfCached.
+  explicit LRUCache(const int max_cache_entries)
+      : max_cache_entries_(max_cache_entries) {
+    CHECK_GT(max_cache_entries_, 0)
+        << "The maximum number of cache entries must be greater than 0.";
+    cache_misses_ = 0;
+    cache_hits_ = 0;
+  }
+
   // Fetch the entry and return the value. If the entry is in the cache then it
   // will be returned efficiently.
+  //
+  // NOTE: The cache miss function is called while the cache is locked.
   virtual ValueType Fetch(const KeyType& key) {
+    CHECK(fetch_entry_) << "The cache does not have a cache miss function.";
     std::lock_guard<std::mutex> lock(mutex_);
     const auto it = cache_entries_map_.find(key);
 
@@ -113,6 +126,39 @@ class LRUCache {
     InsertIntoCache(key, value);
   }
 
+  // Returns true and sets the value if the entry is in the cache. Unlike Fetch,
+  // an entry that is not in the cache is not fetched so that the caller may
+  // compute the value without holding the cache lock.
+  virtual bool FetchIfCached(const KeyType& key, ValueType* value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = cache_entries_map_.find(key);
+    if (it == cache_entries_map_.end()) {
+      ++cache_misses_;
+      return false;
+    }
+
+    ++cache_hits_;
+    cache_entries_.splice(
+        cache_entries_.end(), cache_entries_, it->second.second);
+    *CHECK_NOTNULL(value) = it->second.first;
+    return true;
+  }
+
+  // Inserts a key-value pair into the cache unless the key is already in the
+  // cache, and returns the cached value. Multiple threads may compute the value
+  // of the same key after a miss in FetchIfCached, in which case all of them
+  // use the value of the first thread to insert it.
+  virtual ValueType InsertIfMissing(const KeyType& key,
+                                    const ValueType& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = cache_entries_map_.find(key);
+    if (it != cache_entries_map_.end()) {
+      return it->second.first;
+    }
+    InsertIntoCache(key, value);
+    return value;
+  }
+
   // Return if the key exists in the cache.
   virtual bool ExistsInCache(const KeyType& key) {
     return ContainsKey(cache_entries_map_, key);
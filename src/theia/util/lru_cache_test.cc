@@ -134,4 +134,31 @@ TEST(LRUCache, FetchWithCacheMiss) {
   EXPECT_EQ(lru_cache.NumCacheHits(), 0);
 }
 
+TEST(LRUCache, FetchIfCachedAndInsertIfMissing) {
+  const int kMaxCacheSize = 1;
+  LRUCache<int, int> lru_cache(kMaxCacheSize);
+  int value = 0;
+  EXPECT_FALSE(lru_cache.FetchIfCached(0, &value));
+  EXPECT_EQ(lru_cache.Size(), 0);
+  EXPECT_EQ(lru_cache.NumCacheMisses(), 1);
+
+  EXPECT_EQ(lru_cache.InsertIfMissing(0, FindOrDie(cache_lookup, 0)),
+            FindOrDie(cache_lookup, 0));
+  // A value inserted for a key that is already in the cache is discarded.
+  EXPECT_EQ(lru_cache.InsertIfMissing(0, FindOrDie(cache_lookup, 1)),
+            FindOrDie(cache_lookup, 0));
+  EXPECT_TRUE(lru_cache.FetchIfCached(0, &value));
+  EXPECT_EQ(value, FindOrDie(cache_lookup, 0));
+  EXPECT_EQ(lru_cache.Size(), 1);
+  EXPECT_EQ(lru_cache.NumCacheHits(), 1);
+
+  // Inserting a new key evicts the oldest entry.
+  EXPECT_EQ(lru_cache.InsertIfMissing(1, FindOrDie(cache_lookup, 1)),
+            FindOrDie(cache_lookup, 1));
+  EXPECT_FALSE(lru_cache.FetchIfCached(0, &value));
+  EXPECT_TRUE(lru_cache.FetchIfCached(1, &value));
+  EXPECT_EQ(value, FindOrDie(cache_lookup, 1));
+  EXPECT_EQ(lru_cache.Size(), 1);
+}
+
 }  // namespace theia
@@ -62,6 +62,7 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <condition_variable>
 #include <functional>
 #include <future>
@@ -114,4 +115,36 @@ ThreadPool::~ThreadPool() {
     worker.join();
 }
 
+void ParallelFor(ThreadPool* pool,
+                 const int start,
+                 const int end,
+                 const int min_block_size,
+                 const std::function<void(int, int)>& func) {
+  const int num_items = end - start;
+  if (num_items <= 0) {
+    return;
+  }
+  if (pool == nullptr || pool->NumThreads() == 1 ||
+      num_items < 2 * min_block_size) {
+    func(start, end);
+    return;
+  }
+
+  // Use a few blocks per thread so that the load stays balanced when the cost
+  // per item varies.
+  static const int kNumBlocksPerThread = 4;
+  const int block_size = std::max(
+      min_block_size,
+      (num_items + kNumBlocksPerThread * pool->NumThreads() - 1) /
+          (kNumBlocksPerThread * pool->NumThreads()));
+  std::vector<std::future<void> > futures;
+  futures.reserve((num_items + block_size - 1) / block_size);
+  for (int i = start; i < end; i += block_size) {
+    futures.emplace_back(pool->Add(func, i, std::min(i + block_size, end)));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
 }  // namespace theia
@@ -93,6 +93,9 @@ class ThreadPool {
   auto Add(F&& f, Args&& ... args)
       ->std::future<typename std::result_of<F(Args...)>::type>;
 
+  // Returns the number of worker threads.
+  int NumThreads() const { return workers.size(); }
+
  private:
   // Keep track of threads so we can join them
   std::vector<std::thread> workers;
@@ -132,6 +135,17 @@ auto ThreadPool::Add(F&& f, Args&& ... args)
   return res;
 }
 
+// Splits [start, end) into contiguous blocks of at least min_block_size items
+// and calls func(block_start, block_end) for each block on the thread pool,
+// returning once all blocks have been processed. If the pool is null or the
+// range is too small to split, func is called once on the calling thread. This
+// must not be called from within a task of the same pool.
+void ParallelFor(ThreadPool* pool,
+                 const int start,
+                 const int end,
+                 const int min_block_size,
+                 const std::function<void(int, int)>& func);
+
 }  // namespace theia
 
 #endif  // THEIA_UTIL_THREADPOOL_H_